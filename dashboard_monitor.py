@@ -8,11 +8,13 @@ import serial.tools.list_ports
 import pandas as pd
 import threading
 import time
-import re
+import struct
 import os
 import glob
+import json
 from datetime import datetime
 from collections import deque
+from telemetry_protocol import *  # Định dạng khung telemetry nhị phân, giải mã COBS/CRC
 
 # =============================================================================
 # 1. CẤU HÌNH HỆ THỐNG (SYSTEM CONFIGURATION)
@@ -79,6 +81,7 @@ class MedicalMonitorApp:
         """Khởi tạo các biến toàn cục"""
         self.running = False           # Trạng thái vòng lặp Serial
         self.ser = None                # Đối tượng Serial
+        self.tx_seq = 0                # Số thứ tự khung lệnh gửi xuống thiết bị
         self.thread = None             # Luồng đọc dữ liệu
         
         # Buffer dữ liệu hiển thị biểu đồ
@@ -91,6 +94,14 @@ class MedicalMonitorApp:
         # Cấu hình ngưỡng cảnh báo
         self.alarm_threshold = 120
         
+        # Trạng thái giao thức telemetry
+        self.last_seq = None
+        self.frames_lost = 0
+
+        # File CSV ghi dạng sóng thô (mở khi nhận khung thô đầu tiên)
+        self.raw_files = {}
+        self.trace = TraceAssembler()  # Gom khung TLM_MSG_TRACE của một lần xuất ghi vết
+
         # Dataframe lịch sử
         self.df_history = pd.DataFrame()
         
@@ -189,6 +200,8 @@ class MedicalMonitorApp:
         self.create_styled_button(btn_frame, "🔌 KẾT NỐI / NGẮT", self.toggle_connection, "#444").pack(fill=tk.X, pady=5)
         self.create_styled_button(btn_frame, "📝 THÊM GHI CHÚ", self.add_annotation, "#555").pack(fill=tk.X, pady=5)
         self.create_styled_button(btn_frame, "⚙️ CÀI ĐẶT NGƯỠNG", self.set_threshold, "#555").pack(fill=tk.X, pady=5)
+        self.create_styled_button(btn_frame, "🛠️ CẤU HÌNH THIẾT BỊ", self.device_config, "#555").pack(fill=tk.X, pady=5)
+        self.create_styled_button(btn_frame, "🧭 LẤY TRACE", self.request_trace, "#555").pack(fill=tk.X, pady=5)
         self.create_styled_button(btn_frame, "📸 CHỤP MÀN HÌNH", self.snapshot_graph, "#555").pack(fill=tk.X, pady=5)
         self.create_styled_button(btn_frame, "🔄 RESET BIỂU ĐỒ", self.reset_graph, "#666").pack(fill=tk.X, pady=5)
 
@@ -319,6 +332,8 @@ class MedicalMonitorApp:
             if self.ser: 
                 try: self.ser.close()
                 except: pass
+            for f in self.raw_files.values():
+                f.close()
             self.lbl_status.config(text="DISCONNECTED", fg="gray")
             self.log_terminal("Ngắt kết nối.")
         else:
@@ -338,50 +353,170 @@ class MedicalMonitorApp:
             messagebox.showerror("Lỗi", str(e))
 
     def serial_read_loop(self):
+        """Tách luồng byte theo 0x00: khung hợp lệ được xử lý, phần còn lại (log ESP) hiện ra terminal."""
+        rx = bytearray()
         while self.running:
             try:
                 if self.ser.in_waiting:
-                    line = self.ser.readline().decode('utf-8', errors='ignore').strip()
-                    if line:
-                        if len(line) < 150: self.root.after(0, self.log_terminal, line)
-                        if "| ML PREDICTION:" in line:
-                            self.process_data_line(line)
+                    rx += self.ser.read(self.ser.in_waiting)
+                    while b"\x00" in rx:
+                        chunk, _, rx = rx.partition(b"\x00")
+                        self.handle_chunk(bytes(chunk))
             except Exception as e:
                 print(f"Serial Error: {e}")
                 break
             time.sleep(0.01)
 
-    def process_data_line(self, line):
-        pattern = r"\| ML PREDICTION: Class (\d+) \((.*?)\) \| Inputs: HR=(\d+), SpO2=([\d.]+), HRV=([\d.]+), Acc=([\d.]+)"
-        match = re.search(pattern, line)
-        if match:
-            class_id = int(match.group(1))
-            status_text = match.group(2)
-            hr = int(match.group(3))
-            spo2 = float(match.group(4))
-            hrv = float(match.group(5))
-            accel = float(match.group(6))
-            
-            # --- FIX SPO2 CLAMP ---
-            if spo2 > 99.9: spo2 = 99.9
-            
-            self.root.after(0, self.update_dashboard_ui, hr, spo2, status_text, accel)
-            
-            now = datetime.now()
-            record = {
-                'Date': now.strftime("%Y-%m-%d"),
-                'Time': now.strftime("%H:%M:%S"),
-                'HR': hr,
-                'SpO2': spo2,
-                'HRV': hrv,
-                'Status': status_text,
-                'Accel': accel,
-                'Class_ID': class_id
-            }
-            self.data_buffer.append(record)
-            
-            if time.time() - self.last_save_time > SAVE_INTERVAL_SEC:
-                self.save_data_to_excel()
+    def handle_chunk(self, chunk):
+        if not chunk:
+            return
+        # Log văn bản (ESP_LOG) có thể nằm trước khung: thử tách sau mỗi dấu xuống dòng
+        starts = [0] + [i + 1 for i, b in enumerate(chunk) if b == 0x0A]
+        for start in starts:
+            parsed = parse_frame(chunk[start:])
+            if parsed:
+                self.log_text(chunk[:start])
+                self.process_frame(*parsed)
+                return
+        self.log_text(chunk)
+
+    def log_text(self, data):
+        for line in data.decode('utf-8', errors='ignore').splitlines():
+            line = line.strip()
+            if line and len(line) < 150:
+                self.root.after(0, self.log_terminal, line)
+
+    def process_frame(self, msg_type, seq, payload):
+        # Phát hiện mất khung theo số thứ tự
+        if self.last_seq is not None:
+            lost = (seq - self.last_seq - 1) & 0xFFFF
+            if lost:
+                self.frames_lost += lost
+                self.root.after(0, self.log_terminal, f"[TLM] Mất {lost} khung (tổng {self.frames_lost})")
+        self.last_seq = seq
+
+        try:
+            if msg_type == TLM_MSG_VITALS:
+                self.process_vitals(payload)
+            elif msg_type == TLM_MSG_EVENT:
+                self.process_event(payload)
+            elif msg_type == TLM_MSG_DIAG:
+                self.process_diag(payload)
+            elif msg_type == TLM_MSG_RAW:
+                self.process_raw(payload)
+            elif msg_type == TLM_MSG_CONFIG:
+                self.process_config(payload)
+            elif msg_type == TLM_MSG_PERF:
+                t_ms, interval_ms, stages = decode_perf(payload)
+                self.root.after(0, self.log_terminal, f"[PERF] min/avg/p99/max us: {format_perf(stages)}")
+            elif msg_type == TLM_MSG_TRACE:
+                self.process_trace(payload)
+            elif msg_type == TLM_MSG_SYSMON:
+                header, tasks = decode_sysmon(payload)
+                self.root.after(0, self.log_terminal, f"[SYS] {format_sysmon(header, tasks)}")
+        except struct.error as e:
+            self.root.after(0, self.log_terminal, f"[TLM] Khung loại {msg_type} sai kích thước: {e}")
+
+    def process_vitals(self, payload):
+        (t_ms, class_id, sqi, hr_x10, spo2_x10, hrv_x10, accel_mg, energy_x1e4,
+         sdnn_x10, pnn50_x10, lf, hf, lf_hf_x100, rr_count, temp_x100) = struct.unpack_from(VITALS_FORMAT, payload)
+        hr = int(round(hr_x10 / 10.0))
+        spo2 = spo2_x10 / 10.0
+        hrv = hrv_x10 / 10.0
+        accel = accel_mg / 1000.0
+        status_text = CLASS_NAMES[class_id] if class_id < len(CLASS_NAMES) else "Unknown"
+
+        # --- FIX SPO2 CLAMP ---
+        if spo2 > 99.9: spo2 = 99.9
+
+        self.root.after(0, self.update_dashboard_ui, hr, spo2, status_text, accel)
+        self.root.after(0, self.log_terminal,
+                        f"| Class {class_id} ({status_text}) | HR={hr_x10 / 10.0:.1f}, SpO2={spo2:.1f}, HRV={hrv:.1f}, "
+                        f"Acc={accel:.2f}, SDNN={sdnn_x10 / 10.0:.1f}, LF/HF={lf_hf_x100 / 100.0:.2f}, RR={rr_count} |")
+
+        now = datetime.now()
+        record = {
+            'Date': now.strftime("%Y-%m-%d"),
+            'Time': now.strftime("%H:%M:%S"),
+            'HR': hr,
+            'SpO2': spo2,
+            'HRV': hrv,
+            'Status': status_text,
+            'Accel': accel,
+            'Class_ID': class_id
+        }
+        self.data_buffer.append(record)
+
+        if time.time() - self.last_save_time > SAVE_INTERVAL_SEC:
+            self.save_data_to_excel()
+
+    def process_event(self, payload):
+        t_ms, code = struct.unpack_from(EVENT_HEADER_FORMAT, payload)
+        data = payload[struct.calcsize(EVENT_HEADER_FORMAT):]
+        if code == TLM_EVT_SQI_REJECT:
+            reason, dc, pi, clip, kurt, zc, zc_cv, temp = struct.unpack_from(EVT_SQI_FORMAT, data)
+            name = SQI_REASONS[reason] if reason < len(SQI_REASONS) else str(reason)
+            text = (f"| WARNING: Low signal quality (SQI: {name}, DC={dc}, PI={pi / 100.0:.2f}, "
+                    f"Clip={clip / 10.0:.1f}, Kurt={kurt / 10.0:.1f}, ZC={zc / 100.0:.2f}/{zc_cv / 100.0:.2f}). Temp:{temp / 100.0:.2f}")
+        elif code == TLM_EVT_LOW_CORRELATION:
+            corr, temp = struct.unpack_from(EVT_CORR_FORMAT, data)
+            text = f"| WARNING: Low signal quality (Corr: {corr / 1000.0:.2f}). Temp:{temp / 100.0:.2f}"
+        elif code == TLM_EVT_PROX_ENTER:
+            text = "| POWER: Entering proximity mode (no finger) |"
+        elif code == TLM_EVT_PROX_EXIT:
+            text = "| POWER: Finger detected, resuming measurement |"
+        elif code == TLM_EVT_AGC:
+            o1, n1, o2, n2, orge, nrge, gr, gi = struct.unpack_from(EVT_AGC_FORMAT, data)
+            text = (f"| AGC: LED1 0x{o1:02X}->0x{n1:02X}, LED2 0x{o2:02X}->0x{n2:02X}, RGE {orge}->{nrge}, "
+                    f"Gain R={gr / 1000.0:.3f} IR={gi / 1000.0:.3f} |")
+        else:
+            text = f"[TLM] Sự kiện {code} tại {t_ms} ms"
+        self.root.after(0, self.log_terminal, text)
+
+    def process_diag(self, payload):
+        (t_ms, freq, tx, err, timeout, probe_fail, accel_ovf, agc, frames, dropped,
+         raw_frames, raw_dropped, udp_datagrams, udp_dropped, udp_errors,
+         ppg_lost) = struct.unpack_from(DIAG_FORMAT, payload)
+        self.root.after(0, self.log_terminal,
+                        f"| DIAG: I2C {freq} Hz Tx={tx} Err={err} Timeout={timeout} | AccelOvf={accel_ovf} "
+                        f"PpgLost={ppg_lost} "
+                        f"AGC={agc} | TLM {frames} khung, bỏ {dropped}, mất {self.frames_lost} "
+                        f"| RAW {raw_frames} khung, bỏ {raw_dropped} | UDP {udp_datagrams} gói, bỏ {udp_dropped}, lỗi {udp_errors} |")
+
+    def process_config(self, payload):
+        version, param, status, value = struct.unpack_from(CONFIG_FORMAT, payload)
+        name = CONFIG_PARAMS[param] if param < len(CONFIG_PARAMS) else f"#{param}"
+        status_text = CONFIG_STATUS[status] if status < len(CONFIG_STATUS) else str(status)
+        self.root.after(0, self.log_terminal, f"[CFG] {name} = {value:g} (v{version}, {status_text})")
+
+    def process_trace(self, payload):
+        """Khối cuối của lần xuất: lưu Chrome trace JSON (mở bằng ui.perfetto.dev)."""
+        if not self.trace.add_frame(payload):
+            return
+        path = os.path.join(DATA_FOLDER, f"Trace_{datetime.now().strftime('%Y%m%d_%H%M%S')}.json")
+        with open(path, "w") as f:
+            json.dump(self.trace.to_chrome(), f)
+        self.root.after(0, self.log_terminal,
+                        f"[TRACE] {len(self.trace.events)} sự kiện, {len(self.trace.tasks)} task -> {path}")
+        self.trace.reset()
+
+    def process_raw(self, payload):
+        """Ghi từng mẫu thô vào CSV theo luồng (ppg/accel) để thu thập dữ liệu."""
+        stream, flags, t0_ms, period_us, data = decode_raw(payload)
+        if stream not in RAW_STREAM_NAMES:
+            return
+        name, columns = RAW_STREAM_NAMES[stream]
+        f = self.raw_files.get(stream)
+        if f is None:
+            path = os.path.join(DATA_FOLDER, f"Raw_{name}_{datetime.now().strftime('%Y%m%d_%H%M%S')}.csv")
+            f = open(path, "w", buffering=1)
+            f.write("t_ms,flags," + ",".join(columns) + "\n")
+            self.raw_files[stream] = f
+            self.root.after(0, self.log_terminal, f"[RAW] Ghi dạng sóng thô vào {path}")
+        for k in range(len(data[0])):
+            t = t0_ms + k * period_us / 1000.0
+            sample_flags = flags if k == 0 else 0
+            f.write(f"{t:.2f},{sample_flags}," + ",".join(str(ch[k]) for ch in data) + "\n")
 
     def update_dashboard_ui(self, hr, spo2, status, accel):
         self.lbl_hr.config(text=str(hr))
@@ -607,6 +742,40 @@ class MedicalMonitorApp:
         v = simpledialog.askinteger("Cài đặt", "Ngưỡng BPM:", initialvalue=self.alarm_threshold)
         if v: self.alarm_threshold = v
 
+    def device_config(self):
+        """Đọc/ghi cấu hình chạy của thiết bị: "tên=giá trị", thêm "!" ở cuối để lưu NVS, để trống để đọc tất cả."""
+        if not (self.ser and self.ser.is_open):
+            messagebox.showwarning("Cấu hình", "Chưa kết nối thiết bị")
+            return
+        cmd = simpledialog.askstring("Cấu hình thiết bị",
+                                     "tên=giá trị (thêm ! để lưu), trống = đọc tất cả\n" + ", ".join(CONFIG_PARAMS))
+        if cmd is None:
+            return
+        cmd = cmd.strip()
+        try:
+            if not cmd:
+                frame = config_get_frame(self.tx_seq)
+            elif "=" in cmd:
+                name, value = cmd.split("=", 1)
+                persist = value.strip().endswith("!")
+                frame = config_set_frame(self.tx_seq, name.strip(), float(value.strip().rstrip("!")), persist)
+            else:
+                frame = config_get_frame(self.tx_seq, cmd)
+        except ValueError:
+            messagebox.showerror("Cấu hình", f"Lệnh không hợp lệ: {cmd}")
+            return
+        self.tx_seq = (self.tx_seq + 1) & 0xFFFF
+        self.ser.write(frame)
+
+    def request_trace(self):
+        """Yêu cầu thiết bị xuất vòng ghi vết (cần bật CONFIG_TRACE_RECORDER)."""
+        if not (self.ser and self.ser.is_open):
+            messagebox.showwarning("Trace", "Chưa kết nối thiết bị")
+            return
+        self.trace.reset()
+        self.ser.write(build_frame(TLM_MSG_TRACE_DUMP, self.tx_seq, b""))
+        self.tx_seq = (self.tx_seq + 1) & 0xFFFF
+
     def snapshot_graph(self):
         try:
             f = f"Snap_{datetime.now().strftime('%H%M%S')}.png"
@@ -0,0 +1,17 @@
+#ifndef SIM_DRIVER_GPIO_H
+#define SIM_DRIVER_GPIO_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+typedef enum {
+    GPIO_PULLUP_DISABLE = 0,
+    GPIO_PULLUP_ENABLE = 1,
+} gpio_pullup_t;
+
+// Chỉ ghi nhận mức (còi báo): bộ mô phỏng đếm số lần bật
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Đồng hồ ảo của bộ mô phỏng (µs từ lúc khởi động), không phải thời gian thực của host
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "sdkconfig.h"
+
+// =========================================================
+// FREERTOS TRÊN PTHREADS (BỘ MÔ PHỎNG HOST)
+// =========================================================
+// - Mỗi task là một pthread; mọi chờ đợi (delay, mutex, stream/message buffer, UART, bus I2C)
+//   đi qua sim_clock.c và tính trên đồng hồ ảo
+// - Đồng hồ ảo chỉ tiến khi mọi task đều đang chờ: xử lý tốn 0 thời gian ảo,
+//   nên bộ mô phỏng chạy nhanh nhất có thể thay vì theo thời gian thực
+// - Không có ưu tiên / chiếm quyền: các task chạy song song thật như hai lõi ESP32
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;            // Như ESP-IDF: kích thước stack tính bằng byte
+
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define configMAX_TASK_NAME_LEN 16
+#define portNUM_PROCESSORS 2
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL (pdFALSE)
+#define pdPASS (pdTRUE)
+
+// Vùng găng của ESP-IDF (spinlock giữa hai lõi): mutex pthread, không chờ trên đồng hồ ảo
+typedef struct {
+    pthread_mutex_t lock;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->lock)
+#define portEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->lock)
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef SIM_FREERTOS_MESSAGE_BUFFER_H
+#define SIM_FREERTOS_MESSAGE_BUFFER_H
+
+#include "FreeRTOS.h"
+#include "stream_buffer.h"
+
+// Như FreeRTOS: message buffer là stream buffer, mỗi bản tin có tiền tố độ dài (size_t)
+typedef StreamBufferHandle_t MessageBufferHandle_t;
+
+MessageBufferHandle_t xMessageBufferCreate(size_t xBufferSizeBytes);
+size_t xMessageBufferSend(MessageBufferHandle_t xMessageBuffer, const void *pvTxData, size_t xDataLengthBytes,
+                          TickType_t xTicksToWait);
+size_t xMessageBufferReceive(MessageBufferHandle_t xMessageBuffer, void *pvRxData, size_t xBufferLengthBytes,
+                             TickType_t xTicksToWait);
+size_t xMessageBufferSpacesAvailable(MessageBufferHandle_t xMessageBuffer);
+
+#endif
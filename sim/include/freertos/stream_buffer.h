@@ -0,0 +1,16 @@
+#ifndef SIM_FREERTOS_STREAM_BUFFER_H
+#define SIM_FREERTOS_STREAM_BUFFER_H
+
+#include "FreeRTOS.h"
+
+typedef struct sim_stream *StreamBufferHandle_t;
+
+StreamBufferHandle_t xStreamBufferCreate(size_t xBufferSizeBytes, size_t xTriggerLevelBytes);
+size_t xStreamBufferSend(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+                         TickType_t xTicksToWait);
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes,
+                            TickType_t xTicksToWait);
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SIM_FREERTOS_TASK_H
+#define SIM_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct sim_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// Chỉ các trường firmware dùng (CONFIG_FREERTOS_USE_TRACE_FACILITY)
+typedef struct {
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    UBaseType_t xTaskNumber;
+    uint32_t usStackHighWaterMark;
+} TaskStatus_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask,
+                                   BaseType_t xCoreID);
+void vTaskDelete(TaskHandle_t xTaskToDelete);      // Chỉ hỗ trợ NULL (task tự kết thúc)
+void vTaskDelay(TickType_t xTicksToDelay);
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement);
+TickType_t xTaskGetTickCount(void);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetHandle(const char *pcNameToQuery);
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t xCoreID);     // Không có task IDLE: NULL
+char *pcTaskGetName(TaskHandle_t xTaskToQuery);
+UBaseType_t uxTaskGetNumberOfTasks(void);
+// Stack pthread trên host không so sánh được với Xtensa: trả về toàn bộ kích thước đã khai báo
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask);
+// Như FreeRTOS: trả về 0 nếu mảng không đủ chỗ cho mọi task; pulTotalRunTime luôn là 0
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pxTaskStatusArray, UBaseType_t uxArraySize,
+                                 uint32_t *pulTotalRunTime);
+
+#endif
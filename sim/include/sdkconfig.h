@@ -0,0 +1,12 @@
+#ifndef SIM_SDKCONFIG_H
+#define SIM_SDKCONFIG_H
+
+// Giá trị lấy từ sdkconfig của dự án; các tùy chọn Kconfig của ứng dụng để trống (dùng mặc định trong mã)
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_IDLE_TASK_STACKSIZE 1536
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#define CONFIG_ESP_WIFI_SSID "myssid"
+#define CONFIG_ESP_WIFI_PASSWORD "mypassword"
+
+#endif
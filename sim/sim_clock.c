@@ -0,0 +1,263 @@
+#define _GNU_SOURCE             // pthread_setname_np
+#include "sim_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_done = PTHREAD_COND_INITIALIZER;
+
+static uint64_t sim_now_us = 0;         // Đọc không khóa (nguyên tử), chỉ ghi khi giữ khóa
+static uint64_t sim_end_us = SIM_FOREVER;
+static sim_end_reason_t sim_end = SIM_END_NONE;
+static int sim_runnable = 0;            // Số task đang chạy (không chờ)
+static sim_task_t *sim_tasks = NULL;
+
+static __thread sim_task_t *sim_self = NULL;
+
+
+uint64_t sim_clock_now_us(void)
+{
+    return __atomic_load_n(&sim_now_us, __ATOMIC_ACQUIRE);
+}
+
+TickType_t sim_clock_ticks(void)
+{
+    return (TickType_t)(sim_clock_now_us() / SIM_TICK_US);
+}
+
+uint64_t sim_clock_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        return SIM_FOREVER;
+    }
+    return sim_clock_now_us() + (uint64_t)ticks * SIM_TICK_US;
+}
+
+void sim_clock_lock(void)
+{
+    pthread_mutex_lock(&sim_lock);
+}
+
+void sim_clock_unlock(void)
+{
+    pthread_mutex_unlock(&sim_lock);
+}
+
+
+// =========================================================
+// CHỜ / ĐÁNH THỨC (ĐANG GIỮ KHÓA)
+// =========================================================
+
+static void wake_task(sim_task_t *task, bool notified)
+{
+    task->waiting = false;
+    task->notified = notified;
+    sim_runnable++;
+    pthread_cond_signal(&task->cond);
+}
+
+/**
+ * @brief Không còn task nào chạy: nhảy tới thời hạn gần nhất và đánh thức các task hết hạn.
+ * Vượt quá thời gian mô phỏng hoặc không còn thời hạn nào thì dừng (mọi task giữ nguyên ở điểm chờ).
+ */
+static void advance_clock(void)
+{
+    uint64_t next = SIM_FOREVER;
+    for (sim_task_t *t = sim_tasks; t != NULL; t = t->next) {
+        if (t->alive && t->waiting && t->wake_us < next) {
+            next = t->wake_us;
+        }
+    }
+
+    if (next == SIM_FOREVER || next > sim_end_us) {
+        if (next != SIM_FOREVER) {
+            __atomic_store_n(&sim_now_us, sim_end_us, __ATOMIC_RELEASE);
+        }
+        sim_end = (next == SIM_FOREVER) ? SIM_END_DEADLOCK : SIM_END_TIME;
+        pthread_cond_broadcast(&sim_done);
+        return;
+    }
+
+    if (next > sim_now_us) {
+        __atomic_store_n(&sim_now_us, next, __ATOMIC_RELEASE);
+    }
+    for (sim_task_t *t = sim_tasks; t != NULL; t = t->next) {
+        if (t->alive && t->waiting && t->wake_us <= next) {
+            wake_task(t, false);
+        }
+    }
+}
+
+bool sim_clock_wait(const void *obj, uint64_t deadline_us)
+{
+    sim_task_t *self = sim_self;
+    if (self == NULL) {
+        fprintf(stderr, "sim: blocking call outside a task\n");
+        abort();
+    }
+    if (deadline_us <= sim_now_us) {
+        return false;
+    }
+
+    self->wait_obj = obj;
+    self->wake_us = deadline_us;
+    self->waiting = true;
+    self->notified = false;
+    if (--sim_runnable == 0 && sim_end == SIM_END_NONE) {
+        advance_clock();
+    }
+    while (self->waiting) {
+        pthread_cond_wait(&self->cond, &sim_lock);
+    }
+    self->wait_obj = NULL;
+    return self->notified;
+}
+
+void sim_clock_notify(const void *obj)
+{
+    if (obj == NULL || sim_end != SIM_END_NONE) {
+        return;
+    }
+    for (sim_task_t *t = sim_tasks; t != NULL; t = t->next) {
+        if (t->alive && t->waiting && t->wait_obj == obj) {
+            wake_task(t, true);
+        }
+    }
+}
+
+void sim_clock_sleep_us(uint64_t duration_us)
+{
+    if (duration_us == 0) {
+        sched_yield();
+        return;
+    }
+    sim_clock_lock();
+    sim_clock_wait(NULL, sim_now_us + duration_us);
+    sim_clock_unlock();
+}
+
+
+// =========================================================
+// TASK
+// =========================================================
+
+static void *task_main(void *arg)
+{
+    sim_task_t *task = (sim_task_t *)arg;
+    sim_self = task;
+    task->entry(task->arg);
+
+    // Task trả về (như app_main): coi như vTaskDelete(NULL)
+    sim_clock_lock();
+    task->alive = false;
+    if (--sim_runnable == 0 && sim_end == SIM_END_NONE) {
+        advance_clock();
+    }
+    sim_clock_unlock();
+    return NULL;
+}
+
+sim_task_t *sim_clock_spawn(void (*entry)(void *), const char *name, uint32_t stack_size, void *arg)
+{
+    sim_task_t *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return NULL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->stack_size = stack_size;
+    task->entry = entry;
+    task->arg = arg;
+    task->alive = true;
+    pthread_cond_init(&task->cond, NULL);
+
+    // Đếm là đang chạy ngay từ lúc tạo để đồng hồ không tiến trước khi thread kịp khởi động
+    sim_clock_lock();
+    task->next = sim_tasks;
+    sim_tasks = task;
+    sim_runnable++;
+    sim_clock_unlock();
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SIM_TASK_HOST_STACK);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&task->thread, &attr, task_main, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        sim_clock_lock();
+        task->alive = false;
+        sim_runnable--;
+        sim_clock_unlock();
+        return NULL;
+    }
+    pthread_setname_np(task->thread, task->name);   // trace_recorder lấy tên task từ đây
+    return task;
+}
+
+sim_task_t *sim_clock_current(void)
+{
+    return sim_self;
+}
+
+sim_task_t *sim_clock_find(const char *name)
+{
+    sim_task_t *found = NULL;
+    sim_clock_lock();
+    for (sim_task_t *t = sim_tasks; t != NULL; t = t->next) {
+        if (t->alive && strncmp(t->name, name, configMAX_TASK_NAME_LEN) == 0) {
+            found = t;
+            break;
+        }
+    }
+    sim_clock_unlock();
+    return found;
+}
+
+int sim_clock_task_count(void)
+{
+    int count = 0;
+    sim_clock_lock();
+    for (sim_task_t *t = sim_tasks; t != NULL; t = t->next) {
+        count += t->alive;
+    }
+    sim_clock_unlock();
+    return count;
+}
+
+int sim_clock_list(sim_task_t **out, int max)
+{
+    int count = 0;
+    sim_clock_lock();
+    for (sim_task_t *t = sim_tasks; t != NULL; t = t->next) {
+        if (!t->alive) {
+            continue;
+        }
+        if (count < max) {
+            out[count] = t;
+        }
+        count++;
+    }
+    sim_clock_unlock();
+    return count;
+}
+
+sim_end_reason_t sim_clock_run(void (*entry)(void *), uint64_t end_us)
+{
+    sim_clock_lock();
+    sim_end_us = end_us;
+    sim_clock_unlock();
+
+    if (sim_clock_spawn(entry, "main", 3584, NULL) == NULL) {
+        return SIM_END_DEADLOCK;
+    }
+
+    sim_clock_lock();
+    while (sim_end == SIM_END_NONE) {
+        pthread_cond_wait(&sim_done, &sim_lock);
+    }
+    sim_end_reason_t reason = sim_end;
+    sim_clock_unlock();
+    return reason;
+}
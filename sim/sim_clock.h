@@ -0,0 +1,69 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+// =========================================================
+// ĐỒNG HỒ ẢO VÀ LẬP LỊCH TASK
+// =========================================================
+// - Thời gian ảo (µs) chỉ tiến khi không còn task nào đang chạy: khi đó nhảy thẳng tới
+//   thời hạn chờ gần nhất và đánh thức các task hết hạn (mô phỏng sự kiện rời rạc)
+// - Mọi trạng thái dùng chung của shim (mutex, stream buffer, UART, bus I2C) được bảo vệ
+//   bởi một khóa chung; sim_clock_wait/notify chỉ gọi khi đang giữ khóa
+// - Hết thời gian mô phỏng (hoặc mọi task chờ vô hạn): mọi task bị giữ lại ở điểm chờ,
+//   sim_clock_run() trả về để đọc trạng thái cuối một cách an toàn
+
+#define SIM_FOREVER UINT64_MAX
+#define SIM_TICK_US (1000000ULL / configTICK_RATE_HZ)
+#define SIM_TASK_HOST_STACK (1024 * 1024)   // Stack pthread (x86-64 cần nhiều hơn Xtensa)
+
+typedef struct sim_task {
+    pthread_t thread;
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_size;                // Kích thước khai báo trong firmware (byte)
+    void (*entry)(void *);
+    void *arg;
+    pthread_cond_t cond;
+    const void *wait_obj;               // Đối tượng đang chờ (NULL: chỉ chờ thời gian)
+    uint64_t wake_us;                   // Thời hạn chờ, SIM_FOREVER nếu không có
+    bool waiting;
+    bool notified;
+    bool alive;
+    struct sim_task *next;
+} sim_task_t;
+
+typedef enum {
+    SIM_END_NONE = 0,
+    SIM_END_TIME,                       // Đã chạy đủ thời gian yêu cầu
+    SIM_END_DEADLOCK,                   // Mọi task chờ vô hạn
+} sim_end_reason_t;
+
+uint64_t sim_clock_now_us(void);
+TickType_t sim_clock_ticks(void);
+// Thời hạn tuyệt đối từ số tick chờ của FreeRTOS (portMAX_DELAY = vô hạn)
+uint64_t sim_clock_deadline(TickType_t ticks);
+
+void sim_clock_lock(void);
+void sim_clock_unlock(void);
+
+// Chờ (đang giữ khóa) tới khi sim_clock_notify(obj) hoặc tới deadline_us.
+// @return true nếu được đánh thức bởi notify, false nếu hết hạn
+bool sim_clock_wait(const void *obj, uint64_t deadline_us);
+void sim_clock_notify(const void *obj);
+// Chờ một khoảng thời gian ảo (không giữ khóa)
+void sim_clock_sleep_us(uint64_t duration_us);
+
+sim_task_t *sim_clock_spawn(void (*entry)(void *), const char *name, uint32_t stack_size, void *arg);
+sim_task_t *sim_clock_current(void);
+sim_task_t *sim_clock_find(const char *name);
+int sim_clock_task_count(void);
+// Chép tối đa max task còn sống vào out; trả về tổng số task còn sống
+int sim_clock_list(sim_task_t **out, int max);
+
+// Chạy entry như task "main" (giống app_main) cho tới khi hết end_us thời gian ảo
+sim_end_reason_t sim_clock_run(void (*entry)(void *), uint64_t end_us);
+
+#endif
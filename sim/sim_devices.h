@@ -0,0 +1,51 @@
+#ifndef SIM_DEVICES_H
+#define SIM_DEVICES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// =========================================================
+// THIẾT BỊ I2C MÔ PHỎNG (MAX30102, MPU6050, SSD1306)
+// =========================================================
+// - Mô hình mức thanh ghi: con trỏ thanh ghi tự tăng, FIFO không tự tăng địa chỉ,
+//   cờ ngắt xóa khi đọc, reset mềm; chỉ những gì driver trong src/ dùng tới
+// - Cảm biến cập nhật lười: mỗi lần được truy cập thì sinh bù các mẫu tới thời điểm ảo hiện tại
+//   (theo tốc độ lấy mẫu đang cấu hình), FIFO đầy thì tràn như chip thật
+
+typedef struct {
+    uint32_t samples;               // Mẫu đã đưa vào FIFO
+    uint32_t samples_read;
+    uint32_t samples_lost;          // Mất do FIFO đầy
+    uint32_t prox_triggers;
+    uint32_t temp_conversions;
+    uint8_t led_red_pa;
+    uint8_t led_ir_pa;
+    uint32_t sample_rate_hz;        // Tốc độ ra FIFO (sau trung bình)
+} sim_max30102_stats_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t overflows;
+} sim_mpu6050_stats_t;
+
+typedef struct {
+    uint32_t commands;
+    uint32_t data_bytes;
+    bool display_on;
+} sim_ssd1306_stats_t;
+
+void sim_max30102_attach(void);
+void sim_max30102_get_stats(sim_max30102_stats_t *stats);
+// Thời điểm lấy mẫu của mẫu mới nhất firmware đã đọc khỏi FIFO tại (hoặc trước) t_us; false nếu chưa có
+bool sim_max30102_newest_read_sample(uint64_t t_us, uint64_t *sample_us);
+
+void sim_mpu6050_attach(void);
+void sim_mpu6050_get_stats(sim_mpu6050_stats_t *stats);
+
+void sim_ssd1306_attach(void);
+void sim_ssd1306_get_stats(sim_ssd1306_stats_t *stats);
+// Vẽ màn hình 128x64 bằng ký tự nửa khối (mỗi dòng chữ = 2 hàng điểm)
+void sim_ssd1306_render(FILE *out);
+
+#endif
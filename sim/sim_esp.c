@@ -0,0 +1,606 @@
+#include "sim_esp.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "driver/uart.h"
+#include "sim_clock.h"
+
+static sim_esp_stats_t esp_stats;
+
+// =========================================================
+// HỆ THỐNG: ĐỒNG HỒ, LỖI, LOG, HEAP
+// =========================================================
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)sim_clock_now_us();
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_READ_ONLY: return "ESP_ERR_NVS_READ_ONLY";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+#define LOG_TAG_LEVELS 8
+
+static esp_log_level_t log_default_level = (esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL;
+static struct {
+    char tag[16];
+    esp_log_level_t level;
+} log_tag_levels[LOG_TAG_LEVELS];
+static int log_tag_count = 0;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&log_lock);
+    if (strcmp(tag, "*") == 0) {
+        log_default_level = level;
+        log_tag_count = 0;
+    } else {
+        int i = 0;
+        while (i < log_tag_count && strcmp(log_tag_levels[i].tag, tag) != 0) {
+            i++;
+        }
+        if (i < LOG_TAG_LEVELS) {
+            snprintf(log_tag_levels[i].tag, sizeof(log_tag_levels[i].tag), "%s", tag);
+            log_tag_levels[i].level = level;
+            if (i == log_tag_count) {
+                log_tag_count++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    pthread_mutex_lock(&log_lock);
+    esp_log_level_t limit = log_default_level;
+    for (int i = 0; i < log_tag_count; i++) {
+        if (strcmp(log_tag_levels[i].tag, tag) == 0) {
+            limit = log_tag_levels[i].level;
+        }
+    }
+    if (level <= limit) {
+        va_list args;
+        va_start(args, format);
+        fprintf(stderr, "%c (%lu) %s: ", letters[level], (unsigned long)(sim_clock_now_us() / 1000), tag);
+        vfprintf(stderr, format, args);
+        fputc('\n', stderr);
+        va_end(args);
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+// Heap không được mô phỏng: số liệu cố định cỡ một ESP32 sau khi khởi động
+#define SIM_HEAP_FREE 180000
+#define SIM_HEAP_LARGEST_BLOCK 110592
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return SIM_HEAP_FREE;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return SIM_HEAP_FREE;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return SIM_HEAP_LARGEST_BLOCK;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return SIM_HEAP_FREE;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return SIM_HEAP_FREE;
+}
+
+
+// =========================================================
+// GPIO / LEDC (CÒI BÁO)
+// =========================================================
+
+#define SIM_GPIO_COUNT 40
+
+static uint8_t gpio_levels[SIM_GPIO_COUNT];
+static uint32_t ledc_duty[LEDC_CHANNEL_7 + 1];
+static bool ledc_on[LEDC_CHANNEL_7 + 1];
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_clock_lock();
+    if (level && !gpio_levels[gpio_num]) {
+        esp_stats.buzzer_beeps++;
+    }
+    gpio_levels[gpio_num] = (level != 0);
+    sim_clock_unlock();
+    return ESP_OK;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf)
+{
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf)
+{
+    return ledc_set_duty(ledc_conf->speed_mode, ledc_conf->channel, ledc_conf->duty);
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
+{
+    if (channel < LEDC_CHANNEL_0 || channel > LEDC_CHANNEL_7) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ledc_duty[channel] = duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    if (channel < LEDC_CHANNEL_0 || channel > LEDC_CHANNEL_7) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_clock_lock();
+    bool on = ledc_duty[channel] > 0;
+    if (on && !ledc_on[channel]) {
+        esp_stats.buzzer_tones++;
+    }
+    ledc_on[channel] = on;
+    sim_clock_unlock();
+    return ESP_OK;
+}
+
+
+// =========================================================
+// UART
+// =========================================================
+
+static struct {
+    int baud_rate;
+    bool installed;
+    size_t tx_buffer_size;
+    uint64_t tx_busy_until_us;      // Thời điểm ảo byte đã ghi cuối cùng truyền xong
+    FILE *tx_file;
+    sim_uart_tx_hook_t tx_hook;
+    const uint8_t *rx_data;
+    size_t rx_len;
+    size_t rx_pos;
+    uint64_t rx_start_us;
+} uart = { .baud_rate = 115200 };
+
+void sim_uart_set_tx(FILE *file, sim_uart_tx_hook_t hook)
+{
+    uart.tx_file = file;
+    uart.tx_hook = hook;
+}
+
+void sim_uart_set_rx(const uint8_t *data, size_t len, uint64_t start_us)
+{
+    uart.rx_data = data;
+    uart.rx_len = len;
+    uart.rx_pos = 0;
+    uart.rx_start_us = start_us;
+}
+
+// 8N1: 10 bit mỗi byte
+static uint64_t uart_byte_us(void)
+{
+    return 10000000ULL / (uint64_t)uart.baud_rate;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config)
+{
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX || uart_config->baud_rate <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart.baud_rate = uart_config->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              void *uart_queue, int intr_alloc_flags)
+{
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart.tx_buffer_size = (tx_buffer_size > 0) ? (size_t)tx_buffer_size : 0;
+    uart.installed = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Ghi như driver ESP-IDF: dữ liệu được chép vào bộ đệm TX rồi truyền dần theo baud,
+ * hàm chỉ chờ khi phần chưa truyền vượt quá bộ đệm TX (không có bộ đệm: chờ truyền xong).
+ */
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+    if (!uart.installed) {
+        return -1;
+    }
+    sim_clock_lock();
+    uint64_t now = sim_clock_now_us();
+    uint64_t byte_us = uart_byte_us();
+    uint64_t start = (uart.tx_busy_until_us > now) ? uart.tx_busy_until_us : now;
+    uart.tx_busy_until_us = start + size * byte_us;
+
+    if (uart.tx_file != NULL) {
+        fwrite(src, 1, size, uart.tx_file);
+    }
+    if (uart.tx_hook != NULL) {
+        uart.tx_hook(src, size, start, byte_us);
+    }
+    esp_stats.tx_bytes += size;
+    esp_stats.tx_writes++;
+
+    uint64_t buffered_us = uart.tx_buffer_size * byte_us;
+    if (uart.tx_busy_until_us > now + buffered_us) {
+        uint64_t until = uart.tx_busy_until_us - buffered_us;
+        esp_stats.tx_blocked_us += until - now;
+        sim_clock_wait(NULL, until);
+    }
+    sim_clock_unlock();
+    return (int)size;
+}
+
+// Số byte host đã gửi tới thời điểm t (truyền liên tục theo baud từ rx_start_us)
+static size_t uart_rx_arrived(uint64_t t)
+{
+    if (t < uart.rx_start_us) {
+        return 0;
+    }
+    uint64_t arrived = (t - uart.rx_start_us) / uart_byte_us();
+    return (arrived < uart.rx_len) ? (size_t)arrived : uart.rx_len;
+}
+
+/**
+ * @brief Như driver ESP-IDF: chờ tới khi đủ length byte hoặc hết thời gian, trả về số byte đã đọc.
+ */
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    if (!uart.installed) {
+        return -1;
+    }
+    sim_clock_lock();
+    uint64_t deadline = sim_clock_deadline(ticks_to_wait);
+    size_t want = uart.rx_pos + length;
+    for (;;) {
+        uint64_t now = sim_clock_now_us();
+        if (uart_rx_arrived(now) >= want || now >= deadline) {
+            break;
+        }
+        // Chờ tới lúc đủ byte (nếu host còn gửi đủ) hoặc hết hạn; SIM_FOREVER: chờ mãi
+        uint64_t until = deadline;
+        if (want <= uart.rx_len) {
+            uint64_t ready = uart.rx_start_us + want * uart_byte_us();
+            if (ready < until) {
+                until = ready;
+            }
+        }
+        sim_clock_wait(NULL, until);
+    }
+    size_t n = uart_rx_arrived(sim_clock_now_us()) - uart.rx_pos;
+    if (n > length) {
+        n = length;
+    }
+    if (n > 0) {
+        memcpy(buf, uart.rx_data + uart.rx_pos, n);
+        uart.rx_pos += n;
+    }
+    esp_stats.rx_bytes += n;
+    sim_clock_unlock();
+    return (int)n;
+}
+
+void sim_esp_get_stats(sim_esp_stats_t *stats)
+{
+    sim_clock_lock();
+    *stats = esp_stats;
+    sim_clock_unlock();
+}
+
+
+// =========================================================
+// NVS (TRONG RAM)
+// =========================================================
+
+#define SIM_NVS_NAMESPACES 8
+#define SIM_NVS_ENTRIES 64
+#define SIM_NVS_NAME_LEN 16     // Tối đa 15 ký tự như NVS thật
+
+typedef enum {
+    NVS_TYPE_U8,
+    NVS_TYPE_U32,
+} sim_nvs_type_t;
+
+static char nvs_namespaces[SIM_NVS_NAMESPACES][SIM_NVS_NAME_LEN];
+static int nvs_namespace_count = 0;
+static struct {
+    uint8_t ns;
+    char key[SIM_NVS_NAME_LEN];
+    sim_nvs_type_t type;
+    uint32_t value;
+} nvs_entries[SIM_NVS_ENTRIES];
+static int nvs_entry_count = 0;
+static bool nvs_initialized = false;
+
+// Handle = chỉ số namespace + 1, bit 31 đánh dấu chỉ đọc
+#define NVS_HANDLE_READONLY 0x80000000u
+
+esp_err_t nvs_flash_init(void)
+{
+    nvs_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    sim_clock_lock();
+    nvs_namespace_count = 0;
+    nvs_entry_count = 0;
+    sim_clock_unlock();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!nvs_initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (strlen(name) >= SIM_NVS_NAME_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_OK;
+    sim_clock_lock();
+    int ns = 0;
+    while (ns < nvs_namespace_count && strcmp(nvs_namespaces[ns], name) != 0) {
+        ns++;
+    }
+    if (ns == nvs_namespace_count) {
+        // Namespace chưa có: chỉ tạo khi mở để ghi (như NVS thật)
+        if (open_mode == NVS_READONLY) {
+            ret = ESP_ERR_NVS_NOT_FOUND;
+        } else if (ns >= SIM_NVS_NAMESPACES) {
+            ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        } else {
+            snprintf(nvs_namespaces[ns], SIM_NVS_NAME_LEN, "%s", name);
+            nvs_namespace_count++;
+        }
+    }
+    if (ret == ESP_OK) {
+        *out_handle = (nvs_handle_t)(ns + 1) | (open_mode == NVS_READONLY ? NVS_HANDLE_READONLY : 0);
+    }
+    sim_clock_unlock();
+    return ret;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+static int nvs_find(nvs_handle_t handle, const char *key, sim_nvs_type_t type)
+{
+    uint8_t ns = (uint8_t)((handle & ~NVS_HANDLE_READONLY) - 1);
+    for (int i = 0; i < nvs_entry_count; i++) {
+        if (nvs_entries[i].ns == ns && nvs_entries[i].type == type && strcmp(nvs_entries[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, sim_nvs_type_t type, uint32_t *value)
+{
+    sim_clock_lock();
+    int i = nvs_find(handle, key, type);
+    if (i >= 0) {
+        *value = nvs_entries[i].value;
+    }
+    sim_clock_unlock();
+    return (i >= 0) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, sim_nvs_type_t type, uint32_t value)
+{
+    if (handle & NVS_HANDLE_READONLY) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (strlen(key) >= SIM_NVS_NAME_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_OK;
+    sim_clock_lock();
+    int i = nvs_find(handle, key, type);
+    if (i < 0) {
+        if (nvs_entry_count >= SIM_NVS_ENTRIES) {
+            ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        } else {
+            i = nvs_entry_count++;
+            nvs_entries[i].ns = (uint8_t)(handle - 1);
+            snprintf(nvs_entries[i].key, SIM_NVS_NAME_LEN, "%s", key);
+            nvs_entries[i].type = type;
+        }
+    }
+    if (ret == ESP_OK) {
+        nvs_entries[i].value = value;
+    }
+    sim_clock_unlock();
+    return ret;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    uint32_t value;
+    esp_err_t ret = nvs_get(handle, key, NVS_TYPE_U8, &value);
+    if (ret == ESP_OK) {
+        *out_value = (uint8_t)value;
+    }
+    return ret;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return nvs_set(handle, key, NVS_TYPE_U8, value);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    return nvs_get(handle, key, NVS_TYPE_U32, out_value);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_set(handle, key, NVS_TYPE_U32, value);
+}
+
+
+// =========================================================
+// FLASH: PARTITION "vitals" (partitions.csv)
+// =========================================================
+
+static const esp_partition_t vitals_partition = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = 0x40,
+    .address = 0x110000,
+    .size = 0x80000,
+    .label = "vitals",
+};
+static uint8_t *flash_data = NULL;
+
+static uint8_t *flash_storage(void)
+{
+    if (flash_data == NULL) {
+        flash_data = malloc(vitals_partition.size);
+        if (flash_data != NULL) {
+            memset(flash_data, 0xFF, vitals_partition.size);
+        }
+    }
+    return flash_data;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    if (type != vitals_partition.type ||
+        (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != vitals_partition.subtype) ||
+        (label != NULL && strcmp(label, vitals_partition.label) != 0) || flash_storage() == NULL) {
+        return NULL;
+    }
+    return &vitals_partition;
+}
+
+static esp_err_t flash_check(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (partition != &vitals_partition) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    esp_err_t ret = flash_check(partition, src_offset, size);
+    if (ret == ESP_OK) {
+        memcpy(dst, flash_data + src_offset, size);
+    }
+    return ret;
+}
+
+// NOR flash: ghi chỉ xóa được bit 1 -> 0
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    esp_err_t ret = flash_check(partition, dst_offset, size);
+    if (ret == ESP_OK) {
+        const uint8_t *bytes = (const uint8_t *)src;
+        for (size_t i = 0; i < size; i++) {
+            flash_data[dst_offset + i] &= bytes[i];
+        }
+    }
+    return ret;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    esp_err_t ret = flash_check(partition, offset, size);
+    if (ret == ESP_OK && (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0)) {
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    if (ret == ESP_OK) {
+        memset(flash_data + offset, 0xFF, size);
+    }
+    return ret;
+}
+
+bool sim_flash_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL || flash_storage() == NULL) {
+        if (f != NULL) {
+            fclose(f);
+        }
+        return false;
+    }
+    size_t n = fread(flash_data, 1, vitals_partition.size, f);
+    fclose(f);
+    return n == vitals_partition.size;
+}
+
+bool sim_flash_save(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL || flash_storage() == NULL) {
+        if (f != NULL) {
+            fclose(f);
+        }
+        return false;
+    }
+    bool ok = fwrite(flash_data, 1, vitals_partition.size, f) == vitals_partition.size;
+    return (fclose(f) == 0) && ok;
+}
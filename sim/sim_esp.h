@@ -0,0 +1,36 @@
+#ifndef SIM_ESP_H
+#define SIM_ESP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+// =========================================================
+// NGOẠI VI ESP-IDF MÔ PHỎNG (UART, FLASH, CÒI)
+// =========================================================
+// - UART: byte TX ghi ra file (đọc được bằng các công cụ Python như từ cổng COM),
+//   thời điểm truyền xong tính theo baud; RX nạp sẵn từ file, đến dần theo baud từ một mốc thời gian
+// - Flash: partition "vitals" trong RAM, có thể nạp / lưu ra file ảnh để dùng với vitals_log_dump.py
+
+// Gọi mỗi lần firmware ghi UART: byte thứ i truyền xong tại start_us + (i + 1) * byte_us (thời gian ảo)
+typedef void (*sim_uart_tx_hook_t)(const uint8_t *data, size_t len, uint64_t start_us, uint64_t byte_us);
+
+typedef struct {
+    uint64_t tx_bytes;
+    uint32_t tx_writes;
+    uint64_t tx_blocked_us;         // Tổng thời gian ảo uart_write_bytes phải chờ bộ đệm TX
+    uint32_t rx_bytes;              // Byte host gửi xuống đã được firmware đọc
+    uint32_t buzzer_beeps;          // Số lần GPIO còi lên mức 1
+    uint32_t buzzer_tones;          // Số lần bật PWM còi
+} sim_esp_stats_t;
+
+void sim_uart_set_tx(FILE *file, sim_uart_tx_hook_t hook);
+void sim_uart_set_rx(const uint8_t *data, size_t len, uint64_t start_us);
+void sim_esp_get_stats(sim_esp_stats_t *stats);
+
+bool sim_flash_load(const char *path);
+bool sim_flash_save(const char *path);
+
+#endif
@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/message_buffer.h"
+#include "sim_clock.h"
+
+// =========================================================
+// TASK VÀ THỜI GIAN
+// =========================================================
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask,
+                                   BaseType_t xCoreID)
+{
+    sim_task_t *task = sim_clock_spawn(pvTaskCode, pcName, usStackDepth, pvParameters);
+    if (pvCreatedTask != NULL) {
+        *pvCreatedTask = task;
+    }
+    return (task != NULL) ? pdPASS : pdFAIL;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete != NULL && xTaskToDelete != sim_clock_current()) {
+        abort();    // Firmware không xóa task khác
+    }
+    // Task tự kết thúc: chờ vô hạn, không còn được tính là đang chạy
+    sim_clock_lock();
+    sim_clock_current()->alive = false;
+    for (;;) {
+        sim_clock_wait(NULL, SIM_FOREVER);
+    }
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    if (xTicksToDelay == 0) {
+        sim_clock_sleep_us(0);
+        return;
+    }
+    // Như FreeRTOS: thức dậy ở biên tick thứ xTicksToDelay kể từ tick hiện tại
+    uint64_t wake_us = ((uint64_t)sim_clock_ticks() + xTicksToDelay) * SIM_TICK_US;
+    sim_clock_sleep_us(wake_us - sim_clock_now_us());
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+    TickType_t wake_tick = *pxPreviousWakeTime + xTimeIncrement;
+    *pxPreviousWakeTime = wake_tick;
+    uint64_t wake_us = (uint64_t)wake_tick * SIM_TICK_US;
+    uint64_t now_us = sim_clock_now_us();
+    if (wake_us > now_us) {
+        sim_clock_sleep_us(wake_us - now_us);
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return sim_clock_ticks();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return sim_clock_current();
+}
+
+TaskHandle_t xTaskGetHandle(const char *pcNameToQuery)
+{
+    return sim_clock_find(pcNameToQuery);
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t xCoreID)
+{
+    return NULL;
+}
+
+char *pcTaskGetName(TaskHandle_t xTaskToQuery)
+{
+    sim_task_t *task = (xTaskToQuery != NULL) ? xTaskToQuery : sim_clock_current();
+    return (task != NULL) ? task->name : "?";
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    return (UBaseType_t)sim_clock_task_count();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+    sim_task_t *task = (xTask != NULL) ? xTask : sim_clock_current();
+    return (task != NULL) ? task->stack_size : 0;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pxTaskStatusArray, UBaseType_t uxArraySize,
+                                 uint32_t *pulTotalRunTime)
+{
+    sim_task_t *tasks[64];
+    int max = (uxArraySize < 64) ? (int)uxArraySize : 64;
+    int count = sim_clock_list(tasks, max);
+
+    if (pulTotalRunTime != NULL) {
+        *pulTotalRunTime = 0;
+    }
+    if (count > max) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        pxTaskStatusArray[i] = (TaskStatus_t){
+            .xHandle = tasks[i],
+            .pcTaskName = tasks[i]->name,
+            .xTaskNumber = (UBaseType_t)(i + 1),
+            .usStackHighWaterMark = tasks[i]->stack_size,
+        };
+    }
+    return (UBaseType_t)count;
+}
+
+
+// =========================================================
+// MUTEX
+// =========================================================
+
+struct sim_mutex {
+    sim_task_t *owner;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return calloc(1, sizeof(struct sim_mutex));
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    sim_clock_lock();
+    uint64_t deadline = sim_clock_deadline(xBlockTime);
+    while (xSemaphore->owner != NULL) {
+        if (!sim_clock_wait(xSemaphore, deadline) && xSemaphore->owner != NULL) {
+            sim_clock_unlock();
+            return pdFALSE;
+        }
+    }
+    xSemaphore->owner = sim_clock_current();
+    sim_clock_unlock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    sim_clock_lock();
+    BaseType_t ok = (xSemaphore->owner != NULL) ? pdTRUE : pdFALSE;
+    xSemaphore->owner = NULL;
+    sim_clock_notify(xSemaphore);
+    sim_clock_unlock();
+    return ok;
+}
+
+
+// =========================================================
+// STREAM BUFFER / MESSAGE BUFFER
+// =========================================================
+
+struct sim_stream {
+    uint8_t *buf;
+    size_t size;
+    size_t head;                // Vị trí đọc
+    size_t count;               // Số byte đang có
+    size_t trigger;             // Số byte tối thiểu để bên nhận thức dậy
+    bool message;               // Message buffer: mỗi bản tin có tiền tố độ dài size_t
+};
+
+static StreamBufferHandle_t stream_create(size_t size, size_t trigger, bool message)
+{
+    struct sim_stream *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->buf = malloc(size);
+    if (s->buf == NULL) {
+        free(s);
+        return NULL;
+    }
+    s->size = size;
+    s->trigger = (trigger == 0) ? 1 : trigger;
+    s->message = message;
+    return s;
+}
+
+static void ring_write(struct sim_stream *s, const uint8_t *src, size_t len)
+{
+    size_t tail = (s->head + s->count) % s->size;
+    for (size_t i = 0; i < len; i++) {
+        s->buf[(tail + i) % s->size] = src[i];
+    }
+    s->count += len;
+}
+
+static void ring_peek(const struct sim_stream *s, uint8_t *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = s->buf[(s->head + i) % s->size];
+    }
+}
+
+static void ring_consume(struct sim_stream *s, size_t len)
+{
+    s->head = (s->head + len) % s->size;
+    s->count -= len;
+}
+
+/**
+ * @brief Ghi vào bộ đệm, chờ tối đa ticks cho đủ chỗ. Stream ghi được bao nhiêu thì ghi bấy nhiêu,
+ * message chỉ ghi khi đủ chỗ cho cả bản tin (kèm tiền tố độ dài).
+ */
+static size_t stream_send(struct sim_stream *s, const void *data, size_t len, TickType_t ticks)
+{
+    size_t needed = s->message ? len + sizeof(size_t) : len;
+    sim_clock_lock();
+    uint64_t deadline = sim_clock_deadline(ticks);
+    while (s->size - s->count < needed) {
+        if (!sim_clock_wait(s, deadline)) {
+            break;
+        }
+    }
+
+    size_t space = s->size - s->count;
+    size_t written = 0;
+    if (s->message) {
+        if (space >= needed) {
+            ring_write(s, (const uint8_t *)&len, sizeof(len));
+            ring_write(s, data, len);
+            written = len;
+        }
+    } else {
+        written = (len < space) ? len : space;
+        ring_write(s, data, written);
+    }
+    if (written > 0) {
+        sim_clock_notify(s);
+    }
+    sim_clock_unlock();
+    return written;
+}
+
+static size_t stream_receive(struct sim_stream *s, void *data, size_t max_len, TickType_t ticks)
+{
+    sim_clock_lock();
+    uint64_t deadline = sim_clock_deadline(ticks);
+    while (s->count < s->trigger) {
+        if (!sim_clock_wait(s, deadline)) {
+            break;
+        }
+    }
+
+    size_t read = 0;
+    if (s->message) {
+        size_t len;
+        if (s->count >= sizeof(len)) {
+            ring_peek(s, (uint8_t *)&len, sizeof(len));
+            // Bản tin lớn hơn bộ đệm nhận: giữ nguyên trong hàng đợi (như FreeRTOS)
+            if (len <= max_len) {
+                ring_consume(s, sizeof(len));
+                ring_peek(s, data, len);
+                ring_consume(s, len);
+                read = len;
+            }
+        }
+    } else {
+        read = (s->count < max_len) ? s->count : max_len;
+        ring_peek(s, data, read);
+        ring_consume(s, read);
+    }
+    if (read > 0) {
+        sim_clock_notify(s);
+    }
+    sim_clock_unlock();
+    return read;
+}
+
+static size_t stream_spaces(struct sim_stream *s)
+{
+    sim_clock_lock();
+    size_t space = s->size - s->count;
+    sim_clock_unlock();
+    return space;
+}
+
+StreamBufferHandle_t xStreamBufferCreate(size_t xBufferSizeBytes, size_t xTriggerLevelBytes)
+{
+    return stream_create(xBufferSizeBytes, xTriggerLevelBytes, false);
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+                         TickType_t xTicksToWait)
+{
+    return stream_send(xStreamBuffer, pvTxData, xDataLengthBytes, xTicksToWait);
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes,
+                            TickType_t xTicksToWait)
+{
+    return stream_receive(xStreamBuffer, pvRxData, xBufferLengthBytes, xTicksToWait);
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+    return stream_spaces(xStreamBuffer);
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+    sim_clock_lock();
+    size_t count = xStreamBuffer->count;
+    sim_clock_unlock();
+    return count;
+}
+
+MessageBufferHandle_t xMessageBufferCreate(size_t xBufferSizeBytes)
+{
+    return stream_create(xBufferSizeBytes, sizeof(size_t), true);
+}
+
+size_t xMessageBufferSend(MessageBufferHandle_t xMessageBuffer, const void *pvTxData, size_t xDataLengthBytes,
+                          TickType_t xTicksToWait)
+{
+    return stream_send(xMessageBuffer, pvTxData, xDataLengthBytes, xTicksToWait);
+}
+
+size_t xMessageBufferReceive(MessageBufferHandle_t xMessageBuffer, void *pvRxData, size_t xBufferLengthBytes,
+                             TickType_t xTicksToWait)
+{
+    return stream_receive(xMessageBuffer, pvRxData, xBufferLengthBytes, xTicksToWait);
+}
+
+size_t xMessageBufferSpacesAvailable(MessageBufferHandle_t xMessageBuffer)
+{
+    return stream_spaces(xMessageBuffer);
+}
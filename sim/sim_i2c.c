@@ -0,0 +1,305 @@
+#include "sim_i2c.h"
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2c.h"
+#include "sim_clock.h"
+
+#define SIM_I2C_MAX_DEVICES 8
+#define SIM_I2C_SEGMENT_MAX 256         // Byte ghi tối đa trong một đoạn (OLED: 1 + 128)
+
+typedef enum {
+    I2C_OP_START,
+    I2C_OP_WRITE,
+    I2C_OP_READ,
+    I2C_OP_STOP,
+} i2c_op_kind_t;
+
+typedef struct {
+    i2c_op_kind_t kind;
+    uint8_t *data;                  // WRITE: bản sao dữ liệu; READ: bộ đệm của người gọi
+    size_t len;
+} i2c_op_t;
+
+typedef struct {
+    i2c_op_t *ops;
+    size_t count;
+    size_t capacity;
+} i2c_cmd_link_t;
+
+static struct {
+    uint8_t addr;
+    sim_i2c_device_t device;
+} devices[SIM_I2C_MAX_DEVICES];
+static int device_count = 0;
+
+static uint32_t bus_freq_hz = 100000;
+static bool bus_installed = false;
+static uint64_t bus_free_us = 0;
+static uint32_t max_freq_hz = UINT32_MAX;
+static uint32_t noise_state = 1;
+static sim_i2c_stats_t bus_stats;
+
+
+esp_err_t sim_i2c_attach(uint8_t addr, const sim_i2c_device_t *device)
+{
+    if (device_count >= SIM_I2C_MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+    devices[device_count].addr = addr;
+    devices[device_count].device = *device;
+    device_count++;
+    return ESP_OK;
+}
+
+void sim_i2c_set_max_freq(uint32_t freq_hz, uint32_t seed)
+{
+    max_freq_hz = freq_hz;
+    noise_state = seed ? seed : 1;
+}
+
+void sim_i2c_get_stats(sim_i2c_stats_t *stats)
+{
+    sim_clock_lock();
+    *stats = bus_stats;
+    stats->freq_hz = bus_freq_hz;
+    sim_clock_unlock();
+}
+
+static const sim_i2c_device_t *find_device(uint8_t addr)
+{
+    for (int i = 0; i < device_count; i++) {
+        if (devices[i].addr == addr) {
+            return &devices[i].device;
+        }
+    }
+    return NULL;
+}
+
+
+// =========================================================
+// DRIVER
+// =========================================================
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || i2c_conf->master.clk_speed == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bus_freq_hz = i2c_conf->master.clk_speed;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len,
+                             int intr_alloc_flags)
+{
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (bus_installed) {
+        return ESP_FAIL;            // Như ESP-IDF: phải i2c_driver_delete trước khi cài lại
+    }
+    bus_installed = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    if (!bus_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    bus_installed = false;
+    return ESP_OK;
+}
+
+
+// =========================================================
+// CMD LINK
+// =========================================================
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(i2c_cmd_link_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    i2c_cmd_link_t *link = (i2c_cmd_link_t *)cmd_handle;
+    if (link == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < link->count; i++) {
+        if (link->ops[i].kind == I2C_OP_WRITE) {
+            free(link->ops[i].data);
+        }
+    }
+    free(link->ops);
+    free(link);
+}
+
+static esp_err_t add_op(i2c_cmd_handle_t cmd_handle, i2c_op_kind_t kind, uint8_t *data, size_t len)
+{
+    i2c_cmd_link_t *link = (i2c_cmd_link_t *)cmd_handle;
+    if (link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (link->count == link->capacity) {
+        size_t capacity = link->capacity ? link->capacity * 2 : 8;
+        i2c_op_t *ops = realloc(link->ops, capacity * sizeof(i2c_op_t));
+        if (ops == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        link->ops = ops;
+        link->capacity = capacity;
+    }
+    link->ops[link->count++] = (i2c_op_t){ .kind = kind, .data = data, .len = len };
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    return add_op(cmd_handle, I2C_OP_START, NULL, 0);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    return add_op(cmd_handle, I2C_OP_STOP, NULL, 0);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    uint8_t *copy = malloc(data_len ? data_len : 1);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, data, data_len);
+    esp_err_t ret = add_op(cmd_handle, I2C_OP_WRITE, copy, data_len);
+    if (ret != ESP_OK) {
+        free(copy);
+    }
+    return ret;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    return i2c_master_write(cmd_handle, &data, 1, ack_en);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    return add_op(cmd_handle, I2C_OP_READ, data, data_len);
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack)
+{
+    return add_op(cmd_handle, I2C_OP_READ, data, 1);
+}
+
+
+// =========================================================
+// THỰC THI TRÊN BUS
+// =========================================================
+
+typedef struct {
+    const sim_i2c_device_t *device;
+    bool reading;
+    bool expect_addr;
+    uint8_t segment[SIM_I2C_SEGMENT_MAX];
+    size_t segment_len;
+} bus_state_t;
+
+static void flush_segment(bus_state_t *bus)
+{
+    if (bus->device != NULL && !bus->reading && bus->segment_len > 0) {
+        bus->device->write(bus->device->ctx, bus->segment, bus->segment_len);
+    }
+    bus->segment_len = 0;
+}
+
+// xorshift32: nhiễu bit khi chạy quá tốc độ bus cho phép
+static void corrupt_bytes(uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        noise_state ^= noise_state << 13;
+        noise_state ^= noise_state >> 17;
+        noise_state ^= noise_state << 5;
+        if ((noise_state & 0x7) == 0) {
+            data[i] ^= (uint8_t)(1u << ((noise_state >> 8) & 0x7));
+            bus_stats.corrupted_bytes++;
+        }
+    }
+}
+
+/**
+ * @brief Chạy các lệnh ngay tại thời điểm bắt đầu giao dịch (thiết bị thấy trạng thái lúc đó),
+ * rồi chờ hết thời gian truyền trên bus. NACK ở byte địa chỉ dừng giao dịch (ESP_FAIL).
+ */
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    i2c_cmd_link_t *link = (i2c_cmd_link_t *)cmd_handle;
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!bus_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sim_clock_lock();
+    while (sim_clock_now_us() < bus_free_us) {
+        sim_clock_wait(NULL, bus_free_us);
+    }
+
+    esp_err_t ret = ESP_OK;
+    uint64_t clocks = 0;
+    bus_state_t bus = { 0 };
+    for (size_t i = 0; i < link->count && ret == ESP_OK; i++) {
+        i2c_op_t *op = &link->ops[i];
+        switch (op->kind) {
+        case I2C_OP_START:
+            flush_segment(&bus);
+            bus.expect_addr = true;
+            clocks += 1;
+            break;
+        case I2C_OP_STOP:
+            flush_segment(&bus);
+            bus.device = NULL;
+            clocks += 1;
+            break;
+        case I2C_OP_WRITE:
+            for (size_t b = 0; b < op->len && ret == ESP_OK; b++) {
+                clocks += 9;
+                if (bus.expect_addr) {
+                    bus.expect_addr = false;
+                    bus.reading = (op->data[b] & 0x01) != 0;
+                    bus.device = find_device(op->data[b] >> 1);
+                    if (bus.device == NULL) {
+                        bus_stats.nacks++;
+                        ret = ESP_FAIL;
+                    }
+                } else if (bus.device != NULL && !bus.reading && bus.segment_len < SIM_I2C_SEGMENT_MAX) {
+                    bus.segment[bus.segment_len++] = op->data[b];
+                }
+            }
+            break;
+        case I2C_OP_READ:
+            clocks += 9 * op->len;
+            if (bus.device != NULL && bus.reading) {
+                bus.device->read(bus.device->ctx, op->data, op->len);
+                if (bus_freq_hz > max_freq_hz) {
+                    corrupt_bytes(op->data, op->len);
+                }
+            } else {
+                memset(op->data, 0xFF, op->len);    // SDA thả nổi
+            }
+            break;
+        }
+    }
+    flush_segment(&bus);
+
+    uint64_t duration_us = (clocks * 1000000ULL + bus_freq_hz - 1) / bus_freq_hz;
+    bus_free_us = sim_clock_now_us() + duration_us;
+    bus_stats.transactions++;
+    bus_stats.busy_us += duration_us;
+    sim_clock_wait(NULL, bus_free_us);
+    sim_clock_unlock();
+    return ret;
+}
@@ -0,0 +1,38 @@
+#ifndef SIM_I2C_H
+#define SIM_I2C_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// =========================================================
+// BUS I2C MÔ PHỎNG
+// =========================================================
+// - i2c_master_cmd_begin() chạy danh sách lệnh trên các thiết bị đã gắn (sim_i2c_attach),
+//   địa chỉ không có thiết bị thì NACK (ESP_FAIL)
+// - Mỗi byte dữ liệu một lần write() (sau byte địa chỉ ghi), mỗi đoạn đọc một lần read();
+//   hàm gọi lại chạy khi đang giữ khóa đồng hồ ảo nên thiết bị không cần khóa riêng
+// - Thời gian bus: 9 xung SCL mỗi byte (+1 cho START/STOP) theo tần số đã cấu hình
+// - Vượt sim_i2c_set_max_freq(): byte đọc bị lật bit ngẫu nhiên (bus thiếu trở kéo lên)
+
+typedef struct {
+    void *ctx;
+    // Các byte ghi sau byte địa chỉ trong một đoạn START..START/STOP (byte đầu thường là thanh ghi)
+    void (*write)(void *ctx, const uint8_t *data, size_t len);
+    void (*read)(void *ctx, uint8_t *data, size_t len);
+} sim_i2c_device_t;
+
+typedef struct {
+    uint32_t freq_hz;
+    uint32_t transactions;
+    uint32_t nacks;
+    uint32_t corrupted_bytes;       // Byte đọc bị lật bit do tần số quá cao
+    uint64_t busy_us;               // Tổng thời gian ảo bus bận
+} sim_i2c_stats_t;
+
+esp_err_t sim_i2c_attach(uint8_t addr, const sim_i2c_device_t *device);
+void sim_i2c_set_max_freq(uint32_t freq_hz, uint32_t seed);
+void sim_i2c_get_stats(sim_i2c_stats_t *stats);
+
+#endif
@@ -0,0 +1,564 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "sim_clock.h"
+#include "sim_esp.h"
+#include "sim_i2c.h"
+#include "sim_devices.h"
+#include "sim_waveform.h"
+#include "telemetry.h"
+#include "perf_stats.h"
+#include "trace_recorder.h"
+
+// =========================================================
+// MÔ PHỎNG TOÀN BỘ FIRMWARE TRÊN LINUX
+// =========================================================
+// app_main() của firmware chạy nguyên vẹn trên shim FreeRTOS / ESP-IDF với đồng hồ ảo,
+// cảm biến mô phỏng sau API i2c_master_*. Byte telemetry UART được ghi ra file (đọc bằng
+// các công cụ Python) và giải mã tại chỗ để đo thông lượng / độ trễ đầu-cuối theo thời gian ảo.
+
+void app_main(void);
+
+#define TLM_TYPE_MAX 0x20
+#define TLM_EVENT_MAX 8
+
+static const char *const class_names[] = { "Normal", "Stress/Risk", "Moving", "Low SpO2!", "Arrhythmia!" };
+static const char *const event_names[TLM_EVENT_MAX] = {
+    [TLM_EVT_SQI_REJECT] = "SQI reject", [TLM_EVT_LOW_CORRELATION] = "low correlation",
+    [TLM_EVT_PROX_ENTER] = "proximity enter", [TLM_EVT_PROX_EXIT] = "proximity exit", [TLM_EVT_AGC] = "AGC",
+};
+
+typedef struct {
+    uint32_t count;
+    double sum;
+    double min;
+    double max;
+} sim_series_t;
+
+static void series_add(sim_series_t *s, double v)
+{
+    if (s->count == 0 || v < s->min) s->min = v;
+    if (s->count == 0 || v > s->max) s->max = v;
+    s->sum += v;
+    s->count++;
+}
+
+static double series_mean(const sim_series_t *s)
+{
+    return s->count ? s->sum / s->count : 0.0;
+}
+
+// Thống kê khung telemetry; chỉ cập nhật từ hàm gọi lại UART TX (đang giữ khóa đồng hồ ảo)
+static struct {
+    uint8_t encoded[512];
+    size_t encoded_len;
+    bool overflow;
+    uint32_t frames;
+    uint32_t bad_frames;
+    uint32_t lost_frames;           // Khoảng trống seq: khung bị firmware bỏ do bộ đệm đầy
+    bool have_seq;
+    uint16_t next_seq;
+    uint32_t by_type[TLM_TYPE_MAX];
+    uint32_t events[TLM_EVENT_MAX];
+    uint32_t classes[5];
+    sim_series_t hr;
+    sim_series_t hr_error;
+    sim_series_t spo2;
+    sim_series_t spo2_error;
+    sim_series_t sample_to_result_ms;   // Mẫu mới nhất của cửa sổ -> kết quả được tạo
+    sim_series_t result_to_uart_ms;     // Kết quả được tạo -> byte cuối của khung rời UART
+    struct {
+        uint32_t count;
+        double weighted_avg;
+        uint32_t p99_max;
+        uint32_t max;
+    } perf[PERF_STAGE_COUNT];
+    tlm_diag_t diag;
+    bool have_diag;
+} mon;
+
+static struct {
+    double duration_s;
+    const char *tlm_out;
+    const char *uart_in;
+    double uart_in_at_s;
+    const char *trace_out;
+    const char *flash_file;
+    uint32_t i2c_max_hz;
+    bool no_mpu;
+    bool no_oled;
+    bool show_oled;
+    int log_level;
+} opt = {
+    .duration_s = 120.0,
+    .tlm_out = "telemetry.bin",
+    .uart_in_at_s = 1.0,
+    .i2c_max_hz = 400000,
+    .log_level = ESP_LOG_WARN,
+};
+
+
+// =========================================================
+// GIẢI MÃ KHUNG TELEMETRY
+// =========================================================
+
+static void on_vitals(const tlm_vitals_t *v, uint64_t done_us)
+{
+    const sim_scenario_t *scenario = sim_waveform_scenario();
+    double hr = v->hr_x10 / 10.0;
+    double spo2 = v->spo2_x10 / 10.0;
+    series_add(&mon.hr, hr);
+    series_add(&mon.spo2, spo2);
+    if (scenario->ppg_csv == NULL) {
+        series_add(&mon.hr_error, fabs(hr - scenario->hr_bpm));
+        series_add(&mon.spo2_error, fabs(spo2 - scenario->spo2));
+    }
+    if (v->ml_class < sizeof(class_names) / sizeof(class_names[0])) {
+        mon.classes[v->ml_class]++;
+    }
+
+    uint64_t result_us = (uint64_t)v->time_ms * 1000;
+    uint64_t sample_us;
+    if (sim_max30102_newest_read_sample(result_us, &sample_us) && sample_us <= result_us) {
+        series_add(&mon.sample_to_result_ms, (result_us - sample_us) / 1000.0);
+    }
+    if (done_us >= result_us) {
+        series_add(&mon.result_to_uart_ms, (done_us - result_us) / 1000.0);
+    }
+}
+
+static void on_perf(const uint8_t *payload, size_t len)
+{
+    if (len < offsetof(tlm_perf_t, stages)) {
+        return;
+    }
+    tlm_perf_t perf;
+    memset(&perf, 0, sizeof(perf));
+    memcpy(&perf, payload, len < sizeof(perf) ? len : sizeof(perf));
+    for (int i = 0; i < perf.stage_count && i < PERF_STAGE_COUNT; i++) {
+        const tlm_perf_stage_t *s = &perf.stages[i];
+        if (s->count == 0) {
+            continue;
+        }
+        uint32_t total = mon.perf[i].count + s->count;
+        mon.perf[i].weighted_avg = (mon.perf[i].weighted_avg * mon.perf[i].count + (double)s->avg_us * s->count) / total;
+        mon.perf[i].count = total;
+        if (s->p99_us > mon.perf[i].p99_max) mon.perf[i].p99_max = s->p99_us;
+        if (s->max_us > mon.perf[i].max) mon.perf[i].max = s->max_us;
+    }
+}
+
+static void on_frame(const uint8_t *encoded, size_t len, uint64_t done_us)
+{
+    uint8_t frame[sizeof(mon.encoded)];
+    size_t n = tlm_cobs_decode(encoded, len, frame);
+    if (n < 5 || tlm_crc16(frame, n - 2) != (uint16_t)(frame[n - 2] | (frame[n - 1] << 8))) {
+        mon.bad_frames++;
+        return;
+    }
+    uint8_t type = frame[0];
+    uint16_t seq = (uint16_t)(frame[1] | (frame[2] << 8));
+    if (mon.have_seq && seq != mon.next_seq) {
+        mon.lost_frames += (uint16_t)(seq - mon.next_seq);
+    }
+    mon.have_seq = true;
+    mon.next_seq = seq + 1;
+    mon.frames++;
+    if (type < TLM_TYPE_MAX) {
+        mon.by_type[type]++;
+    }
+
+    const uint8_t *payload = &frame[3];
+    size_t payload_len = n - 5;
+    switch (type) {
+    case TLM_MSG_VITALS:
+        if (payload_len >= sizeof(tlm_vitals_t)) {
+            tlm_vitals_t vitals;
+            memcpy(&vitals, payload, sizeof(vitals));
+            on_vitals(&vitals, done_us);
+        }
+        break;
+    case TLM_MSG_EVENT:
+        if (payload_len >= sizeof(tlm_event_header_t)) {
+            const tlm_event_header_t *event = (const tlm_event_header_t *)payload;
+            if (event->code < TLM_EVENT_MAX) {
+                mon.events[event->code]++;
+            }
+        }
+        break;
+    case TLM_MSG_DIAG:
+        if (payload_len >= sizeof(tlm_diag_t)) {
+            memcpy(&mon.diag, payload, sizeof(mon.diag));
+            mon.have_diag = true;
+        }
+        break;
+    case TLM_MSG_PERF:
+        on_perf(payload, payload_len);
+        break;
+    default:
+        break;
+    }
+}
+
+static void on_uart_tx(const uint8_t *data, size_t len, uint64_t start_us, uint64_t byte_us)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0x00) {
+            if (mon.encoded_len < sizeof(mon.encoded)) {
+                mon.encoded[mon.encoded_len++] = data[i];
+            } else {
+                mon.overflow = true;
+            }
+            continue;
+        }
+        if (mon.overflow) {
+            mon.bad_frames++;
+        } else if (mon.encoded_len > 0) {
+            on_frame(mon.encoded, mon.encoded_len, start_us + (i + 1) * byte_us);
+        }
+        mon.encoded_len = 0;
+        mon.overflow = false;
+    }
+}
+
+
+// =========================================================
+// BÁO CÁO
+// =========================================================
+
+static void print_series(const char *label, const sim_series_t *s, const char *unit)
+{
+    if (s->count == 0) {
+        printf("  %-24s -\n", label);
+        return;
+    }
+    printf("  %-24s mean %.1f, min %.1f, max %.1f %s (n=%lu)\n", label, series_mean(s), s->min, s->max, unit,
+           (unsigned long)s->count);
+}
+
+static void print_report(sim_end_reason_t reason, double real_s)
+{
+    static const char *const type_names[TLM_TYPE_MAX] = {
+        [TLM_MSG_VITALS] = "VITALS", [TLM_MSG_RAW] = "RAW", [TLM_MSG_EVENT] = "EVENT", [TLM_MSG_DIAG] = "DIAG",
+        [TLM_MSG_CONFIG] = "CONFIG", [TLM_MSG_PERF] = "PERF", [TLM_MSG_SYSMON] = "SYSMON", [TLM_MSG_TRACE] = "TRACE",
+    };
+    double virtual_s = sim_clock_now_us() / 1e6;
+    const sim_scenario_t *scenario = sim_waveform_scenario();
+    sim_max30102_stats_t max_stats;
+    sim_mpu6050_stats_t mpu_stats;
+    sim_ssd1306_stats_t oled_stats;
+    sim_i2c_stats_t bus;
+    sim_esp_stats_t esp;
+    sim_max30102_get_stats(&max_stats);
+    sim_mpu6050_get_stats(&mpu_stats);
+    sim_ssd1306_get_stats(&oled_stats);
+    sim_i2c_get_stats(&bus);
+    sim_esp_get_stats(&esp);
+
+    uint32_t windows = mon.by_type[TLM_MSG_VITALS] + mon.events[TLM_EVT_SQI_REJECT];
+    printf("=== ppg_sim: %.1f s virtual in %.2f s real (%.0fx)%s ===\n", virtual_s, real_s,
+           real_s > 0 ? virtual_s / real_s : 0.0, reason == SIM_END_DEADLOCK ? ", all tasks blocked" : "");
+    if (scenario->ppg_csv != NULL) {
+        printf("Scenario: replay %s%s%s\n", scenario->ppg_csv, scenario->accel_csv ? " + " : "",
+               scenario->accel_csv ? scenario->accel_csv : "");
+    } else {
+        printf("Scenario: HR %.0f bpm, SpO2 %.1f %%, PI %.1f %%, noise %.2f\n", scenario->hr_bpm, scenario->spo2,
+               scenario->perfusion, scenario->noise);
+    }
+    printf("Throughput: %lu windows (%.1f per real second)\n", (unsigned long)windows,
+           real_s > 0 ? windows / real_s : 0.0);
+
+    printf("Sensors:\n");
+    printf("  MAX30102  %lu samples @ %lu Hz, %lu read, %lu lost to FIFO overflow, LED red/IR PA 0x%02X/0x%02X,"
+           " %lu proximity triggers\n", (unsigned long)max_stats.samples, (unsigned long)max_stats.sample_rate_hz,
+           (unsigned long)max_stats.samples_read, (unsigned long)max_stats.samples_lost, max_stats.led_red_pa,
+           max_stats.led_ir_pa, (unsigned long)max_stats.prox_triggers);
+    printf("  MPU6050   %lu samples, %lu FIFO overflows\n", (unsigned long)mpu_stats.samples,
+           (unsigned long)mpu_stats.overflows);
+    printf("  SSD1306   %lu commands, %lu data bytes (%.1f full refreshes)\n", (unsigned long)oled_stats.commands,
+           (unsigned long)oled_stats.data_bytes, oled_stats.data_bytes / 1024.0);
+    printf("  I2C       %lu Hz, %lu transactions, %lu NACK, %lu corrupted bytes, bus busy %.1f %%\n",
+           (unsigned long)bus.freq_hz, (unsigned long)bus.transactions, (unsigned long)bus.nacks,
+           (unsigned long)bus.corrupted_bytes, virtual_s > 0 ? bus.busy_us / 1e4 / virtual_s : 0.0);
+
+    printf("Telemetry: %llu bytes in %lu writes (%.1f%% of UART), blocked %.1f ms, %lu frames, %lu bad, %lu lost\n ",
+           (unsigned long long)esp.tx_bytes, (unsigned long)esp.tx_writes,
+           virtual_s > 0 ? esp.tx_bytes * 10.0 / TLM_UART_BAUD / virtual_s * 100.0 : 0.0, esp.tx_blocked_us / 1000.0,
+           (unsigned long)mon.frames, (unsigned long)mon.bad_frames, (unsigned long)mon.lost_frames);
+    for (int t = 0; t < TLM_TYPE_MAX; t++) {
+        if (mon.by_type[t] > 0) {
+            printf(" %s %lu", type_names[t] ? type_names[t] : "?", (unsigned long)mon.by_type[t]);
+        }
+    }
+    printf("\n");
+    if (mon.by_type[TLM_MSG_EVENT] > 0) {
+        printf(" ");
+        for (int e = 0; e < TLM_EVENT_MAX; e++) {
+            if (mon.events[e] > 0) {
+                printf(" %s %lu", event_names[e] ? event_names[e] : "?", (unsigned long)mon.events[e]);
+            }
+        }
+        printf("\n");
+    }
+    if (esp.rx_bytes > 0) {
+        printf("  Host -> device: %lu bytes read by TLM_RX\n", (unsigned long)esp.rx_bytes);
+    }
+    if (mon.have_diag) {
+        printf("  Last DIAG: tlm dropped %lu, raw dropped %lu, accel overflows %lu, PPG lost %lu, AGC changes %lu\n",
+               (unsigned long)mon.diag.tlm_dropped, (unsigned long)mon.diag.raw_dropped,
+               (unsigned long)mon.diag.accel_fifo_overflows, (unsigned long)mon.diag.ppg_samples_lost,
+               (unsigned long)mon.diag.agc_changes);
+    }
+
+    printf("Results:\n");
+    print_series("HR", &mon.hr, "bpm");
+    print_series("SpO2", &mon.spo2, "%");
+    if (mon.hr_error.count > 0) {
+        printf("  %-24s HR %.1f bpm, SpO2 %.1f %%\n", "Mean abs error vs truth", series_mean(&mon.hr_error),
+               series_mean(&mon.spo2_error));
+    }
+    printf("  Classes:");
+    for (size_t c = 0; c < sizeof(class_names) / sizeof(class_names[0]); c++) {
+        printf(" %s %lu", class_names[c], (unsigned long)mon.classes[c]);
+    }
+    printf("\n  Buzzer: %lu beeps, %lu tones\n", (unsigned long)esp.buzzer_beeps, (unsigned long)esp.buzzer_tones);
+
+    printf("Latency (virtual time):\n");
+    print_series("newest sample -> result", &mon.sample_to_result_ms, "ms");
+    print_series("result -> UART done", &mon.result_to_uart_ms, "ms");
+
+    bool have_perf = false;
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+        have_perf |= mon.perf[i].count > 0;
+    }
+    if (have_perf) {
+#ifdef PERF_CLOCK_ESP_TIMER
+        printf("Per stage (virtual time, us): count / avg / p99 / max\n");
+#else
+        printf("Host CPU per stage (real time, us): count / avg / p99 / max\n");
+#endif
+        for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+            if (mon.perf[i].count > 0) {
+                printf("  %-10s %8lu %10.1f %8lu %8lu\n", perf_stage_name((perf_stage_t)i),
+                       (unsigned long)mon.perf[i].count, mon.perf[i].weighted_avg,
+                       (unsigned long)mon.perf[i].p99_max, (unsigned long)mon.perf[i].max);
+            }
+        }
+    }
+}
+
+
+// =========================================================
+// DÒNG LỆNH
+// =========================================================
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --duration S         virtual seconds to simulate (default 120)\n"
+            "  --hr BPM             synthetic heart rate (default 72)\n"
+            "  --spo2 PCT           synthetic SpO2 (default 97)\n"
+            "  --pi PCT             IR perfusion index (default 2)\n"
+            "  --noise X            noise std / pulse amplitude (default 0.02)\n"
+            "  --motion G:S:E       arm swing of G g from S to E seconds\n"
+            "  --finger-off S:E     no finger from S to E seconds\n"
+            "  --temp C             MAX30102 die temperature (default 33.5)\n"
+            "  --seed N             noise seed\n"
+            "  --replay-ppg FILE    replay a Raw_ppg_*.csv recording\n"
+            "  --replay-accel FILE  replay a Raw_accel_*.csv recording\n"
+            "  --no-mpu, --no-oled  leave the device off the bus (NACK)\n"
+            "  --i2c-max-hz HZ      highest SCL the bus tolerates (default 400000)\n"
+            "  --tlm-out FILE       UART telemetry bytes (default telemetry.bin)\n"
+            "  --uart-in FILE[@S]   bytes sent by the host from S seconds (default 1)\n"
+            "  --trace FILE         export the trace ring at the end (trace_to_chrome.py)\n"
+            "  --flash FILE         vitals partition image, loaded if present and saved at the end\n"
+            "  --log-level N        ESP_LOG level 0..5 (default 2 = warnings)\n"
+            "  --oled               print the final OLED screen\n",
+            prog);
+}
+
+static bool parse_range(const char *arg, double *a, double *b, double *c)
+{
+    if (c != NULL) {
+        return sscanf(arg, "%lf:%lf:%lf", a, b, c) == 3;
+    }
+    return sscanf(arg, "%lf:%lf", a, b) == 2;
+}
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    if (data != NULL) {
+        *len = fread(data, 1, (size_t)(size > 0 ? size : 0), f);
+    }
+    fclose(f);
+    return data;
+}
+
+static bool parse_args(int argc, char **argv, sim_scenario_t *scenario)
+{
+    enum {
+        OPT_DURATION = 256, OPT_HR, OPT_SPO2, OPT_PI, OPT_NOISE, OPT_MOTION, OPT_FINGER_OFF, OPT_TEMP, OPT_SEED,
+        OPT_REPLAY_PPG, OPT_REPLAY_ACCEL, OPT_NO_MPU, OPT_NO_OLED, OPT_I2C_MAX_HZ, OPT_TLM_OUT, OPT_UART_IN,
+        OPT_TRACE, OPT_FLASH, OPT_LOG_LEVEL, OPT_OLED, OPT_HELP,
+    };
+    static const struct option options[] = {
+        { "duration", required_argument, NULL, OPT_DURATION },
+        { "hr", required_argument, NULL, OPT_HR },
+        { "spo2", required_argument, NULL, OPT_SPO2 },
+        { "pi", required_argument, NULL, OPT_PI },
+        { "noise", required_argument, NULL, OPT_NOISE },
+        { "motion", required_argument, NULL, OPT_MOTION },
+        { "finger-off", required_argument, NULL, OPT_FINGER_OFF },
+        { "temp", required_argument, NULL, OPT_TEMP },
+        { "seed", required_argument, NULL, OPT_SEED },
+        { "replay-ppg", required_argument, NULL, OPT_REPLAY_PPG },
+        { "replay-accel", required_argument, NULL, OPT_REPLAY_ACCEL },
+        { "no-mpu", no_argument, NULL, OPT_NO_MPU },
+        { "no-oled", no_argument, NULL, OPT_NO_OLED },
+        { "i2c-max-hz", required_argument, NULL, OPT_I2C_MAX_HZ },
+        { "tlm-out", required_argument, NULL, OPT_TLM_OUT },
+        { "uart-in", required_argument, NULL, OPT_UART_IN },
+        { "trace", required_argument, NULL, OPT_TRACE },
+        { "flash", required_argument, NULL, OPT_FLASH },
+        { "log-level", required_argument, NULL, OPT_LOG_LEVEL },
+        { "oled", no_argument, NULL, OPT_OLED },
+        { "help", no_argument, NULL, OPT_HELP },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (c) {
+        case OPT_DURATION: opt.duration_s = atof(optarg); break;
+        case OPT_HR: scenario->hr_bpm = atof(optarg); break;
+        case OPT_SPO2: scenario->spo2 = atof(optarg); break;
+        case OPT_PI: scenario->perfusion = atof(optarg); break;
+        case OPT_NOISE: scenario->noise = atof(optarg); break;
+        case OPT_MOTION:
+            if (!parse_range(optarg, &scenario->motion_g, &scenario->motion_start_s, &scenario->motion_end_s)) {
+                return false;
+            }
+            break;
+        case OPT_FINGER_OFF:
+            if (!parse_range(optarg, &scenario->finger_off_start_s, &scenario->finger_off_end_s, NULL)) {
+                return false;
+            }
+            break;
+        case OPT_TEMP: scenario->temp_c = atof(optarg); break;
+        case OPT_SEED: scenario->seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case OPT_REPLAY_PPG: scenario->ppg_csv = optarg; break;
+        case OPT_REPLAY_ACCEL: scenario->accel_csv = optarg; break;
+        case OPT_NO_MPU: opt.no_mpu = true; break;
+        case OPT_NO_OLED: opt.no_oled = true; break;
+        case OPT_I2C_MAX_HZ: opt.i2c_max_hz = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case OPT_TLM_OUT: opt.tlm_out = optarg; break;
+        case OPT_UART_IN: {
+            char *at = strchr(optarg, '@');
+            if (at != NULL) {
+                *at = '\0';
+                opt.uart_in_at_s = atof(at + 1);
+            }
+            opt.uart_in = optarg;
+            break;
+        }
+        case OPT_TRACE: opt.trace_out = optarg; break;
+        case OPT_FLASH: opt.flash_file = optarg; break;
+        case OPT_LOG_LEVEL: opt.log_level = atoi(optarg); break;
+        case OPT_OLED: opt.show_oled = true; break;
+        default: return false;
+        }
+    }
+    return optind == argc && opt.duration_s > 0 && scenario->hr_bpm > 0;
+}
+
+static void firmware_main(void *arg)
+{
+    app_main();
+}
+
+int main(int argc, char **argv)
+{
+    sim_scenario_t scenario = {
+        .hr_bpm = 72.0,
+        .spo2 = 97.0,
+        .perfusion = 2.0,
+        .noise = 0.02,
+        .temp_c = 33.5,
+        .seed = 1,
+    };
+    if (!parse_args(argc, argv, &scenario)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!sim_waveform_init(&scenario)) {
+        return 1;
+    }
+    esp_log_level_set("*", (esp_log_level_t)opt.log_level);
+
+    FILE *tlm_file = NULL;
+    if (opt.tlm_out[0] != '\0' && (tlm_file = fopen(opt.tlm_out, "wb")) == NULL) {
+        fprintf(stderr, "sim: cannot create %s\n", opt.tlm_out);
+        return 1;
+    }
+    sim_uart_set_tx(tlm_file, on_uart_tx);
+    uint8_t *uart_in = NULL;
+    if (opt.uart_in != NULL) {
+        size_t len = 0;
+        if ((uart_in = load_file(opt.uart_in, &len)) == NULL) {
+            fprintf(stderr, "sim: cannot open %s\n", opt.uart_in);
+            return 1;
+        }
+        sim_uart_set_rx(uart_in, len, (uint64_t)(opt.uart_in_at_s * 1e6));
+    }
+    if (opt.flash_file != NULL) {
+        sim_flash_load(opt.flash_file);     // Chưa có file: partition trống (0xFF)
+    }
+
+    sim_i2c_set_max_freq(opt.i2c_max_hz, scenario.seed);
+    sim_max30102_attach();
+    if (!opt.no_mpu) {
+        sim_mpu6050_attach();
+    }
+    if (!opt.no_oled) {
+        sim_ssd1306_attach();
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    sim_end_reason_t reason = sim_clock_run(firmware_main, (uint64_t)(opt.duration_s * 1e6));
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double real_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    // Mọi task đã dừng ở điểm chờ: đọc trạng thái cuối không cần đồng bộ thêm
+    if (tlm_file != NULL) {
+        fclose(tlm_file);
+    }
+    print_report(reason, real_s);
+    if (opt.show_oled) {
+        sim_ssd1306_render(stdout);
+    }
+    if (opt.trace_out != NULL && !trace_export_file(opt.trace_out)) {
+        fprintf(stderr, "sim: cannot write %s\n", opt.trace_out);
+    }
+    if (opt.flash_file != NULL && !sim_flash_save(opt.flash_file)) {
+        fprintf(stderr, "sim: cannot write %s\n", opt.flash_file);
+    }
+    free(uart_in);
+    fflush(stdout);
+    // Các thread task vẫn bị giữ ở điểm chờ: thoát ngay, không chờ chúng
+    _exit(0);
+}
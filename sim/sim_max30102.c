@@ -0,0 +1,322 @@
+#include <math.h>
+#include <string.h>
+#include "sim_devices.h"
+#include "sim_i2c.h"
+#include "sim_waveform.h"
+#include "sim_clock.h"
+#include "max30102_api.h"
+#include "i2c_api.h"         // MAX30102_ADDR
+
+#define MAX_MODE_SHDN 0x80
+#define MAX_MODE_RESET 0x40
+#define MAX_INT_A_FULL 0x80
+#define MAX_INT_PPG_RDY 0x40
+#define MAX_INT_PWR_RDY 0x01
+#define MAX_TEMP_EN 0x01
+#define MAX_TEMP_CONVERSION_US 29000    // Datasheet: 29 ms
+#define MAX_OVF_MAX 0x1F
+#define MAX_HISTORY 256                 // Lần đọc FIFO gần nhất (tra độ trễ)
+
+static const uint16_t sample_rates[8] = { 50, 100, 200, 400, 800, 1000, 1600, 3200 };
+static const uint8_t averages[8] = { 1, 2, 4, 8, 16, 32, 32, 32 };
+
+typedef struct {
+    uint32_t red;
+    uint32_t ir;
+    uint64_t time_us;           // Thời điểm lấy mẫu (ảo)
+} fifo_sample_t;
+
+static struct {
+    uint8_t regs[256];
+    uint8_t ptr;
+    fifo_sample_t fifo[MAX30102_FIFO_DEPTH];
+    uint8_t wr;
+    uint8_t rd;
+    uint8_t count;              // Mẫu chưa đọc (wr == rd không phân biệt được rỗng / đầy)
+    uint8_t byte_index;         // Byte tiếp theo trong mẫu đang đọc (6 byte / mẫu)
+    double next_sample_us;
+    bool proximity;             // Đang ở chế độ proximity (chưa vượt ngưỡng)
+    uint64_t temp_ready_us;
+    uint64_t last_read_time_us; // Thời điểm lấy mẫu của mẫu vừa đọc xong
+    bool popped;                // Lần đọc hiện tại đã lấy ra ít nhất một mẫu
+    struct {
+        uint64_t read_us;
+        uint64_t sample_us;
+    } history[MAX_HISTORY];
+    uint32_t history_count;
+    sim_max30102_stats_t stats;
+} max;
+
+
+// =========================================================
+// LẤY MẪU
+// =========================================================
+
+static double sample_period_us(void)
+{
+    uint8_t sr = (max.regs[REG_SPO2_CONFIG] >> 2) & 0x07;
+    uint8_t ave = (max.regs[REG_FIFO_CONFIG] >> 5) & 0x07;
+    return 1e6 * averages[ave] / sample_rates[sr];
+}
+
+static bool sampling(void)
+{
+    return !(max.regs[REG_MODE_CONFIG] & MAX_MODE_SHDN) && (max.regs[REG_MODE_CONFIG] & 0x07) != 0;
+}
+
+/**
+ * @brief ADC 18 bit: dòng quang = (nA/mA) x dòng LED (0.2 mA/bước), thang đo 2048 nA << ADC_RGE;
+ * độ rộng xung ngắn hơn thì các bit thấp bằng 0 (15..18 bit).
+ */
+static uint32_t adc_counts(double na_per_ma, uint8_t pa)
+{
+    uint8_t rge = (max.regs[REG_SPO2_CONFIG] >> 5) & 0x03;
+    uint8_t pw = max.regs[REG_SPO2_CONFIG] & 0x03;
+    double full_scale_na = 2048.0 * (1 << rge);
+    double counts = na_per_ma * pa * 0.2 / full_scale_na * MAX30102_ADC_FULL_SCALE;
+    if (counts < 0.0) {
+        counts = 0.0;
+    }
+    uint32_t value = (counts > MAX30102_ADC_FULL_SCALE) ? MAX30102_ADC_FULL_SCALE : (uint32_t)counts;
+    return value & ~((1u << (3 - pw)) - 1) & MAX30102_ADC_MASK;
+}
+
+static void fifo_push(uint64_t t_us, uint32_t red, uint32_t ir)
+{
+    if (max.count == MAX30102_FIFO_DEPTH) {
+        if (max.regs[REG_OVF_COUNTER] < MAX_OVF_MAX) {
+            max.regs[REG_OVF_COUNTER]++;
+        }
+        max.stats.samples_lost++;
+        if (!(max.regs[REG_FIFO_CONFIG] & 0x10)) {
+            return;                     // Không rollover: giữ dữ liệu cũ, bỏ mẫu mới
+        }
+        max.rd = (max.rd + 1) % MAX30102_FIFO_DEPTH;
+        max.count--;
+        max.byte_index = 0;
+    }
+    max.fifo[max.wr] = (fifo_sample_t){ .red = red, .ir = ir, .time_us = t_us };
+    max.wr = (max.wr + 1) % MAX30102_FIFO_DEPTH;
+    max.count++;
+    max.stats.samples++;
+
+    max.regs[REG_INTR_STATUS_1] |= MAX_INT_PPG_RDY;
+    if (max.count >= MAX30102_FIFO_DEPTH - (max.regs[REG_FIFO_CONFIG] & 0x0F)) {
+        max.regs[REG_INTR_STATUS_1] |= MAX_INT_A_FULL;
+    }
+}
+
+// Proximity: chỉ LED IR ở dòng PILOT_PA, so 8 bit cao của ADC với PROX_INT_THRESH
+static void proximity_sample(double t_s)
+{
+    double red, ir;
+    sim_waveform_ppg(t_s, &red, &ir);
+    uint32_t counts = adc_counts(ir, max.regs[REG_PILOT_PA]);
+    if ((counts >> 10) > max.regs[REG_PROX_INT_THRESH]) {
+        max.proximity = false;
+        max.regs[REG_INTR_STATUS_1] |= MAX30102_PROX_INT;
+        max.stats.prox_triggers++;
+    }
+}
+
+// Sinh bù mọi mẫu tới thời điểm ảo hiện tại
+static void max_advance(void)
+{
+    uint64_t now = sim_clock_now_us();
+
+    if ((max.regs[REG_TEMP_CONFIG] & MAX_TEMP_EN) && now >= max.temp_ready_us) {
+        double temp = sim_waveform_scenario()->temp_c;
+        double whole = floor(temp);
+        max.regs[REG_TEMP_INTR] = (uint8_t)(int8_t)whole;
+        max.regs[REG_TEMP_FRAC] = (uint8_t)((temp - whole) * 16.0) & 0x0F;
+        max.regs[REG_TEMP_CONFIG] &= ~MAX_TEMP_EN;
+        max.regs[REG_INTR_STATUS_2] |= MAX30102_DIE_TEMP_RDY;
+        max.stats.temp_conversions++;
+    }
+
+    if (!sampling()) {
+        max.next_sample_us = (double)now;
+        return;
+    }
+    double period = sample_period_us();
+    while (max.next_sample_us <= (double)now) {
+        uint64_t t_us = (uint64_t)max.next_sample_us;
+        double t_s = t_us / 1e6;
+        if (max.proximity) {
+            proximity_sample(t_s);
+        } else {
+            double red, ir;
+            sim_waveform_ppg(t_s, &red, &ir);
+            fifo_push(t_us, adc_counts(red, max.regs[REG_LED1_PA]), adc_counts(ir, max.regs[REG_LED2_PA]));
+        }
+        max.next_sample_us += period;
+    }
+}
+
+static void max_reset(void)
+{
+    memset(max.regs, 0, sizeof(max.regs));
+    max.regs[REG_INTR_STATUS_1] = MAX_INT_PWR_RDY;
+    max.regs[REG_REV_ID] = 0x03;
+    max.regs[REG_PART_ID] = MAX30102_PART_ID;
+    max.wr = max.rd = max.count = max.byte_index = 0;
+    max.proximity = false;
+}
+
+
+// =========================================================
+// THANH GHI
+// =========================================================
+
+static void max_write_reg(uint8_t reg, uint8_t value)
+{
+    switch (reg) {
+    case REG_INTR_STATUS_1:
+    case REG_INTR_STATUS_2:
+    case REG_FIFO_DATA:
+    case REG_TEMP_INTR:
+    case REG_TEMP_FRAC:
+    case REG_REV_ID:
+    case REG_PART_ID:
+        return;                         // Chỉ đọc
+    case REG_FIFO_WR_PTR:
+    case REG_FIFO_RD_PTR:
+        max.regs[reg] = value & 0x1F;
+        if (reg == REG_FIFO_WR_PTR) {
+            max.wr = value & 0x1F;
+        } else {
+            max.rd = value & 0x1F;
+        }
+        max.count = (uint8_t)((max.wr - max.rd) & 0x1F);
+        max.byte_index = 0;
+        return;
+    case REG_MODE_CONFIG:
+        if (value & MAX_MODE_RESET) {
+            max_reset();
+            return;
+        }
+        max.regs[reg] = value;
+        // Ghi MODE khi PROX_INT_EN bật: khởi động lại ở chế độ proximity
+        max.proximity = (max.regs[REG_INTR_ENABLE_1] & MAX30102_PROX_INT) != 0;
+        max.next_sample_us = (double)sim_clock_now_us() + sample_period_us();
+        return;
+    case REG_SPO2_CONFIG:
+    case REG_FIFO_CONFIG:
+        max.regs[reg] = value;
+        max.next_sample_us = (double)sim_clock_now_us() + sample_period_us();
+        return;
+    case REG_INTR_ENABLE_1:
+        max.regs[reg] = value;
+        if (!(value & MAX30102_PROX_INT)) {
+            max.proximity = false;
+        }
+        return;
+    case REG_TEMP_CONFIG:
+        max.regs[reg] = value & MAX_TEMP_EN;
+        if (value & MAX_TEMP_EN) {
+            max.temp_ready_us = sim_clock_now_us() + MAX_TEMP_CONVERSION_US;
+        }
+        return;
+    default:
+        max.regs[reg] = value;
+        return;
+    }
+}
+
+static uint8_t max_read_fifo_byte(void)
+{
+    if (max.count == 0) {
+        return 0;
+    }
+    const fifo_sample_t *s = &max.fifo[max.rd];
+    uint32_t value = (max.byte_index < 3) ? s->red : s->ir;
+    uint8_t byte = (uint8_t)(value >> (8 * (2 - max.byte_index % 3)));
+    if (++max.byte_index == 6) {
+        max.byte_index = 0;
+        max.last_read_time_us = s->time_us;
+        max.popped = true;
+        max.rd = (max.rd + 1) % MAX30102_FIFO_DEPTH;
+        max.count--;
+        max.regs[REG_OVF_COUNTER] = 0;
+        max.stats.samples_read++;
+    }
+    return byte;
+}
+
+static uint8_t max_read_reg(uint8_t reg)
+{
+    uint8_t value;
+    switch (reg) {
+    case REG_INTR_STATUS_1:
+    case REG_INTR_STATUS_2:
+        value = max.regs[reg];
+        max.regs[reg] = 0;              // Xóa khi đọc
+        return value;
+    case REG_FIFO_WR_PTR:
+        return max.wr;
+    case REG_FIFO_RD_PTR:
+        return max.rd;
+    case REG_FIFO_DATA:
+        return max_read_fifo_byte();
+    default:
+        return max.regs[reg];
+    }
+}
+
+static void max_i2c_write(void *ctx, const uint8_t *data, size_t len)
+{
+    max_advance();
+    max.ptr = data[0];
+    for (size_t i = 1; i < len; i++) {
+        max_write_reg(max.ptr, data[i]);
+        max.ptr++;
+    }
+}
+
+static void max_i2c_read(void *ctx, uint8_t *data, size_t len)
+{
+    max_advance();
+    max.popped = false;
+    for (size_t i = 0; i < len; i++) {
+        data[i] = max_read_reg(max.ptr);
+        if (max.ptr != REG_FIFO_DATA) {
+            max.ptr++;
+        }
+    }
+    if (max.popped) {
+        uint32_t slot = max.history_count++ % MAX_HISTORY;
+        max.history[slot].read_us = sim_clock_now_us();
+        max.history[slot].sample_us = max.last_read_time_us;
+    }
+}
+
+void sim_max30102_attach(void)
+{
+    max_reset();
+    sim_i2c_device_t device = { .ctx = NULL, .write = max_i2c_write, .read = max_i2c_read };
+    sim_i2c_attach(MAX30102_ADDR, &device);
+}
+
+void sim_max30102_get_stats(sim_max30102_stats_t *stats)
+{
+    sim_clock_lock();
+    *stats = max.stats;
+    stats->led_red_pa = max.regs[REG_LED1_PA];
+    stats->led_ir_pa = max.regs[REG_LED2_PA];
+    stats->sample_rate_hz = (uint32_t)lround(1e6 / sample_period_us());
+    sim_clock_unlock();
+}
+
+// Gọi khi đang giữ khóa (từ hàm gọi lại UART TX)
+bool sim_max30102_newest_read_sample(uint64_t t_us, uint64_t *sample_us)
+{
+    uint32_t available = (max.history_count < MAX_HISTORY) ? max.history_count : MAX_HISTORY;
+    for (uint32_t i = 1; i <= available; i++) {
+        uint32_t slot = (max.history_count - i) % MAX_HISTORY;
+        if (max.history[slot].read_us <= t_us) {
+            *sample_us = max.history[slot].sample_us;
+            return true;
+        }
+    }
+    return false;
+}
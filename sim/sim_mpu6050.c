@@ -0,0 +1,192 @@
+#include <math.h>
+#include <string.h>
+#include "sim_devices.h"
+#include "sim_i2c.h"
+#include "sim_waveform.h"
+#include "sim_clock.h"
+#include "mpu6050_api.h"
+
+#define MPU_PWR_SLEEP 0x40
+#define MPU_PWR_RESET_VALUE 0x40        // Sau khi cấp nguồn / reset: chế độ ngủ
+
+static struct {
+    uint8_t regs[128];
+    uint8_t ptr;
+    uint8_t fifo[MPU6050_FIFO_SIZE];
+    uint16_t fifo_head;         // Byte cũ nhất
+    uint16_t fifo_count;
+    double next_sample_us;
+    sim_mpu6050_stats_t stats;
+} mpu;
+
+
+// =========================================================
+// LẤY MẪU
+// =========================================================
+
+// DLPF tắt (CONFIG 0 hoặc 7): tần số gốc 8 kHz, bật: 1 kHz
+static double mpu_sample_period_us(void)
+{
+    uint8_t dlpf = mpu.regs[MPU6050_REG_CONFIG] & 0x07;
+    double base_hz = (dlpf == 0 || dlpf == 7) ? 8000.0 : 1000.0;
+    return 1e6 * (1 + mpu.regs[MPU6050_REG_SMPLRT_DIV]) / base_hz;
+}
+
+// FIFO đầy: byte cũ nhất bị ghi đè (khung 6 byte lệch đi) và bật cờ FIFO_OFLOW
+static void mpu_fifo_push(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (mpu.fifo_count == MPU6050_FIFO_SIZE) {
+            mpu.fifo_head = (mpu.fifo_head + 1) % MPU6050_FIFO_SIZE;
+            mpu.fifo_count--;
+            if (!(mpu.regs[MPU6050_REG_INT_STATUS] & MPU6050_INT_FIFO_OFLOW)) {
+                mpu.stats.overflows++;
+            }
+            mpu.regs[MPU6050_REG_INT_STATUS] |= MPU6050_INT_FIFO_OFLOW;
+        }
+        mpu.fifo[(mpu.fifo_head + mpu.fifo_count) % MPU6050_FIFO_SIZE] = data[i];
+        mpu.fifo_count++;
+    }
+}
+
+static void mpu_sample(double t_s)
+{
+    double g[3];
+    sim_waveform_accel(t_s, g);
+    double lsb_per_g = 16384.0 / (1 << ((mpu.regs[MPU6050_REG_ACCEL_CONFIG] >> 3) & 0x03));
+    uint8_t *out = &mpu.regs[MPU6050_REG_ACCEL_XOUT_H];
+    for (int axis = 0; axis < 3; axis++) {
+        double v = lround(g[axis] * lsb_per_g);
+        int16_t raw = (int16_t)(v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+        out[axis * 2] = (uint8_t)((uint16_t)raw >> 8);
+        out[axis * 2 + 1] = (uint8_t)raw;
+    }
+    if ((mpu.regs[MPU6050_REG_USER_CTRL] & MPU6050_USER_CTRL_FIFO_EN) &&
+        (mpu.regs[MPU6050_REG_FIFO_EN] & MPU6050_FIFO_EN_ACCEL)) {
+        mpu_fifo_push(out, MPU6050_FIFO_SAMPLE_BYTES);
+    }
+    mpu.stats.samples++;
+}
+
+static void mpu_advance(void)
+{
+    uint64_t now = sim_clock_now_us();
+    if (mpu.regs[MPU6050_REG_PWR_MGMT_1] & MPU_PWR_SLEEP) {
+        mpu.next_sample_us = (double)now;
+        return;
+    }
+    double period = mpu_sample_period_us();
+    while (mpu.next_sample_us <= (double)now) {
+        mpu_sample(mpu.next_sample_us / 1e6);
+        mpu.next_sample_us += period;
+    }
+}
+
+static void mpu_reset(void)
+{
+    memset(mpu.regs, 0, sizeof(mpu.regs));
+    mpu.regs[MPU6050_REG_PWR_MGMT_1] = MPU_PWR_RESET_VALUE;
+    mpu.regs[MPU6050_REG_WHO_AM_I] = MPU6050_WHO_AM_I_VAL;
+    mpu.fifo_head = mpu.fifo_count = 0;
+}
+
+
+// =========================================================
+// THANH GHI
+// =========================================================
+
+static void mpu_write_reg(uint8_t reg, uint8_t value)
+{
+    if (reg >= sizeof(mpu.regs)) {
+        return;
+    }
+    switch (reg) {
+    case MPU6050_REG_PWR_MGMT_1:
+        if (value & PWR_MGMT_1_RESET) {
+            mpu_reset();
+            return;
+        }
+        mpu.regs[reg] = value;
+        mpu.next_sample_us = (double)sim_clock_now_us() + mpu_sample_period_us();
+        return;
+    case MPU6050_REG_USER_CTRL:
+        if (value & MPU6050_USER_CTRL_FIFO_RESET) {
+            mpu.fifo_head = mpu.fifo_count = 0;
+        }
+        mpu.regs[reg] = value & ~MPU6050_USER_CTRL_FIFO_RESET;     // Bit reset tự xóa
+        return;
+    case MPU6050_REG_SMPLRT_DIV:
+    case MPU6050_REG_CONFIG:
+        mpu.regs[reg] = value;
+        mpu.next_sample_us = (double)sim_clock_now_us() + mpu_sample_period_us();
+        return;
+    case MPU6050_REG_INT_STATUS:
+    case MPU6050_REG_WHO_AM_I:
+    case MPU6050_REG_FIFO_COUNTH:
+    case MPU6050_REG_FIFO_COUNTH + 1:
+        return;                         // Chỉ đọc
+    default:
+        mpu.regs[reg] = value;
+        return;
+    }
+}
+
+static uint8_t mpu_read_reg(uint8_t reg)
+{
+    uint8_t value;
+    switch (reg) {
+    case MPU6050_REG_INT_STATUS:
+        value = mpu.regs[reg];
+        mpu.regs[reg] = 0;              // Xóa khi đọc
+        return value;
+    case MPU6050_REG_FIFO_COUNTH:
+        return (uint8_t)(mpu.fifo_count >> 8);
+    case MPU6050_REG_FIFO_COUNTH + 1:
+        return (uint8_t)mpu.fifo_count;
+    case MPU6050_REG_FIFO_R_W:
+        if (mpu.fifo_count == 0) {
+            return 0xFF;
+        }
+        value = mpu.fifo[mpu.fifo_head];
+        mpu.fifo_head = (mpu.fifo_head + 1) % MPU6050_FIFO_SIZE;
+        mpu.fifo_count--;
+        return value;
+    default:
+        return (reg < sizeof(mpu.regs)) ? mpu.regs[reg] : 0;
+    }
+}
+
+static void mpu_i2c_write(void *ctx, const uint8_t *data, size_t len)
+{
+    mpu_advance();
+    mpu.ptr = data[0];
+    for (size_t i = 1; i < len; i++) {
+        mpu_write_reg(mpu.ptr, data[i]);
+        mpu.ptr++;
+    }
+}
+
+static void mpu_i2c_read(void *ctx, uint8_t *data, size_t len)
+{
+    mpu_advance();
+    for (size_t i = 0; i < len; i++) {
+        data[i] = mpu_read_reg(mpu.ptr);
+        if (mpu.ptr != MPU6050_REG_FIFO_R_W) {
+            mpu.ptr++;
+        }
+    }
+}
+
+void sim_mpu6050_attach(void)
+{
+    mpu_reset();
+    sim_i2c_device_t device = { .ctx = NULL, .write = mpu_i2c_write, .read = mpu_i2c_read };
+    sim_i2c_attach(MPU6050_ADDR, &device);
+}
+
+void sim_mpu6050_get_stats(sim_mpu6050_stats_t *stats)
+{
+    sim_clock_lock();
+    *stats = mpu.stats;
+    sim_clock_unlock();
+}
@@ -0,0 +1,187 @@
+#include <string.h>
+#include "sim_devices.h"
+#include "sim_i2c.h"
+#include "sim_clock.h"
+#include "oled_driver.h"
+
+#define OLED_WIDTH 128
+#define OLED_PAGES 8
+#define OLED_CONTROL_CO 0x80            // Continuation: chỉ một byte theo sau byte điều khiển
+#define OLED_CONTROL_DC 0x40            // 1 = dữ liệu GDDRAM, 0 = lệnh
+
+typedef enum {
+    OLED_ADDR_HORIZONTAL = 0,
+    OLED_ADDR_VERTICAL = 1,
+    OLED_ADDR_PAGE = 2,
+} oled_addr_mode_t;
+
+static struct {
+    uint8_t gddram[OLED_PAGES][OLED_WIDTH];
+    uint8_t page;
+    uint8_t col;
+    uint8_t col_start, col_end;
+    uint8_t page_start, page_end;
+    oled_addr_mode_t mode;
+    bool display_on;
+    bool seg_remap;                     // A1: cột 127 nối SEG0
+    bool com_reverse;                   // C8: quét COM63 -> COM0
+    uint8_t cmd[8];                     // Lệnh đang nhận tham số
+    uint8_t cmd_len;
+    uint8_t cmd_need;
+    sim_ssd1306_stats_t stats;
+} oled;
+
+
+// =========================================================
+// LỆNH
+// =========================================================
+
+static uint8_t command_args(uint8_t cmd)
+{
+    switch (cmd) {
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        return 1;
+    case 0x21: case 0x22: case 0xA3:
+        return 2;
+    case 0x29: case 0x2A:
+        return 5;
+    case 0x26: case 0x27:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static void execute_command(const uint8_t *cmd)
+{
+    uint8_t op = cmd[0];
+    if (op <= 0x0F) {
+        oled.col = (oled.col & 0xF0) | op;                  // Page mode: 4 bit thấp cột
+    } else if (op <= 0x1F) {
+        oled.col = (uint8_t)(((op & 0x07) << 4) | (oled.col & 0x0F));
+    } else if (op >= 0xB0 && op <= 0xB7) {
+        oled.page = op & 0x07;
+    } else {
+        switch (op) {
+        case 0x20: oled.mode = (oled_addr_mode_t)(cmd[1] & 0x03); break;
+        case 0x21: oled.col_start = oled.col = cmd[1] & 0x7F; oled.col_end = cmd[2] & 0x7F; break;
+        case 0x22: oled.page_start = oled.page = cmd[1] & 0x07; oled.page_end = cmd[2] & 0x07; break;
+        case 0xA0: case 0xA1: oled.seg_remap = (op & 0x01) != 0; break;
+        case 0xC0: case 0xC8: oled.com_reverse = (op & 0x08) != 0; break;
+        case 0xAE: case 0xAF: oled.display_on = (op & 0x01) != 0; break;
+        default: break;                 // Độ tương phản, clock, charge pump...: không ảnh hưởng hình
+        }
+    }
+    oled.stats.commands++;
+}
+
+static void command_byte(uint8_t byte)
+{
+    if (oled.cmd_len == 0) {
+        oled.cmd_need = command_args(byte);
+    }
+    oled.cmd[oled.cmd_len++] = byte;
+    if (oled.cmd_len > oled.cmd_need) {
+        execute_command(oled.cmd);
+        oled.cmd_len = 0;
+    }
+}
+
+static void data_byte(uint8_t byte)
+{
+    oled.gddram[oled.page][oled.col] = byte;
+    oled.stats.data_bytes++;
+    if (oled.mode == OLED_ADDR_PAGE) {
+        oled.col = (oled.col + 1) % OLED_WIDTH;
+    } else if (oled.mode == OLED_ADDR_HORIZONTAL) {
+        if (oled.col++ >= oled.col_end) {
+            oled.col = oled.col_start;
+            oled.page = (oled.page >= oled.page_end) ? oled.page_start : oled.page + 1;
+        }
+    } else {
+        if (oled.page++ >= oled.page_end) {
+            oled.page = oled.page_start;
+            oled.col = (oled.col >= oled.col_end) ? oled.col_start : oled.col + 1;
+        }
+    }
+}
+
+// Byte điều khiển: Co = 0 -> phần còn lại cùng một loại; Co = 1 -> một byte rồi tới byte điều khiển mới
+static void oled_i2c_write(void *ctx, const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        uint8_t control = data[i++];
+        bool is_data = (control & OLED_CONTROL_DC) != 0;
+        size_t end = (control & OLED_CONTROL_CO) ? ((i < len) ? i + 1 : len) : len;
+        for (; i < end; i++) {
+            if (is_data) {
+                data_byte(data[i]);
+            } else {
+                command_byte(data[i]);
+            }
+        }
+    }
+}
+
+static void oled_i2c_read(void *ctx, uint8_t *data, size_t len)
+{
+    memset(data, oled.display_on ? 0x00 : 0x40, len);      // Byte trạng thái: bit 6 = màn hình tắt
+}
+
+void sim_ssd1306_attach(void)
+{
+    memset(&oled, 0, sizeof(oled));
+    oled.mode = OLED_ADDR_PAGE;
+    oled.col_end = OLED_WIDTH - 1;
+    oled.page_end = OLED_PAGES - 1;
+    sim_i2c_device_t device = { .ctx = NULL, .write = oled_i2c_write, .read = oled_i2c_read };
+    sim_i2c_attach(OLED_I2C_ADDRESS, &device);
+}
+
+void sim_ssd1306_get_stats(sim_ssd1306_stats_t *stats)
+{
+    sim_clock_lock();
+    *stats = oled.stats;
+    stats->display_on = oled.display_on;
+    sim_clock_unlock();
+}
+
+
+// =========================================================
+// HIỂN THỊ TRÊN TERMINAL
+// =========================================================
+
+// Điểm ảnh theo vị trí nhìn thấy: module thường lắp sao cho A1 + C8 cho hình đúng chiều
+static bool pixel_at(int x, int y)
+{
+    int col = oled.seg_remap ? x : OLED_WIDTH - 1 - x;
+    int row = oled.com_reverse ? y : OLED_PAGES * 8 - 1 - y;
+    return (oled.gddram[row / 8][col] >> (row % 8)) & 0x01;
+}
+
+void sim_ssd1306_render(FILE *out)
+{
+    static const char *const blocks[4] = { " ", "▀", "▄", "█" };
+
+    sim_clock_lock();
+    fprintf(out, "+");
+    for (int x = 0; x < OLED_WIDTH; x++) {
+        fputc('-', out);
+    }
+    fprintf(out, "+\n");
+    for (int y = 0; y < OLED_PAGES * 8; y += 2) {
+        fputc('|', out);
+        for (int x = 0; x < OLED_WIDTH; x++) {
+            int cell = oled.display_on ? (pixel_at(x, y) | (pixel_at(x, y + 1) << 1)) : 0;
+            fputs(blocks[cell], out);
+        }
+        fprintf(out, "|\n");
+    }
+    fprintf(out, "+");
+    for (int x = 0; x < OLED_WIDTH; x++) {
+        fputc('-', out);
+    }
+    fprintf(out, "+\n");
+    sim_clock_unlock();
+}
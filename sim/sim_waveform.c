@@ -0,0 +1,238 @@
+#include "sim_waveform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "algorithm.h"          // SPO2_A/B/C: tỉ số Z đúng với hiệu chuẩn của firmware
+#include "config_store.h"       // LED_PA_DEFAULT
+#include "max30102_api.h"       // MAX30102_ADC_FULL_SCALE
+
+#define WAVE_IR_DC 250.0                // nA/mA: ngón tay trên cảm biến
+#define WAVE_RED_DC 180.0
+#define WAVE_AMBIENT 1.5                // nA/mA: không có ngón tay (chỉ phản xạ nền)
+#define WAVE_RESP_HZ 0.25
+#define WAVE_RESP_DEPTH 0.003           // Dao động nền hô hấp (tỉ lệ DC)
+#define WAVE_RSA_DEPTH 0.04             // Biến thiên HR theo hô hấp
+#define WAVE_LF_HZ 0.1
+#define WAVE_LF_DEPTH 0.03
+#define WAVE_MOTION_HZ 1.8              // Vung tay / đi bộ
+#define WAVE_MOTION_COUPLING 0.02       // Biến thiên DC quang trên mỗi g
+#define WAVE_ACCEL_NOISE_G 0.004
+
+// Phát lại: số đếm ADC ghi ở cấu hình mặc định (LED_PA_DEFAULT, ADC_RGE 01 = 4096 nA)
+#define REPLAY_PPG_NA_PER_COUNT (4096.0 / MAX30102_ADC_FULL_SCALE)
+#define REPLAY_LED_MA (LED_PA_DEFAULT * 0.2)
+#define REPLAY_ACCEL_LSB_PER_G 16384.0
+
+typedef struct {
+    double *t_s;
+    double *values;             // channels giá trị mỗi dòng
+    int channels;
+    size_t count;
+    double period_s;            // Độ dài một vòng lặp
+} replay_t;
+
+static sim_scenario_t scenario;
+static double red_ratio;        // PI đỏ / PI IR = Z
+static replay_t replay_ppg;
+static replay_t replay_accel;
+
+
+// =========================================================
+// PHÁT LẠI CSV
+// =========================================================
+
+/**
+ * @brief Đọc file "t_ms,flags,c1,c2[,c3]" (dòng đầu là tiêu đề). Mốc thời gian đưa về 0,
+ * chu kỳ lặp = độ dài bản ghi + một bước mẫu.
+ */
+static bool replay_load(replay_t *replay, const char *path, int channels)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "sim: cannot open %s\n", path);
+        return false;
+    }
+    size_t capacity = 0;
+    char line[256];
+    replay->channels = channels;
+    replay->count = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        double t_ms, v[3];
+        unsigned flags;
+        int n = sscanf(line, "%lf,%u,%lf,%lf,%lf", &t_ms, &flags, &v[0], &v[1], &v[2]);
+        if (n < 2 + channels) {
+            continue;                   // Tiêu đề hoặc dòng hỏng
+        }
+        if (replay->count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            replay->t_s = realloc(replay->t_s, capacity * sizeof(double));
+            replay->values = realloc(replay->values, capacity * channels * sizeof(double));
+            if (replay->t_s == NULL || replay->values == NULL) {
+                fclose(f);
+                return false;
+            }
+        }
+        replay->t_s[replay->count] = t_ms / 1000.0;
+        memcpy(&replay->values[replay->count * channels], v, channels * sizeof(double));
+        replay->count++;
+    }
+    fclose(f);
+    if (replay->count < 2) {
+        fprintf(stderr, "sim: %s has no samples\n", path);
+        return false;
+    }
+    double t0 = replay->t_s[0];
+    for (size_t i = 0; i < replay->count; i++) {
+        replay->t_s[i] -= t0;
+    }
+    double step = replay->t_s[replay->count - 1] / (double)(replay->count - 1);
+    replay->period_s = replay->t_s[replay->count - 1] + step;
+    return true;
+}
+
+// Nội suy tuyến tính tại t (lặp vòng); giữa mẫu cuối và mẫu đầu vòng sau cũng nội suy
+static void replay_sample(const replay_t *replay, double t_s, double *out)
+{
+    double t = fmod(t_s, replay->period_s);
+    size_t lo = 0, hi = replay->count;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (replay->t_s[mid] <= t) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t next = (lo + 1 < replay->count) ? lo + 1 : 0;
+    double t_next = (next > lo) ? replay->t_s[next] : replay->period_s;
+    double frac = (t_next > replay->t_s[lo]) ? (t - replay->t_s[lo]) / (t_next - replay->t_s[lo]) : 0.0;
+    for (int c = 0; c < replay->channels; c++) {
+        double a = replay->values[lo * replay->channels + c];
+        double b = replay->values[next * replay->channels + c];
+        out[c] = a + (b - a) * frac;
+    }
+}
+
+
+// =========================================================
+// TỔNG HỢP
+// =========================================================
+
+// Nhiễu Gauss tất định theo thời điểm (hai kênh gọi ở các thời điểm khác nhau vẫn lặp lại được)
+static double gauss_at(double t_s, uint32_t stream)
+{
+    uint64_t x = (uint64_t)llround(t_s * 1e6) * 0x9E3779B97F4A7C15ULL ^ ((uint64_t)scenario.seed << 32) ^ stream;
+    double u[2];
+    for (int i = 0; i < 2; i++) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        u[i] = ((double)(x >> 11) + 0.5) / 9007199254740992.0;
+    }
+    return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+// Pha nhịp tim = tích phân HR(t)/60, HR biến thiên hình sin theo hô hấp (RSA) và dải LF
+static double beat_phase(double t_s)
+{
+    double f0 = scenario.hr_bpm / 60.0;
+    double w_hf = 2.0 * M_PI * WAVE_RESP_HZ;
+    double w_lf = 2.0 * M_PI * WAVE_LF_HZ;
+    return f0 * (t_s + WAVE_RSA_DEPTH * (1.0 - cos(w_hf * t_s)) / w_hf
+                     + WAVE_LF_DEPTH * (1.0 - cos(w_lf * t_s)) / w_lf);
+}
+
+// Thể tích máu trong một nhịp (0..~1): đỉnh tâm thu và sóng dội
+static double pulse_shape(double phase)
+{
+    double p = phase - floor(phase);
+    double systolic = (p - 0.18) / 0.07;
+    double dicrotic = (p - 0.45) / 0.09;
+    return exp(-0.5 * systolic * systolic) + 0.35 * exp(-0.5 * dicrotic * dicrotic);
+}
+
+static double motion_g(double t_s, int axis)
+{
+    if (scenario.motion_g <= 0.0 || t_s < scenario.motion_start_s || t_s >= scenario.motion_end_s) {
+        return 0.0;
+    }
+    static const double axis_gain[3] = { 1.0, 0.5, 0.3 };
+    return scenario.motion_g * axis_gain[axis] * sin(2.0 * M_PI * WAVE_MOTION_HZ * t_s + axis);
+}
+
+bool sim_waveform_finger_present(double t_s)
+{
+    return !(t_s >= scenario.finger_off_start_s && t_s < scenario.finger_off_end_s);
+}
+
+bool sim_waveform_init(const sim_scenario_t *config)
+{
+    scenario = *config;
+
+    // Z từ SpO2 = A*Z^2 + B*Z + C (nghiệm nhỏ, nằm trong dải hiệu chuẩn)
+    double disc = SPO2_B * SPO2_B - 4.0 * SPO2_A * (SPO2_C - scenario.spo2);
+    red_ratio = (disc > 0.0) ? (-SPO2_B - sqrt(disc)) / (2.0 * SPO2_A) : 0.0;
+
+    if (scenario.ppg_csv != NULL && !replay_load(&replay_ppg, scenario.ppg_csv, 2)) {
+        return false;
+    }
+    if (scenario.accel_csv != NULL && !replay_load(&replay_accel, scenario.accel_csv, 3)) {
+        return false;
+    }
+    return true;
+}
+
+const sim_scenario_t *sim_waveform_scenario(void)
+{
+    return &scenario;
+}
+
+/**
+ * @brief Dòng quang trên mỗi mA dòng LED: ánh sáng truyền qua giảm khi thể tích máu tăng,
+ * AC đỏ = Z * AC IR (cùng DC tương đối) để firmware tính lại đúng SpO2 của scenario.
+ */
+void sim_waveform_ppg(double t_s, double *red_na_per_ma, double *ir_na_per_ma)
+{
+    if (!sim_waveform_finger_present(t_s)) {
+        *red_na_per_ma = WAVE_AMBIENT * (1.0 + 0.01 * gauss_at(t_s, 1));
+        *ir_na_per_ma = WAVE_AMBIENT * (1.0 + 0.01 * gauss_at(t_s, 2));
+        return;
+    }
+    if (replay_ppg.count > 0) {
+        double counts[2];
+        replay_sample(&replay_ppg, t_s, counts);
+        *red_na_per_ma = counts[0] * REPLAY_PPG_NA_PER_COUNT / REPLAY_LED_MA;
+        *ir_na_per_ma = counts[1] * REPLAY_PPG_NA_PER_COUNT / REPLAY_LED_MA;
+        return;
+    }
+
+    double pi_ir = scenario.perfusion / 100.0;
+    double pulse = pulse_shape(beat_phase(t_s));
+    double baseline = 1.0 + WAVE_RESP_DEPTH * sin(2.0 * M_PI * WAVE_RESP_HZ * t_s)
+                    + WAVE_MOTION_COUPLING * motion_g(t_s, 0);
+
+    double ir_ac = pi_ir * (pulse + scenario.noise * gauss_at(t_s, 2));
+    double red_ac = pi_ir * red_ratio * (pulse + scenario.noise * gauss_at(t_s, 1));
+    *ir_na_per_ma = WAVE_IR_DC * baseline * (1.0 - ir_ac);
+    *red_na_per_ma = WAVE_RED_DC * baseline * (1.0 - red_ac);
+}
+
+// Cảm biến nằm ngang: trọng lực trên trục Z
+void sim_waveform_accel(double t_s, double accel_g[3])
+{
+    if (replay_accel.count > 0) {
+        double lsb[3];
+        replay_sample(&replay_accel, t_s, lsb);
+        for (int i = 0; i < 3; i++) {
+            accel_g[i] = lsb[i] / REPLAY_ACCEL_LSB_PER_G;
+        }
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        accel_g[i] = motion_g(t_s, i) + WAVE_ACCEL_NOISE_G * gauss_at(t_s, 3 + i);
+    }
+    accel_g[2] += 1.0;
+}
@@ -0,0 +1,40 @@
+#ifndef SIM_WAVEFORM_H
+#define SIM_WAVEFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// =========================================================
+// TÍN HIỆU ĐẦU VÀO CHO CẢM BIẾN MÔ PHỎNG
+// =========================================================
+// - Tổng hợp: PPG hai đỉnh (tâm thu + sóng dội) theo HR có biến thiên RSA/LF, nền hô hấp,
+//   tỉ số AC/DC của LED đỏ suy ra từ SpO2 bằng chính hệ số hiệu chuẩn của firmware
+// - Chuyển động: dao động tay trên gia tốc, ghép vào PPG dưới dạng nhiễu nhân trên DC
+// - Phát lại: file Raw_ppg_*.csv / Raw_accel_*.csv của dashboard (nội suy tuyến tính, lặp vòng)
+// - PPG trả về dòng quang (nA) trên mỗi mA dòng LED: cảm biến tự nhân với dòng LED đang cấu hình
+
+typedef struct {
+    double hr_bpm;
+    double spo2;                    // %
+    double perfusion;               // Chỉ số tưới máu IR (AC/DC, %)
+    double noise;                   // Độ lệch chuẩn nhiễu / biên độ AC
+    double motion_g;                // Biên độ dao động tay (g), 0 = không
+    double motion_start_s;
+    double motion_end_s;
+    double finger_off_start_s;      // Khoảng không đặt ngón tay (start >= end: luôn có ngón)
+    double finger_off_end_s;
+    double temp_c;                  // Nhiệt độ die MAX30102
+    uint32_t seed;
+    const char *ppg_csv;            // NULL: tổng hợp
+    const char *accel_csv;
+} sim_scenario_t;
+
+// Nạp scenario (và file phát lại nếu có). @return false nếu không đọc được file
+bool sim_waveform_init(const sim_scenario_t *scenario);
+const sim_scenario_t *sim_waveform_scenario(void);
+
+void sim_waveform_ppg(double t_s, double *red_na_per_ma, double *ir_na_per_ma);
+void sim_waveform_accel(double t_s, double accel_g[3]);
+bool sim_waveform_finger_present(double t_s);
+
+#endif
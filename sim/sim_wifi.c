@@ -0,0 +1,18 @@
+#include "wifi_init.h"
+
+// Wi-Fi không được mô phỏng: telemetry_udp thấy "chưa kết nối" và bỏ qua các khung UDP
+
+esp_err_t wifi_init_sta(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool wifi_is_connected(void)
+{
+    return false;
+}
+
+uint32_t wifi_connect_count(void)
+{
+    return 0;
+}
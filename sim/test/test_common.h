@@ -0,0 +1,31 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+
+// =========================================================
+// KIỂM THỬ TRÊN HOST (ctest)
+// =========================================================
+// Mỗi bài là một chương trình riêng: CHECK ghi lỗi và chạy tiếp, TEST_DONE trả mã thoát
+// (0 = đạt). Không dùng assert(): bản RelWithDebInfo định nghĩa NDEBUG.
+
+static int test_failures = 0;
+
+#define CHECK(cond, ...)                                                    \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            test_failures++;                                                \
+            printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond);          \
+            printf(__VA_ARGS__);                                            \
+            printf("\n");                                                   \
+        }                                                                   \
+    } while (0)
+
+#define TEST_DONE()                                                         \
+    do {                                                                    \
+        printf("%s (%d failure%s)\n", test_failures ? "FAILED" : "PASSED",  \
+               test_failures, test_failures == 1 ? "" : "s");               \
+        return test_failures ? 1 : 0;                                       \
+    } while (0)
+
+#endif
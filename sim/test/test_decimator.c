@@ -0,0 +1,96 @@
+#include <math.h>
+#include "test_common.h"
+#include "algorithm.h"
+
+// =========================================================
+// BỘ HẠ TỐC FIR POLYPHASE: GỢN DẢI THÔNG, SUY HAO CHỐNG CHỒNG PHỔ
+// =========================================================
+// Đưa sóng sin vào ở tốc độ FIFO và đo biên độ ra (RMS sau khi bộ lọc ổn định) so với biên độ vào.
+// Tần số tính theo tốc độ ra fs_out: dải thông là dải PPG cần giữ (tới 0.2 fs_out = 10 Hz ở
+// 50 Hz), dải chặn là mọi tần số vào từ 0.8 fs_out tới Nyquist đầu vào — chúng chồng phổ
+// về lại đúng dải thông sau khi hạ tốc.
+
+#define AMPLITUDE 1000000.0         // Số đếm, cỡ DC của PPG nhưng không bão hòa Q15
+#define OUTPUT_SAMPLES 2048
+#define SETTLE_OUTPUTS 16           // > số tap mỗi nhánh
+#define PASSBAND_EDGE 0.2           // fs_out
+#define STOPBAND_EDGE 0.8           // fs_out
+#define FREQ_STEPS 40
+#define MAX_RIPPLE_DB 0.3
+#define MIN_STOPBAND_DB 50.0
+
+// Độ lợi biên độ tại tần số vào f (đơn vị fs_out)
+static double gain_at(int factor, double f)
+{
+    decimator_t decim;
+    decimator_init(&decim, factor);
+    decimator_reset(&decim, 0);
+
+    double sum_sq = 0.0;
+    int outputs = 0;
+    for (long n = 0; outputs < SETTLE_OUTPUTS + OUTPUT_SAMPLES; n++) {
+        double x = AMPLITUDE * sin(2.0 * M_PI * f / factor * n + 0.3);
+        int32_t y;
+        if (!decimator_process(&decim, (int32_t)lrint(x), &y)) {
+            continue;
+        }
+        if (outputs++ >= SETTLE_OUTPUTS) {
+            sum_sq += (double)y * y;
+        }
+    }
+    return sqrt(2.0 * sum_sq / OUTPUT_SAMPLES) / AMPLITUDE;
+}
+
+static double to_db(double gain)
+{
+    return 20.0 * log10(gain > 1e-12 ? gain : 1e-12);
+}
+
+static void check_factor(int factor)
+{
+    double pass_min = INFINITY, pass_max = -INFINITY;
+    for (int s = 0; s <= FREQ_STEPS; s++) {
+        // Bỏ DC tuyệt đối: RMS trên 2048 mẫu của sin rất chậm không đo được biên độ
+        double f = 0.01 + (PASSBAND_EDGE - 0.01) * s / FREQ_STEPS;
+        double db = to_db(gain_at(factor, f));
+        if (db < pass_min) pass_min = db;
+        if (db > pass_max) pass_max = db;
+    }
+
+    const double nyquist_in = factor / 2.0;
+    double stop_max = -INFINITY, stop_worst_f = 0.0;
+    for (int s = 0; s <= FREQ_STEPS * factor; s++) {
+        double f = STOPBAND_EDGE + (nyquist_in - STOPBAND_EDGE) * s / (FREQ_STEPS * factor);
+        double db = to_db(gain_at(factor, f));
+        if (db > stop_max) {
+            stop_max = db;
+            stop_worst_f = f;
+        }
+    }
+
+    printf("factor %d: passband 0..%.1f fs_out %+.3f..%+.3f dB (ripple %.3f dB), "
+           "alias band %.1f..%.1f fs_out max %.1f dB at %.2f fs_out\n",
+           factor, PASSBAND_EDGE, pass_min, pass_max, pass_max - pass_min,
+           STOPBAND_EDGE, nyquist_in, stop_max, stop_worst_f);
+    CHECK(pass_max - pass_min < MAX_RIPPLE_DB, "factor %d ripple %.3f dB", factor, pass_max - pass_min);
+    CHECK(fabs(pass_max) < MAX_RIPPLE_DB, "factor %d passband gain %+.3f dB", factor, pass_max);
+    CHECK(stop_max < -MIN_STOPBAND_DB, "factor %d alias attenuation %.1f dB", factor, -stop_max);
+}
+
+int main(void)
+{
+    // Độ lợi DC đúng bằng 1: kênh thô giữ nguyên mức DC cho SpO2/SQI
+    for (int factor = 2; factor <= 4; factor += 2) {
+        decimator_t decim;
+        decimator_init(&decim, factor);
+        decimator_reset(&decim, 200000);
+        int32_t y = 0;
+        for (int n = 0; n < factor * 4; n++) {
+            decimator_process(&decim, 200000, &y);
+        }
+        CHECK(y == 200000, "factor %d DC %ld", factor, (long)y);
+
+        check_factor(factor);
+    }
+    TEST_DONE();
+}
@@ -0,0 +1,158 @@
+#include <math.h>
+#include <string.h>
+#include "test_common.h"
+#include "algorithm.h"
+#include "config_store.h"       // LED_PA_DEFAULT
+#include "max30102_api.h"       // MAX30102_ADC_FULL_SCALE
+#include "sim_waveform.h"
+
+// =========================================================
+// KHỬ NHIỄU CHUYỂN ĐỘNG: SAI SỐ HR CÓ / KHÔNG CÓ NLMS
+// =========================================================
+// Cùng chuỗi xử lý với sensor_data_reader ở profile chuẩn (FIFO 100 sps, hạ tốc còn 50 Hz,
+// cửa sổ 5.12 s): PPG và gia tốc lấy từ sim_waveform (dao động tay 1.8 Hz ghép vào DC quang),
+// HR từ tự tương quan được so với HR của scenario.
+
+#define FIFO_RATE_HZ 100
+#define FIFO_DECIMATION 2
+#define RATE_HZ (FIFO_RATE_HZ / FIFO_DECIMATION)
+#define WINDOW_LEN 256
+#define HR_DECIMATION 2
+#define WINDOWS 60
+#define SETTLE_WINDOWS 3            // Bỏ qua khi NLMS và bộ lọc còn hội tụ
+#define SCENARIO_HR 72.0
+#define FULL_SCALE_NA 4096.0        // ADC_RGE 01
+
+typedef struct {
+    double mean_abs_error;
+    int valid_windows;              // HR trong dải tìm kiếm
+} run_result_t;
+
+static ppg_context_t ppg;
+static bandpass_f32_t bandpass_accel[NLMS_AXES];
+static float accel[NLMS_AXES][BUFFER_SIZE];
+
+static int32_t to_counts(double na_per_ma)
+{
+    return (int32_t)(na_per_ma * LED_PA_DEFAULT * 0.2 / FULL_SCALE_NA * MAX30102_ADC_FULL_SCALE);
+}
+
+static run_result_t run(double motion_g, bool use_nlms)
+{
+    sim_scenario_t scenario = {
+        .hr_bpm = SCENARIO_HR, .spo2 = 97.0, .perfusion = 2.0, .noise = 0.02,
+        .motion_g = motion_g, .motion_start_s = 0.0, .motion_end_s = 1e9,
+        .temp_c = 33.5, .seed = 1,
+    };
+    sim_waveform_init(&scenario);
+    ppg_context_init(&ppg, RATE_HZ, WINDOW_LEN, FIFO_DECIMATION, HR_DECIMATION);
+    for (int a = 0; a < NLMS_AXES; a++) {
+        bandpass_init_f32(&bandpass_accel[a], RATE_HZ, BANDPASS_LOW_HZ, BANDPASS_HIGH_HZ);
+    }
+
+    run_result_t result = {0};
+    double error_sum = 0.0;
+    uint64_t fifo_index = 0;
+
+    for (int w = 0; w < WINDOWS; w++) {
+        int i = 0;
+        sqi_reset(&ppg.sqi);
+        while (i < WINDOW_LEN) {
+            double t_s = (double)fifo_index++ / FIFO_RATE_HZ;
+            double red_na, ir_na;
+            sim_waveform_ppg(t_s, &red_na, &ir_na);
+            int32_t red_fifo = to_counts(red_na), ir_fifo = to_counts(ir_na);
+            if (!ppg.bandpass_primed) {
+                decimator_reset(&ppg.decim_fifo_red, red_fifo);
+                decimator_reset(&ppg.decim_fifo_ir, ir_fifo);
+            }
+            int32_t red, ir;
+            decimator_process(&ppg.decim_fifo_red, red_fifo, &red);
+            if (!decimator_process(&ppg.decim_fifo_ir, ir_fifo, &ir)) {
+                continue;
+            }
+            double g[NLMS_AXES];
+            sim_waveform_accel(t_s, g);
+            for (int a = 0; a < NLMS_AXES; a++) {
+                accel[a][i] = (float)g[a];
+            }
+            ppg_store_sample(&ppg, i, red, ir, (uint32_t)lrint(t_s * 1000.0));
+            i++;
+        }
+
+        uint64_t ir_mean, red_mean;
+        remove_dc_part(&ppg, ppg.ir_raw, ppg.red_raw, &ir_mean, &red_mean);
+        if (use_nlms) {
+            for (int a = 0; a < NLMS_AXES; a++) {
+                if (w == 0) {
+                    bandpass_reset_f32(&bandpass_accel[a], accel[a][0]);
+                }
+                for (int k = 0; k < WINDOW_LEN; k++) {
+                    accel[a][k] = bandpass_process_f32(&bandpass_accel[a], accel[a][k]);
+                }
+            }
+            cancel_motion_artifacts(&ppg.nlms_ir, ppg.ir_data, accel[0], accel[1], accel[2], WINDOW_LEN);
+        }
+        int hr_len = ppg_decimate_hr_window(&ppg);
+        double r0;
+        double hr = calculate_heart_rate(&ppg, ppg.hr_data, hr_len, &r0);
+
+        if (w < SETTLE_WINDOWS) {
+            continue;
+        }
+        if (hr >= HR_SEARCH_MIN_BPM && hr <= HR_SEARCH_MAX_BPM) {
+            result.valid_windows++;
+            error_sum += fabs(hr - SCENARIO_HR);
+        } else {
+            error_sum += SCENARIO_HR;       // Không ra HR: tính như sai hoàn toàn
+        }
+    }
+    result.mean_abs_error = error_sum / (WINDOWS - SETTLE_WINDOWS);
+    return result;
+}
+
+/**
+ * @brief Cửa sổ ngắn: chỉ len mẫu đầu là của cửa sổ này, phần còn lại của bộ đệm là dữ liệu cũ
+ * (nhịp khác, biên độ lớn hơn nhiều). HR chỉ được tính từ len mẫu hợp lệ.
+ */
+static void check_short_window(int len)
+{
+    const double hr_rate_hz = (double)RATE_HZ / HR_DECIMATION;
+    ppg_context_init(&ppg, RATE_HZ, WINDOW_LEN, FIFO_DECIMATION, HR_DECIMATION);
+    for (int i = 0; i < ppg.hr_window_len; i++) {
+        double t_s = i / hr_rate_hz;
+        ppg.hr_data[i] = (i < len) ? (int32_t)lrint(1000.0 * sin(2.0 * M_PI * SCENARIO_HR / 60.0 * t_s))
+                                   : (int32_t)lrint(100000.0 * sin(2.0 * M_PI * 150.0 / 60.0 * t_s));
+    }
+    double r0;
+    double hr = calculate_heart_rate(&ppg, ppg.hr_data, len, &r0);
+    printf("short window %3d/%d : HR %.1f bpm\n", len, ppg.hr_window_len, hr);
+    CHECK(fabs(hr - SCENARIO_HR) < 3.0, "%d-sample window: HR %.1f bpm", len, hr);
+}
+
+int main(void)
+{
+    check_short_window(WINDOW_LEN / HR_DECIMATION);
+    check_short_window(48);
+    check_short_window(30);
+
+    static const double motion_levels[] = { 0.5, 1.0 };
+
+    run_result_t clean = run(0.0, true);
+    printf("no motion           : |HR error| %.2f bpm, %d/%d windows\n",
+           clean.mean_abs_error, clean.valid_windows, WINDOWS - SETTLE_WINDOWS);
+    CHECK(clean.mean_abs_error < 2.0, "clean HR error %.2f bpm", clean.mean_abs_error);
+
+    for (size_t m = 0; m < sizeof(motion_levels) / sizeof(motion_levels[0]); m++) {
+        run_result_t off = run(motion_levels[m], false);
+        run_result_t on = run(motion_levels[m], true);
+        printf("motion %.1f g, no NLMS: |HR error| %.2f bpm, %d/%d windows\n",
+               motion_levels[m], off.mean_abs_error, off.valid_windows, WINDOWS - SETTLE_WINDOWS);
+        printf("motion %.1f g, NLMS   : |HR error| %.2f bpm, %d/%d windows\n",
+               motion_levels[m], on.mean_abs_error, on.valid_windows, WINDOWS - SETTLE_WINDOWS);
+        CHECK(on.mean_abs_error < 3.0, "NLMS HR error %.2f bpm at %.1f g", on.mean_abs_error, motion_levels[m]);
+        CHECK(on.mean_abs_error < 0.5 * off.mean_abs_error, "NLMS %.2f vs %.2f bpm at %.1f g",
+              on.mean_abs_error, off.mean_abs_error, motion_levels[m]);
+    }
+    TEST_DONE();
+}
@@ -0,0 +1,175 @@
+#include <stdint.h>
+#include <string.h>
+#include "test_common.h"
+#include "telemetry.h"
+
+// =========================================================
+// GIAO THỨC TELEMETRY: COBS, CRC16, ĐÓNG GÓI KHỐI THÔ
+// =========================================================
+// Giải nén khối thô viết lại ở đây theo decode_raw() trong telemetry_protocol.py,
+// để kiểm tra firmware và host hiểu định dạng như nhau.
+
+static uint32_t rng_state = 12345;
+
+static uint32_t next_random(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static void check_cobs(size_t len, bool with_zeros)
+{
+    uint8_t in[512], encoded[600], decoded[600];
+    for (size_t i = 0; i < len; i++) {
+        in[i] = with_zeros ? (uint8_t)next_random() : (uint8_t)(1 + next_random() % 255);
+    }
+
+    size_t n = tlm_cobs_encode(in, len, encoded);
+    CHECK(n <= len + len / 254 + 1, "len %zu: %zu encoded bytes", len, n);
+    CHECK(memchr(encoded, 0, n) == NULL, "len %zu: encoded frame contains 0x00", len);
+
+    size_t m = tlm_cobs_decode(encoded, n, decoded);
+    CHECK(m == len, "len %zu: decoded %zu bytes", len, m);
+    CHECK(m != len || memcmp(in, decoded, len) == 0, "len %zu: round trip mismatch", len);
+}
+
+static void test_cobs(void)
+{
+    static const size_t lengths[] = { 0, 1, 253, 254, 255, 300 };
+    uint8_t out[8];
+
+    // Khung rỗng chỉ còn byte mã 0x01
+    CHECK(tlm_cobs_encode(NULL, 0, out) == 1 && out[0] == 0x01, "empty frame encoding");
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        check_cobs(lengths[i], false);      // Khối 254 byte khác 0 dùng mã 0xFF không kèm số 0
+        check_cobs(lengths[i], true);
+    }
+
+    // 254 byte khác 0 -> 0xFF + 254 byte + 0x01
+    uint8_t in[254], encoded[260];
+    memset(in, 0xAA, sizeof(in));
+    size_t n = tlm_cobs_encode(in, sizeof(in), encoded);
+    CHECK(n == 256 && encoded[0] == 0xFF && encoded[255] == 0x01, "254-byte block: %zu bytes", n);
+
+    // Khung hỏng: mã trỏ quá cuối, hoặc chứa 0x00
+    static const uint8_t truncated[] = { 0x05, 0x11, 0x22 };
+    static const uint8_t zero_code[] = { 0x02, 0x11, 0x00, 0x22 };
+    uint8_t decoded[8];
+    CHECK(tlm_cobs_decode(truncated, sizeof(truncated), decoded) == 0, "truncated frame accepted");
+    CHECK(tlm_cobs_decode(zero_code, sizeof(zero_code), decoded) == 0, "frame with 0x00 accepted");
+}
+
+static void test_crc16(void)
+{
+    // CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), cùng giá trị với tlm_crc16() phía Python
+    static const uint8_t check[] = "123456789";
+    static const uint8_t single_a[] = "A";
+    static const uint8_t zeros[4] = { 0 };
+    CHECK(tlm_crc16(check, 9) == 0x29B1, "\"123456789\" -> 0x%04X", tlm_crc16(check, 9));
+    CHECK(tlm_crc16(single_a, 1) == 0xB915, "\"A\" -> 0x%04X", tlm_crc16(single_a, 1));
+    CHECK(tlm_crc16(zeros, 4) == 0x84C0, "4 x 0x00 -> 0x%04X", tlm_crc16(zeros, 4));
+    CHECK(tlm_crc16(NULL, 0) == 0xFFFF, "empty -> 0x%04X", tlm_crc16(NULL, 0));
+}
+
+static size_t raw_unpack(const uint8_t *payload, tlm_raw_header_t *header, uint8_t *widths,
+                         int32_t out[][TLM_RAW_MAX_SAMPLES])
+{
+    memcpy(header, payload, sizeof(*header));
+    size_t pos = sizeof(*header);
+    for (int c = 0; c < header->channels; c++) {
+        uint32_t first = payload[pos] | (payload[pos + 1] << 8) | (payload[pos + 2] << 16)
+                       | ((uint32_t)payload[pos + 3] << 24);
+        out[c][0] = (int32_t)first;
+        widths[c] = payload[pos + 4];
+        pos += 5;
+    }
+
+    uint64_t acc = 0;
+    int acc_bits = 0;
+    for (int c = 0; c < header->channels; c++) {
+        for (int k = 1; k < header->count; k++) {
+            while (acc_bits < widths[c]) {
+                acc |= (uint64_t)payload[pos++] << acc_bits;
+                acc_bits += 8;
+            }
+            uint32_t zz = (widths[c] == 32) ? (uint32_t)acc : (uint32_t)(acc & ((1u << widths[c]) - 1));
+            acc >>= widths[c];
+            acc_bits -= widths[c];
+            out[c][k] = (int32_t)((uint32_t)out[c][k - 1] + ((zz >> 1) ^ (0u - (zz & 1))));
+        }
+    }
+    return pos;
+}
+
+// Một khối với delta lớn nhất cho trước: kiểm tra độ rộng bit chọn ra và giải nén đúng
+static void check_raw(int channels, int count, const int32_t max_delta[], const uint8_t expect_width[])
+{
+    static int32_t data[TLM_RAW_MAX_CHANNELS][TLM_RAW_MAX_SAMPLES];
+    const int32_t *ptrs[TLM_RAW_MAX_CHANNELS];
+    for (int c = 0; c < channels; c++) {
+        data[c][0] = (int32_t)(next_random() & 0x3FFFF);
+        for (int k = 1; k < count; k++) {
+            // Delta lớn nhất đặt ở mẫu cuối (âm) để độ rộng đúng bằng độ rộng của nó
+            int32_t delta = (k == count - 1) ? -max_delta[c]
+                          : (max_delta[c] ? (int32_t)(next_random() % (uint32_t)max_delta[c]) : 0);
+            data[c][k] = (int32_t)((uint32_t)data[c][k - 1] + (uint32_t)delta);
+        }
+        ptrs[c] = data[c];
+    }
+
+    tlm_raw_header_t header = {
+        .stream = TLM_RAW_PPG, .flags = TLM_RAW_FLAG_DISCONTINUITY, .count = (uint8_t)count,
+        .channels = (uint8_t)channels, .t0_ms = 123456, .period_us = 2500,
+    };
+    uint8_t payload[TLM_MAX_PAYLOAD];
+    size_t size = tlm_raw_pack(&header, ptrs, payload);
+    CHECK(size > 0, "%d ch x %d samples did not fit", channels, count);
+    if (size == 0) {
+        return;
+    }
+
+    tlm_raw_header_t got;
+    uint8_t widths[TLM_RAW_MAX_CHANNELS];
+    int32_t out[TLM_RAW_MAX_CHANNELS][TLM_RAW_MAX_SAMPLES];
+    size_t used = raw_unpack(payload, &got, widths, out);
+    CHECK(memcmp(&got, &header, sizeof(header)) == 0, "header mismatch");
+    CHECK(used == size, "unpacked %zu of %zu bytes", used, size);
+    for (int c = 0; c < channels; c++) {
+        CHECK(widths[c] == expect_width[c], "channel %d width %u, expected %u", c, widths[c], expect_width[c]);
+        CHECK(memcmp(out[c], data[c], count * sizeof(int32_t)) == 0, "channel %d samples mismatch", c);
+    }
+}
+
+static void test_raw_pack(void)
+{
+    // zigzag(-d) = 2d - 1: delta -1 -> 1 bit, -2^17 -> 18 bit, -2^18 (PPG 18 bit đảo chiều) -> 19 bit
+    check_raw(2, TLM_RAW_MAX_SAMPLES, (const int32_t[]){ 0, 1 }, (const uint8_t[]){ 0, 1 });
+    check_raw(2, TLM_RAW_MAX_SAMPLES, (const int32_t[]){ 1 << 17, 1 << 18 }, (const uint8_t[]){ 18, 19 });
+    check_raw(3, TLM_RAW_MAX_SAMPLES, (const int32_t[]){ 100, 3000, 1 << 15 }, (const uint8_t[]){ 8, 13, 16 });
+    check_raw(1, 2, (const int32_t[]){ INT32_MAX }, (const uint8_t[]){ 32 });
+    check_raw(2, 1, (const int32_t[]){ 0, 0 }, (const uint8_t[]){ 0, 0 });
+
+    // Khối không vừa TLM_MAX_PAYLOAD hoặc sai kích thước: trả về 0
+    static int32_t wide[TLM_RAW_MAX_CHANNELS][TLM_RAW_MAX_SAMPLES];
+    const int32_t *ptrs[TLM_RAW_MAX_CHANNELS] = { wide[0], wide[1], wide[2] };
+    for (int c = 0; c < TLM_RAW_MAX_CHANNELS; c++) {
+        for (int k = 0; k < TLM_RAW_MAX_SAMPLES; k++) {
+            wide[c][k] = (k & 1) ? 0x40000000 : 0;     // delta ±2^30 -> 32 bit
+        }
+    }
+    tlm_raw_header_t header = { .stream = TLM_RAW_ACCEL, .count = TLM_RAW_MAX_SAMPLES, .channels = 3 };
+    uint8_t payload[TLM_MAX_PAYLOAD];
+    CHECK(tlm_raw_pack(&header, ptrs, payload) == 0, "32-bit deltas x 3 channels should not fit");
+    header.count = TLM_RAW_MAX_SAMPLES + 1;
+    CHECK(tlm_raw_pack(&header, ptrs, payload) == 0, "count above TLM_RAW_MAX_SAMPLES accepted");
+    header.count = 0;
+    CHECK(tlm_raw_pack(&header, ptrs, payload) == 0, "empty block accepted");
+}
+
+int main(void)
+{
+    test_cobs();
+    test_crc16();
+    test_raw_pack();
+    TEST_DONE();
+}
@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "esp_log.h"
+#include "vitals_log.h"
+
+// =========================================================
+// NHẬT KÝ FLASH: MẤT ĐIỆN GIỮA CHỪNG VÀ GHI LỖI
+// =========================================================
+// Flash giả lập trên file tạm, hành xử như NOR: xóa đưa về 0xFF, ghi chỉ xóa bit (AND).
+// Mất điện được giả lập bằng cách cắt một lần ghi/xóa giữa chừng (chỉ một phần byte xuống
+// flash), bỏ trạng thái RAM rồi mount lại.
+
+#define FLASH_SECTORS 8
+#define FLASH_SIZE (FLASH_SECTORS * VLOG_SECTOR_SIZE)
+#define CYCLES 400
+#define MAX_RECORDS_PER_CYCLE 80
+
+typedef struct {
+    FILE *file;
+    long ops_until_cut;             // < 0: không cắt điện
+    bool powered;
+    bool fail_writes;
+    uint32_t erase_count[FLASH_SECTORS];
+} file_flash_t;
+
+static uint32_t rng_state = 2024;
+
+static uint32_t next_random(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// Thao tác kế tiếp có bị cắt điện không; sau khi cắt mọi thao tác đều lỗi cho tới lần mount sau
+static bool power_cut_now(file_flash_t *flash)
+{
+    if (flash->ops_until_cut < 0) {
+        return false;
+    }
+    if (flash->ops_until_cut-- == 0) {
+        flash->powered = false;
+        return true;
+    }
+    return false;
+}
+
+static esp_err_t file_read(void *ctx, uint32_t offset, void *dst, size_t len)
+{
+    file_flash_t *flash = ctx;
+    if (!flash->powered || offset + len > FLASH_SIZE) {
+        return ESP_FAIL;
+    }
+    fseek(flash->file, offset, SEEK_SET);
+    return fread(dst, 1, len, flash->file) == len ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t file_write(void *ctx, uint32_t offset, const void *src, size_t len)
+{
+    static uint8_t buf[VLOG_SECTOR_SIZE];
+    file_flash_t *flash = ctx;
+    if (!flash->powered || flash->fail_writes || offset + len > FLASH_SIZE || len > sizeof(buf)) {
+        return ESP_FAIL;
+    }
+    bool cut = power_cut_now(flash);
+    size_t n = cut ? next_random() % len : len;       // Ghi dở: chỉ phần đầu xuống flash
+
+    fseek(flash->file, offset, SEEK_SET);
+    if (fread(buf, 1, n, flash->file) != n) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        buf[i] &= ((const uint8_t *)src)[i];
+    }
+    fseek(flash->file, offset, SEEK_SET);
+    fwrite(buf, 1, n, flash->file);
+    return cut ? ESP_FAIL : ESP_OK;
+}
+
+static esp_err_t file_erase(void *ctx, uint32_t offset, size_t len)
+{
+    static uint8_t blank[VLOG_SECTOR_SIZE];
+    file_flash_t *flash = ctx;
+    if (!flash->powered || offset % VLOG_SECTOR_SIZE != 0 || len % VLOG_SECTOR_SIZE != 0 ||
+        offset + len > FLASH_SIZE) {
+        return ESP_FAIL;
+    }
+    memset(blank, 0xFF, sizeof(blank));
+    for (uint32_t pos = offset; pos < offset + len; pos += VLOG_SECTOR_SIZE) {
+        bool cut = power_cut_now(flash);
+        size_t n = cut ? next_random() % VLOG_SECTOR_SIZE : VLOG_SECTOR_SIZE;
+        fseek(flash->file, pos, SEEK_SET);
+        fwrite(blank, 1, n, flash->file);
+        flash->erase_count[pos / VLOG_SECTOR_SIZE]++;
+        if (cut) {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+static bool file_flash_open(file_flash_t *flash, vlog_flash_t *vlog_flash)
+{
+    memset(flash, 0, sizeof(*flash));
+    flash->file = tmpfile();
+    if (flash->file == NULL) {
+        return false;
+    }
+    flash->ops_until_cut = -1;
+    flash->powered = true;
+    *vlog_flash = (vlog_flash_t){ file_read, file_write, file_erase, flash, FLASH_SIZE };
+    return file_erase(flash, 0, FLASH_SIZE) == ESP_OK;
+}
+
+typedef struct {
+    uint32_t pages;
+    uint32_t records;
+    uint32_t last_seq;
+    uint32_t last_time;
+    bool ordered;
+} export_check_t;
+
+static bool check_page(const vlog_page_header_t *header, const vlog_record_t *records, void *arg)
+{
+    export_check_t *check = arg;
+    if (check->pages > 0 && (int32_t)(header->seq - check->last_seq) <= 0) {
+        check->ordered = false;
+    }
+    check->last_seq = header->seq;
+    for (int i = 0; i < header->count; i++) {
+        if (check->records > 0 && records[i].time_ms <= check->last_time) {
+            check->ordered = false;
+        }
+        check->last_time = records[i].time_ms;
+        check->records++;
+    }
+    check->pages++;
+    return true;
+}
+
+static vlog_record_t make_record(uint32_t time_ms)
+{
+    return (vlog_record_t){ .time_ms = time_ms, .hr_x10 = 720, .spo2_x10 = 975, .temp_x100 = 3350 };
+}
+
+/**
+ * @brief Mỗi chu kỳ: mount, kiểm tra bản xuất, thêm bản ghi cho tới khi bị cắt điện ở một thao tác
+ * ngẫu nhiên. Bản ghi đã nằm trong trang ghi thành công phải còn sau lần mount kế tiếp.
+ */
+static void test_power_cuts(void)
+{
+    static vitals_log_t log;
+    file_flash_t flash;
+    vlog_flash_t vlog_flash;
+    CHECK(file_flash_open(&flash, &vlog_flash), "cannot create flash file");
+
+    uint32_t time_ms = 0;
+    uint32_t durable_time = 0;      // Bản ghi mới nhất chắc chắn đã xuống flash
+    bool have_durable = false;
+    int unordered = 0, lost_durable = 0, overfull = 0;
+
+    for (int cycle = 0; cycle < CYCLES; cycle++) {
+        flash.powered = true;
+        flash.ops_until_cut = -1;
+        if (vitals_log_mount(&log, &vlog_flash) != ESP_OK) {
+            CHECK(false, "cycle %d: mount failed", cycle);
+            break;
+        }
+
+        export_check_t check = { .ordered = true };
+        vitals_log_export(&log, check_page, &check);
+        if (!check.ordered) unordered++;
+        if (have_durable && (check.records == 0 || check.last_time < durable_time)) lost_durable++;
+
+        // Mất điện sau một số thao tác flash ngẫu nhiên (đôi khi chu kỳ kết thúc bình thường)
+        flash.ops_until_cut = (next_random() % 4 == 0) ? -1 : (long)(next_random() % 6);
+        int records = 1 + next_random() % MAX_RECORDS_PER_CYCLE;
+        for (int r = 0; r < records; r++) {
+            vlog_record_t record = make_record(++time_ms);
+            uint32_t written = log.pages_written;
+            if (vitals_log_append(&log, &record) == ESP_OK && log.pages_written > written) {
+                durable_time = time_ms;
+                have_durable = true;
+            }
+            if (log.pending.header.count > VLOG_RECORDS_PER_PAGE) overfull++;
+            if (!flash.powered) break;
+        }
+        if (flash.powered && next_random() % 2 == 0 && vitals_log_flush(&log) == ESP_OK) {
+            durable_time = time_ms;
+            have_durable = true;
+        }
+    }
+
+    uint32_t erase_min = UINT32_MAX, erase_max = 0;
+    for (int s = 0; s < FLASH_SECTORS; s++) {
+        if (flash.erase_count[s] < erase_min) erase_min = flash.erase_count[s];
+        if (flash.erase_count[s] > erase_max) erase_max = flash.erase_count[s];
+    }
+    printf("%d power-cut cycles: %u records appended, sector erases %u..%u\n",
+           CYCLES, (unsigned)time_ms, (unsigned)erase_min, (unsigned)erase_max);
+    CHECK(unordered == 0, "%d exports out of order", unordered);
+    CHECK(lost_durable == 0, "%d mounts lost a record from a completed page", lost_durable);
+    CHECK(overfull == 0, "pending page overfilled %d times", overfull);
+    // Xóa bị cắt giữa chừng được làm lại sau khi mount, nên lệch vài lần là bình thường
+    CHECK(erase_max <= 2 * erase_min, "uneven wear: erases %u..%u", (unsigned)erase_min, (unsigned)erase_max);
+    fclose(flash.file);
+}
+
+/**
+ * @brief Vài trang ghi tốt, rồi flash từ chối mọi lần ghi trong hơn page_count lần thêm bản ghi:
+ * trang đầy ở nguyên trong RAM, bản ghi mới bị bỏ và được đếm, và lỗi kéo dài không được xóa
+ * dần cả vòng log (các trang cũ vẫn còn trong bản xuất).
+ */
+static void test_failing_writes(void)
+{
+    static vitals_log_t log;
+    file_flash_t flash;
+    vlog_flash_t vlog_flash;
+    CHECK(file_flash_open(&flash, &vlog_flash), "cannot create flash file");
+    CHECK(vitals_log_mount(&log, &vlog_flash) == ESP_OK, "mount failed");
+
+    const uint32_t good_pages = 3;
+    uint32_t time_ms = 0;
+    while (time_ms < good_pages * VLOG_RECORDS_PER_PAGE) {
+        vlog_record_t record = make_record(++time_ms);
+        vitals_log_append(&log, &record);
+    }
+    CHECK(log.pages_written == good_pages, "pages_written %u before the fault", (unsigned)log.pages_written);
+
+    const uint32_t attempts = 2 * log.page_count;
+    const uint32_t erased_before = log.sectors_erased;
+    int max_count = 0;
+    flash.fail_writes = true;
+    for (uint32_t r = 0; r < attempts; r++) {
+        vlog_record_t record = make_record(++time_ms);
+        vitals_log_append(&log, &record);
+        if (log.pending.header.count > max_count) max_count = log.pending.header.count;
+    }
+    const uint32_t erased = log.sectors_erased - erased_before;
+    printf("%u appends with failing writes: %u write errors, %u sector erases\n",
+           (unsigned)attempts, (unsigned)log.write_errors, (unsigned)erased);
+    CHECK(max_count == (int)VLOG_RECORDS_PER_PAGE, "pending page reached %d records", max_count);
+    CHECK(log.records_dropped == attempts - VLOG_RECORDS_PER_PAGE, "%u records dropped",
+          (unsigned)log.records_dropped);
+    CHECK(log.write_errors > 0 && log.pages_written == good_pages, "write_errors %u, pages_written %u",
+          (unsigned)log.write_errors, (unsigned)log.pages_written);
+    CHECK(erased < FLASH_SECTORS / 2, "%u sectors erased while writes were failing", (unsigned)erased);
+
+    // Trang ghi trước khi lỗi + trang đầy trong RAM
+    export_check_t check = { .ordered = true };
+    vitals_log_export(&log, check_page, &check);
+    CHECK(check.ordered && check.records == (good_pages + 1) * VLOG_RECORDS_PER_PAGE,
+          "during the fault: %u records exported", (unsigned)check.records);
+
+    // Flash hoạt động lại: sau thời gian chờ, trang đang giữ được ghi trước bản ghi mới
+    flash.fail_writes = false;
+    uint32_t tries = 0;
+    while (log.pages_written == good_pages && tries++ < 100000) {
+        vlog_record_t record = make_record(++time_ms);
+        vitals_log_append(&log, &record);
+    }
+    CHECK(log.pages_written == good_pages + 1 && log.pending.header.count == 1,
+          "after %u appends: pages_written %u, pending %u", (unsigned)tries,
+          (unsigned)log.pages_written, (unsigned)log.pending.header.count);
+
+    CHECK(vitals_log_mount(&log, &vlog_flash) == ESP_OK, "remount failed");
+    check = (export_check_t){ .ordered = true };
+    vitals_log_export(&log, check_page, &check);
+    CHECK(check.ordered && check.records == (good_pages + 1) * VLOG_RECORDS_PER_PAGE &&
+          check.last_time == (good_pages + 1) * VLOG_RECORDS_PER_PAGE,
+          "after remount: %u records, last time %u", (unsigned)check.records, (unsigned)check.last_time);
+    fclose(flash.file);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    test_power_cuts();
+    test_failing_writes();
+    TEST_DONE();
+}
@@ -4,14 +4,7 @@
 #include <string.h> 
 #include <stdlib.h> // Cần cho abs()
 
-// Khai báo lại time_array (Đã có trong header)
-double time_array[BUFFER_SIZE];
-
 #define DEBUG true
-#define MINIMUM_RATIO 0.3
-#define SPO2_A 1.5958422
-#define SPO2_B -34.6596622
-#define SPO2_C 112.6898759
 
 // =========================================================
 // HÀM HỖ TRỢ PHÂN TÍCH HRV
@@ -22,7 +15,7 @@ double time_array[BUFFER_SIZE];
  * @param rmssd_out: Con trỏ để lưu trữ kết quả RMSSD
  * @param sdnn_out: Con trỏ để lưu trữ kết quả SDNN (không dùng trong main.c hiện tại, nhưng được tính)
  */
-static void compute_hrv_metrics(const int *rr_data, int count, float *rmssd_out, float *sdnn_out) {
+static void compute_hrv_metrics(const float *rr_data, int count, float *rmssd_out, float *sdnn_out) {
     if (count < 2) {
         *rmssd_out = 0.0f;
         *sdnn_out = 0.0f;
@@ -41,9 +34,9 @@ static void compute_hrv_metrics(const int *rr_data, int count, float *rmssd_out,
     float artifact_threshold = 0.2f;
 
     for (int i = 1; i < count; i++) {
-        int diff = rr_data[i] - rr_data[i - 1];
+        float diff = rr_data[i] - rr_data[i - 1];
         // Loại bỏ Artifact: Nếu sự khác biệt quá lớn (ví dụ > 20%), bỏ qua
-        if (rr_data[i-1] != 0 && (float)abs(diff) > (float)rr_data[i-1] * artifact_threshold) {
+        if (rr_data[i-1] != 0 && fabsf(diff) > rr_data[i-1] * artifact_threshold) {
              continue; 
         }
         sum_sq_diff += (double)diff * diff;
@@ -62,65 +55,640 @@ static void compute_hrv_metrics(const int *rr_data, int count, float *rmssd_out,
     *sdnn_out = (count > 1) ? sqrt(sum_sq_dev / (count - 1)) : 0.0f;
 }
 
+// =========================================================
+// PHÁT HIỆN NHỊP TIM THEO TỪNG MẪU (THAY CHO find_peaks)
+// =========================================================
+
+void beat_detector_init(beat_detector_t *detector)
+{
+    memset(detector, 0, sizeof(*detector));
+}
+
 /**
- * @brief Hàm tìm các đỉnh R-peak (systolic peak) trong dữ liệu IR
- * và lưu trữ khoảng thời gian giữa chúng (RR-Intervals).
+ * @brief Biên độ tín hiệu đổi theo hệ số gain_ratio (ví dụ AGC đổi dòng LED):
+ * co giãn mức đỉnh/nhiễu và các mẫu đang giữ để ngưỡng thích nghi không phải học lại.
  */
-static int find_peaks(int32_t *ir_data, int *rr_intervals) {
-    int peak_indices[BUFFER_SIZE / 2]; 
-    int peak_count = 0;
-    
-    // Ngưỡng động: 30% giá trị đỉnh lớn nhất
-    int max_ir = 0;
-    for (int i = 0; i < BUFFER_SIZE; i++) {
-        if (ir_data[i] > max_ir) max_ir = ir_data[i];
+void beat_detector_rescale(beat_detector_t *detector, float gain_ratio)
+{
+    detector->peak_level *= gain_ratio;
+    detector->noise_level *= gain_ratio;
+    detector->x0 *= gain_ratio;
+    detector->x1 *= gain_ratio;
+}
+
+static void beat_queue_push(beat_detector_t *detector, const beat_event_t *event)
+{
+    if (detector->queue_count >= BEAT_QUEUE_SIZE) {
+        // Hàng đợi đầy: bỏ sự kiện cũ nhất
+        detector->queue_tail = (detector->queue_tail + 1) % BEAT_QUEUE_SIZE;
+        detector->queue_count--;
+        detector->dropped_events++;
     }
-    // 
-    int threshold = max_ir * 0.3; 
-    
-    // Khoảng cách tối thiểu giữa các đỉnh (300ms = Max 200 BPM)
-    const int min_peak_distance_samples = 300 / DELAY_AMOSTRAGEM; 
-    
-    int last_peak_index = -min_peak_distance_samples; 
-
-    for (int i = 1; i < BUFFER_SIZE - 1; i++) {
-        // Kiểm tra: Giá trị > Ngưỡng VÀ Đang ở đỉnh cục bộ
-        if (ir_data[i] > threshold && ir_data[i] > ir_data[i - 1] && ir_data[i] > ir_data[i + 1]) {
-            // Kiểm tra: Khoảng cách giữa các đỉnh
-            if (i - last_peak_index >= min_peak_distance_samples) {
-                peak_indices[peak_count++] = i;
-                last_peak_index = i;
-            }
+    detector->queue[detector->queue_head] = *event;
+    detector->queue_head = (detector->queue_head + 1) % BEAT_QUEUE_SIZE;
+    detector->queue_count++;
+}
+
+bool beat_detector_pop(beat_detector_t *detector, beat_event_t *event)
+{
+    if (detector->queue_count == 0) {
+        return false;
+    }
+    *event = detector->queue[detector->queue_tail];
+    detector->queue_tail = (detector->queue_tail + 1) % BEAT_QUEUE_SIZE;
+    detector->queue_count--;
+    return true;
+}
+
+static void accept_beat(beat_detector_t *detector, uint32_t time_us, float amplitude)
+{
+    beat_event_t event = { .time_us = time_us, .amplitude = amplitude, .rr_ms = 0.0f };
+
+    if (detector->beat_count > 0) {
+        // Hiệu số không dấu vẫn đúng khi bộ đếm us quay vòng
+        float rr_ms = (uint32_t)(time_us - detector->last_beat_us) / 1000.0f;
+        if (rr_ms >= BEAT_MIN_RR_MS && rr_ms <= BEAT_MAX_RR_MS) {
+            event.rr_ms = rr_ms;
+            detector->rr_history[detector->rr_pos] = rr_ms;
+            detector->rr_pos = (detector->rr_pos + 1) % BEAT_HISTORY_SIZE;
+            if (detector->rr_count < BEAT_HISTORY_SIZE) detector->rr_count++;
         }
     }
-    
-    // Tính toán RR-Intervals (ms)
-    int rr_count = 0;
-    for (int i = 1; i < peak_count; i++) {
-        int index_diff = peak_indices[i] - peak_indices[i - 1];
-        rr_intervals[rr_count++] = index_diff * DELAY_AMOSTRAGEM;
+    detector->last_beat_us = time_us;
+    detector->beat_count++;
+
+    // Mức đỉnh thích nghi (EMA 1/8, khởi tạo bằng nhịp đầu tiên)
+    if (detector->beat_count == 1) {
+        detector->peak_level = amplitude;
+    } else {
+        detector->peak_level += (amplitude - detector->peak_level) * 0.125f;
     }
-    
-    return rr_count;
+    beat_queue_push(detector, &event);
 }
 
-// =========================================================
-// CHỨC NĂNG PHÂN TÍCH CHÍNH (HRV VÀ STRESS)
-// =========================================================
+/**
+ * @brief Xử lý một mẫu PPG đã lọc. Đỉnh được xác nhận trễ 1 mẫu (cần mẫu sau để biết cực đại),
+ * thời điểm đỉnh được nội suy parabol giữa 3 mẫu để đạt độ phân giải dưới chu kỳ lấy mẫu.
+ * @return true nếu phát hiện nhịp mới (sự kiện đã vào hàng đợi)
+ */
+bool beat_detector_process(beat_detector_t *detector, int32_t sample, uint32_t timestamp_ms)
+{
+    float x2 = (float)sample;
+    float x1 = detector->x1;
+    float x0 = detector->x0;
+    uint32_t t1 = detector->t1;
+    uint32_t t0 = detector->t0;
+    bool beat = false;
+
+    if (detector->samples_seen >= 2 && x1 > x0 && x1 >= x2 && x1 > 0.0f) {
+        // Ngưỡng thích nghi giữa mức nhiễu và mức đỉnh, giảm dần nếu lâu không có nhịp
+        float threshold = detector->noise_level + BEAT_THRESHOLD_RATIO * (detector->peak_level - detector->noise_level);
+        uint32_t since_last_ms = (uint32_t)(t1 * 1000u - detector->last_beat_us) / 1000u;
+        if (detector->beat_count > 0 && since_last_ms > BEAT_MAX_RR_MS) {
+            threshold *= 0.5f;
+        }
+
+        // Nội suy parabol: độ lệch đỉnh (đơn vị mẫu) trong [-0.5, 0.5]
+        float denom = x0 - 2.0f * x1 + x2;
+        float delta = (denom != 0.0f) ? 0.5f * (x0 - x2) / denom : 0.0f;
+        if (delta > 0.5f) delta = 0.5f;
+        if (delta < -0.5f) delta = -0.5f;
+        float amplitude = x1 - 0.25f * (x0 - x2) * delta;
+        float half_span_us = (delta >= 0.0f) ? (timestamp_ms - t1) * 1000.0f : (t1 - t0) * 1000.0f;
+        uint32_t peak_us = t1 * 1000u + (int32_t)lrintf(delta * half_span_us);
+
+        bool refractory = detector->beat_count > 0 &&
+                          (uint32_t)(peak_us - detector->last_beat_us) < BEAT_REFRACTORY_MS * 1000u;
+
+        if (!refractory && (amplitude > threshold || detector->beat_count == 0)) {
+            accept_beat(detector, peak_us, amplitude);
+            beat = true;
+        } else {
+            // Cực đại bị loại: cập nhật mức nhiễu
+            detector->noise_level += (amplitude - detector->noise_level) * 0.125f;
+        }
+    }
+
+    detector->x0 = x1;
+    detector->x1 = x2;
+    detector->t0 = t1;
+    detector->t1 = timestamp_ms;
+    detector->samples_seen++;
+    return beat;
+}
+
+int beat_detector_rr_intervals(const beat_detector_t *detector, float *rr_ms, int max_count)
+{
+    int count = (detector->rr_count < max_count) ? detector->rr_count : max_count;
+    // Trả về theo thứ tự cũ -> mới
+    int start = (detector->rr_pos - count + BEAT_HISTORY_SIZE) % BEAT_HISTORY_SIZE;
+    for (int i = 0; i < count; i++) {
+        rr_ms[i] = detector->rr_history[(start + i) % BEAT_HISTORY_SIZE];
+    }
+    return count;
+}
 
-float calculate_hrv_rmssd(int32_t *ir_data, size_t buffer_size)
+float beat_detector_heart_rate(const beat_detector_t *detector)
 {
-    int rr_intervals[BUFFER_SIZE / 2]; 
+    float rr_ms[BEAT_HR_AVERAGE];
+    int count = beat_detector_rr_intervals(detector, rr_ms, BEAT_HR_AVERAGE);
+    if (count == 0) {
+        return 0.0f;
+    }
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) {
+        sum += rr_ms[i];
+    }
+    return 60000.0f * count / sum;
+}
+
+float beat_detector_rmssd(const beat_detector_t *detector)
+{
+    float rr_ms[BEAT_HISTORY_SIZE];
     float rmssd, sdnn;
-    
-    int rr_count = find_peaks(ir_data, rr_intervals);
-    
-    compute_hrv_metrics(rr_intervals, rr_count, &rmssd, &sdnn);
+    int count = beat_detector_rr_intervals(detector, rr_ms, BEAT_HISTORY_SIZE);
+
+    compute_hrv_metrics(rr_ms, count, &rmssd, &sdnn);
     
     // Trả về RMSSD làm chỉ số chính cho HRV
     return rmssd;
 }
 
+// =========================================================
+// ĐẶC TRƯNG CHUYỂN ĐỘNG TỪ GIA TỐC KẾ
+// =========================================================
+
+void compute_motion_features(const float *ax, const float *ay, const float *az, int count, motion_features_t *features)
+{
+    features->peak_g = 0.0f;
+    features->mean_g = 0.0f;
+    features->energy = 0.0f;
+    if (count <= 0) {
+        return;
+    }
+
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    for (int i = 0; i < count; i++) {
+        float magnitude = sqrtf(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+        if (magnitude > features->peak_g) features->peak_g = magnitude;
+        sum += magnitude;
+        sum_sq += (double)magnitude * magnitude;
+    }
+
+    double mean = sum / count;
+    double variance = sum_sq / count - mean * mean;
+    features->mean_g = mean;
+    features->energy = (variance > 0.0) ? variance : 0.0f;
+}
+
+void align_to_timestamps(const uint32_t *src_t, const float *src_v, int src_count,
+                         const uint32_t *dst_t, float *dst_v, int dst_count)
+{
+    int j = 0;
+
+    for (int i = 0; i < dst_count; i++) {
+        if (src_count == 0) {
+            dst_v[i] = 0.0f;
+            continue;
+        }
+        // Tìm cặp mẫu nguồn bao quanh dst_t[i]
+        while (j < src_count - 1 && src_t[j + 1] <= dst_t[i]) {
+            j++;
+        }
+        if (dst_t[i] <= src_t[0]) {
+            dst_v[i] = src_v[0];
+        } else if (j >= src_count - 1) {
+            dst_v[i] = src_v[src_count - 1];
+        } else {
+            uint32_t span = src_t[j + 1] - src_t[j];
+            float frac = (span > 0) ? (float)(dst_t[i] - src_t[j]) / span : 0.0f;
+            dst_v[i] = src_v[j] + frac * (src_v[j + 1] - src_v[j]);
+        }
+    }
+}
+
+// =========================================================
+// LỌC THÔNG DẢI IIR (BIQUAD NỐI TẦNG)
+// =========================================================
+
+// Hệ số đã chuẩn hóa theo a0: {b0, b1, b2, a1, a2}
+typedef struct {
+    double b0, b1, b2, a1, a2;
+} biquad_coefs_t;
+
+/**
+ * @brief Thiết kế biquad Butterworth (Q = 1/sqrt(2)) theo RBJ Audio EQ Cookbook.
+ * Section 0 là thông cao (low_hz), section 1 là thông thấp (high_hz).
+ */
+static biquad_coefs_t design_bandpass_section(int section, double fs_hz, double low_hz, double high_hz)
+{
+    biquad_coefs_t c;
+    double f0 = (section == 0) ? low_hz : high_hz;
+    double w0 = 2.0 * M_PI * f0 / fs_hz;
+    double cos_w0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * M_SQRT1_2);
+    double a0 = 1.0 + alpha;
+
+    if (section == 0) {
+        c.b0 = (1.0 + cos_w0) / 2.0;
+        c.b1 = -(1.0 + cos_w0);
+    } else {
+        c.b0 = (1.0 - cos_w0) / 2.0;
+        c.b1 = 1.0 - cos_w0;
+    }
+    c.b2 = c.b0;
+    c.a1 = -2.0 * cos_w0;
+    c.a2 = 1.0 - alpha;
+
+    c.b0 /= a0; c.b1 /= a0; c.b2 /= a0; c.a1 /= a0; c.a2 /= a0;
+    return c;
+}
+
+// Độ lợi DC của một section: H(z=1)
+static double biquad_dc_gain(double b0, double b1, double b2, double a1, double a2)
+{
+    return (b0 + b1 + b2) / (1.0 + a1 + a2);
+}
+
+void bandpass_init_f32(bandpass_f32_t *filter, float fs_hz, float low_hz, float high_hz)
+{
+    for (int s = 0; s < BANDPASS_SECTIONS; s++) {
+        biquad_coefs_t c = design_bandpass_section(s, fs_hz, low_hz, high_hz);
+        biquad_f32_t *bq = &filter->section[s];
+        bq->b0 = c.b0; bq->b1 = c.b1; bq->b2 = c.b2;
+        bq->a1 = c.a1; bq->a2 = c.a2;
+        bq->z1 = 0.0f; bq->z2 = 0.0f;
+    }
+}
+
+/**
+ * @brief Đặt trạng thái như thể đầu vào đã bằng x0 từ lâu (tránh quá độ khi bắt đầu).
+ */
+void bandpass_reset_f32(bandpass_f32_t *filter, float x0)
+{
+    float x = x0;
+    for (int s = 0; s < BANDPASS_SECTIONS; s++) {
+        biquad_f32_t *bq = &filter->section[s];
+        float y = biquad_dc_gain(bq->b0, bq->b1, bq->b2, bq->a1, bq->a2) * x;
+        bq->z2 = bq->b2 * x - bq->a2 * y;
+        bq->z1 = bq->b1 * x - bq->a1 * y + bq->z2;
+        x = y;
+    }
+}
+
+float bandpass_process_f32(bandpass_f32_t *filter, float x)
+{
+    for (int s = 0; s < BANDPASS_SECTIONS; s++) {
+        biquad_f32_t *bq = &filter->section[s];
+        float y = bq->b0 * x + bq->z1;
+        bq->z1 = bq->b1 * x - bq->a1 * y + bq->z2;
+        bq->z2 = bq->b2 * x - bq->a2 * y;
+        x = y;
+    }
+    return x;
+}
+
+static int32_t to_q30(double value)
+{
+    return (int32_t)lround(value * (double)(1 << BIQUAD_Q30_SHIFT));
+}
+
+void bandpass_init_q30(bandpass_q30_t *filter, float fs_hz, float low_hz, float high_hz)
+{
+    for (int s = 0; s < BANDPASS_SECTIONS; s++) {
+        biquad_coefs_t c = design_bandpass_section(s, fs_hz, low_hz, high_hz);
+        biquad_q30_t *bq = &filter->section[s];
+        bq->b0 = to_q30(c.b0); bq->b1 = to_q30(c.b1); bq->b2 = to_q30(c.b2);
+        bq->a1 = to_q30(c.a1); bq->a2 = to_q30(c.a2);
+        bq->x1 = bq->x2 = bq->y1 = bq->y2 = 0;
+    }
+}
+
+void bandpass_reset_q30(bandpass_q30_t *filter, int32_t x0)
+{
+    int32_t x = x0;
+    for (int s = 0; s < BANDPASS_SECTIONS; s++) {
+        biquad_q30_t *bq = &filter->section[s];
+        double scale = 1.0 / (double)(1 << BIQUAD_Q30_SHIFT);
+        double gain = biquad_dc_gain(bq->b0 * scale, bq->b1 * scale, bq->b2 * scale, bq->a1 * scale, bq->a2 * scale);
+        int32_t y = (int32_t)lround(gain * x);
+        bq->x1 = bq->x2 = x;
+        bq->y1 = bq->y2 = y;
+        x = y;
+    }
+}
+
+int32_t bandpass_process_q30(bandpass_q30_t *filter, int32_t x)
+{
+    for (int s = 0; s < BANDPASS_SECTIONS; s++) {
+        biquad_q30_t *bq = &filter->section[s];
+        int64_t acc = (int64_t)bq->b0 * x + (int64_t)bq->b1 * bq->x1 + (int64_t)bq->b2 * bq->x2
+                    - (int64_t)bq->a1 * bq->y1 - (int64_t)bq->a2 * bq->y2;
+        int32_t y = (int32_t)((acc + (1LL << (BIQUAD_Q30_SHIFT - 1))) >> BIQUAD_Q30_SHIFT);
+        bq->x2 = bq->x1; bq->x1 = x;
+        bq->y2 = bq->y1; bq->y1 = y;
+        x = y;
+    }
+    return x;
+}
+
+// =========================================================
+// HẠ TỐC ĐA TỐC ĐỘ (POLYPHASE FIR)
+// =========================================================
+
+/**
+ * @brief Thiết kế FIR thông thấp sinc cửa sổ Hamming (M * DECIM_TAPS_PER_PHASE tap),
+ * lượng tử Q15 và chia thành M nhánh pha. Hệ số 1 = đi thẳng, không lọc.
+ */
+void decimator_init(decimator_t *decim, int factor)
+{
+    memset(decim, 0, sizeof(*decim));
+    if (factor < 1) factor = 1;
+    if (factor > DECIM_MAX_FACTOR) factor = DECIM_MAX_FACTOR;
+    decim->factor = factor;
+    decim->phase = factor - 1;
+    if (factor == 1) {
+        return;
+    }
+
+    const int taps = factor * DECIM_TAPS_PER_PHASE;
+    const double fc = DECIM_CUTOFF_RATIO / factor;     // Chuẩn hóa theo tốc độ vào
+    const double center = (taps - 1) / 2.0;
+    double h[DECIM_MAX_FACTOR * DECIM_TAPS_PER_PHASE];
+    double sum = 0.0;
+
+    for (int n = 0; n < taps; n++) {
+        double t = n - center;
+        double sinc = (t == 0.0) ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+        double window = 0.54 - 0.46 * cos(2.0 * M_PI * n / (taps - 1));
+        h[n] = sinc * window;
+        sum += h[n];
+    }
+
+    // Lượng tử Q15, dồn sai số làm tròn vào tap giữa để độ lợi DC đúng bằng 1 (kênh thô giữ DC)
+    int32_t q_sum = 0;
+    for (int n = 0; n < taps; n++) {
+        int16_t q = (int16_t)lround(h[n] / sum * (1 << DECIM_Q15_SHIFT));
+        decim->coeffs[n % factor][n / factor] = q;
+        q_sum += q;
+    }
+    decim->coeffs[(taps / 2) % factor][(taps / 2) / factor] += (int16_t)((1 << DECIM_Q15_SHIFT) - q_sum);
+}
+
+// Đặt trạng thái như thể đầu vào đã bằng x0 từ lâu (giữ nguyên pha của chuỗi ra)
+void decimator_reset(decimator_t *decim, int32_t x0)
+{
+    for (int p = 0; p < DECIM_MAX_FACTOR; p++) {
+        for (int k = 0; k < DECIM_TAPS_PER_PHASE; k++) {
+            decim->delay[p][k] = x0;
+        }
+    }
+}
+
+/**
+ * @brief Đưa một mẫu tốc độ cao vào nhánh pha hiện tại. Khi nhánh 0 nhận mẫu (mỗi M mẫu),
+ * tính y[m] = sum_p sum_k h[kM+p] * x[(m-k)M - p] — chỉ tốn taps phép nhân cho mỗi mẫu ra.
+ * @return true nếu có mẫu ra (ghi vào *y)
+ */
+bool decimator_process(decimator_t *decim, int32_t x, int32_t *y)
+{
+    if (decim->factor == 1) {
+        *y = x;
+        return true;
+    }
+
+    // Mẫu đầu khối (nhánh M-1) mở ô mới trong vòng trễ của mọi nhánh
+    if (decim->phase == decim->factor - 1) {
+        decim->head = (decim->head + 1) % DECIM_TAPS_PER_PHASE;
+    }
+    decim->delay[decim->phase][decim->head] = x;
+
+    if (decim->phase > 0) {
+        decim->phase--;
+        return false;
+    }
+    decim->phase = decim->factor - 1;
+
+    int64_t acc = 0;
+    for (int p = 0; p < decim->factor; p++) {
+        int idx = decim->head;
+        for (int k = 0; k < DECIM_TAPS_PER_PHASE; k++) {
+            acc += (int64_t)decim->coeffs[p][k] * decim->delay[p][idx];
+            idx = (idx == 0) ? DECIM_TAPS_PER_PHASE - 1 : idx - 1;
+        }
+    }
+    *y = (int32_t)((acc + (1LL << (DECIM_Q15_SHIFT - 1))) >> DECIM_Q15_SHIFT);
+    return true;
+}
+
+// Trễ nhóm (pha tuyến tính) tính theo số mẫu đầu vào, tính từ mẫu vào mới nhất
+float decimator_delay_samples(const decimator_t *decim)
+{
+    if (decim->factor == 1) {
+        return 0.0f;
+    }
+    return (decim->factor * DECIM_TAPS_PER_PHASE - 1) / 2.0f;
+}
+
+// =========================================================
+// CHỈ SỐ CHẤT LƯỢNG TÍN HIỆU (SQI)
+// =========================================================
+
+void sqi_reset(sqi_accumulator_t *acc)
+{
+    memset(acc, 0, sizeof(*acc));
+    acc->last_crossing = -1;
+}
+
+void sqi_update(sqi_accumulator_t *acc, int32_t ir_raw, int32_t red_raw, int32_t ir_filtered)
+{
+    acc->sum_ir_raw += ir_raw;
+    acc->sum_red_raw += red_raw;
+    if (ir_raw >= SQI_CLIP_LEVEL || red_raw >= SQI_CLIP_LEVEL) {
+        acc->clipped++;
+    }
+
+    double x = ir_filtered;
+    double x2 = x * x;
+    acc->sum1 += x;
+    acc->sum2 += x2;
+    acc->sum3 += x2 * x;
+    acc->sum4 += x2 * x2;
+
+    // Cắt 0 chiều lên: đánh dấu chu kỳ mạch
+    if (acc->count > 0 && acc->last_filtered < 0 && ir_filtered >= 0) {
+        if (acc->last_crossing >= 0) {
+            int64_t interval = acc->count - acc->last_crossing;
+            acc->sum_interval += interval;
+            acc->sum_interval_sq += interval * interval;
+        }
+        acc->last_crossing = acc->count;
+        acc->zero_crossings++;
+    }
+    acc->last_filtered = ir_filtered;
+    acc->count++;
+}
+
+/**
+ * @brief Đánh giá chất lượng cửa sổ, các kiểm tra rẻ nhất/chắc chắn nhất được xét trước.
+ * @return Lý do loại cửa sổ, SQI_OK nếu đủ tốt để tính HR/SpO2/ML
+ */
+sqi_reason_t sqi_evaluate(const sqi_accumulator_t *acc, float sample_rate_hz, sqi_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    if (acc->count == 0) {
+        result->reason = SQI_NO_FINGER;
+        return result->reason;
+    }
+
+    int n = acc->count;
+    result->ir_dc = (float)acc->sum_ir_raw / n;
+    result->red_dc = (float)acc->sum_red_raw / n;
+    result->clipped_percent = 100.0f * acc->clipped / n;
+
+    double mean = acc->sum1 / n;
+    double m2 = acc->sum2 / n - mean * mean;
+    // Mômen bậc 4 quanh trung bình từ các tổng thô
+    double m4 = acc->sum4 / n - 4.0 * mean * acc->sum3 / n + 6.0 * mean * mean * acc->sum2 / n - 3.0 * mean * mean * mean * mean;
+    result->kurtosis = (m2 > 0.0) ? m4 / (m2 * m2) : 0.0f;
+
+    // PI = AC đỉnh-đỉnh / DC; với dạng sóng gần sin, đỉnh-đỉnh ~ 2*sqrt(2)*RMS
+    double ac_rms = (m2 > 0.0) ? sqrt(m2) : 0.0;
+    result->perfusion_index = (result->ir_dc > 0.0f) ? 100.0f * 2.0f * M_SQRT2 * ac_rms / result->ir_dc : 0.0f;
+
+    float duration_s = n / sample_rate_hz;
+    result->zero_crossing_hz = acc->zero_crossings / duration_s;
+    int intervals = acc->zero_crossings - 1;
+    if (intervals > 1) {
+        double mean_interval = (double)acc->sum_interval / intervals;
+        double var_interval = (double)acc->sum_interval_sq / intervals - mean_interval * mean_interval;
+        result->zero_crossing_cv = (var_interval > 0.0) ? sqrt(var_interval) / mean_interval : 0.0f;
+    }
+
+    if (result->ir_dc < SQI_FINGER_DC_MIN) {
+        result->reason = SQI_NO_FINGER;
+    } else if (result->clipped_percent > SQI_MAX_CLIPPED_PERCENT) {
+        result->reason = SQI_SATURATED;
+    } else if (result->ir_dc > SQI_DC_MAX_FRACTION * SQI_ADC_FULL_SCALE) {
+        result->reason = SQI_ADC_RANGE;
+    } else if (result->perfusion_index < SQI_PI_MIN) {
+        result->reason = SQI_LOW_PERFUSION;
+    } else if (result->perfusion_index > SQI_PI_MAX) {
+        result->reason = SQI_HIGH_PERFUSION;
+    } else if (result->kurtosis > SQI_KURTOSIS_MAX) {
+        result->reason = SQI_KURTOSIS;
+    } else if (result->zero_crossing_hz < SQI_ZC_RATE_MIN_HZ || result->zero_crossing_hz > SQI_ZC_RATE_MAX_HZ ||
+               result->zero_crossing_cv > SQI_ZC_CV_MAX) {
+        result->reason = SQI_IRREGULAR;
+    } else {
+        result->reason = SQI_OK;
+    }
+    return result->reason;
+}
+
+const char *sqi_reason_str(sqi_reason_t reason)
+{
+    switch (reason) {
+        case SQI_OK:             return "OK";
+        case SQI_NO_FINGER:      return "No finger";
+        case SQI_SATURATED:      return "Saturated";
+        case SQI_ADC_RANGE:      return "ADC range";
+        case SQI_LOW_PERFUSION:  return "Low perfusion";
+        case SQI_HIGH_PERFUSION: return "High perfusion";
+        case SQI_KURTOSIS:       return "Artifact";
+        case SQI_IRREGULAR:      return "Irregular";
+        default:                 return "Unknown";
+    }
+}
+
+// =========================================================
+// KHỬ NHIỄU CHUYỂN ĐỘNG BẰNG NLMS
+// =========================================================
+
+void nlms_init(nlms_filter_t *filter, float mu)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->mu = mu;
+}
+
+// Nhiễu chuyển động trong PPG co giãn theo biên độ tín hiệu, tham chiếu gia tốc thì không
+void nlms_rescale(nlms_filter_t *filter, float gain_ratio)
+{
+    for (int a = 0; a < NLMS_AXES; a++) {
+        for (int k = 0; k < NLMS_TAPS; k++) {
+            filter->weights[a][k] *= gain_ratio;
+        }
+    }
+}
+
+/**
+ * @brief Xử lý một mẫu: ước lượng thành phần chuyển động từ gia tốc và trừ khỏi PPG.
+ * Chỉ dùng nhân/cộng và một phép chia mỗi mẫu; công suất tham chiếu cập nhật tăng dần
+ * nên chi phí O(NLMS_AXES * NLMS_TAPS).
+ * @return Tín hiệu sai số e = d - y (PPG đã khử nhiễu)
+ */
+float nlms_process_sample(nlms_filter_t *filter, const float reference[NLMS_AXES], float desired)
+{
+    int pos = filter->pos;
+
+    // 1. Đẩy mẫu tham chiếu mới vào đường trễ, cập nhật công suất
+    for (int a = 0; a < NLMS_AXES; a++) {
+        float oldest = filter->delay[a][pos];
+        filter->power += reference[a] * reference[a] - oldest * oldest;
+        filter->delay[a][pos] = reference[a];
+    }
+    if (filter->power < 0.0f) filter->power = 0.0f; // Sai số làm tròn tích lũy
+
+    // 2. Ước lượng nhiễu chuyển động y = w^T x
+    float estimate = 0.0f;
+    for (int a = 0; a < NLMS_AXES; a++) {
+        int idx = pos;
+        for (int k = 0; k < NLMS_TAPS; k++) {
+            estimate += filter->weights[a][k] * filter->delay[a][idx];
+            idx = (idx == 0) ? NLMS_TAPS - 1 : idx - 1;
+        }
+    }
+    float error = desired - estimate;
+
+    // 3. Cập nhật trọng số w += mu * e * x / (eps + ||x||^2)
+    float step = filter->mu * error / (NLMS_EPSILON + filter->power);
+    for (int a = 0; a < NLMS_AXES; a++) {
+        int idx = pos;
+        for (int k = 0; k < NLMS_TAPS; k++) {
+            filter->weights[a][k] += step * filter->delay[a][idx];
+            idx = (idx == 0) ? NLMS_TAPS - 1 : idx - 1;
+        }
+    }
+
+    filter->pos = (pos + 1) % NLMS_TAPS;
+    return error;
+}
+
+void cancel_motion_artifacts(nlms_filter_t *filter, int32_t *ppg_data,
+                             const float *ax, const float *ay, const float *az, int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    // Bỏ thành phần trọng trường (trung bình từng trục) khỏi tín hiệu tham chiếu
+    float mean[NLMS_AXES] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < count; i++) {
+        mean[0] += ax[i];
+        mean[1] += ay[i];
+        mean[2] += az[i];
+    }
+    for (int a = 0; a < NLMS_AXES; a++) {
+        mean[a] /= count;
+    }
+
+    for (int i = 0; i < count; i++) {
+        float reference[NLMS_AXES] = { ax[i] - mean[0], ay[i] - mean[1], az[i] - mean[2] };
+        ppg_data[i] = (int32_t)lrintf(nlms_process_sample(filter, reference, (float)ppg_data[i]));
+    }
+}
+
 // =========================================================
 // HÀM PREDICT_STRESS ĐÃ ĐƯỢC XÓA VÀ THAY THẾ BẰNG ML TRONG MAIN.C
 // =========================================================
@@ -132,67 +700,141 @@ void predict_stress(int hr, double spo2, float hrv, char *output_status)
 */
 
 
+// =========================================================
+// NGỮ CẢNH XỬ LÝ MỘT KÊNH PPG
+// =========================================================
+
+/**
+ * @brief Khởi tạo ngữ cảnh một kênh PPG: tốc độ xử lý, độ dài cửa sổ và các hệ số hạ tốc.
+ * calculate_heart_rate làm việc trên cửa sổ đã hạ tốc hr_decimation lần.
+ */
+void ppg_context_init(ppg_context_t *ctx, float sample_rate_hz, int window_length,
+                      int fifo_decimation, int hr_decimation)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    if (window_length > BUFFER_SIZE) window_length = BUFFER_SIZE;
+    if (hr_decimation < 1) hr_decimation = 1;
+
+    ctx->sample_rate_hz = sample_rate_hz;
+    ctx->sample_period_s = 1.0 / sample_rate_hz;
+    ctx->window_len = window_length;
+    ctx->hr_period_s = ctx->sample_period_s * hr_decimation;
+    ctx->hr_window_len = window_length / hr_decimation;
+    init_time_array(ctx);
+    ppg_context_set_calibration(ctx, SPO2_A, SPO2_B, SPO2_C, MINIMUM_RATIO);
+
+    decimator_init(&ctx->decim_fifo_red, fifo_decimation);
+    decimator_init(&ctx->decim_fifo_ir, fifo_decimation);
+    decimator_init(&ctx->decim_hr, hr_decimation);
+    bandpass_init_q30(&ctx->bandpass_ir, sample_rate_hz, BANDPASS_LOW_HZ, BANDPASS_HIGH_HZ);
+    bandpass_init_q30(&ctx->bandpass_red, sample_rate_hz, BANDPASS_LOW_HZ, BANDPASS_HIGH_HZ);
+    ctx->bandpass_primed = false;
+    nlms_init(&ctx->nlms_ir, NLMS_DEFAULT_MU);
+    nlms_init(&ctx->nlms_red, NLMS_DEFAULT_MU);
+    beat_detector_init(&ctx->beat_detector);
+    sqi_reset(&ctx->sqi);
+}
+
+void ppg_context_set_calibration(ppg_context_t *ctx, double spo2_a, double spo2_b, double spo2_c,
+                                 double min_autocorr_ratio)
+{
+    ctx->spo2_a = spo2_a;
+    ctx->spo2_b = spo2_b;
+    ctx->spo2_c = spo2_c;
+    ctx->min_autocorr_ratio = min_autocorr_ratio;
+}
+
+// Một mẫu ở tốc độ xử lý: lưu thô, lọc thông dải và tích lũy SQI
+void ppg_store_sample(ppg_context_t *ctx, int i, int32_t red, int32_t ir, uint32_t t_ms)
+{
+    ctx->time_ms[i] = t_ms;
+    ctx->ir_raw[i] = ir;
+    ctx->red_raw[i] = red;
+
+    // Lọc thông dải ngay khi có mẫu (trạng thái giữ qua các cửa sổ)
+    if (!ctx->bandpass_primed) {
+        bandpass_reset_q30(&ctx->bandpass_ir, ir);
+        bandpass_reset_q30(&ctx->bandpass_red, red);
+        ctx->bandpass_primed = true;
+    }
+    ctx->ir_data[i] = bandpass_process_q30(&ctx->bandpass_ir, ir);
+    ctx->red_data[i] = bandpass_process_q30(&ctx->bandpass_red, red);
+    sqi_update(&ctx->sqi, ir, red, ctx->ir_data[i]);
+}
+
+// Hạ tốc IR đã làm sạch của cửa sổ về ~HR_TARGET_RATE_HZ (ctx->hr_data) cho tự tương quan
+int ppg_decimate_hr_window(ppg_context_t *ctx)
+{
+    ctx->hr_len = 0;
+    for (int i = 0; i < ctx->window_len && ctx->hr_len < ctx->hr_window_len; i++) {
+        if (decimator_process(&ctx->decim_hr, ctx->ir_data[i], &ctx->hr_data[ctx->hr_len])) {
+            ctx->hr_len++;
+        }
+    }
+    return ctx->hr_len;
+}
+
 // =========================================================
 // CÁC HÀM XỬ LÝ DỮ LIỆU CŨ (GIỮ NGUYÊN)
 // =========================================================
 
-void init_time_array()
+void init_time_array(ppg_context_t *ctx)
 {
     double time = 0;
-    for(int i = 0; i < BUFFER_SIZE; i++){
-        time_array[i] = time;
-        time += DELAY_AMOSTRAGEM / 1000.0;
+    for(int i = 0; i < ctx->window_len; i++){
+        ctx->time_array[i] = time;
+        time += ctx->sample_period_s;
     }
 }
 
-void remove_dc_part(int32_t *ir_buffer, int32_t *red_buffer, uint64_t *ir_mean, uint64_t *red_mean)
+void remove_dc_part(const ppg_context_t *ctx, int32_t *ir_buffer, int32_t *red_buffer, uint64_t *ir_mean, uint64_t *red_mean)
 {
     *ir_mean = 0;
     *red_mean = 0;
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         *ir_mean += ir_buffer[i];
         *red_mean += red_buffer[i];
     }
 
-    *ir_mean = *ir_mean / (BUFFER_SIZE);
-    *red_mean = *red_mean / (BUFFER_SIZE);
+    *ir_mean = *ir_mean / ctx->window_len;
+    *red_mean = *red_mean / ctx->window_len;
 
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         red_buffer[i] = red_buffer[i] - *red_mean;
         ir_buffer[i] = ir_buffer[i] - *ir_mean;
     }
 }
 
-void remove_trend_line(int32_t *buffer)
+void remove_trend_line(const ppg_context_t *ctx, int32_t *buffer)
 {
     double a = 0;
     double b = 0;
 
-    calculate_linear_regression(&a, &b, buffer);
+    calculate_linear_regression(ctx, &a, &b, buffer);
 
     double time = 0;
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         buffer [i] = ((buffer[i] + (-a * time)) - b);
-        time += DELAY_AMOSTRAGEM / 1000.0;
+        time += ctx->sample_period_s;
     }
 }
 
-void calculate_linear_regression(double *angular_coef, double *linear_coef, int32_t *data)
+void calculate_linear_regression(const ppg_context_t *ctx, double *angular_coef, double *linear_coef, int32_t *data)
 {
-    int64_t sum_of_y = sum_of_elements(data);
-    double sum_of_x = 325.12; 
-    double sum_of_x2 = somatoria_x2();
-    double sum_of_xy = sum_of_xy_elements(data);
+    int64_t sum_of_y = sum_of_elements(ctx, data);
+    double sum_of_x = ctx->sample_period_s * ctx->window_len * (ctx->window_len - 1) / 2.0;
+    double sum_of_x2 = somatoria_x2(ctx);
+    double sum_of_xy = sum_of_xy_elements(ctx, data);
     double sum_of_x_squared = (sum_of_x * sum_of_x);
 
-    double temp = (sum_of_xy - (sum_of_x * sum_of_y) / BUFFER_SIZE);
-    double temp2 = (sum_of_x2 - (sum_of_x_squared / BUFFER_SIZE));
+    double temp = (sum_of_xy - (sum_of_x * sum_of_y) / ctx->window_len);
+    double temp2 = (sum_of_x2 - (sum_of_x_squared / ctx->window_len));
 
     *angular_coef = temp/temp2;
-    *linear_coef = ((sum_of_y/BUFFER_SIZE) - (*angular_coef*(sum_of_x/BUFFER_SIZE)));
+    *linear_coef = ((sum_of_y/ctx->window_len) - (*angular_coef*(sum_of_x/ctx->window_len)));
 }
 
-double correlation_datay_datax(int32_t *data_red, int32_t *data_ir)
+double correlation_datay_datax(const ppg_context_t *ctx, int32_t *data_red, int32_t *data_ir)
 {
     double correlation = 0;
     double x_mean = 0;
@@ -205,33 +847,33 @@ double correlation_datay_datax(int32_t *data_red, int32_t *data_ir)
     double sx = 0; 
     double sy = 0; 
 
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         sum_of_x += data_red[i];
         sum_of_y += data_ir[i];
     }
-    x_mean = sum_of_x / BUFFER_SIZE;
-    y_mean = sum_of_y / BUFFER_SIZE;
+    x_mean = sum_of_x / ctx->window_len;
+    y_mean = sum_of_y / ctx->window_len;
 
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         sum_of_x_minus_xmean2 += ((data_red[i] - x_mean)*(data_red[i] - x_mean));
         sum_of_y_minus_ymean2 += ((data_ir[i] - y_mean)*(data_ir[i] - y_mean));
         covar_xy += ((data_red[i] - x_mean)*(data_ir[i] - y_mean));
     }
-    sx = sqrt(sum_of_x_minus_xmean2 / (BUFFER_SIZE)); 
-    sy = sqrt(sum_of_y_minus_ymean2 / (BUFFER_SIZE)); 
-    covar_xy = (covar_xy / (BUFFER_SIZE));
+    sx = sqrt(sum_of_x_minus_xmean2 / ctx->window_len); 
+    sy = sqrt(sum_of_y_minus_ymean2 / ctx->window_len); 
+    covar_xy = (covar_xy / ctx->window_len);
 
     correlation = (covar_xy / (sx * sy));
 
     return correlation;
 }
 
-double spo2_measurement(int32_t *ir_data, int32_t *red_data, uint64_t ir_mean, uint64_t red_mean)
+double spo2_measurement(const ppg_context_t *ctx, int32_t *ir_data, int32_t *red_data, uint64_t ir_mean, uint64_t red_mean)
 {
     double Z = 0;
     double SpO2;
-    double ir_rms = rms_value(ir_data);
-    double red_rms = rms_value(red_data);
+    double ir_rms = rms_value(ctx, ir_data);
+    double red_rms = rms_value(ctx, red_data);
 
     if (ir_mean == 0 || red_mean == 0) {
         return 0.0; 
@@ -239,7 +881,7 @@ double spo2_measurement(int32_t *ir_data, int32_t *red_data, uint64_t ir_mean, u
 
     Z = (red_rms/red_mean) / (ir_rms/ir_mean); 
     
-    SpO2 = SPO2_A * Z * Z + SPO2_B * Z + SPO2_C; 
+    SpO2 = ctx->spo2_a * Z * Z + ctx->spo2_b * Z + ctx->spo2_c; 
     
     if (SpO2 > 100.0) SpO2 = 100.0;
     if (SpO2 < 80.0) SpO2 = 80.0; 
@@ -247,94 +889,117 @@ double spo2_measurement(int32_t *ir_data, int32_t *red_data, uint64_t ir_mean, u
     return SpO2;
 }
 
-int calculate_heart_rate(int32_t *ir_data, double *r0, double *auto_correlationated_data)
+/**
+ * @brief HR từ đỉnh tự tương quan, chỉ xét các độ trễ ứng với HR_SEARCH_MIN_BPM..HR_SEARCH_MAX_BPM.
+ * Nội suy parabol quanh đỉnh cho độ trễ lẻ (độ phân giải HR không còn bị lượng tử theo mẫu).
+ * @param len Số mẫu hợp lệ của cửa sổ này trong ir_data (ctx->hr_len), <= ctx->hr_window_len
+ * @return HR (bpm), 0 nếu không có đỉnh hợp lệ
+ */
+double calculate_heart_rate(ppg_context_t *ctx, int32_t *ir_data, int len, double *r0)
 {
-    double auto_correlation_result;
-    double resultado = 0;
-    
-    double auto_coorelation_0 = auto_correlation_function(ir_data, 0);
+    if (len > ctx->hr_window_len) len = ctx->hr_window_len;
+    double auto_coorelation_0 = auto_correlation_function(ctx, ir_data, len, 0);
     *r0 = auto_coorelation_0;
-    
+
+    // Khoảng độ trễ theo giới hạn sinh lý, chừa 1 mẫu hai bên cho nội suy (chỉ trong phần đã có mẫu)
+    int lag_min = (int)floor(60.0 / (HR_SEARCH_MAX_BPM * ctx->hr_period_s));
+    int lag_max = (int)ceil(60.0 / (HR_SEARCH_MIN_BPM * ctx->hr_period_s));
+    if (lag_min < 1) lag_min = 1;
+    if (lag_max > len - 2) lag_max = len - 2;
+
+    memset(ctx->auto_correlationated_data, 0, ctx->hr_window_len * sizeof(double));
+    ctx->auto_correlationated_data[0] = 1.0;
+    if (auto_coorelation_0 <= 0.0 || lag_max <= lag_min) {
+        return 0;
+    }
+
     double biggest_value = 0;
     int biggest_value_index = 0;
-    double division;
-
-    for(int i = 0; i < 125; i++){
-        auto_correlation_result = auto_correlation_function(ir_data, i);
-        division = auto_correlation_result / auto_coorelation_0;
-        auto_correlationated_data[i] = division;
-
-        if(i > 10){ 
-            if(division > MINIMUM_RATIO){
-                if(biggest_value < division){
-                    biggest_value = division;
-                    biggest_value_index = i;
-                }
-            }
+
+    for(int i = lag_min - 1; i <= lag_max + 1; i++){
+        double division = auto_correlation_function(ctx, ir_data, len, i) / auto_coorelation_0;
+        ctx->auto_correlationated_data[i] = division;
+
+        if(i >= lag_min && i <= lag_max && division > ctx->min_autocorr_ratio && biggest_value < division){
+            biggest_value = division;
+            biggest_value_index = i;
         }
     }
-    
-    if (biggest_value_index > 0) {
-        resultado = ((1 / (biggest_value_index * (DELAY_AMOSTRAGEM / 1000.0))) * 60);
+
+    if (biggest_value_index == 0) {
+        return 0;
     }
-    
-    if (resultado > 200 || resultado < 40) {
+
+    double lag = biggest_value_index;
+    double r_prev = ctx->auto_correlationated_data[biggest_value_index - 1];
+    double r_next = ctx->auto_correlationated_data[biggest_value_index + 1];
+    double denom = r_prev - 2.0 * biggest_value + r_next;
+    // Chỉ nội suy khi là cực đại địa phương (đỉnh ở biên khoảng tìm thì giữ độ trễ nguyên)
+    if (denom < 0.0 && biggest_value >= r_prev && biggest_value >= r_next) {
+        lag += 0.5 * (r_prev - r_next) / denom;
+    }
+
+    double resultado = 60.0 / (lag * ctx->hr_period_s);
+    if (resultado > HR_SEARCH_MAX_BPM || resultado < HR_SEARCH_MIN_BPM) {
         return 0; 
     }
 
-    return (int)resultado; 
+    return resultado; 
 }
 
-double auto_correlation_function(int32_t *data, int32_t lag)
+double auto_correlation_function(const ppg_context_t *ctx, int32_t *data, int len, int32_t lag)
 {
     double soma = 0;
     double resultado = 0;
-    for(int i = 0; i < (BUFFER_SIZE - lag); i++){
+    if (len <= 0) {
+        return 0;
+    }
+    for(int i = 0; i < (len - lag); i++){
         soma += ((data[i]) * (data[i + lag]));
     }
-    resultado = soma / BUFFER_SIZE;
+    resultado = soma / len;
     return resultado;
 }
 
-int64_t sum_of_elements(int32_t *data)
+int64_t sum_of_elements(const ppg_context_t *ctx, int32_t *data)
 {
     int64_t sum = 0;
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         sum += data[i];
     }
     return sum;
 }
 
-double sum_of_xy_elements(int32_t *data)
+double sum_of_xy_elements(const ppg_context_t *ctx, int32_t *data)
 {
     double sum_xy = 0;
     double time = 0;
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         sum_xy += (data[i] * time);
-        time += DELAY_AMOSTRAGEM / 1000.0;
+        time += ctx->sample_period_s;
     }
     return sum_xy;
 }
 
-double sum_of_squared_elements(int32_t *data)
+double sum_of_squared_elements(const ppg_context_t *ctx, int32_t *data)
 {
     double sum_squared = 0;
     int time = 0;
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         sum_squared += (data[i] * data[i]);
-        time += DELAY_AMOSTRAGEM / 1000.0;
+        time += ctx->sample_period_s;
     }
     return sum_squared;
 }
 
-double somatoria_x2()
+double somatoria_x2(const ppg_context_t *ctx)
 {
-    float incremento = (DELAY_AMOSTRAGEM / 1000.0);
+    float incremento = ctx->sample_period_s;
     double resultado = 0.0;
     double squared_values = 0;
     float temp = 0;
 
-    for(int i = 0; i < BUFFER_SIZE; i++){
+    for(int i = 0; i < ctx->window_len; i++){
         squared_values = temp * temp;
         temp += incremento;
         resultado += squared_values;
@@ -342,13 +1007,13 @@ double somatoria_x2()
     return resultado;
 }
 
-double rms_value(int32_t *data)
+double rms_value(const ppg_context_t *ctx, int32_t *data)
 {
     double result = 0;
     int32_t somatoria = 0;
-    for(int i = 0; i <BUFFER_SIZE; i++){
+    for(int i = 0; i <ctx->window_len; i++){
         somatoria += (data[i] * data[i]);
     }
-    result = sqrt(somatoria / BUFFER_SIZE);
+    result = sqrt(somatoria / ctx->window_len);
     return result;
 }
\ No newline at end of file
@@ -7,35 +7,289 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h> // Cần cho size_t
+#include <stdbool.h>
 
-void remove_dc_part(int32_t *ir_buffer, int32_t *red_buffer, uint64_t *ir_mean, uint64_t *red_mean);
-void calculate_linear_regression(double *angular_coef, double *linear_coef, int32_t *data);
-double correlation_datay_datax(int32_t *data_red, int32_t *data_ir);
-double calculate_pearson_r(int32_t *data_red, int32_t *data_ir);
-void remove_trend_line(int32_t *buffer);
+#define BUFFER_SIZE 512          // Dung lượng tối đa của một cửa sổ (mẫu); độ dài thực tế theo profile
+
+// Toàn bộ trạng thái và bộ đệm của một kênh PPG (định nghĩa ở cuối file)
+typedef struct ppg_context ppg_context_t;
+
+void remove_dc_part(const ppg_context_t *ctx, int32_t *ir_buffer, int32_t *red_buffer, uint64_t *ir_mean, uint64_t *red_mean);
+void calculate_linear_regression(const ppg_context_t *ctx, double *angular_coef, double *linear_coef, int32_t *data);
+double correlation_datay_datax(const ppg_context_t *ctx, int32_t *data_red, int32_t *data_ir);
+void remove_trend_line(const ppg_context_t *ctx, int32_t *buffer);
 
 // Para calcular a regressão linear.
-double sum_of_xy_elements(int32_t *data);
-int64_t sum_of_elements(int32_t *data);
-double sum_of_squared_elements(int32_t *data);
-double somatoria_x2() __attribute__ ((optimize(2)));
-void init_time_array();
-int calculate_heart_rate(int32_t *ir_data, double *r0, double *auto_correlationated_data);
-double spo2_measurement(int32_t *ir_data, int32_t *red_data, uint64_t ir_mean, uint64_t red_mean);
-double rms_value(int32_t *data);
-double auto_correlation_function(int32_t *data, int32_t lag);
+double sum_of_xy_elements(const ppg_context_t *ctx, int32_t *data);
+int64_t sum_of_elements(const ppg_context_t *ctx, int32_t *data);
+double sum_of_squared_elements(const ppg_context_t *ctx, int32_t *data);
+double somatoria_x2(const ppg_context_t *ctx) __attribute__ ((optimize(2)));
+void init_time_array(ppg_context_t *ctx);
+double calculate_heart_rate(ppg_context_t *ctx, int32_t *ir_data, int len, double *r0);
+double spo2_measurement(const ppg_context_t *ctx, int32_t *ir_data, int32_t *red_data, uint64_t ir_mean, uint64_t red_mean);
+double rms_value(const ppg_context_t *ctx, int32_t *data);
+double auto_correlation_function(const ppg_context_t *ctx, int32_t *data, int len, int32_t lag);
+
+
+// =========================================================
+// PHÁT HIỆN NHỊP THEO TỪNG MẪU VỚI MỐC THỜI GIAN DƯỚI CHU KỲ LẤY MẪU
+// =========================================================
+#define BEAT_QUEUE_SIZE 16
+#define BEAT_HISTORY_SIZE 32          // Số RR-Interval gần nhất dùng cho HR/HRV
+#define BEAT_HR_AVERAGE 8             // Số RR dùng để tính HR
+#define BEAT_REFRACTORY_MS 300        // Khoảng cách tối thiểu giữa 2 nhịp (200 bpm)
+#define BEAT_MIN_RR_MS 300.0f
+#define BEAT_MAX_RR_MS 1500.0f        // 40 bpm
+#define BEAT_THRESHOLD_RATIO 0.5f     // Vị trí ngưỡng giữa mức nhiễu và mức đỉnh
+
+typedef struct {
+    uint32_t time_us;    // Thời điểm đỉnh (đã nội suy), bộ đếm us quay vòng
+    float amplitude;     // Biên độ đỉnh (đã nội suy)
+    float rr_ms;         // RR tới nhịp trước, 0 nếu không hợp lệ
+} beat_event_t;
+
+typedef struct {
+    // 3 mẫu gần nhất để tìm cực đại và nội suy
+    float x0, x1;
+    uint32_t t0, t1;
+    uint32_t samples_seen;
+
+    // Ngưỡng thích nghi
+    float peak_level;
+    float noise_level;
+    uint32_t last_beat_us;
+    uint32_t beat_count;
+
+    // Hàng đợi sự kiện nhịp
+    beat_event_t queue[BEAT_QUEUE_SIZE];
+    int queue_head;
+    int queue_tail;
+    int queue_count;
+    uint32_t dropped_events;
+
+    // Lịch sử RR-Interval (vòng)
+    float rr_history[BEAT_HISTORY_SIZE];
+    int rr_pos;
+    int rr_count;
+} beat_detector_t;
+
+void beat_detector_init(beat_detector_t *detector);
+void beat_detector_rescale(beat_detector_t *detector, float gain_ratio);
+bool beat_detector_process(beat_detector_t *detector, int32_t sample, uint32_t timestamp_ms);
+bool beat_detector_pop(beat_detector_t *detector, beat_event_t *event);
+int beat_detector_rr_intervals(const beat_detector_t *detector, float *rr_ms, int max_count);
+float beat_detector_heart_rate(const beat_detector_t *detector);
+// RMSSD (ms) tính từ lịch sử RR thay vì quét lại dữ liệu thô
+float beat_detector_rmssd(const beat_detector_t *detector);
+
+// Đặc trưng chuyển động của một cửa sổ (đơn vị g)
+typedef struct {
+    float peak_g;    // Độ lớn gia tốc lớn nhất
+    float mean_g;    // Độ lớn gia tốc trung bình
+    float energy;    // Năng lượng chuyển động: phương sai của độ lớn (g^2)
+} motion_features_t;
+
+void compute_motion_features(const float *ax, const float *ay, const float *az, int count, motion_features_t *features);
+
+// Nội suy tuyến tính chuỗi (src_t, src_v) tại các mốc thời gian dst_t (cả hai tăng dần)
+void align_to_timestamps(const uint32_t *src_t, const float *src_v, int src_count,
+                         const uint32_t *dst_t, float *dst_v, int dst_count);
+
+// =========================================================
+// LỌC THÔNG DẢI IIR THEO TỪNG MẪU (HPF + LPF BUTTERWORTH BẬC 2 NỐI TẦNG)
+// =========================================================
+#define BANDPASS_SECTIONS 2
+#define BANDPASS_LOW_HZ 0.5f      // Loại trôi nền do hô hấp
+#define BANDPASS_HIGH_HZ 4.0f     // 240 bpm, loại nhiễu tần số cao
+#define BIQUAD_Q30_SHIFT 30       // Hệ số fixed-point dạng Q2.30
+
+// Biquad float, dạng Direct Form II Transposed
+typedef struct {
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+} biquad_f32_t;
+
+// Biquad fixed-point, dạng Direct Form I (hệ số Q30, tích lũy 64 bit)
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;
+    int32_t x1, x2, y1, y2;
+} biquad_q30_t;
 
+typedef struct {
+    biquad_f32_t section[BANDPASS_SECTIONS];
+} bandpass_f32_t;
 
-// Hàm tính RMSSD (cần chuỗi RR Intervals, không phải dữ liệu thô)
-// Tạm thời để hàm này nhận dữ liệu thô (để phù hợp với cấu trúc fill_buffers_data)
-float calculate_hrv_rmssd(int32_t *ir_data, size_t buffer_size);
+typedef struct {
+    biquad_q30_t section[BANDPASS_SECTIONS];
+} bandpass_q30_t;
+
+void bandpass_init_f32(bandpass_f32_t *filter, float fs_hz, float low_hz, float high_hz);
+void bandpass_reset_f32(bandpass_f32_t *filter, float x0);
+float bandpass_process_f32(bandpass_f32_t *filter, float x);
+void bandpass_init_q30(bandpass_q30_t *filter, float fs_hz, float low_hz, float high_hz);
+void bandpass_reset_q30(bandpass_q30_t *filter, int32_t x0);
+int32_t bandpass_process_q30(bandpass_q30_t *filter, int32_t x);
+
+// =========================================================
+// HẠ TỐC ĐA TỐC ĐỘ: FIR CHỐNG CHỒNG PHỔ DẠNG POLYPHASE
+// =========================================================
+#define DECIM_MAX_FACTOR 8
+#define DECIM_TAPS_PER_PHASE 8            // Số tap của mỗi nhánh pha (tổng = hệ số * 8)
+#define DECIM_CUTOFF_RATIO 0.4f           // Tần số cắt = 0.4 * tốc độ ra (80% Nyquist đầu ra)
+#define DECIM_Q15_SHIFT 15
+#define HR_TARGET_RATE_HZ 25              // Tốc độ nội bộ cho ước lượng HR bằng tự tương quan
+#define HR_SEARCH_MIN_BPM 40.0            // Giới hạn tìm đỉnh tự tương quan
+#define HR_SEARCH_MAX_BPM 200.0
+
+// Hiệu chuẩn mặc định (ghi đè lúc chạy bằng ppg_context_set_calibration)
+#define MINIMUM_RATIO 0.3                 // Đỉnh tự tương quan tối thiểu so với R(0)
+#define SPO2_A 1.5958422                  // SpO2 = A*Z^2 + B*Z + C
+#define SPO2_B -34.6596622
+#define SPO2_C 112.6898759
+
+// Nhánh p giữ các mẫu x[mM - p]; mỗi M mẫu vào mới tính một mẫu ra
+typedef struct {
+    int factor;
+    int phase;                                                  // Nhánh sẽ nhận mẫu kế tiếp
+    int head;                                                   // Vị trí mới nhất trong vòng trễ
+    int16_t coeffs[DECIM_MAX_FACTOR][DECIM_TAPS_PER_PHASE];     // h[k*M + p], Q15, tổng = 1.0
+    int32_t delay[DECIM_MAX_FACTOR][DECIM_TAPS_PER_PHASE];
+} decimator_t;
+
+void decimator_init(decimator_t *decim, int factor);
+void decimator_reset(decimator_t *decim, int32_t x0);
+bool decimator_process(decimator_t *decim, int32_t x, int32_t *y);
+float decimator_delay_samples(const decimator_t *decim);
+
+// =========================================================
+// CHỈ SỐ CHẤT LƯỢNG TÍN HIỆU (SQI) TÍNH TĂNG DẦN THEO TỪNG MẪU
+// =========================================================
+#define SQI_ADC_FULL_SCALE 262143        // ADC 18 bit
+#define SQI_FINGER_DC_MIN 50000          // DC IR tối thiểu khi có ngón tay
+#define SQI_CLIP_LEVEL (SQI_ADC_FULL_SCALE - 1024)
+#define SQI_MAX_CLIPPED_PERCENT 1.0f     // % mẫu bão hòa cho phép
+#define SQI_DC_MAX_FRACTION 0.95f        // DC quá gần đỉnh thang đo
+#define SQI_PI_MIN 0.05f                 // Perfusion index tối thiểu (%)
+#define SQI_PI_MAX 20.0f                 // PI quá lớn: nhiễu chuyển động
+#define SQI_KURTOSIS_MAX 6.0f            // Xung nhọn/artifact làm kurtosis tăng cao
+#define SQI_ZC_RATE_MIN_HZ 0.5f          // 30 bpm
+#define SQI_ZC_RATE_MAX_HZ 7.0f          // 210 bpm, tối đa 2 lần cắt/nhịp (khấc dicrotic)
+#define SQI_ZC_CV_MAX 0.35f              // Hệ số biến thiên khoảng cắt 0 tối đa
+
+typedef enum {
+    SQI_OK = 0,
+    SQI_NO_FINGER,
+    SQI_SATURATED,
+    SQI_ADC_RANGE,
+    SQI_LOW_PERFUSION,
+    SQI_HIGH_PERFUSION,
+    SQI_KURTOSIS,
+    SQI_IRREGULAR,
+} sqi_reason_t;
+
+// Bộ tích lũy của một cửa sổ: mỗi mẫu chỉ tốn vài phép cộng/nhân
+typedef struct {
+    int count;
+    int64_t sum_ir_raw;
+    int64_t sum_red_raw;
+    int clipped;
+    double sum1, sum2, sum3, sum4;      // Mômen của IR đã lọc (cho kurtosis)
+    int32_t last_filtered;
+    int zero_crossings;                 // Số lần cắt 0 chiều lên
+    int last_crossing;                  // Chỉ số mẫu lần cắt 0 trước (-1 nếu chưa có)
+    int64_t sum_interval;
+    int64_t sum_interval_sq;
+} sqi_accumulator_t;
+
+typedef struct {
+    sqi_reason_t reason;
+    float ir_dc;
+    float red_dc;
+    float perfusion_index;              // %
+    float clipped_percent;
+    float kurtosis;
+    float zero_crossing_hz;
+    float zero_crossing_cv;
+} sqi_result_t;
+
+void sqi_reset(sqi_accumulator_t *acc);
+void sqi_update(sqi_accumulator_t *acc, int32_t ir_raw, int32_t red_raw, int32_t ir_filtered);
+sqi_reason_t sqi_evaluate(const sqi_accumulator_t *acc, float sample_rate_hz, sqi_result_t *result);
+const char *sqi_reason_str(sqi_reason_t reason);
+
+// =========================================================
+// KHỬ NHIỄU CHUYỂN ĐỘNG (NLMS THÍCH NGHI, THAM CHIẾU LÀ GIA TỐC 3 TRỤC)
+// =========================================================
+#define NLMS_AXES 3
+#define NLMS_TAPS 8               // Số tap mỗi trục (8 x 40 ms = 320 ms)
+#define NLMS_DEFAULT_MU 0.05f     // Bước thích nghi (đã chuẩn hóa, 0 < mu < 2)
+#define NLMS_EPSILON 1e-4f        // Chống chia cho 0 khi không có chuyển động (g^2)
+
+// Trạng thái bộ lọc được giữ qua các cửa sổ để trọng số tiếp tục hội tụ
+typedef struct {
+    float weights[NLMS_AXES][NLMS_TAPS];
+    float delay[NLMS_AXES][NLMS_TAPS];   // Đường trễ vòng của tín hiệu tham chiếu
+    int pos;
+    float power;                         // Tổng bình phương trong đường trễ (cập nhật tăng dần)
+    float mu;
+} nlms_filter_t;
+
+void nlms_init(nlms_filter_t *filter, float mu);
+void nlms_rescale(nlms_filter_t *filter, float gain_ratio);
+float nlms_process_sample(nlms_filter_t *filter, const float reference[NLMS_AXES], float desired);
+void cancel_motion_artifacts(nlms_filter_t *filter, int32_t *ppg_data,
+                             const float *ax, const float *ay, const float *az, int count);
 
 // Hàm dự đoán trạng thái Stress/Relax (giả định dùng 3 tham số)
 void predict_stress(int hr, double spo2, float hrv, char *output_status);
 
+// =========================================================
+// NGỮ CẢNH XỬ LÝ MỘT KÊNH PPG (KHÔNG CẤP PHÁT ĐỘNG, KÍCH THƯỚC CỐ ĐỊNH KHI BIÊN DỊCH)
+// =========================================================
+// Mỗi cảm biến/kênh dùng một ngữ cảnh riêng (cấp phát tĩnh): các hàm chỉ đọc/ghi ngữ cảnh
+// được truyền vào nên có thể xử lý song song nhiều kênh.
+struct ppg_context {
+    // Cấu hình (ppg_context_init)
+    float sample_rate_hz;
+    double sample_period_s;
+    int window_len;
+    double hr_period_s;                 // Cửa sổ tốc độ thấp cho calculate_heart_rate
+    int hr_window_len;
+    double spo2_a, spo2_b, spo2_c;      // Hệ số đường cong SpO2
+    double min_autocorr_ratio;
+
+    // Trạng thái theo từng mẫu, giữ qua các cửa sổ
+    decimator_t decim_fifo_red;         // FIFO -> tốc độ xử lý
+    decimator_t decim_fifo_ir;
+    decimator_t decim_hr;               // Tốc độ xử lý -> ~HR_TARGET_RATE_HZ
+    bandpass_q30_t bandpass_ir;
+    bandpass_q30_t bandpass_red;
+    bool bandpass_primed;               // false: nạp lại bộ lọc ở mức DC của mẫu kế tiếp
+    nlms_filter_t nlms_ir;
+    nlms_filter_t nlms_red;
+    beat_detector_t beat_detector;
+    sqi_accumulator_t sqi;
+
+    // Bộ đệm cửa sổ
+    int32_t red_raw[BUFFER_SIZE];       // Mẫu thô (giữ DC cho SpO2)
+    int32_t ir_raw[BUFFER_SIZE];
+    int32_t red_data[BUFFER_SIZE];      // Đã lọc thông dải / khử chuyển động
+    int32_t ir_data[BUFFER_SIZE];
+    uint32_t time_ms[BUFFER_SIZE];      // Mốc thời gian từng mẫu
+    int32_t hr_data[BUFFER_SIZE];       // IR đã hạ tốc cho tự tương quan
+    int hr_len;
+
+    // Vùng nháp
+    double time_array[BUFFER_SIZE];
+    double auto_correlationated_data[BUFFER_SIZE];
+};
 
-#define BUFFER_SIZE 128
-#define DELAY_AMOSTRAGEM 40
+void ppg_context_init(ppg_context_t *ctx, float sample_rate_hz, int window_length,
+                      int fifo_decimation, int hr_decimation);
+void ppg_context_set_calibration(ppg_context_t *ctx, double spo2_a, double spo2_b, double spo2_c,
+                                 double min_autocorr_ratio);
+void ppg_store_sample(ppg_context_t *ctx, int i, int32_t red, int32_t ir, uint32_t t_ms);
+int ppg_decimate_hr_window(ppg_context_t *ctx);
 
 
 #endif
\ No newline at end of file
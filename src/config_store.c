@@ -0,0 +1,206 @@
+#include "config_store.h"
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include "algorithm.h"
+#include "max30102_api.h"
+
+static const char *TAG_CFG = "CFG";
+
+typedef enum {
+    CFG_TYPE_U8,
+    CFG_TYPE_FLOAT,     // Lưu trong NVS dưới dạng u32 (mẫu bit IEEE-754)
+} config_type_t;
+
+typedef struct {
+    const char *key;    // Khóa NVS (tối đa 15 ký tự)
+    config_type_t type;
+    size_t offset;      // Vị trí trong app_config_t
+    float min;
+    float max;
+    float def;
+} config_param_t;
+
+#define CFG_FIELD(field) offsetof(app_config_t, field)
+
+static const config_param_t config_params[CFG_PARAM_COUNT] = {
+    [CFG_ACCEL_THRESHOLD_G]  = { "accel_thr",   CFG_TYPE_FLOAT, CFG_FIELD(accel_threshold_g),  1.0f, 4.0f,    ACCEL_THRESHOLD_MOTION },
+    [CFG_MIN_CORRELATION]    = { "min_corr",    CFG_TYPE_FLOAT, CFG_FIELD(min_correlation),    0.0f, 1.0f,    PEARSON_MIN_CORRELATION },
+    [CFG_HR_BASE_BPM]        = { "hr_base",     CFG_TYPE_U8,    CFG_FIELD(hr_base_bpm),        30,   100,     HR_BASE_BPM },
+    [CFG_SPO2_A]             = { "spo2_a",      CFG_TYPE_FLOAT, CFG_FIELD(spo2_a),             -100, 100,     SPO2_A },
+    [CFG_SPO2_B]             = { "spo2_b",      CFG_TYPE_FLOAT, CFG_FIELD(spo2_b),             -200, 200,     SPO2_B },
+    [CFG_SPO2_C]             = { "spo2_c",      CFG_TYPE_FLOAT, CFG_FIELD(spo2_c),             0,    200,     SPO2_C },
+    [CFG_MIN_AUTOCORR_RATIO] = { "min_ac_ratio",CFG_TYPE_FLOAT, CFG_FIELD(min_autocorr_ratio), 0.0f, 1.0f,    MINIMUM_RATIO },
+    [CFG_LED1_PA]            = { "led1_pa",     CFG_TYPE_U8,    CFG_FIELD(led1_pa),            AGC_PA_MIN, AGC_PA_MAX, LED_PA_DEFAULT },
+    [CFG_LED2_PA]            = { "led2_pa",     CFG_TYPE_U8,    CFG_FIELD(led2_pa),            AGC_PA_MIN, AGC_PA_MAX, LED_PA_DEFAULT },
+    [CFG_ACQ_PROFILE]        = { "acq_profile", CFG_TYPE_U8,    CFG_FIELD(acq_profile),        0, MAX30102_PROFILE_COUNT - 1, PPG_ACQ_PROFILE_DEFAULT },
+};
+
+// Seqlock: số lẻ = đang ghi. Phiên bản cấu hình = cfg_seq / 2
+static app_config_t cfg_data;
+static uint32_t cfg_seq = 0;
+static SemaphoreHandle_t cfg_write_mutex;
+
+
+static void field_store(app_config_t *cfg, const config_param_t *param, float value)
+{
+    uint8_t *field = (uint8_t *)cfg + param->offset;
+    if (param->type == CFG_TYPE_U8) {
+        *field = (uint8_t)lrintf(value);
+    } else {
+        memcpy(field, &value, sizeof(float));
+    }
+}
+
+static float field_load(const app_config_t *cfg, const config_param_t *param)
+{
+    const uint8_t *field = (const uint8_t *)cfg + param->offset;
+    if (param->type == CFG_TYPE_U8) {
+        return *field;
+    }
+    float value;
+    memcpy(&value, field, sizeof(float));
+    return value;
+}
+
+static bool value_in_range(const config_param_t *param, float value)
+{
+    return isfinite(value) && value >= param->min && value <= param->max;
+}
+
+static esp_err_t nvs_load_param(nvs_handle_t nvs, const config_param_t *param, float *value)
+{
+    if (param->type == CFG_TYPE_U8) {
+        uint8_t v;
+        esp_err_t ret = nvs_get_u8(nvs, param->key, &v);
+        if (ret == ESP_OK) *value = v;
+        return ret;
+    }
+    uint32_t bits;
+    esp_err_t ret = nvs_get_u32(nvs, param->key, &bits);
+    if (ret == ESP_OK) memcpy(value, &bits, sizeof(float));
+    return ret;
+}
+
+static esp_err_t nvs_save_param(const config_param_t *param, float value)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (param->type == CFG_TYPE_U8) {
+        ret = nvs_set_u8(nvs, param->key, (uint8_t)lrintf(value));
+    } else {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        ret = nvs_set_u32(nvs, param->key, bits);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+/**
+ * @brief Nạp giá trị mặc định rồi ghi đè bằng các khóa có trong NVS (giá trị ngoài giới hạn bị bỏ qua).
+ * Gọi sau nvs_flash_init() và trước khi tạo các task đọc cấu hình.
+ */
+esp_err_t config_store_init(void)
+{
+    cfg_write_mutex = xSemaphoreCreateMutex();
+    if (cfg_write_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < CFG_PARAM_COUNT; i++) {
+        field_store(&cfg_data, &config_params[i], config_params[i].def);
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(CONFIG_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return ESP_OK;      // Namespace chưa có: dùng toàn bộ mặc định
+    }
+    int overridden = 0;
+    for (int i = 0; i < CFG_PARAM_COUNT; i++) {
+        const config_param_t *param = &config_params[i];
+        float value;
+        if (nvs_load_param(nvs, param, &value) != ESP_OK) {
+            continue;
+        }
+        if (!value_in_range(param, value)) {
+            ESP_LOGW(TAG_CFG, "%s = %g out of range, using default", param->key, value);
+            continue;
+        }
+        field_store(&cfg_data, param, value);
+        overridden++;
+    }
+    nvs_close(nvs);
+    ESP_LOGI(TAG_CFG, "Loaded %d/%d parameters from NVS", overridden, CFG_PARAM_COUNT);
+    return ESP_OK;
+}
+
+/**
+ * @brief Chép ảnh chụp nhất quán của cấu hình (không khóa, thử lại nếu trùng lúc đang ghi).
+ * @return Phiên bản của ảnh chụp; so sánh với lần trước để biết cấu hình đã đổi
+ */
+uint32_t config_snapshot(app_config_t *out)
+{
+    uint32_t seq_begin, seq_end;
+    do {
+        seq_begin = __atomic_load_n(&cfg_seq, __ATOMIC_ACQUIRE);
+        memcpy(out, &cfg_data, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq_end = __atomic_load_n(&cfg_seq, __ATOMIC_RELAXED);
+    } while ((seq_begin & 1) || seq_begin != seq_end);
+    return seq_begin / 2;
+}
+
+uint32_t config_version(void)
+{
+    return __atomic_load_n(&cfg_seq, __ATOMIC_ACQUIRE) / 2;
+}
+
+config_status_t config_set(config_param_id_t id, float value, bool persist)
+{
+    if (id >= CFG_PARAM_COUNT) {
+        return CFG_STATUS_UNKNOWN_KEY;
+    }
+    const config_param_t *param = &config_params[id];
+    if (!value_in_range(param, value)) {
+        return CFG_STATUS_OUT_OF_RANGE;
+    }
+
+    xSemaphoreTake(cfg_write_mutex, portMAX_DELAY);
+    __atomic_fetch_add(&cfg_seq, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    field_store(&cfg_data, param, value);
+    __atomic_fetch_add(&cfg_seq, 1, __ATOMIC_RELEASE);
+    xSemaphoreGive(cfg_write_mutex);
+
+    ESP_LOGI(TAG_CFG, "%s = %g (v%u)%s", param->key, value, (unsigned)config_version(), persist ? ", saved" : "");
+    if (persist && nvs_save_param(param, value) != ESP_OK) {
+        return CFG_STATUS_NVS_ERROR;
+    }
+    return CFG_STATUS_OK;
+}
+
+config_status_t config_get(config_param_id_t id, float *value)
+{
+    if (id >= CFG_PARAM_COUNT) {
+        return CFG_STATUS_UNKNOWN_KEY;
+    }
+    app_config_t snapshot;
+    config_snapshot(&snapshot);
+    *value = field_load(&snapshot, &config_params[id]);
+    return CFG_STATUS_OK;
+}
+
+const char *config_param_name(config_param_id_t id)
+{
+    return (id < CFG_PARAM_COUNT) ? config_params[id].key : "?";
+}
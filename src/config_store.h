@@ -0,0 +1,75 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "max30102_api.h"
+
+// =========================================================
+// CẤU HÌNH CHẠY (NVS) VỚI ẢNH CHỤP CÓ PHIÊN BẢN
+// =========================================================
+// - Mỗi tham số có khóa NVS, kiểu, giới hạn và giá trị mặc định (bảng trong config_store.c)
+// - Nạp từ NVS (namespace "ppg") lúc khởi động, sửa được qua telemetry (TLM_MSG_CONFIG_SET)
+// - Ghi dùng seqlock: task DSP chép một ảnh chụp nhất quán mỗi cửa sổ bằng config_snapshot(),
+//   không khóa, rồi đọc bản sao cục bộ trong suốt cửa sổ
+
+#define CONFIG_NVS_NAMESPACE "ppg"
+
+// Giá trị mặc định (khi NVS chưa có khóa tương ứng)
+#define ACCEL_THRESHOLD_MOTION 1.5f
+#define PEARSON_MIN_CORRELATION 0.7f
+#define HR_BASE_BPM 50                // HR tối thiểu cho scaling biểu đồ
+#define LED_PA_DEFAULT 0x24           // 7.2 mA
+
+// Profile thu mẫu (max30102_profile_id_t); có thể ghi đè bằng khóa NVS "ppg/acq_profile"
+#ifdef CONFIG_PPG_ACQ_PROFILE
+#define PPG_ACQ_PROFILE_DEFAULT CONFIG_PPG_ACQ_PROFILE
+#else
+#define PPG_ACQ_PROFILE_DEFAULT MAX30102_PROFILE_STANDARD
+#endif
+
+typedef enum {
+    CFG_ACCEL_THRESHOLD_G = 0,      // Ngưỡng gia tốc coi là đang chuyển động (g)
+    CFG_MIN_CORRELATION,            // Tương quan Pearson tối thiểu để nhận kết quả
+    CFG_HR_BASE_BPM,                // Đáy thang biểu đồ / lịch sử HR
+    CFG_SPO2_A,                     // SpO2 = A*Z^2 + B*Z + C
+    CFG_SPO2_B,
+    CFG_SPO2_C,
+    CFG_MIN_AUTOCORR_RATIO,         // Đỉnh tự tương quan tối thiểu (so với R(0)) cho HR
+    CFG_LED1_PA,                    // Dòng LED đỏ ban đầu (AGC điều chỉnh tiếp)
+    CFG_LED2_PA,                    // Dòng LED IR ban đầu
+    CFG_ACQ_PROFILE,                // max30102_profile_id_t, có hiệu lực sau khi khởi động lại
+    CFG_PARAM_COUNT
+} config_param_id_t;
+
+typedef struct {
+    float accel_threshold_g;
+    float min_correlation;
+    float spo2_a;
+    float spo2_b;
+    float spo2_c;
+    float min_autocorr_ratio;
+    uint8_t hr_base_bpm;
+    uint8_t led1_pa;
+    uint8_t led2_pa;
+    uint8_t acq_profile;
+} app_config_t;
+
+typedef enum {
+    CFG_STATUS_OK = 0,
+    CFG_STATUS_UNKNOWN_KEY = 1,
+    CFG_STATUS_OUT_OF_RANGE = 2,
+    CFG_STATUS_NVS_ERROR = 3,
+} config_status_t;
+
+esp_err_t config_store_init(void);
+uint32_t config_snapshot(app_config_t *out);
+uint32_t config_version(void);
+config_status_t config_set(config_param_id_t id, float value, bool persist);
+config_status_t config_get(config_param_id_t id, float *value);
+const char *config_param_name(config_param_id_t id);
+
+#endif
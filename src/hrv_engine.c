@@ -0,0 +1,243 @@
+#include "hrv_engine.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define HRV_GAP_MAX_UNITS (HRV_RR_GAP - 1)
+
+// Hiệu RR liên tiếp có hợp lệ không (không gián đoạn, không phải artifact)
+static bool diff_is_valid(uint16_t prev, uint16_t curr)
+{
+    if (HRV_RR_IS_GAP(prev) || HRV_RR_IS_GAP(curr)) {
+        return false;
+    }
+    int diff = (int)curr - (int)prev;
+    return (float)abs(diff) <= (float)prev * HRV_ARTIFACT_RATIO;
+}
+
+static bool diff_is_nn50(uint16_t prev, uint16_t curr)
+{
+    return abs((int)curr - (int)prev) > HRV_PNN50_THRESHOLD_MS * HRV_RR_UNITS_PER_MS;
+}
+
+// Cộng (sign = 1) hoặc trừ (sign = -1) đóng góp của một RR và hiệu với RR trước nó
+static void accumulate(hrv_store_t *store, uint16_t prev, uint16_t curr, bool has_prev, int sign)
+{
+    if (!HRV_RR_IS_GAP(curr)) {
+        store->sum_rr += sign * (int64_t)curr;
+        store->sum_rr_sq += sign * (int64_t)curr * curr;
+        store->valid_rr += sign;
+    }
+    if (has_prev && diff_is_valid(prev, curr)) {
+        int64_t diff = (int64_t)curr - prev;
+        store->sum_diff_sq += sign * diff * diff;
+        store->valid_diff += sign;
+        if (diff_is_nn50(prev, curr)) {
+            store->nn50 += sign;
+        }
+    }
+}
+
+void hrv_store_init(hrv_store_t *store)
+{
+    memset(store, 0, sizeof(*store));
+}
+
+static void store_append(hrv_store_t *store, uint16_t rr)
+{
+    if (store->count == HRV_STORE_SIZE) {
+        int oldest = (store->head - store->count + HRV_STORE_SIZE) % HRV_STORE_SIZE;
+        int second = (oldest + 1) % HRV_STORE_SIZE;
+        accumulate(store, 0, store->rr[oldest], false, -1);
+        // Hiệu giữa phần tử cũ nhất và phần tử kế tiếp cũng rời cửa sổ
+        if (diff_is_valid(store->rr[oldest], store->rr[second])) {
+            int64_t diff = (int64_t)store->rr[second] - store->rr[oldest];
+            store->sum_diff_sq -= diff * diff;
+            store->valid_diff--;
+            if (diff_is_nn50(store->rr[oldest], store->rr[second])) {
+                store->nn50--;
+            }
+        }
+        store->count--;
+    }
+
+    bool has_prev = store->count > 0;
+    uint16_t prev = has_prev ? store->rr[(store->head - 1 + HRV_STORE_SIZE) % HRV_STORE_SIZE] : 0;
+    accumulate(store, prev, rr, has_prev, 1);
+
+    store->rr[store->head] = rr;
+    store->head = (store->head + 1) % HRV_STORE_SIZE;
+    store->count++;
+}
+
+/**
+ * @brief Thêm một RR-Interval (ms) vào kho; rr_ms <= 0 đánh dấu gián đoạn chưa rõ thời lượng.
+ * Khi kho đầy, phần tử cũ nhất và hiệu của nó được trừ khỏi các tổng - chi phí O(1).
+ */
+void hrv_store_push(hrv_store_t *store, float rr_ms)
+{
+    float scaled = rr_ms * HRV_RR_UNITS_PER_MS;
+    if (rr_ms <= 0.0f || scaled >= HRV_RR_GAP) {
+        hrv_store_push_gap(store, 0.0f);
+        return;
+    }
+    store_append(store, (uint16_t)lrintf(scaled));
+}
+
+/**
+ * @brief Đánh dấu gián đoạn kéo dài gap_ms (thời gian giữa nhịp hợp lệ cuối cùng và nhịp kế tiếp),
+ * để phổ Lomb-Scargle giữ đúng trục thời gian. Các gián đoạn liên tiếp được gộp làm một.
+ */
+void hrv_store_push_gap(hrv_store_t *store, float gap_ms)
+{
+    uint32_t units = (gap_ms > 0.0f) ? (uint32_t)lrintf(gap_ms * HRV_GAP_UNITS_PER_S / 1000.0f) : 0;
+    uint16_t *last = (store->count > 0) ? &store->rr[(store->head - 1 + HRV_STORE_SIZE) % HRV_STORE_SIZE] : NULL;
+
+    if (last != NULL && HRV_RR_IS_GAP(*last)) {
+        units += *last & HRV_GAP_MAX_UNITS;
+    }
+    uint16_t gap = HRV_RR_GAP | (uint16_t)((units > HRV_GAP_MAX_UNITS) ? HRV_GAP_MAX_UNITS : units);
+    if (last != NULL && HRV_RR_IS_GAP(*last)) {
+        *last = gap;                    // Gián đoạn không tham gia các tổng: sửa tại chỗ
+    } else {
+        store_append(store, gap);
+    }
+}
+
+void hrv_store_time_domain(const hrv_store_t *store, hrv_metrics_t *metrics)
+{
+    const double unit = 1.0 / HRV_RR_UNITS_PER_MS;
+
+    metrics->rr_count = store->valid_rr;
+    metrics->mean_rr_ms = 0.0f;
+    metrics->sdnn_ms = 0.0f;
+    metrics->rmssd_ms = 0.0f;
+    metrics->pnn50 = 0.0f;
+    metrics->duration_s = store->sum_rr * unit / 1000.0;
+
+    if (store->valid_rr > 0) {
+        double mean = (double)store->sum_rr / store->valid_rr;
+        metrics->mean_rr_ms = mean * unit;
+        if (store->valid_rr > 1) {
+            double variance = ((double)store->sum_rr_sq - store->valid_rr * mean * mean) / (store->valid_rr - 1);
+            metrics->sdnn_ms = (variance > 0.0) ? sqrt(variance) * unit : 0.0f;
+        }
+    }
+    if (store->valid_diff > 0) {
+        metrics->rmssd_ms = sqrt((double)store->sum_diff_sq / store->valid_diff) * unit;
+        metrics->pnn50 = 100.0f * store->nn50 / store->valid_diff;
+    }
+}
+
+int hrv_store_snapshot(const hrv_store_t *store, uint16_t *rr_out, int max_count)
+{
+    int count = (store->count < max_count) ? store->count : max_count;
+    int start = (store->head - count + HRV_STORE_SIZE) % HRV_STORE_SIZE;
+    for (int i = 0; i < count; i++) {
+        rr_out[i] = store->rr[(start + i) % HRV_STORE_SIZE];
+    }
+    return count;
+}
+
+/**
+ * @brief Phổ Lomb-Scargle của chuỗi RR (trục thời gian = tổng RR tích lũy), tích phân
+ * công suất trên dải LF (0.04-0.15 Hz) và HF (0.15-0.4 Hz). Gián đoạn đẩy trục thời gian
+ * đi đúng thời lượng bị mất (không nối liền các đoạn), nên pha giữa các đoạn được giữ nguyên.
+ */
+bool hrv_frequency_domain(const uint16_t *rr, int count, hrv_metrics_t *metrics)
+{
+    static float t[HRV_STORE_SIZE];
+    static float y[HRV_STORE_SIZE];
+    static float sin_wt[HRV_STORE_SIZE];
+    static float cos_wt[HRV_STORE_SIZE];
+    const float unit = 1.0f / HRV_RR_UNITS_PER_MS;
+    int n = 0;
+    double time_s = 0.0;        // Trục thời gian, gồm cả gián đoạn
+    double rr_time_s = 0.0;     // Chỉ phần có RR (độ dài dữ liệu thực có)
+    double gap_s = 0.0;         // Thời lượng gián đoạn chờ cộng vào trục khi có RR kế tiếp
+    double mean = 0.0;
+
+    metrics->spectrum_valid = false;
+    metrics->lf_power = 0.0f;
+    metrics->hf_power = 0.0f;
+    metrics->lf_hf_ratio = 0.0f;
+
+    for (int i = 0; i < count && n < HRV_STORE_SIZE; i++) {
+        if (HRV_RR_IS_GAP(rr[i])) {
+            // Gián đoạn ở đầu chuỗi không làm lệch trục; ở cuối chuỗi không kéo dài thời lượng
+            if (n > 0) {
+                gap_s += (double)(rr[i] & HRV_GAP_MAX_UNITS) / HRV_GAP_UNITS_PER_S;
+            }
+            continue;
+        }
+        float rr_ms = rr[i] * unit;
+        time_s += gap_s + rr_ms / 1000.0;
+        rr_time_s += rr_ms / 1000.0;
+        gap_s = 0.0;
+        t[n] = time_s;
+        y[n] = rr_ms;
+        mean += rr_ms;
+        n++;
+    }
+    if (n < 16 || rr_time_s < HRV_MIN_SPECTRUM_SECONDS) {
+        return false;
+    }
+    mean /= n;
+
+    double variance = 0.0;
+    for (int i = 0; i < n; i++) {
+        y[i] -= mean;
+        variance += (double)y[i] * y[i];
+    }
+    variance /= (n - 1);
+    if (variance <= 0.0) {
+        return false;
+    }
+
+    // Bước tần số theo độ phân giải 1/T (quá lấy mẫu HRV_OVERSAMPLE lần) để tích phân đúng đỉnh hẹp
+    double step = 1.0 / (HRV_OVERSAMPLE * time_s);
+    double lf = 0.0;
+    double hf = 0.0;
+    for (double f = HRV_LF_LOW_HZ; f < HRV_HF_HIGH_HZ; f += step) {
+        float w = 2.0f * (float)M_PI * (float)f;
+
+        // sin/cos(w t) tính một lần mỗi điểm; 2wt và w(t - tau) suy ra bằng công thức góc
+        float sum_sin2 = 0.0f, sum_cos2 = 0.0f;
+        for (int i = 0; i < n; i++) {
+            sin_wt[i] = sinf(w * t[i]);
+            cos_wt[i] = cosf(w * t[i]);
+            sum_sin2 += 2.0f * sin_wt[i] * cos_wt[i];
+            sum_cos2 += cos_wt[i] * cos_wt[i] - sin_wt[i] * sin_wt[i];
+        }
+        // Độ lệch thời gian tau làm trực giao các thành phần sin/cos
+        float w_tau = 0.5f * atan2f(sum_sin2, sum_cos2);
+        float cos_tau = cosf(w_tau);
+        float sin_tau = sinf(w_tau);
+
+        float yc = 0.0f, ys = 0.0f, cc = 0.0f, ss = 0.0f;
+        for (int i = 0; i < n; i++) {
+            float c = cos_wt[i] * cos_tau + sin_wt[i] * sin_tau;
+            float s = sin_wt[i] * cos_tau - cos_wt[i] * sin_tau;
+            yc += y[i] * c;
+            ys += y[i] * s;
+            cc += c * c;
+            ss += s * s;
+        }
+        double power = 0.5 * ((cc > 0.0f ? yc * yc / cc : 0.0) + (ss > 0.0f ? ys * ys / ss : 0.0));
+
+        // Chuẩn hóa thành mật độ phổ một phía (ms^2/Hz) để tích phân ra ms^2
+        // (khoảng lấy mẫu trung bình tính trên phần có dữ liệu, không gồm gián đoạn)
+        double psd = power * 2.0 * rr_time_s / n;
+        if (f < HRV_LF_HIGH_HZ) {
+            lf += psd * step;
+        } else {
+            hf += psd * step;
+        }
+    }
+
+    metrics->lf_power = lf;
+    metrics->hf_power = hf;
+    metrics->lf_hf_ratio = (hf > 0.0) ? lf / hf : 0.0f;
+    metrics->spectrum_valid = true;
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef HRV_ENGINE_H
+#define HRV_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// =========================================================
+// KHO RR-INTERVAL DÀI HẠN VÀ CHỈ SỐ HRV
+// =========================================================
+
+#define HRV_STORE_SIZE 512              // ~5-8 phút nhịp tim
+#define HRV_RR_UNITS_PER_MS 4           // Lưu RR theo đơn vị 0.25 ms trong uint16_t
+#define HRV_RR_GAP 0x8000               // Bit đánh dấu gián đoạn; 15 bit thấp = thời lượng bị mất
+#define HRV_GAP_UNITS_PER_S 100         // Thời lượng gián đoạn theo đơn vị 10 ms (tối đa ~327 s)
+#define HRV_RR_IS_GAP(v) (((v) & HRV_RR_GAP) != 0)
+#define HRV_ARTIFACT_RATIO 0.2f         // Bỏ hiệu RR liên tiếp lệch > 20%
+#define HRV_PNN50_THRESHOLD_MS 50
+
+// Phổ Lomb-Scargle (chuỗi RR không đều theo thời gian)
+#define HRV_LF_LOW_HZ 0.04f
+#define HRV_LF_HIGH_HZ 0.15f
+#define HRV_HF_HIGH_HZ 0.40f
+#define HRV_OVERSAMPLE 4                // Bước tần số = 1 / (HRV_OVERSAMPLE * thời lượng)
+#define HRV_MIN_SPECTRUM_SECONDS 120.0f // Cần ít nhất 2 phút cho dải LF
+
+typedef struct {
+    uint16_t rr[HRV_STORE_SIZE];        // Vòng RR (0.25 ms) hoặc gián đoạn (HRV_RR_GAP | 10 ms)
+    int head;
+    int count;
+
+    // Tổng tích lũy cập nhật tăng dần khi thêm/bỏ phần tử
+    int64_t sum_rr;
+    int64_t sum_rr_sq;
+    int valid_rr;
+    int64_t sum_diff_sq;
+    int valid_diff;
+    int nn50;
+} hrv_store_t;
+
+typedef struct {
+    float mean_rr_ms;
+    float rmssd_ms;
+    float sdnn_ms;
+    float pnn50;            // %
+    float lf_power;         // ms^2
+    float hf_power;         // ms^2
+    float lf_hf_ratio;
+    int rr_count;
+    float duration_s;
+    bool spectrum_valid;
+} hrv_metrics_t;
+
+void hrv_store_init(hrv_store_t *store);
+void hrv_store_push(hrv_store_t *store, float rr_ms);
+void hrv_store_push_gap(hrv_store_t *store, float gap_ms);
+void hrv_store_time_domain(const hrv_store_t *store, hrv_metrics_t *metrics);
+int hrv_store_snapshot(const hrv_store_t *store, uint16_t *rr_out, int max_count);
+
+// Tính LF/HF từ bản sao chuỗi RR (chạy trong task nền)
+bool hrv_frequency_domain(const uint16_t *rr, int count, hrv_metrics_t *metrics);
+
+#endif
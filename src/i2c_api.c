@@ -2,13 +2,23 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h" 
 #include "esp_log.h"
+#include "max30102_api.h"
+#include "mpu6050_api.h"
+#include "oled_driver.h"
 
 static const char *TAG_I2C = "I2C_BUS";
 
 i2c_port_t i2c_port = I2C_NUM_0;
 
-// ĐỊNH NGHĨA HÀM ĐÃ SỬA TÊN
-esp_err_t i2c_bus_driver_install(void)
+// Bus dùng chung giữa các task đọc cảm biến, AGC, OLED và sys_monitor (có thể ở lõi khác):
+// mọi cập nhật và bản sao thống kê đều nằm trong vùng găng
+static i2c_bus_stats_t s_bus_stats = { .freq_hz = I2C_MASTER_FREQ_HZ };
+static portMUX_TYPE s_bus_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Các tốc độ thử khi probe, từ cao xuống thấp
+static const uint32_t probe_speeds[] = { 1000000, 400000 };
+
+static esp_err_t i2c_bus_configure(uint32_t freq_hz)
 {
     i2c_config_t i2c_configuration = {
             .mode             = I2C_MODE_MASTER, 
@@ -16,12 +26,31 @@ esp_err_t i2c_bus_driver_install(void)
             .sda_pullup_en    = GPIO_PULLUP_ENABLE,
             .scl_io_num       = SCL_PIN,
             .scl_pullup_en    = GPIO_PULLUP_ENABLE,
-            .master.clk_speed = I2C_MASTER_FREQ_HZ 
+            .master.clk_speed = freq_hz 
     };
     i2c_param_config(i2c_port, &i2c_configuration);
     
     // Cài đặt driver
     esp_err_t err = i2c_driver_install(i2c_port, i2c_configuration.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+    if (err == ESP_OK) {
+        portENTER_CRITICAL(&s_bus_stats_lock);
+        s_bus_stats.freq_hz = freq_hz;
+        portEXIT_CRITICAL(&s_bus_stats_lock);
+    }
+    return err;
+}
+
+static void count_probe_failure(void)
+{
+    portENTER_CRITICAL(&s_bus_stats_lock);
+    s_bus_stats.probe_failures++;
+    portEXIT_CRITICAL(&s_bus_stats_lock);
+}
+
+// ĐỊNH NGHĨA HÀM ĐÃ SỬA TÊN
+esp_err_t i2c_bus_driver_install(void)
+{
+    esp_err_t err = i2c_bus_configure(I2C_MASTER_FREQ_HZ);
     if (err == ESP_OK) {
         ESP_LOGI(TAG_I2C, "I2C Bus Driver installed successfully.");
     } else {
@@ -30,6 +59,27 @@ esp_err_t i2c_bus_driver_install(void)
     return err;
 }
 
+esp_err_t i2c_bus_cmd_begin(i2c_cmd_handle_t cmd, TickType_t ticks_to_wait)
+{
+    esp_err_t ret = i2c_master_cmd_begin(i2c_port, cmd, ticks_to_wait);
+    portENTER_CRITICAL(&s_bus_stats_lock);
+    s_bus_stats.transactions++;
+    if (ret == ESP_ERR_TIMEOUT) {
+        s_bus_stats.timeouts++;
+    } else if (ret != ESP_OK) {
+        s_bus_stats.errors++;
+    }
+    portEXIT_CRITICAL(&s_bus_stats_lock);
+    return ret;
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_bus_stats_lock);
+    *stats = s_bus_stats;
+    portEXIT_CRITICAL(&s_bus_stats_lock);
+}
+
 esp_err_t i2c_sensor_write(uint8_t *data_wr, size_t size)
 {
     i2c_cmd_handle_t cmd = i2c_cmd_link_create();
@@ -37,7 +87,7 @@ esp_err_t i2c_sensor_write(uint8_t *data_wr, size_t size)
     i2c_master_write_byte(cmd, (MAX30102_ADDR << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
     i2c_master_write(cmd, data_wr, size, ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(i2c_port, cmd, pdMS_TO_TICKS(100));
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(100));
     i2c_cmd_link_delete(cmd);
     return ret;
 }
@@ -55,7 +105,143 @@ esp_err_t i2c_sensor_read(uint8_t *data_rd, size_t size)
     }
     i2c_master_read_byte(cmd, data_rd + size - 1, NACK_VAL);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(i2c_port, cmd, pdMS_TO_TICKS(100));
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(100));
     i2c_cmd_link_delete(cmd);
     return ret;
+}
+
+esp_err_t i2c_sensor_read_reg(uint8_t reg_addr, uint8_t *data_rd, size_t size)
+{
+    return i2c_device_read_reg(MAX30102_ADDR, reg_addr, data_rd, size);
+}
+
+esp_err_t i2c_device_read_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data_rd, size_t size)
+{
+    if (size == 0) {
+        return ESP_OK;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+
+    // Bước 1: Ghi địa chỉ thanh ghi (Không STOP)
+    i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, reg_addr, ACK_CHECK_EN);
+
+    // Bước 2: RESTART và đọc dữ liệu
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_READ, ACK_CHECK_EN);
+    if (size > 1) {
+        i2c_master_read(cmd, data_rd, size - 1, ACK_VAL);
+    }
+    i2c_master_read_byte(cmd, data_rd + size - 1, NACK_VAL);
+    i2c_master_stop(cmd);
+
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(100));
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+esp_err_t i2c_device_write_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t data)
+{
+    uint8_t tx_buf[2] = {reg_addr, data};
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
+    i2c_master_write(cmd, tx_buf, 2, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(100));
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+esp_err_t i2c_device_ack(uint8_t dev_addr)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(50));
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+// =========================================================
+// PROBE TỐC ĐỘ BUS
+// =========================================================
+
+// Đọc lặp lại một thanh ghi ID; mọi lần đọc phải trả đúng giá trị kỳ vọng
+static bool verify_id_register(uint8_t dev_addr, uint8_t reg_addr, uint8_t expected)
+{
+    for (int i = 0; i < I2C_PROBE_READBACKS; i++) {
+        uint8_t readback;
+        if (i2c_device_read_reg(dev_addr, reg_addr, &readback, 1) != ESP_OK || readback != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Ghi/đọc lại các mẫu bit xen kẽ vào thanh ghi PILOT_PA (trước khi cấu hình MAX30102)
+static bool verify_max30102_scratch(void)
+{
+    static const uint8_t patterns[] = { 0xA5, 0x5A, 0xFF, 0x00 };
+
+    for (int i = 0; i < sizeof(patterns); i++) {
+        uint8_t readback;
+        if (i2c_device_write_reg(MAX30102_ADDR, REG_PILOT_PA, patterns[i]) != ESP_OK ||
+            i2c_device_read_reg(MAX30102_ADDR, REG_PILOT_PA, &readback, 1) != ESP_OK ||
+            readback != patterns[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t i2c_bus_probe_speed(void)
+{
+    // Chỉ kiểm tra các thiết bị trả lời ở tốc độ an toàn
+    bool has_max30102 = (i2c_device_ack(MAX30102_ADDR) == ESP_OK);
+    bool has_mpu6050  = (i2c_device_ack(MPU6050_ADDR) == ESP_OK);
+    bool has_oled     = (i2c_device_ack(OLED_I2C_ADDRESS) == ESP_OK);
+
+    for (int i = 0; i < sizeof(probe_speeds) / sizeof(probe_speeds[0]); i++) {
+        uint32_t freq_hz = probe_speeds[i];
+        if (freq_hz > I2C_MAX_FREQ_HZ || freq_hz <= I2C_MASTER_FREQ_HZ) {
+            continue;
+        }
+
+        i2c_driver_delete(i2c_port);
+        if (i2c_bus_configure(freq_hz) != ESP_OK) {
+            count_probe_failure();
+            i2c_bus_configure(I2C_MASTER_FREQ_HZ);
+            continue;
+        }
+
+        bool ok = true;
+        if (has_max30102) {
+            ok = ok && verify_id_register(MAX30102_ADDR, REG_PART_ID, MAX30102_PART_ID);
+            ok = ok && verify_max30102_scratch();
+        }
+        if (has_mpu6050) {
+            ok = ok && verify_id_register(MPU6050_ADDR, MPU6050_REG_WHO_AM_I, MPU6050_WHO_AM_I_VAL);
+        }
+        if (has_oled) {
+            ok = ok && (i2c_device_ack(OLED_I2C_ADDRESS) == ESP_OK);
+        }
+
+        if (ok) {
+            ESP_LOGI(TAG_I2C, "I2C bus verified at %lu Hz.", (unsigned long)freq_hz);
+            return freq_hz;
+        }
+
+        ESP_LOGW(TAG_I2C, "I2C bus unstable at %lu Hz, falling back.", (unsigned long)freq_hz);
+        count_probe_failure();
+        i2c_driver_delete(i2c_port);
+        i2c_bus_configure(I2C_MASTER_FREQ_HZ);
+    }
+
+    i2c_bus_stats_t stats;
+    i2c_bus_get_stats(&stats);
+    ESP_LOGI(TAG_I2C, "I2C bus running at safe speed %lu Hz.", (unsigned long)stats.freq_hz);
+    return stats.freq_hz;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "esp_err.h"
 #include "driver/i2c.h"
 #include "driver/gpio.h" 
+#include "sdkconfig.h"
 
 #define MAX30102_ADDR 0x57
 
@@ -15,12 +16,43 @@
 
 #define SDA_PIN 23 
 #define SCL_PIN 22 
-// Giữ tốc độ an toàn 100 kHz (vì không có trở 4.7kΩ)
+// Tốc độ an toàn 100 kHz (vì không có trở 4.7kΩ) - luôn dùng khi khởi động và làm fallback
 #define I2C_MASTER_FREQ_HZ 100000 
 
+// Tốc độ tối đa được phép thử khi probe bus (Kconfig: I2C_MAX_FREQ_HZ)
+#ifdef CONFIG_I2C_MAX_FREQ_HZ
+#define I2C_MAX_FREQ_HZ CONFIG_I2C_MAX_FREQ_HZ
+#else
+#define I2C_MAX_FREQ_HZ 400000
+#endif
+
+// Số lần đọc lặp lại mỗi thanh ghi khi kiểm tra một tốc độ
+#define I2C_PROBE_READBACKS 8
+
+// Thống kê bus I2C (xuất ra telemetry)
+typedef struct {
+    uint32_t freq_hz;        // Tốc độ đang dùng
+    uint32_t transactions;   // Tổng số giao dịch
+    uint32_t errors;         // Giao dịch lỗi (NACK, arbitration...)
+    uint32_t timeouts;       // Giao dịch timeout
+    uint32_t probe_failures; // Số tốc độ bị loại khi probe
+} i2c_bus_stats_t;
+
 // KHAI BÁO HÀM ĐÃ SỬA TÊN
 esp_err_t i2c_bus_driver_install(void); 
 esp_err_t i2c_sensor_read(uint8_t *data_rd, size_t size);
 esp_err_t i2c_sensor_write(uint8_t *data_wr, size_t size);
+// Ghi địa chỉ thanh ghi rồi đọc liên tiếp bằng repeated START (một giao dịch duy nhất)
+esp_err_t i2c_sensor_read_reg(uint8_t reg_addr, uint8_t *data_rd, size_t size);
+
+// Các hàm dùng chung cho mọi thiết bị trên bus
+esp_err_t i2c_bus_cmd_begin(i2c_cmd_handle_t cmd, TickType_t ticks_to_wait);
+esp_err_t i2c_device_read_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data_rd, size_t size);
+esp_err_t i2c_device_write_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t data);
+esp_err_t i2c_device_ack(uint8_t dev_addr);
+
+// Probe tốc độ bus: thử từ I2C_MAX_FREQ_HZ xuống, fallback về I2C_MASTER_FREQ_HZ
+uint32_t i2c_bus_probe_speed(void);
+void i2c_bus_get_stats(i2c_bus_stats_t *stats);
 
 #endif
\ No newline at end of file
@@ -1,19 +1,29 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h" 
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "main.h" 
 #include "max30102_api.h"
 #include "algorithm.h" 
+#include "hrv_engine.h"
 #include "i2c_api.h" 
 #include "oled_driver.h" 
 #include "mpu6050_api.h" 
+#include "telemetry.h"
+#include "telemetry_udp.h"
+#include "wifi_init.h"
+#include "vitals_log.h"
+#include "perf_stats.h"
+#include "sys_monitor.h"
+#include "trace_recorder.h"
 #include "driver/gpio.h" 
 #include "driver/ledc.h" 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h> 
 #include "esp_log.h" 
+#include "esp_timer.h" 
 #include <math.h> 
 #include <string.h> 
 
@@ -30,7 +40,6 @@ static const char *TAG = "MAX30102_APP";
 
 #define BUZZER_GPIO 5 
 #define ACCEL_THRESHOLD_DEMO 1.1f 
-#define ACCEL_THRESHOLD_MOTION 1.5f 
 
 #define LEDC_TIMER LEDC_TIMER_0
 #define LEDC_MODE LEDC_LOW_SPEED_MODE
@@ -38,8 +47,16 @@ static const char *TAG = "MAX30102_APP";
 #define LEDC_DUTY_RES LEDC_TIMER_10_BIT 
 #define LEDC_FREQUENCY 4000 
 
-#define DELAY_AMOSTRAGEM 40
-#define CYCLE_DELAY_MS 50 
+#define READER_TASK_STACK 10240    // score() đặt nhiều mảng double trên stack
+#define HRV_TASK_STACK 4096
+
+// Mẫu FIFO MAX30102 đã đọc nhưng chưa vào cửa sổ: FIFO chỉ giữ 32 mẫu (80 ms ở 400 sps),
+// nên được đọc sớm cả trong lúc xử lý / làm mới OLED / còi, rồi cửa sổ sau lấy từ bộ đệm này
+#define PPG_STAGING_SIZE 1024      // 2.56 s ở 400 sps
+
+// FIFO gia tốc MPU6050: cùng tốc độ xử lý với PPG, đọc burst sau mỗi ACCEL_DRAIN_INTERVAL mẫu PPG
+#define ACCEL_DRAIN_INTERVAL 8
+#define ACCEL_WINDOW_MAX (BUFFER_SIZE * 2)
 
 // BIẾN PLOT BIỂU ĐỒ
 #define HR_PLOT_POINTS 20          // Lưu trữ 20 điểm HR gần nhất (10 giây)
@@ -49,17 +66,65 @@ static int hr_history_index = 0;
 // THAM SỐ VẼ BIỂU ĐỒ (Giả định OLED 128x64)
 #define CHART_Y_MIN 40             // Bắt đầu vẽ từ tọa độ Y=40 
 #define CHART_HEIGHT 23            // Chiều cao biểu đồ 
-#define HR_BASE_BPM 50             // HR tối thiểu cho scaling
 #define HR_MAX_BPM 150             // HR tối đa cho scaling
-#define HR_RANGE (HR_MAX_BPM - HR_BASE_BPM)
+#define HR_RANGE (HR_MAX_BPM - cfg.hr_base_bpm)   // Đáy thang lấy từ cấu hình chạy
+
+
+// Ảnh chụp cấu hình chạy (config_store), chỉ task đọc cảm biến cập nhật, ở ranh giới cửa sổ
+static app_config_t cfg;
+static uint32_t cfg_applied_version = UINT32_MAX;
+
+// Profile thu mẫu đang chạy; tốc độ xử lý = tốc độ FIFO / hệ số hạ tốc, cửa sổ dài PPG_WINDOW_MS
+static const max30102_profile_t *acq_profile;
+
+// Ngữ cảnh xử lý PPG (bộ đệm cửa sổ, bộ lọc, bộ phát hiện nhịp, SQI) của cảm biến MAX30102
+static ppg_context_t ppg;
+
+// Vòng mẫu FIFO thô (chưa hạ tốc) chờ vào cửa sổ, kèm mốc thời gian của từng mẫu
+static struct {
+    int32_t red[PPG_STAGING_SIZE];
+    int32_t ir[PPG_STAGING_SIZE];
+    uint32_t t_ms[PPG_STAGING_SIZE];
+    int head;                       // Mẫu cũ nhất
+    int count;
+} ppg_staging;
+static uint32_t ppg_samples_lost = 0;   // Mất do FIFO cảm biến tràn (OVF_COUNTER) hoặc bộ đệm tạm đầy
+
+// Gia tốc đã căn chỉnh theo mốc thời gian của từng mẫu PPG
+float accel_x_buffer[BUFFER_SIZE];
+float accel_y_buffer[BUFFER_SIZE];
+float accel_z_buffer[BUFFER_SIZE];
 
+// Mẫu gia tốc thô của cửa sổ hiện tại (kèm mốc thời gian)
+static uint32_t accel_win_t[ACCEL_WINDOW_MAX];
+static float accel_win_x[ACCEL_WINDOW_MAX];
+static float accel_win_y[ACCEL_WINDOW_MAX];
+static float accel_win_z[ACCEL_WINDOW_MAX];
+static int accel_win_count = 0;
+static bool accel_fifo_ok = false;
 
-// Các biến lưu trữ dữ liệu
-int32_t red_data = 0;
-int32_t ir_data = 0;
-int32_t red_data_buffer[BUFFER_SIZE]; 
-int32_t ir_data_buffer[BUFFER_SIZE];
-double auto_correlationated_data[BUFFER_SIZE];
+// Bộ lọc thông dải cho gia tốc tham chiếu (cùng đáp ứng với kênh PPG)
+static bandpass_f32_t bandpass_accel[NLMS_AXES];
+static bool bandpass_accel_primed = false;
+
+// HRV dài hạn: kho RR vài phút (ghi bởi task đọc), phổ LF/HF tính ở task nền
+#define HRV_SPECTRUM_PERIOD_MS 30000
+#define HRV_MIN_LONG_TERM_RR 30   // Đủ RR thì dùng RMSSD dài hạn cho ML
+static hrv_store_t hrv_store;
+static uint32_t hrv_last_beat_us;                // Mốc nhịp cuối đã vào kho (đo thời lượng gián đoạn)
+static bool hrv_have_last_beat = false;
+static hrv_metrics_t g_hrv_metrics;
+static SemaphoreHandle_t hrv_mutex;
+
+// SQI tích lũy theo từng mẫu trong lúc thu (ppg.sqi), đánh giá một lần khi hết cửa sổ
+static sqi_result_t g_sqi = { .reason = SQI_NO_FINGER };
+
+// AGC dòng LED / dải ADC
+static max30102_agc_t led_agc;
+
+// Nhật ký kết quả trên flash (partition "vitals"), vẫn còn khi không có PC/Wi-Fi
+static vitals_log_t vitals_log;
+static bool vitals_log_ok = false;
 
 Oled_t oled_dev; 
 
@@ -72,6 +137,7 @@ static float g_accel_x = 0.0f;
 static float g_accel_y = 0.0f;
 static float g_accel_z = 0.0f;
 static float g_total_accel = 0.0f; 
+static float g_motion_energy = 0.0f; 
 static bool is_user_moving = false; 
 
 // =========================================================
@@ -79,14 +145,56 @@ static bool is_user_moving = false;
 // =========================================================
 void fill_buffers_data();
 void sensor_data_reader(void *pvParameters);
+static void drain_accel_fifo(void);
+static void drain_ppg_fifo(void);
+static void delay_draining_fifo(uint32_t duration_ms);
+static void filter_accel_reference(void);
+static void hrv_spectrum_task(void *pvParameters);
+static void send_diagnostics(void);
+static void send_raw_ppg(const int32_t *red, const int32_t *ir, int count, uint32_t t0_ms, uint8_t lost, bool restart);
+static void send_raw_accel(const mpu6050_accel_raw_t *samples, int count, uint32_t t0_ms, uint32_t period_ms);
+static void send_vitals(int prediction, double heart_rate_bpm, double spo2, float temperature);
+static void send_sqi_event(float temperature);
+static void wait_for_finger(void);
+static void apply_agc_step(const max30102_agc_event_t *event);
+static void update_agc(void);
+static void load_acquisition_profile(void);
+static void apply_runtime_config(void);
+static void handle_host_command(uint8_t type, const uint8_t *payload, size_t len);
+#if PERF_STATS_ENABLED
+static void report_perf_stats(void);
+#endif
+#if TRACE_ENABLED
+static void dump_trace(void);
+#endif
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// Đổi giá trị thực (đã nhân hệ số) sang số nguyên 16 bit, bão hòa ở hai đầu
+static uint16_t sat_u16(double value) {
+    if (!(value > 0.0)) return 0;
+    if (value > UINT16_MAX) return UINT16_MAX;
+    return (uint16_t)lround(value);
+}
+
+static int16_t sat_i16(double value) {
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    if (isnan(value)) return 0;
+    return (int16_t)lround(value);
+}
 
 /**
  * @brief Kích hoạt Buzzer cho một lần bíp (DC - Dùng cho cảnh báo nhẹ)
  */
 void trigger_buzzer_dc(int duration_ms) {
+    TRACE_BEGIN_ARG(ALARM, 0);
     gpio_set_level(BUZZER_GPIO, 1);
-    vTaskDelay(pdMS_TO_TICKS(duration_ms));
+    delay_draining_fifo(duration_ms);
     gpio_set_level(BUZZER_GPIO, 0);
+    TRACE_END(ALARM);
 }
 
 /**
@@ -113,7 +221,7 @@ void display_task_values(int heart_rate, double spo2, double correlation) {
     
     int current_frame = heart_frame_counter % 2; 
 
-    if (correlation >= 0.7 && heart_rate >= 40 && spo2 > 80.0) {
+    if (correlation >= cfg.min_correlation && heart_rate >= 40 && spo2 > 80.0) {
         
         // Dòng 1: HR & Tim đập
         oled_draw_heart_animation(&oled_dev, 0, 13, current_frame); 
@@ -155,8 +263,8 @@ void display_task_values(int heart_rate, double spo2, double correlation) {
             if (hr_val > 0) {
                 // 1. Chuẩn hóa giá trị HR về [0, 1]
                 float normalized_hr = 0.0f;
-                if (hr_val > HR_BASE_BPM) {
-                     normalized_hr = (float)(hr_val - HR_BASE_BPM);
+                if (hr_val > cfg.hr_base_bpm) {
+                     normalized_hr = (float)(hr_val - cfg.hr_base_bpm);
                 }
                 
                 // Giới hạn trong phạm vi HR_RANGE
@@ -175,7 +283,7 @@ void display_task_values(int heart_rate, double spo2, double correlation) {
                 if (i > 0 && hr_history[prev_index] > 0) {
                     // Tính lại y_pos_prev từ giá trị cũ
                     int hr_val_prev = hr_history[prev_index];
-                    float normalized_hr_prev = (float) ( (hr_val_prev > HR_BASE_BPM) ? (hr_val_prev - HR_BASE_BPM) : 0);
+                    float normalized_hr_prev = (float) ( (hr_val_prev > cfg.hr_base_bpm) ? (hr_val_prev - cfg.hr_base_bpm) : 0);
                     if (normalized_hr_prev > HR_RANGE) normalized_hr_prev = HR_RANGE; 
 
                     int y_offset_prev = (int)((normalized_hr_prev / HR_RANGE) * CHART_HEIGHT);
@@ -194,7 +302,10 @@ void display_task_values(int heart_rate, double spo2, double correlation) {
         // Cảnh báo tín hiệu kém
         oled_draw_text(&oled_dev, 0, 0, "Input Your Finger"); 
         
-        if (correlation > 0.0) {
+        if (g_sqi.reason != SQI_OK) {
+            sprintf(buffer, "SQI: %s", sqi_reason_str(g_sqi.reason));
+            oled_draw_text(&oled_dev, 1, 0, buffer); 
+        } else if (correlation > 0.0) {
             sprintf(buffer, "Low Qual: %.1f", correlation);
             oled_draw_text(&oled_dev, 1, 0, buffer); 
         } else {
@@ -202,7 +313,14 @@ void display_task_values(int heart_rate, double spo2, double correlation) {
         }
     }
     
+    // Làm mới OLED mất vài chục ms (hơn 100 ms khi bus lùi về 100 kHz): đọc FIFO trước và sau
+    drain_ppg_fifo();
+    PERF_STAGE_BEGIN(DISPLAY);
+    TRACE_BEGIN(DISPLAY);
     oled_update_display(&oled_dev); 
+    TRACE_END(DISPLAY);
+    PERF_STAGE_END(DISPLAY);
+    drain_ppg_fifo();
 }
 
 /**
@@ -241,20 +359,49 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+
+    // 1b. Cấu hình chạy (mặc định + ghi đè từ NVS)
+    ESP_ERROR_CHECK(config_store_init());
+    config_snapshot(&cfg);      // Áp dụng đầy đủ ở vòng đầu của task đọc cảm biến
     
-    // 2. Khởi tạo Buzzer
+    // 2. Telemetry nhị phân qua UART (task ghi riêng), nhận lệnh cấu hình từ host
+    if (telemetry_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Telemetry init failed");
+    }
+    telemetry_set_rx_handler(handle_host_command);
+#if TLM_UDP_ENABLED
+    // 2a. Wi-Fi chạy nền (không chờ kết nối) + bản sao telemetry qua UDP khi có mạng
+    if (wifi_init_sta() != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi init failed");
+    } else if (telemetry_udp_init(TLM_UDP_HOST, TLM_UDP_PORT) != ESP_OK) {
+        ESP_LOGE(TAG, "UDP telemetry init failed");
+    }
+#endif
+
+    // 2b. Nhật ký kết quả trên flash
+    vlog_flash_t vlog_flash;
+    if (vitals_log_flash_partition(&vlog_flash, VLOG_PARTITION_LABEL) == ESP_OK &&
+        vitals_log_mount(&vitals_log, &vlog_flash) == ESP_OK) {
+        vitals_log_ok = true;
+    }
+
+    // 2c. Khởi tạo Buzzer
     init_ledc_driver(); 
     
-    // 3. Khởi tạo I2C
+    // 3. Khởi tạo I2C (100 kHz) và probe tốc độ cao hơn nếu bus ổn định
     i2c_bus_driver_install(); 
+    uint32_t i2c_freq = i2c_bus_probe_speed();
+    ESP_LOGI(TAG, "I2C bus speed: %lu Hz", (unsigned long)i2c_freq);
 
-    // 4. Khởi tạo MAX30102
+    // 4. Khởi tạo MAX30102 theo profile thu mẫu (NVS, mặc định từ menuconfig)
     ESP_LOGI(TAG, "Initializing MAX30102...");
-    max30102_init(&max30102_configuration); 
+    load_acquisition_profile();
     
     // 5. Khởi tạo MPU6050
     ESP_LOGI(TAG, "Initializing MPU6050...");
-    mpu6050_init(); 
+    if (mpu6050_init() == ESP_OK) {
+        accel_fifo_ok = (mpu6050_fifo_init((uint16_t)ppg.sample_rate_hz) == ESP_OK);
+    }
 
     // 6. Khởi tạo OLED
     ESP_LOGI(TAG, "Initializing OLED...");
@@ -268,8 +415,25 @@ void app_main(void)
     vTaskDelay(pdMS_TO_TICKS(500)); 
 
     // 7. Bắt đầu Task xử lý dữ liệu
+    hrv_store_init(&hrv_store);
+    hrv_mutex = xSemaphoreCreateMutex();
     ESP_LOGI(TAG, "Starting sensor reader task on Core 1");
-    xTaskCreatePinnedToCore(sensor_data_reader, "Data", 10240, NULL, 2, NULL, 1);
+    xTaskCreatePinnedToCore(sensor_data_reader, "Data", READER_TASK_STACK, NULL, 2, NULL, 1);
+
+    // 8. Task nền tính phổ HRV (ưu tiên thấp, Core 0)
+    xTaskCreatePinnedToCore(hrv_spectrum_task, "HRV", HRV_TASK_STACK, NULL, 1, NULL, 0);
+
+    // 9. Giám sát stack/heap của các task trên qua telemetry
+    sys_monitor_watch_task("Data", READER_TASK_STACK);
+    sys_monitor_watch_task("HRV", HRV_TASK_STACK);
+    sys_monitor_watch_task("TLM", TLM_TASK_STACK);
+    sys_monitor_watch_task("TLM_RX", TLM_TASK_STACK);
+#if TLM_UDP_ENABLED
+    sys_monitor_watch_task("TLM_UDP", TLM_UDP_TASK_STACK);
+#endif
+    if (sys_monitor_start() != ESP_OK) {
+        ESP_LOGE(TAG, "System monitor start failed");
+    }
 }
 
 
@@ -277,22 +441,56 @@ void sensor_data_reader(void *pvParameters)
 {
     vTaskDelay(pdMS_TO_TICKS(100)); 
     
-    init_time_array();
+    max30102_agc_init(&led_agc);
+
+    for (int a = 0; a < NLMS_AXES; a++) {
+        bandpass_init_f32(&bandpass_accel[a], ppg.sample_rate_hz, BANDPASS_LOW_HZ, BANDPASS_HIGH_HZ);
+    }
     
     uint64_t ir_mean;
     uint64_t red_mean;
-    float temperature;
+    float temperature = 0.0f;
     double r0_autocorrelation;
+    int no_finger_windows = 0;
+
+    // Mẫu tích trong FIFO lúc khởi động không liên tục với cửa sổ đầu: bỏ, không tính là mất
+    max30102_clear_fifo();
 
     for(;;){
+        // Cấu hình đổi qua telemetry: lấy ảnh chụp mới, áp dụng trước khi thu cửa sổ
+        if (config_snapshot(&cfg) != cfg_applied_version) {
+            apply_runtime_config();
+        }
+
         // A. Thu thập dữ liệu MAX30102
+        PERF_STAGE_BEGIN(ACQUIRE);
+        TRACE_BEGIN(ACQUIRE);
         fill_buffers_data();
+        TRACE_END(ACQUIRE);
+        PERF_STAGE_END(ACQUIRE);
+        PERF_STAGE_BEGIN(WINDOW);
+        TRACE_BEGIN(DSP);
 
-        // B. Thu thập dữ liệu MPU-6050
-        mpu6050_read_accel(&g_accel_x, &g_accel_y, &g_accel_z); 
-        g_total_accel = sqrtf(g_accel_x*g_accel_x + g_accel_y*g_accel_y + g_accel_z*g_accel_z);
+        // Nhiệt độ: thu kết quả lần kích hoạt trước / kích hoạt lần mới khi đến hạn
+        max30102_temp_service();
+        max30102_temp_get(&temperature);
+
+        // B. Dữ liệu MPU-6050: đặc trưng chuyển động của cả cửa sổ (từ FIFO)
+        if (accel_fifo_ok) {
+            motion_features_t motion;
+            compute_motion_features(accel_x_buffer, accel_y_buffer, accel_z_buffer, ppg.window_len, &motion);
+            g_accel_x = accel_x_buffer[ppg.window_len - 1];
+            g_accel_y = accel_y_buffer[ppg.window_len - 1];
+            g_accel_z = accel_z_buffer[ppg.window_len - 1];
+            g_total_accel = motion.peak_g;
+            g_motion_energy = motion.energy;
+        } else {
+            mpu6050_read_accel(&g_accel_x, &g_accel_y, &g_accel_z); 
+            g_total_accel = sqrtf(g_accel_x*g_accel_x + g_accel_y*g_accel_y + g_accel_z*g_accel_z);
+            g_motion_energy = 0.0f;
+        }
         
-        is_user_moving = (g_total_accel > ACCEL_THRESHOLD_MOTION); 
+        is_user_moving = (g_total_accel > cfg.accel_threshold_g); 
 
         // C. PHÁT HIỆN GIA TỐC (DEMO - Bỏ qua vì đã có ML xử lý Moving)
         // Chỉ log thông tin
@@ -300,27 +498,102 @@ void sensor_data_reader(void *pvParameters)
             ESP_LOGD(TAG, "Significant Motion Detected: %.2f g", g_total_accel);
         }
         
+        // D0. Cổng chất lượng tín hiệu: bỏ qua HR/SpO2/ML nếu cửa sổ không đạt
+        PERF_STAGE_BEGIN(SQI);
+        sqi_evaluate(&ppg.sqi, ppg.sample_rate_hz, &g_sqi);
+        PERF_STAGE_END(SQI);
+
+        if (g_sqi.reason != SQI_OK) {
+            TRACE_INSTANT(SQI_REJECT, g_sqi.reason);
+            send_sqi_event(temperature);
+
+            // Chuỗi RR bị gián đoạn bởi cửa sổ bị loại; thời lượng được cộng khi có nhịp kế tiếp
+            xSemaphoreTake(hrv_mutex, portMAX_DELAY);
+            hrv_store_push_gap(&hrv_store, 0.0f);
+            xSemaphoreGive(hrv_mutex);
+
+            strcpy(g_stress_status, "N/A");
+            g_hrv_rmssd = 0.0f;
+            display_task_values(0, 0.0, 0.0);
+            update_agc();
+            TRACE_END(DSP);
+            PERF_STAGE_END(WINDOW);
+            send_diagnostics();
+
+            // Không có ngón tay liên tục: ngủ ở chế độ proximity tới khi có ngón tay
+            no_finger_windows = (g_sqi.reason == SQI_NO_FINGER) ? no_finger_windows + 1 : 0;
+            if (no_finger_windows >= PROX_ENTER_WINDOWS) {
+                wait_for_finger();
+                no_finger_windows = 0;
+            }
+            continue;
+        }
+        no_finger_windows = 0;
+
         // D. Xử lý dữ liệu Sinh lý (HR/SpO2/HRV)
-        temperature = get_max30102_temp();
-        remove_dc_part(ir_data_buffer, red_data_buffer, &ir_mean, &red_mean); 
-        remove_trend_line(ir_data_buffer);
-        remove_trend_line(red_data_buffer);
+        // Trung bình DC lấy từ mẫu thô; trôi nền đã được bộ lọc thông dải loại bỏ khi thu mẫu
+        PERF_STAGE_BEGIN(DETREND);
+        remove_dc_part(&ppg, ppg.ir_raw, ppg.red_raw, &ir_mean, &red_mean); 
+        PERF_STAGE_END(DETREND);
+
+        // Trừ thành phần chuyển động (tham chiếu: gia tốc 3 trục đã căn chỉnh, cùng bộ lọc thông dải)
+        if (accel_fifo_ok) {
+            PERF_STAGE_BEGIN(MOTION);
+            filter_accel_reference();
+            cancel_motion_artifacts(&ppg.nlms_ir, ppg.ir_data, accel_x_buffer, accel_y_buffer, accel_z_buffer, ppg.window_len);
+            cancel_motion_artifacts(&ppg.nlms_red, ppg.red_data, accel_x_buffer, accel_y_buffer, accel_z_buffer, ppg.window_len);
+            PERF_STAGE_END(MOTION);
+        }
         
-        double pearson_correlation = correlation_datay_datax(red_data_buffer, ir_data_buffer);
-        int heart_rate = calculate_heart_rate(ir_data_buffer, &r0_autocorrelation, auto_correlationated_data);
+        // Đưa từng mẫu IR đã làm sạch vào bộ phát hiện nhịp
+        PERF_STAGE_BEGIN(BEATS);
+        for (int i = 0; i < ppg.window_len; i++) {
+            beat_detector_process(&ppg.beat_detector, ppg.ir_data[i], ppg.time_ms[i]);
+        }
+        beat_event_t beat;
+        xSemaphoreTake(hrv_mutex, portMAX_DELAY);
+        while (beat_detector_pop(&ppg.beat_detector, &beat)) {
+            ESP_LOGD(TAG, "Beat at %lu us, RR=%.1f ms", (unsigned long)beat.time_us, beat.rr_ms);
+            // RR không hợp lệ (0) được lưu như điểm gián đoạn, kèm khoảng thời gian thật tới nhịp trước
+            if (beat.rr_ms > 0.0f) {
+                hrv_store_push(&hrv_store, beat.rr_ms);
+            } else {
+                hrv_store_push_gap(&hrv_store, hrv_have_last_beat ? (uint32_t)(beat.time_us - hrv_last_beat_us) / 1000.0f : 0.0f);
+            }
+            hrv_last_beat_us = beat.time_us;
+            hrv_have_last_beat = true;
+        }
+        hrv_store_time_domain(&hrv_store, &g_hrv_metrics);
+        xSemaphoreGive(hrv_mutex);
+        PERF_STAGE_END(BEATS);
+
+        // Hạ tốc IR đã làm sạch về ~25 Hz cho tự tương quan; nhịp và SpO2 dùng tốc độ đầy đủ
+        PERF_STAGE_BEGIN(AUTOCORR);
+        ppg_decimate_hr_window(&ppg);
+
+        double pearson_correlation = correlation_datay_datax(&ppg, ppg.red_data, ppg.ir_data);
+        double heart_rate_bpm = calculate_heart_rate(&ppg, ppg.hr_data, ppg.hr_len, &r0_autocorrelation);
+        PERF_STAGE_END(AUTOCORR);
+        int heart_rate = (int)lround(heart_rate_bpm);
         
-        bool is_hr_valid = (heart_rate >= 40 && heart_rate <= 200);
+        bool is_hr_valid = (heart_rate_bpm >= HR_SEARCH_MIN_BPM && heart_rate_bpm <= HR_SEARCH_MAX_BPM);
 
-        if(pearson_correlation >= 0.7 && is_hr_valid){ 
-            double spo2 = spo2_measurement(ir_data_buffer, red_data_buffer, ir_mean, red_mean);
+        if(pearson_correlation >= cfg.min_correlation && is_hr_valid){ 
+            PERF_STAGE_BEGIN(SPO2);
+            double spo2 = spo2_measurement(&ppg, ppg.ir_data, ppg.red_data, ir_mean, red_mean);
+            PERF_STAGE_END(SPO2);
             
-            g_hrv_rmssd = calculate_hrv_rmssd(ir_data_buffer, BUFFER_SIZE);
+            if (g_hrv_metrics.rr_count >= HRV_MIN_LONG_TERM_RR) {
+                g_hrv_rmssd = g_hrv_metrics.rmssd_ms;
+            } else {
+                g_hrv_rmssd = beat_detector_rmssd(&ppg.beat_detector);
+            }
             
             // LƯU HR VÀO LỊCH SỬ CHO BIỂU ĐỒ
-            if (heart_rate >= HR_BASE_BPM && heart_rate <= HR_MAX_BPM) {
+            if (heart_rate >= cfg.hr_base_bpm && heart_rate <= HR_MAX_BPM) {
                 hr_history[hr_history_index] = heart_rate;
             } else {
-                hr_history[hr_history_index] = (heart_rate < HR_BASE_BPM) ? HR_BASE_BPM : HR_MAX_BPM; 
+                hr_history[hr_history_index] = (heart_rate < cfg.hr_base_bpm) ? cfg.hr_base_bpm : HR_MAX_BPM; 
             }
             hr_history_index = (hr_history_index + 1) % HR_PLOT_POINTS;
             
@@ -330,7 +603,7 @@ void sensor_data_reader(void *pvParameters)
             
             // 1. Chuẩn bị đầu vào (Không dùng const để tránh lỗi warning)
             double input_features[4] = {
-                (double)heart_rate,      // HR (bpm)
+                heart_rate_bpm,          // HR (bpm, độ trễ nội suy)
                 spo2,                    // SpO2 (%)
                 (double)g_hrv_rmssd,     // HRV (ms)
                 (double)g_total_accel    // Accel (g)
@@ -340,7 +613,9 @@ void sensor_data_reader(void *pvParameters)
             double output_scores[5]; 
 
             // 3. Gọi hàm dự đoán
+            PERF_STAGE_BEGIN(ML);
             score(input_features, output_scores); 
+            PERF_STAGE_END(ML);
             
             // 4. Tìm lớp có xác suất cao nhất
             int prediction = 0;
@@ -388,45 +663,627 @@ void sensor_data_reader(void *pvParameters)
             // 6. Thực hiện hành động Cảnh báo
             if (acute_danger) {
                 // Nguy hiểm: Hú còi 1.5 giây
+                TRACE_BEGIN_ARG(ALARM, 1);
                 start_buzzer_tone();
-                vTaskDelay(pdMS_TO_TICKS(1500)); 
+                delay_draining_fifo(1500);
                 stop_buzzer_tone();
+                TRACE_END(ALARM);
             } else if (warning) {
                 // Cảnh báo nhẹ: Bíp 100ms
                 trigger_buzzer_dc(100); 
             }
             
-            // In log chi tiết để debug
-            printf("\n| ML PREDICTION: Class %d (%s) | Inputs: HR=%d, SpO2=%.1f, HRV=%.1f, Acc=%.2f |\n", 
-                   prediction, g_stress_status, heart_rate, spo2, g_hrv_rmssd, g_total_accel);
+            // Kết quả cửa sổ gửi qua telemetry nhị phân
+            TRACE_INSTANT(VITALS, prediction);
+            send_vitals(prediction, heart_rate_bpm, spo2, temperature);
             
             heart_frame_counter++; 
             display_task_values(heart_rate, spo2, pearson_correlation); 
 
         } else {
             // Tín hiệu kém
-            printf("\n| WARNING: Low signal quality (Corr: %.2f). Temp:%.2f.\n", pearson_correlation, temperature);
+            tlm_evt_corr_t corr_event = {
+                .correlation_x1000 = sat_i16(pearson_correlation * 1000.0),
+                .temp_x100 = sat_i16(temperature * 100.0f),
+            };
+            telemetry_send_event(TLM_EVT_LOW_CORRELATION, now_ms(), &corr_event, sizeof(corr_event));
             
             strcpy(g_stress_status, "N/A");
             g_hrv_rmssd = 0.0f;
             
             display_task_values(0, 0.0, pearson_correlation); 
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(CYCLE_DELAY_MS));
+
+        update_agc();
+        TRACE_END(DSP);
+        PERF_STAGE_END(WINDOW);
+        send_diagnostics();
+    }
+}
+
+
+/**
+ * @brief Chuyển MAX30102 sang chế độ proximity (chỉ LED pilot dòng thấp) và tạm dừng
+ * toàn bộ pipeline xử lý; chỉ đọc cờ PROX_INT mỗi PROX_POLL_MS cho tới khi có ngón tay.
+ */
+static void wait_for_finger(void)
+{
+    telemetry_send_event(TLM_EVT_PROX_ENTER, now_ms(), NULL, 0);
+    // Lúc nghỉ: ghi nốt trang nhật ký đang dở để không mất nếu bị tắt nguồn
+    if (vitals_log_ok) {
+        vitals_log_flush(&vitals_log);
+    }
+    oled_clear_screen(&oled_dev);
+    oled_draw_text(&oled_dev, 0, 0, "Input Your Finger");
+    oled_draw_text(&oled_dev, 1, 0, "Low power mode");
+    oled_update_display(&oled_dev);
+
+    max30102_enter_proximity_mode(&max30102_configuration, PROX_THRESHOLD);
+    while (!max30102_proximity_detected()) {
+        vTaskDelay(pdMS_TO_TICKS(PROX_POLL_MS));
+    }
+    max30102_exit_proximity_mode(&max30102_configuration);
+    telemetry_send_event(TLM_EVT_PROX_EXIT, now_ms(), NULL, 0);
+    ppg_staging.count = 0;          // Mẫu cũ từ trước lúc nghỉ không còn liên tục
+
+    // Tín hiệu bị gián đoạn: khởi động lại bộ lọc, bộ phát hiện nhịp và FIFO gia tốc
+    ppg.bandpass_primed = false;
+    bandpass_accel_primed = false;
+    beat_detector_init(&ppg.beat_detector);
+    if (accel_fifo_ok) {
+        mpu6050_fifo_reset();
+    }
+}
+
+
+/**
+ * @brief Chọn profile thu mẫu và dòng LED ban đầu theo cấu hình chạy (NVS "ppg", mặc định
+ * PPG_ACQ_PROFILE_DEFAULT / LED_PA_DEFAULT). Nạp cấu hình vào MAX30102 và đặt lại
+ * tốc độ xử lý / độ dài cửa sổ cho các thuật toán.
+ */
+static void load_acquisition_profile(void)
+{
+    uint8_t id = cfg.acq_profile;
+    max30102_configuration.LED1_PULSE_AMP.LED1_PA = cfg.led1_pa;
+    max30102_configuration.LED2_PULSE_AMP.LED2_PA = cfg.led2_pa;
+
+    acq_profile = max30102_get_profile((max30102_profile_id_t)id);
+    if (acq_profile == NULL) {
+        ESP_LOGW(TAG, "Invalid acquisition profile %u, using default", id);
+        acq_profile = max30102_get_profile(PPG_ACQ_PROFILE_DEFAULT);
+    }
+    max30102_apply_profile(&max30102_configuration, acq_profile);
+
+    float sample_rate_hz = (float)acq_profile->output_rate_hz / acq_profile->decimation;
+    int window_len = (int)lrintf(sample_rate_hz * PPG_WINDOW_MS / 1000.0f);
+    if (window_len > BUFFER_SIZE) window_len = BUFFER_SIZE;
+
+    int hr_decimation = (int)lrintf(sample_rate_hz / HR_TARGET_RATE_HZ);
+    if (hr_decimation < 1) hr_decimation = 1;
+    ppg_context_init(&ppg, sample_rate_hz, window_len, acq_profile->decimation, hr_decimation);
+
+    ESP_LOGI(TAG, "Acquisition profile: %s (%u sps FIFO, %.0f Hz processing, HR at %.0f Hz, %d-sample window)",
+             acq_profile->name, acq_profile->output_rate_hz, sample_rate_hz, sample_rate_hz / hr_decimation, window_len);
+}
+
+
+/**
+ * @brief Áp dụng ảnh chụp cấu hình mới: hệ số SpO2/HR cho ngữ cảnh PPG, dòng LED nếu đổi
+ * (đi qua apply_agc_step như một bước AGC: sự kiện, nhật ký AGC, co giãn NLMS/ngưỡng nhịp).
+ * Profile thu mẫu chỉ đổi khi khởi động lại.
+ */
+static void apply_runtime_config(void)
+{
+    static uint8_t applied_led1_pa = LED_PA_DEFAULT;
+    static uint8_t applied_led2_pa = LED_PA_DEFAULT;
+
+    if (cfg_applied_version == UINT32_MAX) {
+        applied_led1_pa = max30102_configuration.LED1_PULSE_AMP.LED1_PA;
+        applied_led2_pa = max30102_configuration.LED2_PULSE_AMP.LED2_PA;
+    }
+    ppg_context_set_calibration(&ppg, cfg.spo2_a, cfg.spo2_b, cfg.spo2_c, cfg.min_autocorr_ratio);
+
+    // So với giá trị cấu hình đã áp dụng (không phải thanh ghi): AGC vẫn tự chỉnh giữa các lần đổi
+    if (cfg.led1_pa != applied_led1_pa || cfg.led2_pa != applied_led2_pa) {
+        max30102_agc_event_t agc_event;
+        if (max30102_agc_set_led(&led_agc, &max30102_configuration, cfg.led1_pa, cfg.led2_pa, &agc_event)) {
+            apply_agc_step(&agc_event);
+        }
+        applied_led1_pa = cfg.led1_pa;
+        applied_led2_pa = cfg.led2_pa;
+    }
+    cfg_applied_version = config_version();
+    ESP_LOGI(TAG, "Runtime config v%u applied", (unsigned)cfg_applied_version);
+}
+
+static void send_config_value(config_param_id_t id, config_status_t status)
+{
+    float value = 0.0f;
+    config_get(id, &value);
+    tlm_config_t reply = {
+        .version = config_version(),
+        .param = (uint8_t)id,
+        .status = (uint8_t)status,
+        .value = value,
+    };
+    telemetry_send(TLM_MSG_CONFIG, &reply, sizeof(reply));
+}
+
+/**
+ * @brief Lệnh từ host (task TLM_RX): đọc/ghi tham số cấu hình, trả lời bằng TLM_MSG_CONFIG.
+ * Chỉ ghi vào config_store; task đọc cảm biến tự áp dụng ở cửa sổ kế tiếp.
+ */
+static void handle_host_command(uint8_t type, const uint8_t *payload, size_t len)
+{
+    if (type == TLM_MSG_CONFIG_SET && len >= sizeof(tlm_config_set_t)) {
+        tlm_config_set_t cmd;
+        memcpy(&cmd, payload, sizeof(cmd));
+        config_status_t status = config_set((config_param_id_t)cmd.param, cmd.value,
+                                            (cmd.flags & TLM_CONFIG_PERSIST) != 0);
+        send_config_value((config_param_id_t)cmd.param, status);
+    } else if (type == TLM_MSG_CONFIG_GET && len >= sizeof(tlm_config_get_t)) {
+        if (payload[0] == TLM_CONFIG_ALL) {
+            for (int id = 0; id < CFG_PARAM_COUNT; id++) {
+                send_config_value((config_param_id_t)id, CFG_STATUS_OK);
+            }
+        } else {
+            config_status_t status = (payload[0] < CFG_PARAM_COUNT) ? CFG_STATUS_OK : CFG_STATUS_UNKNOWN_KEY;
+            send_config_value((config_param_id_t)payload[0], status);
+        }
+#if TRACE_ENABLED
+    } else if (type == TLM_MSG_TRACE_DUMP) {
+        dump_trace();
+#endif
+    }
+}
+
+#if TRACE_ENABLED
+#define TRACE_SEND_TIMEOUT_MS 1000
+
+// Gửi một khối ghi vết; chờ task TLM nhả bớt bộ đệm thay vì bỏ khung
+static bool send_trace_chunk(trace_chunk_kind_t kind, uint8_t count, const void *data, size_t len, void *arg)
+{
+    uint8_t payload[TLM_MAX_PAYLOAD];
+    tlm_trace_header_t header = { .kind = (uint8_t)kind, .count = count };
+    if (sizeof(header) + len > sizeof(payload)) {
+        return false;
+    }
+    memcpy(payload, &header, sizeof(header));
+    memcpy(payload + sizeof(header), data, len);
+    return telemetry_send_blocking(TLM_MSG_TRACE, payload, sizeof(header) + len, TRACE_SEND_TIMEOUT_MS) == ESP_OK;
+}
+
+/**
+ * @brief Xuất vòng ghi vết qua telemetry (gọi từ task TLM_RX khi host gửi TLM_MSG_TRACE_DUMP).
+ * Ghi vết tạm dừng trong lúc xuất; ~40 khung cho cả vòng.
+ */
+static void dump_trace(void)
+{
+    if (!trace_export(send_trace_chunk, NULL)) {
+        ESP_LOGW(TAG, "Trace dump aborted: telemetry link full");
+    }
+}
+#endif
+
+
+/**
+ * @brief AGC cuối cửa sổ (chỉ khi có ngón tay): chỉnh dòng LED / dải ADC cho cửa sổ sau.
+ * Gọi sau khi NLMS và bộ phát hiện nhịp đã xử lý xong cửa sổ hiện tại (thu ở hệ số cũ),
+ * để phép co giãn ngưỡng / trọng số chỉ áp dụng cho mẫu thu ở hệ số mới.
+ */
+static void update_agc(void)
+{
+    if (g_sqi.ir_dc < SQI_FINGER_DC_MIN) {
+        return;
+    }
+    max30102_agc_event_t agc_event;
+    if (max30102_agc_update(&led_agc, &max30102_configuration, g_sqi.red_dc, g_sqi.ir_dc,
+                            g_sqi.clipped_percent, &agc_event)) {
+        apply_agc_step(&agc_event);
+    }
+}
+
+/**
+ * @brief Báo cáo một bước AGC và chuẩn hóa trạng thái DSP qua bước nhảy biên độ:
+ * bộ lọc thông dải được khởi động lại ở mức DC mới, ngưỡng nhịp và trọng số NLMS co giãn theo hệ số.
+ */
+static void apply_agc_step(const max30102_agc_event_t *event)
+{
+    tlm_evt_agc_t agc_event = {
+        .old_led1_pa = event->old_led1_pa, .new_led1_pa = event->new_led1_pa,
+        .old_led2_pa = event->old_led2_pa, .new_led2_pa = event->new_led2_pa,
+        .old_adc_rge = event->old_adc_rge, .new_adc_rge = event->new_adc_rge,
+        .red_gain_x1000 = sat_u16(event->red_gain_ratio * 1000.0f),
+        .ir_gain_x1000 = sat_u16(event->ir_gain_ratio * 1000.0f),
+    };
+    telemetry_send_event(TLM_EVT_AGC, event->time_ms, &agc_event, sizeof(agc_event));
+    TRACE_INSTANT(AGC, event->new_led2_pa);
+
+    ppg.bandpass_primed = false;
+    beat_detector_rescale(&ppg.beat_detector, event->ir_gain_ratio);
+    nlms_rescale(&ppg.nlms_ir, event->ir_gain_ratio);
+    nlms_rescale(&ppg.nlms_red, event->red_gain_ratio);
+}
+
+
+// =========================================================
+// TELEMETRY: ĐÓNG GÓI KẾT QUẢ THÀNH KHUNG NHỊ PHÂN
+// =========================================================
+
+/**
+ * @brief Kết quả một cửa sổ hợp lệ (HR, SpO2, HRV, lớp ML, chuyển động, HRV dài hạn).
+ */
+static void send_vitals(int prediction, double heart_rate_bpm, double spo2, float temperature)
+{
+    tlm_vitals_t vitals = {
+        .time_ms = now_ms(),
+        .ml_class = (uint8_t)prediction,
+        .sqi_reason = (uint8_t)g_sqi.reason,
+        .hr_x10 = sat_u16(heart_rate_bpm * 10.0),
+        .spo2_x10 = sat_u16(spo2 * 10.0),
+        .hrv_x10 = sat_u16(g_hrv_rmssd * 10.0f),
+        .accel_mg = sat_u16(g_total_accel * 1000.0f),
+        .motion_energy_x1e4 = sat_u16(g_motion_energy * 10000.0f),
+        .sdnn_x10 = sat_u16(g_hrv_metrics.sdnn_ms * 10.0f),
+        .pnn50_x10 = sat_u16(g_hrv_metrics.pnn50 * 10.0f),
+        .lf_ms2 = (uint32_t)lrintf(g_hrv_metrics.lf_power),
+        .hf_ms2 = (uint32_t)lrintf(g_hrv_metrics.hf_power),
+        .lf_hf_x100 = sat_u16(g_hrv_metrics.lf_hf_ratio * 100.0f),
+        .rr_count = (uint16_t)g_hrv_metrics.rr_count,
+        .temp_x100 = sat_i16(temperature * 100.0f),
+    };
+    telemetry_send(TLM_MSG_VITALS, &vitals, sizeof(vitals));
+
+    if (vitals_log_ok) {
+        vlog_record_t record = {
+            .time_ms = vitals.time_ms,
+            .hr_x10 = vitals.hr_x10,
+            .spo2_x10 = vitals.spo2_x10,
+            .hrv_x10 = vitals.hrv_x10,
+            .accel_mg = vitals.accel_mg,
+            .ml_class = vitals.ml_class,
+            .sqi_reason = vitals.sqi_reason,
+            .temp_x100 = vitals.temp_x100,
+        };
+        vitals_log_append(&vitals_log, &record);
+    }
+}
+
+// Cửa sổ bị cổng SQI loại (kèm các chỉ số để chẩn đoán)
+static void send_sqi_event(float temperature)
+{
+    tlm_evt_sqi_t sqi_event = {
+        .reason = (uint8_t)g_sqi.reason,
+        .ir_dc = (uint32_t)lrintf(g_sqi.ir_dc),
+        .perfusion_x100 = sat_u16(g_sqi.perfusion_index * 100.0f),
+        .clipped_x10 = sat_u16(g_sqi.clipped_percent * 10.0f),
+        .kurtosis_x10 = sat_i16(g_sqi.kurtosis * 10.0f),
+        .zc_hz_x100 = sat_u16(g_sqi.zero_crossing_hz * 100.0f),
+        .zc_cv_x100 = sat_u16(g_sqi.zero_crossing_cv * 100.0f),
+        .temp_x100 = sat_i16(temperature * 100.0f),
+    };
+    telemetry_send_event(TLM_EVT_SQI_REJECT, now_ms(), &sqi_event, sizeof(sqi_event));
+}
+
+// Thống kê bus I2C, FIFO gia tốc, AGC và chính kênh telemetry
+static void send_diagnostics(void)
+{
+    i2c_bus_stats_t bus_stats;
+    tlm_stats_t tlm_stats;
+    tlm_udp_stats_t udp_stats;
+    i2c_bus_get_stats(&bus_stats);
+    telemetry_get_stats(&tlm_stats);
+    telemetry_udp_get_stats(&udp_stats);
+
+    tlm_diag_t diag = {
+        .time_ms = now_ms(),
+        .i2c_freq_hz = bus_stats.freq_hz,
+        .i2c_transactions = bus_stats.transactions,
+        .i2c_errors = bus_stats.errors,
+        .i2c_timeouts = bus_stats.timeouts,
+        .i2c_probe_failures = bus_stats.probe_failures,
+        .accel_fifo_overflows = accel_fifo_ok ? mpu6050_fifo_overflow_count() : 0,
+        .agc_changes = led_agc.change_count,
+        .tlm_frames = tlm_stats.frames,
+        .tlm_dropped = tlm_stats.dropped,
+        .raw_frames = tlm_stats.raw_frames,
+        .raw_dropped = tlm_stats.raw_dropped,
+        .udp_datagrams = udp_stats.datagrams,
+        .udp_dropped = udp_stats.queue_dropped,
+        .udp_send_errors = udp_stats.send_errors,
+        .ppg_samples_lost = ppg_samples_lost,
+    };
+    telemetry_send(TLM_MSG_DIAG, &diag, sizeof(diag));
+#if PERF_STATS_ENABLED
+    report_perf_stats();
+#endif
+}
+
+#if PERF_STATS_ENABLED
+/**
+ * @brief Mỗi PERF_REPORT_INTERVAL_MS: một dòng log min/avg/p99/max (µs) cho từng bước
+ * và một khung TLM_MSG_PERF, rồi bắt đầu chu kỳ thống kê mới.
+ */
+static void report_perf_stats(void)
+{
+    static uint32_t interval_start_ms = 0;
+    uint32_t now = now_ms();
+    if (interval_start_ms == 0) {
+        interval_start_ms = now;
+    }
+    if (now - interval_start_ms < PERF_REPORT_INTERVAL_MS) {
+        return;
+    }
+
+    perf_summary_t summary[PERF_STAGE_COUNT];
+    perf_summarize(summary);
+    perf_reset();
+
+    tlm_perf_t perf = {
+        .time_ms = now,
+        .interval_ms = now - interval_start_ms,
+        .stage_count = (PERF_STAGE_COUNT < TLM_PERF_MAX_STAGES) ? PERF_STAGE_COUNT : TLM_PERF_MAX_STAGES,
+    };
+    char line[384] = "";
+    int len = 0;
+    for (int i = 0; i < perf.stage_count; i++) {
+        const perf_summary_t *s = &summary[i];
+        perf.stages[i] = (tlm_perf_stage_t){
+            .count = (uint16_t)(s->count > UINT16_MAX ? UINT16_MAX : s->count),
+            .min_us = s->min_us, .avg_us = s->avg_us, .p99_us = s->p99_us, .max_us = s->max_us,
+        };
+        if (s->count > 0 && len < (int)sizeof(line)) {
+            len += snprintf(line + len, sizeof(line) - len, " %s %lu/%lu/%lu/%lu",
+                            perf_stage_name((perf_stage_t)i), (unsigned long)s->min_us, (unsigned long)s->avg_us,
+                            (unsigned long)s->p99_us, (unsigned long)s->max_us);
+        }
     }
+    ESP_LOGI(TAG, "PERF min/avg/p99/max us:%s", line);
+    telemetry_send(TLM_MSG_PERF, &perf,
+                   offsetof(tlm_perf_t, stages) + perf.stage_count * sizeof(tlm_perf_stage_t));
+    interval_start_ms = now;
 }
+#endif
 
+/**
+ * @brief Dạng sóng thô: toàn bộ mẫu đọc từ FIFO MAX30102, ở tốc độ FIFO (trước hạ tốc), gom thành
+ * khối TLM_RAW_MAX_SAMPLES mẫu. Khối đang gom được gửi sớm khi chuỗi mẫu bị ngắt (lost > 0 hoặc
+ * mốc thời gian nhảy, ví dụ sau proximity) hoặc khi bắt đầu đoạn mới (restart: khởi động / AGC).
+ */
+static void send_raw_ppg(const int32_t *red, const int32_t *ir, int count, uint32_t t0_ms, uint8_t lost, bool restart)
+{
+    static int32_t block_red[TLM_RAW_MAX_SAMPLES], block_ir[TLM_RAW_MAX_SAMPLES];
+    static const int32_t *const channels[2] = { block_red, block_ir };
+    static int block_count = 0;
+    static uint32_t block_t0_ms;
+    static uint8_t block_flags;
+    const float period_ms = 1000.0f / acq_profile->output_rate_hz;
+    const uint16_t period_us = (uint16_t)lrintf(1000.0f * period_ms);
 
+    if (!telemetry_raw_enabled()) {
+        block_count = 0;
+        return;
+    }
+    if (block_count > 0) {
+        // Mốc đọc FIFO lệch tới ~1 chu kỳ + 1 ms; vượt 2 chu kỳ là có khoảng trống
+        int32_t jump_ms = (int32_t)(t0_ms - block_t0_ms) - (int32_t)lrintf(block_count * period_ms);
+        bool gap = lost > 0 || abs(jump_ms) > (int32_t)lrintf(2.0f * period_ms) + 1;
+        if (gap || (restart && !(block_flags & TLM_RAW_FLAG_DISCONTINUITY))) {
+            telemetry_send_raw(TLM_RAW_PPG, block_flags, block_t0_ms, period_us, channels, 2, block_count);
+            block_count = 0;
+        }
+    }
+    for (int k = 0; k < count; k++) {
+        if (block_count == 0) {
+            block_t0_ms = t0_ms + (uint32_t)lrintf(k * period_ms);
+            block_flags = (restart || lost > 0) ? TLM_RAW_FLAG_DISCONTINUITY : 0;
+        }
+        block_red[block_count] = red[k];
+        block_ir[block_count] = ir[k];
+        if (++block_count == TLM_RAW_MAX_SAMPLES) {
+            telemetry_send_raw(TLM_RAW_PPG, block_flags, block_t0_ms, period_us, channels, 2, block_count);
+            block_count = 0;
+        }
+    }
+}
+
+// Gia tốc thô theo từng khối TLM_RAW_MAX_SAMPLES mẫu
+static void send_raw_accel(const mpu6050_accel_raw_t *samples, int count, uint32_t t0_ms, uint32_t period_ms)
+{
+    static int32_t ax[TLM_RAW_MAX_SAMPLES], ay[TLM_RAW_MAX_SAMPLES], az[TLM_RAW_MAX_SAMPLES];
+    const int32_t *channels[3] = { ax, ay, az };
+
+    if (!telemetry_raw_enabled()) {
+        return;
+    }
+    for (int start = 0; start < count; start += TLM_RAW_MAX_SAMPLES) {
+        int n = count - start;
+        if (n > TLM_RAW_MAX_SAMPLES) n = TLM_RAW_MAX_SAMPLES;
+        for (int k = 0; k < n; k++) {
+            ax[k] = samples[start + k].x;
+            ay[k] = samples[start + k].y;
+            az[k] = samples[start + k].z;
+        }
+        telemetry_send_raw(TLM_RAW_ACCEL, 0, t0_ms + (uint32_t)start * period_ms,
+                           (uint16_t)(period_ms * 1000), channels, 3, n);
+    }
+}
+
+
+/**
+ * @brief Đọc hết FIFO MAX30102 vào vòng ppg_staging. Gọi quanh mọi việc chặn lâu (OLED, còi):
+ * FIFO 32 mẫu chỉ giữ 80 ms ở 400 sps. Mẫu mới nhất trong FIFO ứng với thời điểm đọc.
+ */
+static void drain_ppg_fifo(void)
+{
+    static int32_t fifo_red[MAX30102_FIFO_DEPTH];
+    static int32_t fifo_ir[MAX30102_FIFO_DEPTH];
+    const float fifo_period_ms = 1000.0f / acq_profile->output_rate_hz;
+    uint8_t lost = 0;
+
+    int fifo_count = max30102_fifo_available(&lost);
+    if (fifo_count <= 0 || read_max30102_fifo_burst(fifo_red, fifo_ir, fifo_count) != ESP_OK) {
+        return;
+    }
+    uint32_t t_read = now_ms();
+    ppg_samples_lost += lost;
+    send_raw_ppg(fifo_red, fifo_ir, fifo_count,
+                 t_read - (uint32_t)lrintf((fifo_count - 1) * fifo_period_ms), lost, !ppg.bandpass_primed);
+
+    for (int k = 0; k < fifo_count; k++) {
+        // Vòng đầy (xử lý chậm hơn tốc độ lấy mẫu): bỏ mẫu cũ nhất
+        if (ppg_staging.count == PPG_STAGING_SIZE) {
+            ppg_staging.head = (ppg_staging.head + 1) % PPG_STAGING_SIZE;
+            ppg_staging.count--;
+            ppg_samples_lost++;
+        }
+        int idx = (ppg_staging.head + ppg_staging.count) % PPG_STAGING_SIZE;
+        ppg_staging.red[idx] = fifo_red[k];
+        ppg_staging.ir[idx] = fifo_ir[k];
+        ppg_staging.t_ms[idx] = t_read - (uint32_t)lrintf((fifo_count - 1 - k) * fifo_period_ms);
+        ppg_staging.count++;
+    }
+}
+
+// Chờ duration_ms nhưng vẫn đọc FIFO mỗi PPG_POLL_MS (dùng thay vTaskDelay khi đang đo)
+static void delay_draining_fifo(uint32_t duration_ms)
+{
+    for (uint32_t waited = 0; waited < duration_ms; waited += PPG_POLL_MS) {
+        uint32_t step = duration_ms - waited;
+        vTaskDelay(pdMS_TO_TICKS(step < PPG_POLL_MS ? step : PPG_POLL_MS));
+        drain_ppg_fifo();
+    }
+}
+
+/**
+ * @brief Thu một cửa sổ window_len mẫu theo nhịp của FIFO MAX30102 (không theo vTaskDelay),
+ * hạ tốc theo profile bằng FIR polyphase. Mẫu lấy từ ppg_staging; phần dư để cho cửa sổ sau.
+ */
 void fill_buffers_data()
 {
-    for(int i = 0; i < BUFFER_SIZE; i++){
-        read_max30102_fifo(&red_data, &ir_data);
-        ir_data_buffer[i] = ir_data;
-        red_data_buffer[i] = red_data;
-        
-        ir_data = 0;
-        red_data = 0;
-        vTaskDelay(pdMS_TO_TICKS(DELAY_AMOSTRAGEM));
+    const float fifo_period_ms = 1000.0f / acq_profile->output_rate_hz;
+    const uint32_t group_delay_ms = (uint32_t)lrintf(decimator_delay_samples(&ppg.decim_fifo_ir) * fifo_period_ms);
+    int i = 0;
+    int last_drain = 0;
+
+    accel_win_count = 0;
+    sqi_reset(&ppg.sqi);
+
+    while (i < ppg.window_len) {
+        drain_ppg_fifo();
+        while (i < ppg.window_len && ppg_staging.count > 0) {
+            int idx = ppg_staging.head;
+            int32_t red, ir;
+            ppg_staging.head = (ppg_staging.head + 1) % PPG_STAGING_SIZE;
+            ppg_staging.count--;
+
+            // Tín hiệu bị gián đoạn (bắt đầu / AGC): nạp lại bộ hạ tốc ở mức DC mới
+            if (!ppg.bandpass_primed) {
+                decimator_reset(&ppg.decim_fifo_red, ppg_staging.red[idx]);
+                decimator_reset(&ppg.decim_fifo_ir, ppg_staging.ir[idx]);
+            }
+            decimator_process(&ppg.decim_fifo_red, ppg_staging.red[idx], &red);
+            if (!decimator_process(&ppg.decim_fifo_ir, ppg_staging.ir[idx], &ir)) {
+                continue;
+            }
+            // Mốc thời gian lùi theo trễ nhóm của FIR (pha tuyến tính)
+            ppg_store_sample(&ppg, i, red, ir, ppg_staging.t_ms[idx] - group_delay_ms);
+            i++;
+        }
+
+        if (accel_fifo_ok && i - last_drain >= ACCEL_DRAIN_INTERVAL) {
+            drain_accel_fifo();
+            last_drain = i;
+        }
+        if (i < ppg.window_len) {
+            vTaskDelay(pdMS_TO_TICKS(PPG_POLL_MS));
+        }
+    }
+
+    if (accel_fifo_ok) {
+        drain_accel_fifo();
+        // Căn chỉnh gia tốc theo mốc thời gian của từng mẫu PPG
+        align_to_timestamps(accel_win_t, accel_win_x, accel_win_count, ppg.time_ms, accel_x_buffer, ppg.window_len);
+        align_to_timestamps(accel_win_t, accel_win_y, accel_win_count, ppg.time_ms, accel_y_buffer, ppg.window_len);
+        align_to_timestamps(accel_win_t, accel_win_z, accel_win_count, ppg.time_ms, accel_z_buffer, ppg.window_len);
+    }
+}
+
+/**
+ * @brief Đọc burst toàn bộ mẫu trong FIFO MPU6050 và gán mốc thời gian.
+ * Mẫu cuối cùng trong FIFO ứng với thời điểm đọc, các mẫu trước cách nhau 1 chu kỳ lấy mẫu.
+ */
+static void drain_accel_fifo(void)
+{
+    static mpu6050_accel_raw_t samples[MPU6050_FIFO_SIZE / MPU6050_FIFO_SAMPLE_BYTES];
+    TRACE_BEGIN(ACCEL_DRAIN);
+    int count = mpu6050_fifo_read_accel(samples, MPU6050_FIFO_SIZE / MPU6050_FIFO_SAMPLE_BYTES);
+    TRACE_END(ACCEL_DRAIN);
+    uint32_t t_last = now_ms();
+    const uint32_t period_ms = (uint32_t)(1000.0f / ppg.sample_rate_hz);
+
+    for (int k = 0; k < count; k++) {
+        // Cửa sổ đầy: dịch bỏ mẫu cũ nhất
+        if (accel_win_count >= ACCEL_WINDOW_MAX) {
+            memmove(&accel_win_t[0], &accel_win_t[1], (ACCEL_WINDOW_MAX - 1) * sizeof(accel_win_t[0]));
+            memmove(&accel_win_x[0], &accel_win_x[1], (ACCEL_WINDOW_MAX - 1) * sizeof(accel_win_x[0]));
+            memmove(&accel_win_y[0], &accel_win_y[1], (ACCEL_WINDOW_MAX - 1) * sizeof(accel_win_y[0]));
+            memmove(&accel_win_z[0], &accel_win_z[1], (ACCEL_WINDOW_MAX - 1) * sizeof(accel_win_z[0]));
+            accel_win_count--;
+        }
+        accel_win_t[accel_win_count] = t_last - (uint32_t)(count - 1 - k) * period_ms;
+        accel_win_x[accel_win_count] = samples[k].x / MPU6050_ACCEL_LSB_PER_G;
+        accel_win_y[accel_win_count] = samples[k].y / MPU6050_ACCEL_LSB_PER_G;
+        accel_win_z[accel_win_count] = samples[k].z / MPU6050_ACCEL_LSB_PER_G;
+        accel_win_count++;
+    }
+    send_raw_accel(samples, count, t_last - (uint32_t)(count > 0 ? count - 1 : 0) * period_ms, period_ms);
+}
+
+/**
+ * @brief Lọc thông dải gia tốc (tại chỗ) bằng cùng đáp ứng với kênh PPG,
+ * để quan hệ tuyến tính giữa nhiễu chuyển động và tham chiếu được giữ nguyên cho NLMS.
+ */
+static void filter_accel_reference(void)
+{
+    float *axes[NLMS_AXES] = { accel_x_buffer, accel_y_buffer, accel_z_buffer };
+
+    for (int a = 0; a < NLMS_AXES; a++) {
+        if (!bandpass_accel_primed) {
+            bandpass_reset_f32(&bandpass_accel[a], axes[a][0]);
+        }
+        for (int i = 0; i < ppg.window_len; i++) {
+            axes[a][i] = bandpass_process_f32(&bandpass_accel[a], axes[a][i]);
+        }
+    }
+    bandpass_accel_primed = true;
+}
+
+/**
+ * @brief Task nền: định kỳ sao chép kho RR và tính LF/HF bằng Lomb-Scargle,
+ * để task đọc cảm biến không bị chặn bởi phép tính phổ.
+ */
+static void hrv_spectrum_task(void *pvParameters)
+{
+    static uint16_t rr_snapshot[HRV_STORE_SIZE];
+    hrv_metrics_t spectrum;
+
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(HRV_SPECTRUM_PERIOD_MS));
+
+        xSemaphoreTake(hrv_mutex, portMAX_DELAY);
+        int count = hrv_store_snapshot(&hrv_store, rr_snapshot, HRV_STORE_SIZE);
+        xSemaphoreGive(hrv_mutex);
+
+        TRACE_BEGIN(HRV_SPECTRUM);
+        hrv_frequency_domain(rr_snapshot, count, &spectrum);
+        TRACE_END(HRV_SPECTRUM);
+
+        xSemaphoreTake(hrv_mutex, portMAX_DELAY);
+        g_hrv_metrics.lf_power = spectrum.lf_power;
+        g_hrv_metrics.hf_power = spectrum.hf_power;
+        g_hrv_metrics.lf_hf_ratio = spectrum.lf_hf_ratio;
+        g_hrv_metrics.spectrum_valid = spectrum.spectrum_valid;
+        xSemaphoreGive(hrv_mutex);
     }
 }
\ No newline at end of file
@@ -3,13 +3,23 @@
 
 #include "esp_err.h"
 #include "max30102_api.h"
+#include "sdkconfig.h"
+#include "config_store.h"
 
 
 void sensor_data_processor(void *pvParameters);
 void sensor_data_reader(void *pvParameters);
 void fill_buffers_data();
 
-#define BUFFER_SIZE 128
+#define BUFFER_SIZE 512
+
+#define PPG_WINDOW_MS 5120            //Độ dài cửa sổ xử lý (128 mẫu ở 25 Hz)
+#define PPG_POLL_MS 20                //Chu kỳ kiểm tra FIFO MAX30102 khi thu cửa sổ
+
+// Phát hiện ngón tay bằng chế độ proximity của MAX30102
+#define PROX_THRESHOLD 0x14           //8 bit cao của ADC IR (~20000 count)
+#define PROX_ENTER_WINDOWS 2          //Số cửa sổ "No finger" liên tiếp trước khi ngủ
+#define PROX_POLL_MS 250              //Chu kỳ kiểm tra cờ PROX_INT khi ngủ
 
 //Configuração dos registradores do modo de funcionamento do sensor MAX30102. Basta colocar o valor binário da configuração que o compilador fará o trabalho de setar os bits corretos.
 max_config max30102_configuration = {
@@ -19,7 +29,7 @@ max_config max30102_configuration = {
 		.INT_EN_1.ALC_OVF_EN        = 0,
 		.INT_EN_1.PROX_INT_EN       = 0,
 
-		.INT_EN_2.DIE_TEMP_RDY_EN   = 0,
+		.INT_EN_2.DIE_TEMP_RDY_EN   = 1,      //Báo nhiệt độ sẵn sàng (đo bất đồng bộ)
 
 		.FIFO_WRITE_PTR.FIFO_WR_PTR = 0,
 
@@ -27,7 +37,7 @@ max_config max30102_configuration = {
 
 		.FIFO_READ_PTR.FIFO_RD_PTR  = 0,
 
-		.FIFO_CONF.SMP_AVE          = 0b010,  //média de 4 valores
+		.FIFO_CONF.SMP_AVE          = 0b010,  //média de 4 valores (ghi đè bởi profile thu mẫu)
 		.FIFO_CONF.FIFO_ROLLOVER_EN = 1,      //fifo rollover enable
 		.FIFO_CONF.FIFO_A_FULL      = 0,      //0
 
@@ -36,13 +46,13 @@ max_config max30102_configuration = {
 		.MODE_CONF.MODE             = 0b011,  //SPO2 mode
 
 		.SPO2_CONF.SPO2_ADC_RGE     = 0b01,   //16384 nA(Escala do DAC)
-		.SPO2_CONF.SPO2_SR          = 0b001,  //200 samples per second
-		.SPO2_CONF.LED_PW           = 0b10,   //pulso de 215 uS do led.
+		.SPO2_CONF.SPO2_SR          = 0b001,  //Ghi đè bởi profile thu mẫu
+		.SPO2_CONF.LED_PW           = 0b10,   //Ghi đè bởi profile thu mẫu
 
-		.LED1_PULSE_AMP.LED1_PA     = 0x24,   //CORRENTE DO LED1 25.4mA
-		.LED2_PULSE_AMP.LED2_PA     = 0x24,   //CORRENTE DO LED2 25.4mA
+		.LED1_PULSE_AMP.LED1_PA     = LED_PA_DEFAULT,   //Ghi đè bởi cấu hình "led1_pa"
+		.LED2_PULSE_AMP.LED2_PA     = LED_PA_DEFAULT,   //Ghi đè bởi cấu hình "led2_pa"
 
-		.PROX_LED_PULS_AMP.PILOT_PA = 0X7F,
+		.PROX_LED_PULS_AMP.PILOT_PA = 0x19,   //LED pilot ~5mA cho chế độ proximity
 
 		.MULTI_LED_CONTROL1.SLOT2   = 0,      //Desabilitado
 		.MULTI_LED_CONTROL1.SLOT1   = 0,      //Desabilitado
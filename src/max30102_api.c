@@ -1,5 +1,9 @@
 #include "max30102_api.h"
 #include "i2c_api.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
 
 
 void max30102_init(max_config *configuration)
@@ -19,14 +23,52 @@ void max30102_init(max_config *configuration)
 }
 
 
+static const max30102_profile_t profiles[MAX30102_PROFILE_COUNT] = {
+	[MAX30102_PROFILE_LOW_POWER] = {
+		.name = "low-power", .spo2_sr = 0b000, .smp_ave = 0b001, .led_pw = 0b01,   //50 sps / 2
+		.output_rate_hz = 25, .decimation = 1,
+	},
+	[MAX30102_PROFILE_STANDARD] = {
+		.name = "standard", .spo2_sr = 0b001, .smp_ave = 0b000, .led_pw = 0b10,    //100 sps
+		.output_rate_hz = 100, .decimation = 2,
+	},
+	[MAX30102_PROFILE_HIGH_RES] = {
+		.name = "high-res", .spo2_sr = 0b011, .smp_ave = 0b000, .led_pw = 0b11,    //400 sps
+		.output_rate_hz = 400, .decimation = 4,
+	},
+};
+
+
+const max30102_profile_t *max30102_get_profile(max30102_profile_id_t id)
+{
+	if (id < 0 || id >= MAX30102_PROFILE_COUNT) {
+		return NULL;
+	}
+	return &profiles[id];
+}
+
+
+/**
+ * Ghi mã tốc độ / độ rộng xung / trung bình của profile vào cấu hình rồi nạp lại
+ * toàn bộ thanh ghi bằng max30102_init. FIFO được xóa vì các mẫu cũ thuộc tốc độ trước.
+ */
+void max30102_apply_profile(max_config *configuration, const max30102_profile_t *profile)
+{
+	configuration->SPO2_CONF.SPO2_SR = profile->spo2_sr;
+	configuration->SPO2_CONF.LED_PW = profile->led_pw;
+	configuration->FIFO_CONF.SMP_AVE = profile->smp_ave;
+
+	max30102_init(configuration);
+	max30102_clear_fifo();
+}
+
+
 void read_max30102_fifo(int32_t *red_data, int32_t *ir_data)
 {
 	uint8_t un_temp[6];
-	uint8_t fifo_reg = REG_FIFO_DATA;
 
-    i2c_sensor_write(&fifo_reg, 1);
-
-    i2c_sensor_read(un_temp, 6);
+	// Một giao dịch repeated START: ghi REG_FIFO_DATA rồi đọc 6 byte
+	i2c_sensor_read_reg(REG_FIFO_DATA, un_temp, 6);
      *red_data += un_temp[0] << 16;
      *red_data += un_temp[1] << 8;
      *red_data += un_temp[2];
@@ -39,10 +81,236 @@ void read_max30102_fifo(int32_t *red_data, int32_t *ir_data)
 }
 
 
-void read_max30102_reg(uint8_t reg_addr, uint8_t *data_reg, size_t bytes_to_read)
+esp_err_t read_max30102_fifo_burst(int32_t *red_data, int32_t *ir_data, size_t samples)
+{
+	uint8_t un_temp[MAX30102_FIFO_DEPTH * 6];
+
+	if (samples == 0) {
+		return ESP_OK;
+	}
+	if (samples > MAX30102_FIFO_DEPTH) {
+		samples = MAX30102_FIFO_DEPTH;
+	}
+
+	// Con trỏ FIFO_DATA không tự tăng địa chỉ: đọc liên tục sẽ lấy lần lượt từng mẫu
+	esp_err_t ret = i2c_sensor_read_reg(REG_FIFO_DATA, un_temp, samples * 6);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	for (size_t i = 0; i < samples; i++) {
+		const uint8_t *p = &un_temp[i * 6];
+		red_data[i] = ((p[0] << 16) | (p[1] << 8) | p[2]) & MAX30102_ADC_MASK;
+		ir_data[i]  = ((p[3] << 16) | (p[4] << 8) | p[5]) & MAX30102_ADC_MASK;
+	}
+	return ESP_OK;
+}
+
+
+esp_err_t read_max30102_fifo_ptrs(uint8_t *wr_ptr, uint8_t *ovf_counter, uint8_t *rd_ptr)
+{
+	uint8_t ptrs[3];
+
+	// WR_PTR (0x04), OVF_COUNTER (0x05), RD_PTR (0x06) liền kề: đọc 3 byte một lần
+	esp_err_t ret = i2c_sensor_read_reg(REG_FIFO_WR_PTR, ptrs, 3);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	*wr_ptr      = ptrs[0] & 0x1F;
+	*ovf_counter = ptrs[1] & 0x1F;
+	*rd_ptr      = ptrs[2] & 0x1F;
+	return ESP_OK;
+}
+
+
+/**
+ * Số mẫu đang chờ trong FIFO. Nếu lost khác NULL: số mẫu đã mất do FIFO tràn kể từ lần đọc
+ * trước (OVF_COUNTER, bão hòa ở 31, tự xóa khi đọc một mẫu).
+ */
+int max30102_fifo_available(uint8_t *lost)
+{
+	uint8_t wr_ptr, ovf_counter, rd_ptr;
+
+	if (read_max30102_fifo_ptrs(&wr_ptr, &ovf_counter, &rd_ptr) != ESP_OK) {
+		return -1;
+	}
+	if (lost != NULL) {
+		*lost = ovf_counter;
+	}
+	// FIFO đã tràn: toàn bộ 32 mẫu đều hợp lệ
+	if (ovf_counter > 0) {
+		return MAX30102_FIFO_DEPTH;
+	}
+	return (wr_ptr - rd_ptr) & (MAX30102_FIFO_DEPTH - 1);
+}
+
+
+void max30102_clear_fifo(void)
+{
+	write_max30102_reg(0, REG_FIFO_WR_PTR);
+	write_max30102_reg(0, REG_OVF_COUNTER);
+	write_max30102_reg(0, REG_FIFO_RD_PTR);
+}
+
+
+/**
+ * Bật PROX_INT_EN và ghi lại MODE_CONFIG để cảm biến khởi động lại ở chế độ proximity:
+ * chỉ LED IR phát với dòng PILOT_PA cho tới khi 8 bit cao của ADC IR vượt threshold,
+ * khi đó cảm biến tự chuyển về chế độ SpO2 và bật cờ PROX_INT.
+ */
+void max30102_enter_proximity_mode(max_config *configuration, uint8_t threshold)
+{
+	uint8_t status;
+
+	write_max30102_reg(configuration->data11, REG_PILOT_PA);
+	write_max30102_reg(threshold, REG_PROX_INT_THRESH);
+	write_max30102_reg(configuration->data1 | MAX30102_PROX_INT, REG_INTR_ENABLE_1);
+	read_max30102_reg(REG_INTR_STATUS_1, &status, 1); // Xóa cờ cũ
+	write_max30102_reg(configuration->data7, REG_MODE_CONFIG);
+}
+
+
+bool max30102_proximity_detected(void)
 {
-	i2c_sensor_write(&reg_addr, 1);
-	i2c_sensor_read(data_reg, bytes_to_read);
+	uint8_t status;
+
+	if (read_max30102_reg(REG_INTR_STATUS_1, &status, 1) != ESP_OK) {
+		return false;
+	}
+	return (status & MAX30102_PROX_INT) != 0;
+}
+
+
+void max30102_exit_proximity_mode(max_config *configuration)
+{
+	write_max30102_reg(configuration->data1 & ~MAX30102_PROX_INT, REG_INTR_ENABLE_1);
+	max30102_clear_fifo();
+}
+
+
+void max30102_agc_init(max30102_agc_t *agc)
+{
+	memset(agc, 0, sizeof(*agc));
+}
+
+
+// Dòng LED mới đưa DC về mức mục tiêu; giữ nguyên nếu DC đang trong vùng trễ
+static uint8_t agc_next_pa(uint8_t pa, float dc, bool clipped)
+{
+	const float low = AGC_DC_LOW_FRACTION * MAX30102_ADC_FULL_SCALE;
+	const float high = AGC_DC_HIGH_FRACTION * MAX30102_ADC_FULL_SCALE;
+	const float target = AGC_DC_TARGET_FRACTION * MAX30102_ADC_FULL_SCALE;
+	float next = pa;
+
+	if (clipped) {
+		// Bão hòa: DC đo được không tin cậy, giảm một nửa
+		next = pa / 2.0f;
+	} else if (dc > high || dc < low) {
+		next = (dc > 0.0f) ? pa * target / dc : AGC_PA_MAX;
+	}
+
+	if (next < AGC_PA_MIN) next = AGC_PA_MIN;
+	if (next > AGC_PA_MAX) next = AGC_PA_MAX;
+	return (uint8_t)lrintf(next);
+}
+
+
+/**
+ * Ghi dòng LED / dải ADC mới xuống cảm biến, điền event (hệ số biên độ mới/cũ) và ghi nhật ký.
+ */
+static void agc_apply(max30102_agc_t *agc, max_config *configuration, uint8_t new_red, uint8_t new_ir,
+                      uint8_t new_rge, max30102_agc_event_t *event)
+{
+	uint8_t old_red = configuration->LED1_PULSE_AMP.LED1_PA;
+	uint8_t old_ir = configuration->LED2_PULSE_AMP.LED2_PA;
+	uint8_t old_rge = configuration->SPO2_CONF.SPO2_ADC_RGE;
+
+	configuration->LED1_PULSE_AMP.LED1_PA = new_red;
+	configuration->LED2_PULSE_AMP.LED2_PA = new_ir;
+	configuration->SPO2_CONF.SPO2_ADC_RGE = new_rge;
+	write_max30102_reg(configuration->data9, REG_LED1_PA);
+	write_max30102_reg(configuration->data10, REG_LED2_PA);
+	if (new_rge != old_rge) {
+		write_max30102_reg(configuration->data8, REG_SPO2_CONFIG);
+	}
+
+	// Biên độ tỷ lệ thuận với dòng LED và tỷ lệ nghịch với thang đo ADC (2048 nA << RGE)
+	float range_ratio = (float)(1 << old_rge) / (float)(1 << new_rge);
+	event->time_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+	event->old_led1_pa = old_red;
+	event->new_led1_pa = new_red;
+	event->old_led2_pa = old_ir;
+	event->new_led2_pa = new_ir;
+	event->old_adc_rge = old_rge;
+	event->new_adc_rge = new_rge;
+	event->red_gain_ratio = (old_red > 0) ? (float)new_red / old_red * range_ratio : range_ratio;
+	event->ir_gain_ratio = (old_ir > 0) ? (float)new_ir / old_ir * range_ratio : range_ratio;
+
+	agc->log[agc->log_head] = *event;
+	agc->log_head = (agc->log_head + 1) % AGC_LOG_SIZE;
+	agc->change_count++;
+}
+
+
+/**
+ * Gọi sau mỗi cửa sổ với DC và tỷ lệ mẫu bão hòa của cửa sổ đó. Điều chỉnh LED1/LED2 PA
+ * theo DC; khi dòng LED đã chạm giới hạn thì đổi SPO2_ADC_RGE. Mọi thay đổi được ghi vào
+ * nhật ký kèm hệ số biên độ (mới/cũ) để DSP phía sau chuẩn hóa qua bước nhảy.
+ * @return true nếu cấu hình thay đổi (event được điền)
+ */
+bool max30102_agc_update(max30102_agc_t *agc, max_config *configuration, float red_dc, float ir_dc,
+                         float clipped_percent, max30102_agc_event_t *event)
+{
+	const float low = AGC_DC_LOW_FRACTION * MAX30102_ADC_FULL_SCALE;
+	const float high = AGC_DC_HIGH_FRACTION * MAX30102_ADC_FULL_SCALE;
+	bool clipped = clipped_percent > 0.0f;
+
+	uint8_t old_red = configuration->LED1_PULSE_AMP.LED1_PA;
+	uint8_t old_ir = configuration->LED2_PULSE_AMP.LED2_PA;
+	uint8_t old_rge = configuration->SPO2_CONF.SPO2_ADC_RGE;
+	uint8_t new_red = agc_next_pa(old_red, red_dc, clipped && red_dc >= ir_dc);
+	uint8_t new_ir = agc_next_pa(old_ir, ir_dc, clipped && ir_dc >= red_dc);
+	uint8_t new_rge = old_rge;
+
+	// Dòng LED đã ở giới hạn: đổi dải ADC (mỗi bước gấp đôi thang đo)
+	if (old_red == AGC_PA_MAX && old_ir == AGC_PA_MAX && red_dc < low && ir_dc < low && old_rge > 0) {
+		new_rge = old_rge - 1;
+		new_red = old_red;
+		new_ir = old_ir;
+	} else if ((old_red == AGC_PA_MIN || old_ir == AGC_PA_MIN) && (clipped || red_dc > high || ir_dc > high) &&
+			   old_rge < AGC_ADC_RGE_MAX) {
+		new_rge = old_rge + 1;
+		new_red = old_red;
+		new_ir = old_ir;
+	}
+
+	if (new_red == old_red && new_ir == old_ir && new_rge == old_rge) {
+		return false;
+	}
+	agc_apply(agc, configuration, new_red, new_ir, new_rge, event);
+	return true;
+}
+
+
+/**
+ * Đặt dòng LED theo yêu cầu từ ngoài (cấu hình chạy), giữ nguyên dải ADC. Đi qua cùng nhật ký
+ * và event như một bước AGC để DSP chuẩn hóa qua bước nhảy biên độ.
+ * @return true nếu dòng LED thay đổi (event được điền)
+ */
+bool max30102_agc_set_led(max30102_agc_t *agc, max_config *configuration, uint8_t red_pa, uint8_t ir_pa,
+                          max30102_agc_event_t *event)
+{
+	if (red_pa == configuration->LED1_PULSE_AMP.LED1_PA && ir_pa == configuration->LED2_PULSE_AMP.LED2_PA) {
+		return false;
+	}
+	agc_apply(agc, configuration, red_pa, ir_pa, configuration->SPO2_CONF.SPO2_ADC_RGE, event);
+	return true;
+}
+
+
+esp_err_t read_max30102_reg(uint8_t reg_addr, uint8_t *data_reg, size_t bytes_to_read)
+{
+	return i2c_sensor_read_reg(reg_addr, data_reg, bytes_to_read);
 }
 
 
@@ -55,16 +323,102 @@ void write_max30102_reg(uint8_t command, uint8_t reg)
 }
 
 
-float get_max30102_temp()
+// Trạng thái đo nhiệt độ bất đồng bộ
+static struct {
+	TickType_t period_ticks;
+	TickType_t last_trigger;
+	bool pending;
+	bool valid;
+	float temp_c;
+} temp_state = { .period_ticks = pdMS_TO_TICKS(MAX30102_TEMP_PERIOD_MS) };
+
+
+static float convert_max30102_temp(const uint8_t *raw)
+{
+	// TINT: số nguyên bù 2 (°C), TFRAC: 4 bit thấp, bước 0.0625 °C
+	return (int8_t)raw[0] + (raw[1] & 0x0F) * 0.0625f;
+}
+
+
+esp_err_t max30102_temp_trigger(void)
 {
-	uint8_t int_temp;
-	uint8_t decimal_temp;
-	float temp = 0;
 	write_max30102_reg(1, REG_TEMP_CONFIG);
-	read_max30102_reg(REG_TEMP_INTR, &int_temp, 1);
-	read_max30102_reg(REG_TEMP_FRAC, &decimal_temp, 1);
-	temp = (int_temp + ((float)decimal_temp/10));
-	return temp;
+	temp_state.pending = true;
+	temp_state.last_trigger = xTaskGetTickCount();
+	return ESP_OK;
+}
+
+
+bool max30102_temp_collect(void)
+{
+	uint8_t status;
+	uint8_t raw[2];
+
+	if (!temp_state.pending) {
+		return false;
+	}
+	// Đọc INTR_STATUS_2 sẽ xóa cờ DIE_TEMP_RDY
+	if (read_max30102_reg(REG_INTR_STATUS_2, &status, 1) != ESP_OK || !(status & MAX30102_DIE_TEMP_RDY)) {
+		return false;
+	}
+	// TEMP_INTR (0x1F) và TEMP_FRAC (0x20) liền kề: đọc 2 byte một lần
+	if (read_max30102_reg(REG_TEMP_INTR, raw, 2) != ESP_OK) {
+		return false;
+	}
+	temp_state.temp_c = convert_max30102_temp(raw);
+	temp_state.valid = true;
+	temp_state.pending = false;
+	return true;
+}
+
+
+void max30102_temp_service(void)
+{
+	if (temp_state.pending) {
+		// Cờ DIE_TEMP_RDY bị mất (ví dụ đã bị đọc ở nơi khác): bỏ lần đo này
+		if (!max30102_temp_collect() &&
+			(xTaskGetTickCount() - temp_state.last_trigger) >= pdMS_TO_TICKS(MAX30102_TEMP_TIMEOUT_MS)) {
+			temp_state.pending = false;
+		}
+		return;
+	}
+	if (!temp_state.valid || (xTaskGetTickCount() - temp_state.last_trigger) >= temp_state.period_ticks) {
+		max30102_temp_trigger();
+	}
+}
+
+
+void max30102_temp_set_period(uint32_t period_ms)
+{
+	temp_state.period_ticks = pdMS_TO_TICKS(period_ms);
+}
+
+
+bool max30102_temp_get(float *temp_c)
+{
+	if (temp_state.valid) {
+		*temp_c = temp_state.temp_c;
+	}
+	return temp_state.valid;
+}
+
+
+float get_max30102_temp()
+{
+	uint8_t raw[2];
+
+	// Phiên bản chặn: kích hoạt và chờ DIE_TEMP_RDY (tối đa ~29 ms theo datasheet)
+	max30102_temp_trigger();
+	for (int i = 0; i < 5 && temp_state.pending; i++) {
+		vTaskDelay(pdMS_TO_TICKS(10));
+		max30102_temp_collect();
+	}
+	if (temp_state.pending) {
+		read_max30102_reg(REG_TEMP_INTR, raw, 2);
+		temp_state.pending = false;
+		return convert_max30102_temp(raw);
+	}
+	return temp_state.temp_c;
 }
 
 
@@ -2,6 +2,9 @@
 #define MAX30102_H
 
 #include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
 #define REG_INTR_STATUS_1 0x00
 #define REG_INTR_STATUS_2 0x01
@@ -26,6 +29,16 @@
 #define REG_REV_ID 0xFE
 #define REG_PART_ID 0xFF
 
+#define MAX30102_PART_ID 0x15
+
+#define MAX30102_PROX_INT 0x10       //Bit PROX_INT trong REG_INTR_STATUS_1 / REG_INTR_ENABLE_1
+#define MAX30102_DIE_TEMP_RDY 0x02   //Bit DIE_TEMP_RDY trong REG_INTR_STATUS_2
+#define MAX30102_TEMP_PERIOD_MS 30000 //Chu kỳ đo nhiệt độ mặc định
+#define MAX30102_TEMP_TIMEOUT_MS 1000 //Bỏ lần đo nếu không có DIE_TEMP_RDY sau thời gian này
+
+#define MAX30102_FIFO_DEPTH 32
+#define MAX30102_ADC_MASK 0x3FFFF   //Dữ liệu ADC 18 bit
+
 
 typedef struct{
 	union{
@@ -145,12 +158,83 @@ typedef struct{
 }max_config;
 
 
+// =========================================================
+// AGC: ĐIỀU CHỈNH DÒNG LED VÀ DẢI ADC GIỮA CÁC CỬA SỔ
+// =========================================================
+#define MAX30102_ADC_FULL_SCALE 262143
+#define AGC_DC_LOW_FRACTION 0.30f    //Dưới ngưỡng này: tăng dòng LED
+#define AGC_DC_HIGH_FRACTION 0.70f   //Trên ngưỡng này: giảm dòng LED (khoảng giữa = trễ)
+#define AGC_DC_TARGET_FRACTION 0.50f
+#define AGC_PA_MIN 0x04              //~0.8 mA
+#define AGC_PA_MAX 0xFF              //51 mA
+#define AGC_ADC_RGE_MAX 0b11         //16384 nA
+#define AGC_LOG_SIZE 16
+
+typedef struct {
+	uint32_t time_ms;
+	uint8_t old_led1_pa, new_led1_pa;   //LED1 = Red trong chế độ SpO2
+	uint8_t old_led2_pa, new_led2_pa;   //LED2 = IR
+	uint8_t old_adc_rge, new_adc_rge;
+	float red_gain_ratio;               //Hệ số nhân biên độ (mới/cũ) để chuẩn hóa tín hiệu
+	float ir_gain_ratio;
+} max30102_agc_event_t;
+
+typedef struct {
+	max30102_agc_event_t log[AGC_LOG_SIZE];  //Lịch sử mọi thay đổi (vòng)
+	int log_head;
+	uint32_t change_count;
+} max30102_agc_t;
+
+// =========================================================
+// PROFILE THU MẪU: TỐC ĐỘ, ĐỘ RỘNG XUNG LED VÀ SỐ MẪU TRUNG BÌNH TRÊN CHIP
+// =========================================================
+typedef enum {
+	MAX30102_PROFILE_LOW_POWER = 0,     //25 sps, xung 118 us (16 bit)
+	MAX30102_PROFILE_STANDARD,          //100 sps, xung 215 us (17 bit)
+	MAX30102_PROFILE_HIGH_RES,          //400 sps, xung 411 us (18 bit)
+	MAX30102_PROFILE_COUNT
+} max30102_profile_id_t;
+
+typedef struct {
+	const char *name;
+	uint8_t spo2_sr;                    //Mã SPO2_SR
+	uint8_t smp_ave;                    //Mã SMP_AVE
+	uint8_t led_pw;                     //Mã LED_PW
+	uint16_t output_rate_hz;            //Tốc độ mẫu ra FIFO = SR / số mẫu trung bình
+	uint8_t decimation;                 //Hệ số hạ tốc trước khi xử lý
+} max30102_profile_t;
+
+const max30102_profile_t *max30102_get_profile(max30102_profile_id_t id);
+void max30102_apply_profile(max_config *configuration, const max30102_profile_t *profile);
+
 void max30102_init(max_config *configuration);
 void write_max30102_reg(uint8_t command, uint8_t reg);
 //void read_max30102_fifo(uint32_t *red_data, uint32_t *ir_data);
 void read_max30102_fifo(int32_t *red_data, int32_t *ir_data);
 float get_max30102_temp();
-void read_max30102_reg(uint8_t reg_addr, uint8_t *data_reg, size_t bytes_to_read);
+
+// Đo nhiệt độ bất đồng bộ: kích hoạt định kỳ, thu kết quả khi DIE_TEMP_RDY bật
+esp_err_t max30102_temp_trigger(void);
+bool max30102_temp_collect(void);
+void max30102_temp_service(void);
+void max30102_temp_set_period(uint32_t period_ms);
+bool max30102_temp_get(float *temp_c);
+esp_err_t read_max30102_reg(uint8_t reg_addr, uint8_t *data_reg, size_t bytes_to_read);
+esp_err_t read_max30102_fifo_burst(int32_t *red_data, int32_t *ir_data, size_t samples);
+esp_err_t read_max30102_fifo_ptrs(uint8_t *wr_ptr, uint8_t *ovf_counter, uint8_t *rd_ptr);
+int max30102_fifo_available(uint8_t *lost);
+void max30102_clear_fifo(void);
+
+// Chế độ proximity: chỉ bật LED pilot cho tới khi IR vượt ngưỡng (có ngón tay)
+void max30102_enter_proximity_mode(max_config *configuration, uint8_t threshold);
+bool max30102_proximity_detected(void);
+void max30102_exit_proximity_mode(max_config *configuration);
+
+void max30102_agc_init(max30102_agc_t *agc);
+bool max30102_agc_update(max30102_agc_t *agc, max_config *configuration, float red_dc, float ir_dc,
+                         float clipped_percent, max30102_agc_event_t *event);
+bool max30102_agc_set_led(max30102_agc_t *agc, max_config *configuration, uint8_t red_pa, uint8_t ir_pa,
+                          max30102_agc_event_t *event);
 
 
 #endif
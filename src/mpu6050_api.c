@@ -6,7 +6,9 @@
 #include "driver/i2c.h" // Cần thiết cho các lệnh I2C
 
 static const char *MPU_TAG = "MPU6050_DRV";
-static const float ACCEL_SCALE_FACTOR = 16384.0f; // Scale factor cho dải +/- 2g
+static const float ACCEL_SCALE_FACTOR = MPU6050_ACCEL_LSB_PER_G;
+
+static uint32_t fifo_overflows = 0;
 
 // Hàm I2C Write cho MPU6050
 static esp_err_t mpu_write_register(uint8_t reg_addr, uint8_t data)
@@ -17,7 +19,7 @@ static esp_err_t mpu_write_register(uint8_t reg_addr, uint8_t data)
     i2c_master_write_byte(cmd, (MPU6050_ADDR << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
     i2c_master_write(cmd, tx_buf, 2, ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, pdMS_TO_TICKS(100));
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(100));
     i2c_cmd_link_delete(cmd);
     return ret;
 }
@@ -42,7 +44,7 @@ static esp_err_t mpu_read_registers(uint8_t reg_addr, uint8_t *data, size_t len)
     i2c_master_read_byte(cmd, data + len - 1, NACK_VAL);
     i2c_master_stop(cmd);
     
-    esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, pdMS_TO_TICKS(100));
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(100));
     i2c_cmd_link_delete(cmd);
     return ret;
 }
@@ -61,7 +63,7 @@ esp_err_t mpu6050_init(void)
     if (ret != ESP_OK) return ret;
     
     // 3. Cấu hình dải đo gia tốc +/- 2g (ACCEL_CONFIG - thanh ghi 0x1C)
-    ret = mpu_write_register(0x1C, ACCEL_FS_SEL_2G);
+    ret = mpu_write_register(MPU6050_REG_ACCEL_CONFIG, ACCEL_FS_SEL_2G);
     if (ret != ESP_OK) return ret;
     
     ESP_LOGI(MPU_TAG, "MPU6050 initialized.");
@@ -87,4 +89,80 @@ esp_err_t mpu6050_read_accel(float *ax, float *ay, float *az)
         *az = (float)accel_raw[2] / ACCEL_SCALE_FACTOR;
     }
     return ret;
+}
+
+esp_err_t mpu6050_fifo_reset(void)
+{
+    esp_err_t ret = mpu_write_register(MPU6050_REG_USER_CTRL, MPU6050_USER_CTRL_FIFO_RESET);
+    if (ret != ESP_OK) return ret;
+    return mpu_write_register(MPU6050_REG_USER_CTRL, MPU6050_USER_CTRL_FIFO_EN);
+}
+
+esp_err_t mpu6050_fifo_init(uint16_t sample_rate_hz)
+{
+    esp_err_t ret;
+
+    if (sample_rate_hz == 0 || sample_rate_hz > 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 1. Bật DLPF: tần số gốc 1 kHz, chống alias cho tốc độ lấy mẫu thấp
+    ret = mpu_write_register(MPU6050_REG_CONFIG, MPU6050_DLPF_CFG_44HZ);
+    if (ret != ESP_OK) return ret;
+
+    // 2. Sample Rate = 1 kHz / (1 + SMPLRT_DIV)
+    ret = mpu_write_register(MPU6050_REG_SMPLRT_DIV, (uint8_t)(1000 / sample_rate_hz - 1));
+    if (ret != ESP_OK) return ret;
+
+    // 3. Chỉ ghi Accel vào FIFO
+    ret = mpu_write_register(MPU6050_REG_FIFO_EN, MPU6050_FIFO_EN_ACCEL);
+    if (ret != ESP_OK) return ret;
+
+    // 4. Reset và bật FIFO
+    ret = mpu6050_fifo_reset();
+    if (ret != ESP_OK) return ret;
+
+    ESP_LOGI(MPU_TAG, "MPU6050 FIFO enabled at %u Hz.", sample_rate_hz);
+    return ESP_OK;
+}
+
+int mpu6050_fifo_read_accel(mpu6050_accel_raw_t *samples, int max_samples)
+{
+    uint8_t count_raw[2];
+    uint8_t status;
+    static uint8_t raw_data[MPU6050_FIFO_SIZE];
+
+    // FIFO tràn: dữ liệu đã lệch khung 6 byte, phải reset
+    if (mpu_read_registers(MPU6050_REG_INT_STATUS, &status, 1) != ESP_OK) return -1;
+    if (status & MPU6050_INT_FIFO_OFLOW) {
+        fifo_overflows++;
+        ESP_LOGW(MPU_TAG, "MPU6050 FIFO overflow, resetting.");
+        mpu6050_fifo_reset();
+        return 0;
+    }
+
+    if (mpu_read_registers(MPU6050_REG_FIFO_COUNTH, count_raw, 2) != ESP_OK) return -1;
+    int count = ((count_raw[0] << 8) | count_raw[1]) / MPU6050_FIFO_SAMPLE_BYTES;
+    if (count > max_samples) {
+        count = max_samples;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // Đọc burst tất cả mẫu từ FIFO_R_W (địa chỉ không tự tăng)
+    if (mpu_read_registers(MPU6050_REG_FIFO_R_W, raw_data, count * MPU6050_FIFO_SAMPLE_BYTES) != ESP_OK) return -1;
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t *p = &raw_data[i * MPU6050_FIFO_SAMPLE_BYTES];
+        samples[i].x = (int16_t)((p[0] << 8) | p[1]);
+        samples[i].y = (int16_t)((p[2] << 8) | p[3]);
+        samples[i].z = (int16_t)((p[4] << 8) | p[5]);
+    }
+    return count;
+}
+
+uint32_t mpu6050_fifo_overflow_count(void)
+{
+    return fifo_overflows;
 }
\ No newline at end of file
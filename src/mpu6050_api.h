@@ -11,15 +11,48 @@
 // Các thanh ghi cần thiết
 #define MPU6050_REG_PWR_MGMT_1 0x6B
 #define MPU6050_REG_ACCEL_XOUT_H 0x3B
+#define MPU6050_REG_WHO_AM_I 0x75
+#define MPU6050_WHO_AM_I_VAL 0x68
+#define MPU6050_REG_SMPLRT_DIV 0x19
+#define MPU6050_REG_CONFIG 0x1A
+#define MPU6050_REG_ACCEL_CONFIG 0x1C
+#define MPU6050_REG_FIFO_EN 0x23
+#define MPU6050_REG_INT_STATUS 0x3A
+#define MPU6050_REG_USER_CTRL 0x6A
+#define MPU6050_REG_FIFO_COUNTH 0x72
+#define MPU6050_REG_FIFO_R_W 0x74
 
 // Cấu hình
 #define PWR_MGMT_1_RESET 0x80
 #define PWR_MGMT_1_CLKSEL_X_AXIS 0x01
 #define ACCEL_FS_SEL_2G 0x00 // Chọn dải đo +/- 2g
+#define MPU6050_ACCEL_LSB_PER_G 16384.0f // Scale factor cho dải +/- 2g
+
+// Cấu hình FIFO
+#define MPU6050_DLPF_CFG_44HZ 0x03      // DLPF bật -> tần số gốc 1 kHz, băng thông accel 44 Hz
+#define MPU6050_FIFO_EN_ACCEL 0x08      // Chỉ đưa Accel X/Y/Z vào FIFO (6 byte/mẫu)
+#define MPU6050_USER_CTRL_FIFO_EN 0x40
+#define MPU6050_USER_CTRL_FIFO_RESET 0x04
+#define MPU6050_INT_FIFO_OFLOW 0x10
+#define MPU6050_FIFO_SIZE 1024
+#define MPU6050_FIFO_SAMPLE_BYTES 6
+
+// Một mẫu gia tốc thô từ FIFO
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} mpu6050_accel_raw_t;
 
 // Khai báo hàm
 esp_err_t mpu6050_init(void);
 esp_err_t mpu6050_read_accel(float *ax, float *ay, float *az);
+
+// FIFO gia tốc: cấu hình tốc độ lấy mẫu và đọc burst toàn bộ mẫu đã tích lũy
+esp_err_t mpu6050_fifo_init(uint16_t sample_rate_hz);
+esp_err_t mpu6050_fifo_reset(void);
+int mpu6050_fifo_read_accel(mpu6050_accel_raw_t *samples, int max_samples);
+uint32_t mpu6050_fifo_overflow_count(void);
 // Có thể thêm hàm đọc gyro nếu cần: esp_err_t mpu6050_read_gyro(float *gx, float *gy, float *gz);
 
 #endif
\ No newline at end of file
@@ -79,7 +79,7 @@ static esp_err_t oled_send_command(uint8_t command) {
     i2c_master_write(cmd, tx_buf, 2, ACK_CHECK_EN);
     i2c_master_stop(cmd);
     
-    esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, pdMS_TO_TICKS(200));
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(200));
     i2c_cmd_link_delete(cmd);
     return ret;
 }
@@ -129,7 +129,7 @@ void oled_update_display(Oled_t *oled) {
         i2c_master_write_byte(cmd_set, OLED_CMD_SET_COLUMN_LOWER, ACK_CHECK_EN); 
         i2c_master_write_byte(cmd_set, OLED_CMD_SET_COLUMN_UPPER, ACK_CHECK_EN); 
         i2c_master_stop(cmd_set);
-        i2c_master_cmd_begin(I2C_NUM_0, cmd_set, pdMS_TO_TICKS(100));
+        i2c_bus_cmd_begin(cmd_set, pdMS_TO_TICKS(100));
         i2c_cmd_link_delete(cmd_set);
 
         // Gửi dữ liệu
@@ -142,7 +142,7 @@ void oled_update_display(Oled_t *oled) {
         i2c_master_write_byte(cmd_data, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
         i2c_master_write(cmd_data, tx_buf, 129, ACK_CHECK_EN);
         i2c_master_stop(cmd_data);
-        i2c_master_cmd_begin(I2C_NUM_0, cmd_data, pdMS_TO_TICKS(100));
+        i2c_bus_cmd_begin(cmd_data, pdMS_TO_TICKS(100));
         i2c_cmd_link_delete(cmd_data);
     }
 }
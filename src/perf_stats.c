@@ -0,0 +1,131 @@
+#ifndef ESP_PLATFORM
+#define _POSIX_C_SOURCE 199309L     // clock_gettime() cả khi biên dịch với -std=c11 (không có phần mở rộng GNU)
+#endif
+#include "perf_stats.h"
+#include <string.h>
+#ifndef ESP_PLATFORM
+#include <time.h>
+#endif
+
+typedef struct {
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint16_t hist[PERF_HIST_BUCKETS];   // Bão hòa ở UINT16_MAX (đặt lại mỗi chu kỳ báo cáo)
+} perf_stage_stats_t;
+
+static perf_stage_stats_t perf_stages[PERF_STAGE_COUNT];
+
+static const char *const perf_stage_names[PERF_STAGE_COUNT] = {
+    [PERF_STAGE_ACQUIRE] = "acq",
+    [PERF_STAGE_SQI] = "sqi",
+    [PERF_STAGE_DETREND] = "dc",
+    [PERF_STAGE_MOTION] = "nlms",
+    [PERF_STAGE_BEATS] = "beat",
+    [PERF_STAGE_AUTOCORR] = "acorr",
+    [PERF_STAGE_SPO2] = "spo2",
+    [PERF_STAGE_ML] = "ml",
+    [PERF_STAGE_DISPLAY] = "oled",
+    [PERF_STAGE_WINDOW] = "win",
+};
+
+
+/**
+ * @brief Ô histogram của một thời lượng: 0..3 µs mỗi giá trị một ô, sau đó mỗi bát độ
+ * [2^o, 2^(o+1)) chia 4 ô bằng nhau theo 2 bit ngay sau bit cao nhất.
+ */
+int perf_hist_bucket(uint32_t elapsed_us)
+{
+    const uint32_t sub_count = 1u << PERF_HIST_SUB_BITS;
+    if (elapsed_us < sub_count) {
+        return (int)elapsed_us;
+    }
+    int octave = 31 - __builtin_clz(elapsed_us);
+    int sub = (int)((elapsed_us >> (octave - PERF_HIST_SUB_BITS)) & (sub_count - 1));
+    int bucket = (octave - PERF_HIST_SUB_BITS + 1) * (int)sub_count + sub;
+    return (bucket < PERF_HIST_BUCKETS) ? bucket : PERF_HIST_BUCKETS - 1;
+}
+
+// Giá trị lớn nhất rơi vào ô (nghịch đảo của perf_hist_bucket)
+uint32_t perf_hist_bucket_upper(int bucket)
+{
+    const int sub_count = 1 << PERF_HIST_SUB_BITS;
+    if (bucket < sub_count) {
+        return (uint32_t)bucket;
+    }
+    int octave = bucket / sub_count + PERF_HIST_SUB_BITS - 1;
+    uint32_t width = 1u << (octave - PERF_HIST_SUB_BITS);
+    uint32_t lower = (uint32_t)(sub_count + bucket % sub_count) << (octave - PERF_HIST_SUB_BITS);
+    return lower + width - 1;
+}
+
+void perf_record(perf_stage_t stage, uint32_t elapsed_us)
+{
+    if (stage >= PERF_STAGE_COUNT) {
+        return;
+    }
+    perf_stage_stats_t *s = &perf_stages[stage];
+    if (s->count == 0 || elapsed_us < s->min_us) s->min_us = elapsed_us;
+    if (elapsed_us > s->max_us) s->max_us = elapsed_us;
+    s->count++;
+    s->sum_us += elapsed_us;
+
+    uint16_t *bin = &s->hist[perf_hist_bucket(elapsed_us)];
+    if (*bin < UINT16_MAX) (*bin)++;
+}
+
+/**
+ * @brief Tóm tắt mọi bước từ lần đặt lại gần nhất. p99 là cận trên của ô chứa phân vị,
+ * kẹp trong [min, max] nên không bao giờ vượt giá trị đo thật.
+ */
+void perf_summarize(perf_summary_t summary[PERF_STAGE_COUNT])
+{
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+        const perf_stage_stats_t *s = &perf_stages[i];
+        perf_summary_t *out = &summary[i];
+        memset(out, 0, sizeof(*out));
+        if (s->count == 0) {
+            continue;
+        }
+        out->count = s->count;
+        out->min_us = s->min_us;
+        out->max_us = s->max_us;
+        out->avg_us = (uint32_t)(s->sum_us / s->count);
+
+        // Tổng histogram có thể nhỏ hơn count nếu ô bão hòa: tính hạng trên tổng đó
+        uint32_t total = 0;
+        for (int b = 0; b < PERF_HIST_BUCKETS; b++) total += s->hist[b];
+        uint32_t rank = (total * 99 + 99) / 100;
+        uint32_t seen = 0;
+        out->p99_us = s->max_us;
+        for (int b = 0; b < PERF_HIST_BUCKETS; b++) {
+            seen += s->hist[b];
+            if (seen >= rank) {
+                uint32_t upper = perf_hist_bucket_upper(b);
+                out->p99_us = (upper < s->max_us) ? upper : s->max_us;
+                break;
+            }
+        }
+        if (out->p99_us < s->min_us) out->p99_us = s->min_us;
+    }
+}
+
+void perf_reset(void)
+{
+    memset(perf_stages, 0, sizeof(perf_stages));
+}
+
+const char *perf_stage_name(perf_stage_t stage)
+{
+    return (stage < PERF_STAGE_COUNT) ? perf_stage_names[stage] : "?";
+}
+
+#if !defined(ESP_PLATFORM) && !defined(PERF_CLOCK_ESP_TIMER)
+uint32_t perf_host_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+}
+#endif
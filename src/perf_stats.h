@@ -0,0 +1,89 @@
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+#if defined(ESP_PLATFORM) || defined(PERF_CLOCK_ESP_TIMER)
+#include "esp_timer.h"
+#endif
+
+// =========================================================
+// ĐO THỜI GIAN TỪNG BƯỚC XỬ LÝ
+// =========================================================
+// - PERF_STAGE_BEGIN/END bao quanh một bước, ghi thời gian (µs) vào histogram của bước đó
+// - Histogram log: 4 ô con mỗi bát độ (sai số p99 <= 25%), đặt lại sau mỗi lần báo cáo
+// - Tắt (mặc định) thì các macro rỗng, không còn lệnh đọc đồng hồ nào trong pipeline
+// - Trên host (không có ESP_PLATFORM) dùng CLOCK_MONOTONIC qua perf_host_now_us() trong perf_stats.c
+//   (header không kéo <time.h> vào, nên không phụ thuộc -std hay thứ tự include); bật bằng -DPERF_STATS_ENABLED=1
+// - PERF_CLOCK_ESP_TIMER: đọc esp_timer_get_time() cả trên host (bộ giả lập: đồng hồ ảo của sim_clock)
+
+#ifndef PERF_STATS_ENABLED
+#ifdef CONFIG_PERF_STATS
+#define PERF_STATS_ENABLED 1
+#else
+#define PERF_STATS_ENABLED 0
+#endif
+#endif
+
+#define PERF_REPORT_INTERVAL_MS 10000
+#define PERF_HIST_SUB_BITS 2            // 2^2 ô con mỗi bát độ
+#define PERF_HIST_BUCKETS 100           // Tới ~2^26 µs (67 s), lớn hơn dồn vào ô cuối
+
+typedef enum {
+    PERF_STAGE_ACQUIRE = 0,     // fill_buffers_data(): chờ FIFO + đọc I2C + lọc thông dải
+    PERF_STAGE_SQI,             // Đánh giá chất lượng tín hiệu
+    PERF_STAGE_DETREND,         // remove_dc_part()
+    PERF_STAGE_MOTION,          // Lọc tham chiếu gia tốc + NLMS
+    PERF_STAGE_BEATS,           // Phát hiện nhịp + HRV miền thời gian
+    PERF_STAGE_AUTOCORR,        // Hạ tốc + tương quan Pearson + tự tương quan HR
+    PERF_STAGE_SPO2,
+    PERF_STAGE_ML,              // score()
+    PERF_STAGE_DISPLAY,         // oled_update_display()
+    PERF_STAGE_WINDOW,          // Toàn bộ xử lý một cửa sổ sau thu mẫu (gồm cả còi cảnh báo nếu kêu)
+    PERF_STAGE_COUNT
+} perf_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p99_us;            // Cận trên của ô chứa phân vị 99
+    uint32_t max_us;
+} perf_summary_t;
+
+#if !defined(ESP_PLATFORM) && !defined(PERF_CLOCK_ESP_TIMER)
+uint32_t perf_host_now_us(void);
+#endif
+
+static inline uint32_t perf_now_us(void)
+{
+#if defined(ESP_PLATFORM) || defined(PERF_CLOCK_ESP_TIMER)
+    return (uint32_t)esp_timer_get_time();
+#else
+    return perf_host_now_us();
+#endif
+}
+
+// BEGIN khai báo biến thời điểm bắt đầu: END phải nằm cùng (hoặc trong) phạm vi đó
+#if PERF_STATS_ENABLED
+#define PERF_STAGE_BEGIN(stage) const uint32_t perf_t0_##stage = perf_now_us()
+#define PERF_STAGE_END(stage) perf_record(PERF_STAGE_##stage, perf_now_us() - perf_t0_##stage)
+#else
+#define PERF_STAGE_BEGIN(stage) do { } while (0)
+#define PERF_STAGE_END(stage) do { } while (0)
+#endif
+
+// Chỉ gọi từ một task (task xử lý cửa sổ): không có khóa
+void perf_record(perf_stage_t stage, uint32_t elapsed_us);
+void perf_summarize(perf_summary_t summary[PERF_STAGE_COUNT]);
+void perf_reset(void);
+const char *perf_stage_name(perf_stage_t stage);
+
+int perf_hist_bucket(uint32_t elapsed_us);
+uint32_t perf_hist_bucket_upper(int bucket);
+
+#endif
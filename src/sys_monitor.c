@@ -0,0 +1,151 @@
+#include "sys_monitor.h"
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "telemetry.h"
+#include "i2c_api.h"
+
+static const char *TAG_MON = "SYSMON";
+
+_Static_assert(sizeof(tlm_sysmon_t) <= TLM_MAX_PAYLOAD, "tlm_sysmon_t must fit one telemetry frame");
+
+#ifndef CONFIG_FREERTOS_USE_TRACE_FACILITY
+#error "sys_monitor needs CONFIG_FREERTOS_USE_TRACE_FACILITY=y (uxTaskGetSystemState)"
+#endif
+
+// Kích thước stack khai báo của các task đã biết (chỉ để chú thích báo cáo, task khác vẫn được lấy mẫu)
+typedef struct {
+    const char *name;
+    uint32_t stack_size;
+} watched_task_t;
+
+static watched_task_t watched_tasks[SYS_MONITOR_MAX_TASKS];
+static int watched_count = 0;
+static TaskStatus_t task_status[SYS_MONITOR_MAX_SYSTEM_TASKS];
+
+
+esp_err_t sys_monitor_watch_task(const char *name, uint32_t stack_size)
+{
+    if (watched_count >= SYS_MONITOR_MAX_TASKS) {
+        return ESP_ERR_NO_MEM;
+    }
+    watched_tasks[watched_count].name = name;
+    watched_tasks[watched_count].stack_size = stack_size;
+    watched_count++;
+    return ESP_OK;
+}
+
+// Kích thước stack đã đăng ký của task, 0 nếu không biết
+static uint32_t known_stack_size(const TaskStatus_t *status)
+{
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        if (status->xHandle != NULL && status->xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+            return CONFIG_FREERTOS_IDLE_TASK_STACKSIZE;
+        }
+    }
+    for (int i = 0; i < watched_count; i++) {
+        if (strncmp(watched_tasks[i].name, status->pcTaskName, configMAX_TASK_NAME_LEN) == 0) {
+            return watched_tasks[i].stack_size;
+        }
+    }
+    return 0;
+}
+
+static int compare_stack_free(const void *a, const void *b)
+{
+    uint32_t free_a = ((const TaskStatus_t *)a)->usStackHighWaterMark;
+    uint32_t free_b = ((const TaskStatus_t *)b)->usStackHighWaterMark;
+    return (free_a > free_b) - (free_a < free_b);
+}
+
+/**
+ * @brief Lấy mức nước cao của mọi task trong hệ thống (uxTaskGetSystemState), kể cả task của
+ * Wi-Fi/IDF. Báo cáo chỉ chứa được TLM_SYSMON_MAX_TASKS task: gửi các task còn ít stack nhất.
+ * Trên ESP-IDF StackType_t là uint8_t: mức nước cao tính bằng byte.
+ */
+static void sample_tasks(tlm_sysmon_t *report)
+{
+    UBaseType_t count = uxTaskGetSystemState(task_status, SYS_MONITOR_MAX_SYSTEM_TASKS, NULL);
+    UBaseType_t task_total = uxTaskGetNumberOfTasks();
+    report->task_total = (uint8_t)(task_total > UINT8_MAX ? UINT8_MAX : task_total);
+    if (count == 0) {
+        ESP_LOGW(TAG_MON, "%u tasks, more than SYS_MONITOR_MAX_SYSTEM_TASKS", (unsigned)task_total);
+        return;
+    }
+    qsort(task_status, count, sizeof(task_status[0]), compare_stack_free);
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *status = &task_status[i];
+        uint32_t free_bytes = status->usStackHighWaterMark;
+        uint32_t stack_size = known_stack_size(status);
+        if (free_bytes < SYS_MONITOR_STACK_WARN_BYTES) {
+            ESP_LOGW(TAG_MON, "Task %s: only %lu stack bytes never used",
+                     status->pcTaskName, (unsigned long)free_bytes);
+        }
+        if (report->task_count >= TLM_SYSMON_MAX_TASKS) {
+            continue;
+        }
+        tlm_sysmon_task_t *entry = &report->tasks[report->task_count++];
+        strncpy(entry->name, status->pcTaskName, TLM_SYSMON_NAME_LEN);
+        entry->stack_size = (uint16_t)(stack_size > UINT16_MAX ? UINT16_MAX : stack_size);
+        entry->stack_free_min = (uint16_t)(free_bytes > UINT16_MAX ? UINT16_MAX : free_bytes);
+    }
+}
+
+/**
+ * @brief Task giám sát: lấy mẫu stack/heap/I2C và gửi TLM_MSG_SYSMON định kỳ.
+ * Không cấp phát gì sau khi khởi động, nên không làm lệch chính heap_delta nó báo cáo.
+ */
+static void sys_monitor_task(void *pvParameters)
+{
+    static tlm_sysmon_t report;
+    uint32_t prev_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    TickType_t last_wake = xTaskGetTickCount();
+
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SYS_MONITOR_PERIOD_MS));
+
+        i2c_bus_stats_t bus_stats;
+        i2c_bus_get_stats(&bus_stats);
+        uint32_t heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+
+        memset(&report, 0, sizeof(report));
+        report.time_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        report.heap_free = heap_free;
+        report.heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+        report.heap_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+        report.heap_delta = (int32_t)(heap_free - prev_free);
+        report.i2c_errors = bus_stats.errors;
+        report.i2c_timeouts = bus_stats.timeouts;
+        prev_free = heap_free;
+        sample_tasks(&report);
+
+        if (report.heap_delta < 0) {
+            ESP_LOGD(TAG_MON, "Heap shrank by %ld bytes (free %lu, min %lu)",
+                     -(long)report.heap_delta, (unsigned long)heap_free, (unsigned long)report.heap_min_free);
+        }
+        telemetry_send(TLM_MSG_SYSMON, &report,
+                       offsetof(tlm_sysmon_t, tasks) + report.task_count * sizeof(tlm_sysmon_task_t));
+    }
+}
+
+esp_err_t sys_monitor_start(void)
+{
+    sys_monitor_watch_task("SYSMON", SYS_MONITOR_TASK_STACK);
+#ifdef CONFIG_ESP_TIMER_TASK_STACK_SIZE
+    sys_monitor_watch_task("esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE);
+#endif
+#ifdef CONFIG_LWIP_TCPIP_TASK_STACK_SIZE
+    sys_monitor_watch_task("tiT", CONFIG_LWIP_TCPIP_TASK_STACK_SIZE);     // Chỉ có khi bật Wi-Fi
+#endif
+
+    if (xTaskCreatePinnedToCore(sys_monitor_task, "SYSMON", SYS_MONITOR_TASK_STACK, NULL, 1, NULL, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
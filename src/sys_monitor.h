@@ -0,0 +1,26 @@
+#ifndef SYS_MONITOR_H
+#define SYS_MONITOR_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// =========================================================
+// GIÁM SÁT STACK / HEAP (TELEMETRY TLM_MSG_SYSMON)
+// =========================================================
+// - Task nền, mỗi SYS_MONITOR_PERIOD_MS: mức nước cao của stack mọi task trong hệ thống
+//   (uxTaskGetSystemState, cần CONFIG_FREERTOS_USE_TRACE_FACILITY), heap trống / thấp nhất /
+//   khối lớn nhất, lỗi I2C
+// - heap_delta giữa hai lần lấy mẫu = 0 ở trạng thái ổn định nếu pipeline không cấp phát
+// - Kích thước stack đăng ký bằng sys_monitor_watch_task chỉ để chú thích báo cáo (0 = không biết)
+
+#define SYS_MONITOR_PERIOD_MS 10000
+#define SYS_MONITOR_MAX_TASKS 12              // Số task được đăng ký kích thước stack
+#define SYS_MONITOR_MAX_SYSTEM_TASKS 32       // Số task tối đa trong hệ thống lấy mẫu được
+#define SYS_MONITOR_TASK_STACK 2560
+#define SYS_MONITOR_STACK_WARN_BYTES 512    // Cảnh báo khi stack còn trống ít hơn
+
+// Đăng ký kích thước stack của một task theo tên (gọi từ app_main, trước hoặc sau khi tạo task)
+esp_err_t sys_monitor_watch_task(const char *name, uint32_t stack_size);
+esp_err_t sys_monitor_start(void);
+
+#endif
@@ -0,0 +1,411 @@
+#include "telemetry.h"
+#include "telemetry_udp.h"
+#include "trace_recorder.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+
+static const char *TAG_TLM = "TLM";
+
+// Khung chưa mã hóa: type + seq + payload + CRC
+#define TLM_HEADER_SIZE 3
+#define TLM_CRC_SIZE 2
+#define TLM_RAW_FRAME_MAX (TLM_HEADER_SIZE + TLM_MAX_PAYLOAD + TLM_CRC_SIZE)
+// COBS thêm tối đa 1 byte mỗi 254 byte, cộng 1 byte mở đầu và byte phân cách 0x00
+#define TLM_ENCODED_MAX (TLM_RAW_FRAME_MAX + TLM_RAW_FRAME_MAX / 254 + 2)
+
+static StreamBufferHandle_t tlm_stream;
+static SemaphoreHandle_t tlm_mutex;
+static uint16_t tlm_seq = 0;
+static tlm_stats_t tlm_stats;
+static volatile bool tlm_raw_enabled = TLM_RAW_STREAM_DEFAULT;
+static volatile tlm_rx_handler_t tlm_rx_handler = NULL;
+
+
+uint16_t tlm_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Consistent Overhead Byte Stuffing: loại mọi byte 0 khỏi khung để 0x00 chỉ dùng
+ * làm dấu phân cách. Không ghi byte phân cách.
+ * @return Số byte đã ghi vào out
+ */
+size_t tlm_cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_pos = 0;
+    size_t out_pos = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = out_pos++;
+            code = 1;
+        } else {
+            out[out_pos++] = in[i];
+            if (++code == 0xFF) {
+                out[code_pos] = code;
+                code_pos = out_pos++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    return out_pos;
+}
+
+/**
+ * @brief Giải mã COBS (không gồm byte phân cách 0x00).
+ * @return Số byte đã giải mã, 0 nếu khung hỏng
+ */
+size_t tlm_cobs_decode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+
+    while (in_pos < len) {
+        uint8_t code = in[in_pos++];
+        if (code == 0 || in_pos + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            out[out_pos++] = in[in_pos++];
+        }
+        if (code < 0xFF && in_pos < len) {
+            out[out_pos++] = 0;
+        }
+    }
+    return out_pos;
+}
+
+static uint32_t zigzag32(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * @brief Đóng gói một khối mẫu: giá trị đầu nguyên vẹn, các delta zigzag ghép bit
+ * với độ rộng nhỏ nhất đủ cho từng kênh.
+ * @return Số byte payload, 0 nếu khối không vừa TLM_MAX_PAYLOAD
+ */
+size_t tlm_raw_pack(const tlm_raw_header_t *header, const int32_t *const *channels, uint8_t *out)
+{
+    const int count = header->count;
+    const int num_channels = header->channels;
+    uint8_t widths[TLM_RAW_MAX_CHANNELS];
+    size_t total_bits = 0;
+
+    if (count < 1 || count > TLM_RAW_MAX_SAMPLES || num_channels < 1 || num_channels > TLM_RAW_MAX_CHANNELS) {
+        return 0;
+    }
+    for (int c = 0; c < num_channels; c++) {
+        uint32_t max_zz = 0;
+        for (int k = 1; k < count; k++) {
+            uint32_t zz = zigzag32(channels[c][k] - channels[c][k - 1]);
+            if (zz > max_zz) max_zz = zz;
+        }
+        uint8_t width = 0;
+        while (width < 32 && (max_zz >> width) != 0) {
+            width++;
+        }
+        widths[c] = width;
+        total_bits += (size_t)width * (count - 1);
+    }
+
+    size_t pos = sizeof(tlm_raw_header_t);
+    size_t size = pos + num_channels * 5 + (total_bits + 7) / 8;
+    if (size > TLM_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    memcpy(out, header, sizeof(tlm_raw_header_t));
+    for (int c = 0; c < num_channels; c++) {
+        uint32_t first = (uint32_t)channels[c][0];
+        out[pos++] = (uint8_t)(first & 0xFF);
+        out[pos++] = (uint8_t)((first >> 8) & 0xFF);
+        out[pos++] = (uint8_t)((first >> 16) & 0xFF);
+        out[pos++] = (uint8_t)(first >> 24);
+        out[pos++] = widths[c];
+    }
+
+    // Ghép bit LSB trước qua thanh ghi tích lũy 64 bit
+    uint64_t acc = 0;
+    int acc_bits = 0;
+    for (int c = 0; c < num_channels; c++) {
+        for (int k = 1; k < count && widths[c] > 0; k++) {
+            acc |= (uint64_t)zigzag32(channels[c][k] - channels[c][k - 1]) << acc_bits;
+            acc_bits += widths[c];
+            while (acc_bits >= 8) {
+                out[pos++] = (uint8_t)(acc & 0xFF);
+                acc >>= 8;
+                acc_bits -= 8;
+            }
+        }
+    }
+    if (acc_bits > 0) {
+        out[pos++] = (uint8_t)(acc & 0xFF);
+    }
+    return pos;
+}
+
+/**
+ * @brief Task ghi UART: chờ có dữ liệu, gom thêm trong TLM_BATCH_MS rồi ghi từng khối lớn,
+ * để task xử lý không bao giờ bị chặn bởi tốc độ UART.
+ */
+static void telemetry_writer_task(void *pvParameters)
+{
+    static uint8_t batch[TLM_BATCH_SIZE];
+
+    for (;;) {
+        size_t n = xStreamBufferReceive(tlm_stream, batch, TLM_BATCH_SIZE, portMAX_DELAY);
+        if (n == 0) {
+            continue;
+        }
+        if (n < TLM_BATCH_SIZE) {
+            vTaskDelay(pdMS_TO_TICKS(TLM_BATCH_MS));
+            n += xStreamBufferReceive(tlm_stream, batch + n, TLM_BATCH_SIZE - n, 0);
+        }
+        TRACE_BEGIN(TLM_WRITE);
+        int written = uart_write_bytes(TLM_UART_NUM, batch, n);
+        TRACE_END(TLM_WRITE);
+        if (written > 0) {
+            tlm_stats.bytes_written += written;
+        }
+    }
+}
+
+/**
+ * @brief Task nhận lệnh từ host: tách khung theo 0x00, giải mã COBS, kiểm tra CRC rồi chuyển cho handler.
+ * Khung dài quá hoặc hỏng bị bỏ qua tới dấu phân cách kế tiếp.
+ */
+static void telemetry_rx_task(void *pvParameters)
+{
+    static uint8_t chunk[64];
+    static uint8_t encoded[TLM_ENCODED_MAX];
+    static uint8_t frame[TLM_RAW_FRAME_MAX];
+    size_t encoded_len = 0;
+    bool overflow = false;
+
+    for (;;) {
+        // uart_read_bytes chỉ trả về khi đủ cả chunk hoặc hết thời gian chờ: với portMAX_DELAY
+        // một khung lệnh ngắn hơn chunk sẽ nằm mãi trong bộ đệm
+        int n = uart_read_bytes(TLM_UART_NUM, chunk, sizeof(chunk), pdMS_TO_TICKS(TLM_BATCH_MS));
+        for (int i = 0; i < n; i++) {
+            if (chunk[i] != 0x00) {
+                if (encoded_len < sizeof(encoded)) {
+                    encoded[encoded_len++] = chunk[i];
+                } else {
+                    overflow = true;
+                }
+                continue;
+            }
+
+            size_t len = overflow ? 0 : tlm_cobs_decode(encoded, encoded_len, frame);
+            encoded_len = 0;
+            overflow = false;
+            if (len < TLM_HEADER_SIZE + TLM_CRC_SIZE) {
+                continue;
+            }
+            uint16_t crc = (uint16_t)(frame[len - 2] | (frame[len - 1] << 8));
+            tlm_rx_handler_t handler = tlm_rx_handler;
+            if (tlm_crc16(frame, len - TLM_CRC_SIZE) == crc && handler != NULL) {
+                handler(frame[0], &frame[TLM_HEADER_SIZE], len - TLM_HEADER_SIZE - TLM_CRC_SIZE);
+            }
+        }
+    }
+}
+
+esp_err_t telemetry_init(void)
+{
+    uart_config_t uart_config = {
+        .baud_rate = TLM_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+    };
+    esp_err_t ret = uart_param_config(TLM_UART_NUM, &uart_config);
+    if (ret == ESP_OK) {
+        ret = uart_driver_install(TLM_UART_NUM, 256, TLM_BATCH_SIZE * 2, 0, NULL, 0);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG_TLM, "UART%d setup failed: %s", TLM_UART_NUM, esp_err_to_name(ret));
+        return ret;
+    }
+
+    tlm_stream = xStreamBufferCreate(TLM_STREAM_SIZE, 1);
+    tlm_mutex = xSemaphoreCreateMutex();
+    if (tlm_stream == NULL || tlm_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskCreatePinnedToCore(telemetry_writer_task, "TLM", TLM_TASK_STACK, NULL, 1, NULL, 0);
+    xTaskCreatePinnedToCore(telemetry_rx_task, "TLM_RX", TLM_TASK_STACK, NULL, 1, NULL, 0);
+    ESP_LOGI(TAG_TLM, "Binary telemetry on UART%d @ %d baud", TLM_UART_NUM, TLM_UART_BAUD);
+    return ESP_OK;
+}
+
+// Cỡ lớn nhất của khung đã mã hóa (kể cả byte phân cách) cho payload len byte
+static size_t tlm_encoded_size_max(size_t len)
+{
+    size_t raw = TLM_HEADER_SIZE + len + TLM_CRC_SIZE;
+    return raw + raw / 254 + 2;
+}
+
+/**
+ * @brief Đóng khung, mã hóa COBS và đưa vào bộ đệm (không chờ).
+ * Số thứ tự chỉ được cấp và khung chỉ được chép sang UDP khi khung đã vào bộ đệm UART,
+ * nên khung bị bỏ không để lại lỗ hổng seq ở host và UDP không nhận bản sao của khung bị gửi lại.
+ * @param reserve Số byte phải còn trống sau khi ghi khung (giữ chỗ cho khung ưu tiên cao hơn)
+ * @return ESP_ERR_NO_MEM nếu bộ đệm đầy (khung bị bỏ và được đếm), ESP_ERR_INVALID_SIZE nếu payload quá dài
+ */
+static esp_err_t telemetry_enqueue(tlm_msg_type_t type, const void *payload, size_t len, size_t reserve)
+{
+    uint8_t frame[TLM_RAW_FRAME_MAX];
+    uint8_t encoded[TLM_ENCODED_MAX];
+    const bool is_raw = (type == TLM_MSG_RAW);
+
+    if (len > TLM_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (tlm_stream == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(tlm_mutex, portMAX_DELAY);
+    uint16_t seq = tlm_seq;
+    frame[0] = (uint8_t)type;
+    frame[1] = (uint8_t)(seq & 0xFF);
+    frame[2] = (uint8_t)(seq >> 8);
+    memcpy(&frame[TLM_HEADER_SIZE], payload, len);
+    uint16_t crc = tlm_crc16(frame, TLM_HEADER_SIZE + len);
+    frame[TLM_HEADER_SIZE + len] = (uint8_t)(crc & 0xFF);
+    frame[TLM_HEADER_SIZE + len + 1] = (uint8_t)(crc >> 8);
+
+    size_t n = tlm_cobs_encode(frame, TLM_HEADER_SIZE + len + TLM_CRC_SIZE, encoded);
+    encoded[n++] = 0x00;
+
+    // Chỉ ghi khi đủ chỗ cho cả khung, không bao giờ ghi nửa khung
+    esp_err_t ret = ESP_OK;
+    if (xStreamBufferSpacesAvailable(tlm_stream) >= n + reserve) {
+        xStreamBufferSend(tlm_stream, encoded, n, 0);
+        tlm_seq++;
+        if (is_raw) tlm_stats.raw_frames++; else tlm_stats.frames++;
+        // Bản sao cho Wi-Fi (nếu đã bật), hàng đợi riêng nên UART và UDP không chặn lẫn nhau
+        telemetry_udp_push(encoded, n);
+    } else {
+        if (is_raw) tlm_stats.raw_dropped++; else tlm_stats.dropped++;
+        ret = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(tlm_mutex);
+    return ret;
+}
+
+esp_err_t telemetry_send(tlm_msg_type_t type, const void *payload, size_t len)
+{
+    return telemetry_enqueue(type, payload, len, 0);
+}
+
+/**
+ * @brief Như telemetry_send nhưng chờ tới timeout_ms cho bộ đệm đủ chỗ trước khi đóng khung.
+ * Dùng cho các lần xuất khối lớn (ghi vết), không gọi từ task xử lý dữ liệu.
+ * @return ESP_ERR_TIMEOUT nếu hết thời gian chờ (khung bị bỏ và được đếm một lần)
+ */
+esp_err_t telemetry_send_blocking(tlm_msg_type_t type, const void *payload, size_t len, uint32_t timeout_ms)
+{
+    if (len > TLM_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (tlm_stream == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const size_t needed = tlm_encoded_size_max(len);
+    const TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    const TickType_t start = xTaskGetTickCount();
+    while (xStreamBufferSpacesAvailable(tlm_stream) < needed) {
+        if (xTaskGetTickCount() - start >= timeout) {
+            xSemaphoreTake(tlm_mutex, portMAX_DELAY);
+            tlm_stats.dropped++;
+            xSemaphoreGive(tlm_mutex);
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+    return telemetry_enqueue(type, payload, len, 0);
+}
+
+esp_err_t telemetry_send_event(tlm_event_code_t code, uint32_t time_ms, const void *data, size_t len)
+{
+    uint8_t payload[TLM_MAX_PAYLOAD];
+    tlm_event_header_t header = { .time_ms = time_ms, .code = (uint8_t)code };
+
+    if (sizeof(header) + len > TLM_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(payload, &header, sizeof(header));
+    if (len > 0) {
+        memcpy(payload + sizeof(header), data, len);
+    }
+    return telemetry_send(TLM_MSG_EVENT, payload, sizeof(header) + len);
+}
+
+void telemetry_get_stats(tlm_stats_t *stats)
+{
+    *stats = tlm_stats;
+}
+
+void telemetry_set_rx_handler(tlm_rx_handler_t handler)
+{
+    tlm_rx_handler = handler;
+}
+
+void telemetry_raw_set_enabled(bool enabled)
+{
+    tlm_raw_enabled = enabled;
+    ESP_LOGI(TAG_TLM, "Raw waveform stream %s", enabled ? "ON" : "OFF");
+}
+
+bool telemetry_raw_enabled(void)
+{
+    return tlm_raw_enabled;
+}
+
+/**
+ * @brief Gửi một khối dạng sóng thô. channels[c][k] là mẫu k của kênh c.
+ * Khung thô luôn chừa lại TLM_RAW_RESERVE byte để không lấn chỗ của khung kết quả.
+ */
+esp_err_t telemetry_send_raw(tlm_raw_stream_t stream, uint8_t flags, uint32_t t0_ms, uint16_t period_us,
+                             const int32_t *const *channels, int num_channels, int count)
+{
+    uint8_t payload[TLM_MAX_PAYLOAD];
+
+    if (!tlm_raw_enabled) {
+        return ESP_OK;
+    }
+    tlm_raw_header_t header = {
+        .stream = (uint8_t)stream,
+        .flags = flags,
+        .count = (uint8_t)count,
+        .channels = (uint8_t)num_channels,
+        .t0_ms = t0_ms,
+        .period_us = period_us,
+    };
+    size_t len = tlm_raw_pack(&header, channels, payload);
+    if (len == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return telemetry_enqueue(TLM_MSG_RAW, payload, len, TLM_RAW_RESERVE);
+}
@@ -0,0 +1,258 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// =========================================================
+// GIAO THỨC TELEMETRY NHỊ PHÂN QUA UART
+// =========================================================
+// Khung: COBS( type | seq (u16) | payload | CRC16 (u16) ) + 0x00
+// - Mọi trường số nguyên là little-endian, giá trị thực gửi dạng fixed-point (hệ số ghi ở tên trường)
+// - CRC16-CCITT (đa thức 0x1021, khởi tạo 0xFFFF) tính trên type, seq và payload
+// - seq tăng theo từng khung đã vào bộ đệm UART để phía host phát hiện mất khung trên đường truyền;
+//   khung bị bỏ ngay trên thiết bị do đầy bộ đệm không lấy seq và được đếm trong DIAG
+
+#ifdef CONFIG_TLM_UART_NUM
+#define TLM_UART_NUM CONFIG_TLM_UART_NUM
+#else
+#define TLM_UART_NUM 0              // Cùng cổng USB-UART với console
+#endif
+
+#ifdef CONFIG_TLM_UART_BAUD
+#define TLM_UART_BAUD CONFIG_TLM_UART_BAUD
+#else
+#define TLM_UART_BAUD 115200
+#endif
+
+#ifdef CONFIG_TLM_RAW_STREAM
+#define TLM_RAW_STREAM_DEFAULT true
+#else
+#define TLM_RAW_STREAM_DEFAULT false
+#endif
+
+#define TLM_MAX_PAYLOAD 240
+#define TLM_STREAM_SIZE 4096        // Bộ đệm giữa task tạo khung và task ghi UART
+#define TLM_BATCH_SIZE 512          // Số byte tối đa mỗi lần ghi UART
+#define TLM_BATCH_MS 20             // Thời gian gom khung trước khi ghi
+#define TLM_TASK_STACK 3072         // Task ghi "TLM" và task nhận "TLM_RX"
+#define TLM_RAW_RESERVE 1024        // Chỗ trống luôn giữ lại cho khung kết quả/sự kiện khi stream thô chạy
+
+typedef enum {
+    TLM_MSG_VITALS = 0x01,          // Kết quả mỗi cửa sổ hợp lệ
+    TLM_MSG_RAW = 0x02,             // Mẫu dạng sóng thô
+    TLM_MSG_EVENT = 0x03,           // Sự kiện (SQI, AGC, proximity...)
+    TLM_MSG_DIAG = 0x04,            // Chẩn đoán định kỳ (bus, bộ đệm)
+    TLM_MSG_CONFIG = 0x05,          // Giá trị một tham số cấu hình (trả lời GET/SET)
+    TLM_MSG_PERF = 0x06,            // Thời gian từng bước xử lý (khi bật CONFIG_PERF_STATS)
+    TLM_MSG_SYSMON = 0x07,          // Stack / heap định kỳ (sys_monitor)
+    TLM_MSG_TRACE = 0x08,           // Một khối dữ liệu ghi vết (trả lời TRACE_DUMP)
+    // Host -> thiết bị (cùng định dạng khung, gửi trên cùng UART)
+    TLM_MSG_CONFIG_SET = 0x10,      // Payload: tlm_config_set_t
+    TLM_MSG_CONFIG_GET = 0x11,      // Payload: tlm_config_get_t
+    TLM_MSG_TRACE_DUMP = 0x12,      // Không có payload
+} tlm_msg_type_t;
+
+typedef enum {
+    TLM_EVT_SQI_REJECT = 0x01,      // Payload: tlm_evt_sqi_t
+    TLM_EVT_LOW_CORRELATION = 0x02, // Payload: tlm_evt_corr_t
+    TLM_EVT_PROX_ENTER = 0x03,      // Không có payload
+    TLM_EVT_PROX_EXIT = 0x04,       // Không có payload
+    TLM_EVT_AGC = 0x05,             // Payload: tlm_evt_agc_t
+} tlm_event_code_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;
+    uint8_t ml_class;               // Lớp dự đoán (0..4)
+    uint8_t sqi_reason;
+    uint16_t hr_x10;                // bpm
+    uint16_t spo2_x10;              // %
+    uint16_t hrv_x10;               // RMSSD dùng cho ML (ms)
+    uint16_t accel_mg;              // Gia tốc đỉnh của cửa sổ
+    uint16_t motion_energy_x1e4;    // g^2
+    uint16_t sdnn_x10;              // ms
+    uint16_t pnn50_x10;             // %
+    uint32_t lf_ms2;
+    uint32_t hf_ms2;
+    uint16_t lf_hf_x100;
+    uint16_t rr_count;
+    int16_t temp_x100;              // °C
+} tlm_vitals_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;
+    uint8_t code;                   // tlm_event_code_t, theo sau là payload của sự kiện
+} tlm_event_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t reason;                 // sqi_reason_t
+    uint32_t ir_dc;
+    uint16_t perfusion_x100;        // %
+    uint16_t clipped_x10;           // %
+    int16_t kurtosis_x10;
+    uint16_t zc_hz_x100;
+    uint16_t zc_cv_x100;
+    int16_t temp_x100;
+} tlm_evt_sqi_t;
+
+typedef struct __attribute__((packed)) {
+    int16_t correlation_x1000;
+    int16_t temp_x100;
+} tlm_evt_corr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t old_led1_pa, new_led1_pa;
+    uint8_t old_led2_pa, new_led2_pa;
+    uint8_t old_adc_rge, new_adc_rge;
+    uint16_t red_gain_x1000;
+    uint16_t ir_gain_x1000;
+} tlm_evt_agc_t;
+
+// =========================================================
+// KHUNG DẠNG SÓNG THÔ (TLM_MSG_RAW)
+// =========================================================
+// Payload: tlm_raw_header_t | channels x (first i32, width u8) | bitstream
+// - Mẫu đầu của mỗi kênh gửi nguyên giá trị, các mẫu sau gửi hiệu (delta) đã zigzag
+// - Mỗi kênh dùng một độ rộng bit cố định (đủ cho delta lớn nhất trong khối),
+//   các delta được ghép liên tiếp theo từng kênh, bit thấp trước, byte cuối đệm 0
+// - Mẫu k của khối có mốc thời gian t0_ms + k * period_us / 1000
+
+#define TLM_RAW_MAX_SAMPLES 32      // Bằng độ sâu FIFO MAX30102; đủ chỗ cả khi delta cần 19 bit
+#define TLM_RAW_MAX_CHANNELS 3
+
+typedef enum {
+    TLM_RAW_PPG = 0x01,             // 2 kênh: red, IR (18 bit, tốc độ FIFO trước hạ tốc)
+    TLM_RAW_ACCEL = 0x02,           // 3 kênh: x, y, z (LSB thô của MPU6050)
+} tlm_raw_stream_t;
+
+#define TLM_RAW_FLAG_DISCONTINUITY 0x01 // Khối đầu sau khi khởi động, đổi khuếch đại (AGC) hoặc mất mẫu (FIFO tràn)
+
+typedef struct __attribute__((packed)) {
+    uint8_t stream;                 // tlm_raw_stream_t
+    uint8_t flags;
+    uint8_t count;                  // Số mẫu mỗi kênh
+    uint8_t channels;
+    uint32_t t0_ms;                 // Mốc thời gian của mẫu đầu tiên
+    uint16_t period_us;             // Chu kỳ lấy mẫu
+} tlm_raw_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;
+    uint32_t i2c_freq_hz;
+    uint32_t i2c_transactions;
+    uint32_t i2c_errors;
+    uint32_t i2c_timeouts;
+    uint32_t i2c_probe_failures;
+    uint32_t accel_fifo_overflows;
+    uint32_t agc_changes;
+    uint32_t tlm_frames;            // Khung đã đưa vào bộ đệm
+    uint32_t tlm_dropped;           // Khung bị bỏ do bộ đệm đầy
+    uint32_t raw_frames;            // Khung dạng sóng thô đã đưa vào bộ đệm
+    uint32_t raw_dropped;           // Khung thô bị bỏ (host/đường truyền chậm)
+    uint32_t udp_datagrams;         // Datagram Wi-Fi đã gửi
+    uint32_t udp_dropped;           // Khung bị bỏ do hàng đợi UDP đầy
+    uint32_t udp_send_errors;       // Datagram gửi lỗi (chưa có kết nối/IP)
+    uint32_t ppg_samples_lost;      // Mẫu PPG mất: FIFO MAX30102 tràn (OVF_COUNTER) hoặc bộ đệm tạm đầy
+} tlm_diag_t;
+
+#define TLM_CONFIG_ALL 0xFF         // tlm_config_get_t.param: đọc mọi tham số
+#define TLM_CONFIG_PERSIST 0x01     // tlm_config_set_t.flags: lưu vào NVS
+
+typedef struct __attribute__((packed)) {
+    uint8_t param;                  // config_param_id_t
+    float value;
+    uint8_t flags;
+} tlm_config_set_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t param;
+} tlm_config_get_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t version;               // Phiên bản cấu hình sau thao tác
+    uint8_t param;
+    uint8_t status;                 // config_status_t
+    float value;
+} tlm_config_t;
+
+#define TLM_PERF_MAX_STAGES 12
+
+typedef struct __attribute__((packed)) {
+    uint16_t count;                 // Số lần đo trong chu kỳ
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} tlm_perf_stage_t;
+
+// Chỉ gửi stage_count phần tử đầu của stages (thứ tự = perf_stage_t)
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;
+    uint32_t interval_ms;           // Độ dài chu kỳ thống kê
+    uint8_t stage_count;
+    tlm_perf_stage_t stages[TLM_PERF_MAX_STAGES];
+} tlm_perf_t;
+
+#define TLM_SYSMON_MAX_TASKS 17            // Vừa TLM_MAX_PAYLOAD; nhiều task hơn thì gửi các task còn ít stack nhất
+#define TLM_SYSMON_NAME_LEN 8
+
+typedef struct __attribute__((packed)) {
+    char name[TLM_SYSMON_NAME_LEN]; // Không bắt buộc kết thúc bằng '\0'
+    uint16_t stack_size;            // byte, 0 nếu không biết (task không đăng ký)
+    uint16_t stack_free_min;        // Mức nước cao: byte chưa từng dùng
+} tlm_sysmon_task_t;
+
+// Chỉ gửi task_count phần tử đầu của tasks
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;
+    uint32_t heap_free;
+    uint32_t heap_min_free;         // Thấp nhất từ lúc khởi động
+    uint32_t heap_largest_block;
+    int32_t heap_delta;             // heap_free - lần lấy mẫu trước (âm = bộ nhớ chưa trả)
+    uint32_t i2c_errors;
+    uint32_t i2c_timeouts;
+    uint8_t task_total;             // Tổng số task trong hệ thống (kể cả không gửi trong tasks)
+    uint8_t task_count;
+    tlm_sysmon_task_t tasks[TLM_SYSMON_MAX_TASKS];
+} tlm_sysmon_t;
+
+// Khung TLM_MSG_TRACE: header + dữ liệu của khối (xem trace_chunk_kind_t trong trace_recorder.h)
+typedef struct __attribute__((packed)) {
+    uint8_t kind;
+    uint8_t count;
+} tlm_trace_header_t;
+
+// Xử lý khung host gửi xuống (đã kiểm tra CRC), gọi từ task nhận TLM_RX
+typedef void (*tlm_rx_handler_t)(uint8_t type, const uint8_t *payload, size_t len);
+
+typedef struct {
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t bytes_written;
+    uint32_t raw_frames;
+    uint32_t raw_dropped;
+} tlm_stats_t;
+
+esp_err_t telemetry_init(void);
+esp_err_t telemetry_send(tlm_msg_type_t type, const void *payload, size_t len);
+esp_err_t telemetry_send_blocking(tlm_msg_type_t type, const void *payload, size_t len, uint32_t timeout_ms);
+esp_err_t telemetry_send_event(tlm_event_code_t code, uint32_t time_ms, const void *data, size_t len);
+void telemetry_get_stats(tlm_stats_t *stats);
+void telemetry_set_rx_handler(tlm_rx_handler_t handler);
+
+// Stream dạng sóng thô: không bao giờ chờ, khung không đủ chỗ bị bỏ và đếm vào raw_dropped
+void telemetry_raw_set_enabled(bool enabled);
+bool telemetry_raw_enabled(void);
+esp_err_t telemetry_send_raw(tlm_raw_stream_t stream, uint8_t flags, uint32_t t0_ms, uint16_t period_us,
+                             const int32_t *const *channels, int num_channels, int count);
+
+// Hàm mã hóa dùng chung (không phụ thuộc phần cứng)
+uint16_t tlm_crc16(const uint8_t *data, size_t len);
+size_t tlm_cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+size_t tlm_cobs_decode(const uint8_t *in, size_t len, uint8_t *out);
+size_t tlm_raw_pack(const tlm_raw_header_t *header, const int32_t *const *channels, uint8_t *out);
+
+#endif
@@ -0,0 +1,132 @@
+#include "telemetry_udp.h"
+#include "telemetry.h"
+#include "wifi_init.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/message_buffer.h"
+#include "lwip/sockets.h"
+#include "esp_log.h"
+
+static const char *TAG_UDP = "TLM_UDP";
+
+// Khung COBS lớn nhất (payload + header/CRC + phần thêm của COBS + phân cách)
+#define TLM_UDP_FRAME_MAX (TLM_MAX_PAYLOAD + 16)
+
+static MessageBufferHandle_t udp_queue;
+static int udp_sock = -1;
+static struct sockaddr_in udp_dest;
+static uint32_t udp_seq = 0;
+static tlm_udp_stats_t udp_stats;
+
+
+static void udp_flush(uint8_t *datagram, size_t *len, uint8_t *frame_count)
+{
+    if (*frame_count == 0) {
+        return;
+    }
+    tlm_udp_header_t header = {
+        .magic = TLM_UDP_MAGIC,
+        .version = TLM_UDP_VERSION,
+        .frame_count = *frame_count,
+        .seq = udp_seq++,
+    };
+    memcpy(datagram, &header, sizeof(header));
+
+    int sent = sendto(udp_sock, datagram, *len, 0, (struct sockaddr *)&udp_dest, sizeof(udp_dest));
+    if (sent < 0) {
+        udp_stats.send_errors++;
+    } else {
+        udp_stats.datagrams++;
+    }
+    *len = sizeof(tlm_udp_header_t);
+    *frame_count = 0;
+}
+
+/**
+ * @brief Task gửi UDP: lấy từng khung nguyên vẹn khỏi hàng đợi, gom vào một datagram
+ * tới khi đầy hoặc hết TLM_UDP_BATCH_MS kể từ khung đầu tiên.
+ */
+static void telemetry_udp_task(void *pvParameters)
+{
+    static uint8_t datagram[TLM_UDP_DATAGRAM_MAX];
+    static uint8_t frame[TLM_UDP_FRAME_MAX];
+    size_t len = sizeof(tlm_udp_header_t);
+    uint8_t frame_count = 0;
+    TickType_t batch_start = 0;
+    const TickType_t batch_ticks = pdMS_TO_TICKS(TLM_UDP_BATCH_MS);
+
+    for (;;) {
+        TickType_t wait = portMAX_DELAY;
+        if (frame_count > 0) {
+            TickType_t elapsed = xTaskGetTickCount() - batch_start;
+            wait = (elapsed < batch_ticks) ? batch_ticks - elapsed : 0;
+        }
+
+        size_t n = xMessageBufferReceive(udp_queue, frame, sizeof(frame), wait);
+        if (n == 0) {
+            udp_flush(datagram, &len, &frame_count);
+            continue;
+        }
+        if (len + n > TLM_UDP_DATAGRAM_MAX || frame_count == UINT8_MAX) {
+            udp_flush(datagram, &len, &frame_count);
+        }
+        if (frame_count == 0) {
+            batch_start = xTaskGetTickCount();
+        }
+        memcpy(datagram + len, frame, n);
+        len += n;
+        frame_count++;
+    }
+}
+
+esp_err_t telemetry_udp_init(const char *host, uint16_t port)
+{
+    memset(&udp_dest, 0, sizeof(udp_dest));
+    udp_dest.sin_family = AF_INET;
+    udp_dest.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &udp_dest.sin_addr) != 1) {
+        ESP_LOGE(TAG_UDP, "Invalid collector address: %s", host);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    udp_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp_sock < 0) {
+        ESP_LOGE(TAG_UDP, "socket() failed: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    udp_queue = xMessageBufferCreate(TLM_UDP_QUEUE_SIZE);
+    if (udp_queue == NULL) {
+        close(udp_sock);
+        udp_sock = -1;
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskCreatePinnedToCore(telemetry_udp_task, "TLM_UDP", TLM_UDP_TASK_STACK, NULL, 1, NULL, 0);
+    ESP_LOGI(TAG_UDP, "UDP telemetry -> %s:%u", host, port);
+    return ESP_OK;
+}
+
+/**
+ * @brief Đưa một khung đã mã hóa COBS (kể cả byte 0x00) vào hàng đợi UDP, không chờ.
+ * Gọi trong mutex của telemetry.c nên thứ tự khung giống hệt luồng UART.
+ */
+void telemetry_udp_push(const uint8_t *frame, size_t len)
+{
+    // Chưa có mạng: không xếp hàng (khung vẫn đi qua UART), tự gắn lại khi có IP
+    if (udp_queue == NULL || !wifi_is_connected()) {
+        return;
+    }
+    // Message buffer lưu thêm 4 byte độ dài cho mỗi khung
+    if (len <= TLM_UDP_FRAME_MAX && xMessageBufferSpacesAvailable(udp_queue) >= len + sizeof(size_t)) {
+        xMessageBufferSend(udp_queue, frame, len, 0);
+        udp_stats.frames++;
+    } else {
+        udp_stats.queue_dropped++;
+    }
+}
+
+void telemetry_udp_get_stats(tlm_udp_stats_t *stats)
+{
+    *stats = udp_stats;
+}
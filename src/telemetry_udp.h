@@ -0,0 +1,61 @@
+#ifndef TELEMETRY_UDP_H
+#define TELEMETRY_UDP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// =========================================================
+// TELEMETRY QUA WI-FI (UDP)
+// =========================================================
+// Cùng các khung COBS của telemetry.h, gom nhiều khung vào một datagram:
+//   tlm_udp_header_t | khung COBS + 0x00 | khung COBS + 0x00 | ...
+// - seq của datagram tăng liên tục để collector phát hiện mất datagram
+// - Mỗi khung vẫn giữ seq và CRC riêng nên có thể giải mã độc lập
+
+#ifdef CONFIG_TLM_UDP_ENABLE
+#define TLM_UDP_ENABLED 1
+#else
+#define TLM_UDP_ENABLED 0
+#endif
+
+#ifdef CONFIG_TLM_UDP_HOST
+#define TLM_UDP_HOST CONFIG_TLM_UDP_HOST
+#else
+#define TLM_UDP_HOST "192.168.1.100"
+#endif
+
+#ifdef CONFIG_TLM_UDP_PORT
+#define TLM_UDP_PORT CONFIG_TLM_UDP_PORT
+#else
+#define TLM_UDP_PORT 5005
+#endif
+
+#define TLM_UDP_MAGIC 0x4854            // "TH" (little-endian)
+#define TLM_UDP_VERSION 1
+#define TLM_UDP_DATAGRAM_MAX 1400       // Dưới MTU Ethernet/Wi-Fi, tránh phân mảnh IP
+#define TLM_UDP_QUEUE_SIZE 8192         // Hàng đợi khung chờ gửi (có giới hạn)
+#define TLM_UDP_BATCH_MS 50             // Thời gian gom khung tối đa trước khi gửi
+#define TLM_UDP_TASK_STACK 3072
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t frame_count;
+    uint32_t seq;
+} tlm_udp_header_t;
+
+typedef struct {
+    uint32_t datagrams;                 // Datagram đã gửi thành công
+    uint32_t frames;                    // Khung đã vào hàng đợi
+    uint32_t queue_dropped;             // Khung bị bỏ do hàng đợi đầy
+    uint32_t send_errors;               // sendto() lỗi (mất kết nối, chưa có IP...)
+} tlm_udp_stats_t;
+
+esp_err_t telemetry_udp_init(const char *host, uint16_t port);
+void telemetry_udp_push(const uint8_t *frame, size_t len);
+void telemetry_udp_get_stats(tlm_udp_stats_t *stats);
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef ESP_PLATFORM
+#define _GNU_SOURCE             // pthread_getname_np
+#endif
+#include "trace_recorder.h"
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+_Static_assert(sizeof(trace_event_t) == 8, "trace_event_t must stay 8 bytes");
+_Static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+#define TRACE_TASK_UNKNOWN 0xFF
+
+static trace_event_t trace_ring[TRACE_RING_SIZE];
+static uint32_t trace_head = 0;             // Tổng số chỗ đã cấp, chỉ số vòng = trace_head % TRACE_RING_SIZE
+static bool trace_active = true;
+
+static void *trace_task_handles[TRACE_MAX_TASKS];
+static char trace_task_names[TRACE_MAX_TASKS][TRACE_TASK_NAME_LEN];
+
+
+// =========================================================
+// NỀN TẢNG: TASK HIỆN TẠI
+// =========================================================
+
+// Tên cắt còn TRACE_TASK_NAME_LEN byte, không bắt buộc kết thúc bằng '\0'
+static void copy_task_name(char *out, const char *name)
+{
+    memset(out, 0, TRACE_TASK_NAME_LEN);
+    memcpy(out, name, strnlen(name, TRACE_TASK_NAME_LEN));
+}
+
+#ifdef ESP_PLATFORM
+static void *current_task(void)
+{
+    return xTaskGetCurrentTaskHandle();
+}
+
+static void current_task_name(char *out)
+{
+    copy_task_name(out, pcTaskGetName(NULL));
+}
+
+// Chờ các lần ghi đã lấy chỗ trước khi dừng ghi vết hoàn tất
+static void wait_for_writers(void)
+{
+    vTaskDelay(1);
+}
+#else
+static void *current_task(void)
+{
+    return (void *)(uintptr_t)pthread_self();
+}
+
+static void current_task_name(char *out)
+{
+    char name[16] = "";
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    copy_task_name(out, name);
+}
+
+static void wait_for_writers(void)
+{
+    usleep(1000);
+}
+#endif
+
+/**
+ * @brief Chỉ số của task đang chạy trong bảng task; lần đầu gặp thì giành một ô trống bằng CAS
+ * (không khóa, mỗi task chỉ tự thêm chính nó).
+ */
+static uint8_t task_index(void)
+{
+    void *self = current_task();
+    for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+        void *handle = __atomic_load_n(&trace_task_handles[i], __ATOMIC_ACQUIRE);
+        if (handle == self) {
+            return (uint8_t)i;
+        }
+        if (handle == NULL) {
+            void *expected = NULL;
+            if (__atomic_compare_exchange_n(&trace_task_handles[i], &expected, self, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                current_task_name(trace_task_names[i]);
+                return (uint8_t)i;
+            }
+        }
+    }
+    return TRACE_TASK_UNKNOWN;
+}
+
+
+// =========================================================
+// GHI VÀ XUẤT
+// =========================================================
+
+void trace_record(trace_event_id_t event, trace_phase_t phase, uint8_t arg)
+{
+    if (!__atomic_load_n(&trace_active, __ATOMIC_RELAXED)) {
+        return;
+    }
+    uint32_t time_us = trace_now_us();
+    uint32_t slot = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED) & (TRACE_RING_SIZE - 1);
+    trace_event_t *e = &trace_ring[slot];
+    e->time_us = time_us;
+    e->event = (uint8_t)event;
+    e->phase = (uint8_t)phase;
+    e->task = task_index();
+    e->arg = arg;
+}
+
+void trace_set_enabled(bool enabled)
+{
+    __atomic_store_n(&trace_active, enabled, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Tạm dừng ghi, xuất bảng task rồi toàn bộ vòng (cũ nhất trước) theo khối
+ * TRACE_EVENTS_PER_CHUNK sự kiện, cuối cùng là trace_end_t. Vòng giữ nguyên sau khi xuất.
+ * @return false nếu hàm gọi lại dừng giữa chừng
+ */
+bool trace_export(trace_export_cb_t cb, void *arg)
+{
+    bool was_active = __atomic_load_n(&trace_active, __ATOMIC_ACQUIRE);
+    trace_set_enabled(false);
+    wait_for_writers();
+
+    bool ok = true;
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+    uint32_t count = (head < TRACE_RING_SIZE) ? head : TRACE_RING_SIZE;
+
+    uint8_t task_count = 0;
+    while (task_count < TRACE_MAX_TASKS && trace_task_handles[task_count] != NULL) {
+        task_count++;
+    }
+    ok = cb(TRACE_CHUNK_TASKS, task_count, trace_task_names, (size_t)task_count * TRACE_TASK_NAME_LEN, arg);
+
+    trace_event_t chunk[TRACE_EVENTS_PER_CHUNK];
+    for (uint32_t i = 0; ok && i < count; ) {
+        uint8_t n = 0;
+        while (n < TRACE_EVENTS_PER_CHUNK && i < count) {
+            chunk[n++] = trace_ring[(head - count + i) & (TRACE_RING_SIZE - 1)];
+            i++;
+        }
+        ok = cb(TRACE_CHUNK_EVENTS, n, chunk, n * sizeof(trace_event_t), arg);
+    }
+
+    if (ok) {
+        trace_end_t end = { .recorded = head, .exported = count };
+        ok = cb(TRACE_CHUNK_END, 0, &end, sizeof(end), arg);
+    }
+
+    trace_set_enabled(was_active);
+    return ok;
+}
+
+#ifndef ESP_PLATFORM
+static bool write_file_chunk(trace_chunk_kind_t kind, uint8_t count, const void *data, size_t len, void *arg)
+{
+    FILE *f = (FILE *)arg;
+    uint8_t header[4] = { (uint8_t)kind, count, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+    return fwrite(header, 1, sizeof(header), f) == sizeof(header) && fwrite(data, 1, len, f) == len;
+}
+
+bool trace_export_file(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = trace_export(write_file_chunk, f);
+    return (fclose(f) == 0) && ok;
+}
+#endif
@@ -0,0 +1,108 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "perf_stats.h"     // perf_now_us(): đồng hồ của trace khi không chọn TRACE_CLOCK_ESP_TIMER
+#if defined(ESP_PLATFORM) || defined(TRACE_CLOCK_ESP_TIMER)
+#include "esp_timer.h"
+#endif
+
+// =========================================================
+// GHI VẾT SỰ KIỆN (ĐỊNH DẠNG CHROME TRACE / PERFETTO)
+// =========================================================
+// - Mỗi sự kiện 8 byte (thời điểm µs, mã sự kiện, pha B/E/i, task, tham số) trong vòng RAM,
+//   ghi không khóa từ mọi task (chỉ số vòng tăng nguyên tử), vòng đầy thì đè sự kiện cũ nhất
+// - Task nhận chỉ số nhỏ ở lần ghi đầu tiên; bảng tên task xuất kèm dữ liệu
+// - Xuất: trace_export() chia thành các khối (bảng task, sự kiện, kết thúc) cho một hàm gọi lại,
+//   trên ESP32 gửi qua telemetry (TLM_MSG_TRACE), trên host ghi ra file; trace_to_chrome.py chuyển sang JSON
+// - Tắt (mặc định) thì các macro rỗng
+// - Mốc thời gian: esp_timer trên ESP32; TRACE_CLOCK_ESP_TIMER chọn esp_timer cả trên host
+//   (bộ giả lập: đồng hồ ảo, so được với trace thiết bị), nếu không thì theo perf_now_us()
+
+#ifndef TRACE_ENABLED
+#ifdef CONFIG_TRACE_RECORDER
+#define TRACE_ENABLED 1
+#else
+#define TRACE_ENABLED 0
+#endif
+#endif
+
+#define TRACE_RING_SIZE 1024            // Lũy thừa của 2
+#define TRACE_MAX_TASKS 16
+#define TRACE_TASK_NAME_LEN 8
+#define TRACE_EVENTS_PER_CHUNK 28       // 224 byte, vừa một khung telemetry
+
+typedef enum {
+    TRACE_EV_ACQUIRE = 0,       // Chờ + đọc FIFO MAX30102 một cửa sổ
+    TRACE_EV_DSP,               // Xử lý cửa sổ (SQI -> HR/SpO2 -> ML)
+    TRACE_EV_ACCEL_DRAIN,       // Đọc burst FIFO MPU6050
+    TRACE_EV_DISPLAY,           // oled_update_display()
+    TRACE_EV_ALARM,             // Còi cảnh báo (arg: 1 = hú còi, 0 = bíp)
+    TRACE_EV_TLM_WRITE,         // Task TLM ghi một lô lên UART
+    TRACE_EV_HRV_SPECTRUM,      // Phổ Lomb-Scargle
+    TRACE_EV_SQI_REJECT,        // Tức thời, arg = sqi_reason_t
+    TRACE_EV_AGC,               // Tức thời, arg = dòng LED IR mới
+    TRACE_EV_VITALS,            // Tức thời, arg = lớp ML
+    TRACE_EV_COUNT
+} trace_event_id_t;
+
+typedef enum {
+    TRACE_PHASE_BEGIN = 'B',    // Giống trường "ph" của Chrome trace
+    TRACE_PHASE_END = 'E',
+    TRACE_PHASE_INSTANT = 'i',
+} trace_phase_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t time_us;           // Tràn sau ~71 phút: host tự nối tiếp
+    uint8_t event;              // trace_event_id_t
+    uint8_t phase;              // trace_phase_t
+    uint8_t task;               // Chỉ số trong bảng task
+    uint8_t arg;
+} trace_event_t;
+
+typedef enum {
+    TRACE_CHUNK_TASKS = 0,      // count tên task, mỗi tên TRACE_TASK_NAME_LEN byte
+    TRACE_CHUNK_EVENTS = 1,     // count trace_event_t, cũ nhất trước
+    TRACE_CHUNK_END = 2,        // trace_end_t
+} trace_chunk_kind_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t recorded;          // Tổng số sự kiện từ lúc khởi động (kể cả đã bị đè)
+    uint32_t exported;
+} trace_end_t;
+
+// Trả về false để dừng xuất
+typedef bool (*trace_export_cb_t)(trace_chunk_kind_t kind, uint8_t count, const void *data, size_t len, void *arg);
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(ev) trace_record(TRACE_EV_##ev, TRACE_PHASE_BEGIN, 0)
+#define TRACE_END(ev) trace_record(TRACE_EV_##ev, TRACE_PHASE_END, 0)
+#define TRACE_INSTANT(ev, arg) trace_record(TRACE_EV_##ev, TRACE_PHASE_INSTANT, (uint8_t)(arg))
+#define TRACE_BEGIN_ARG(ev, arg) trace_record(TRACE_EV_##ev, TRACE_PHASE_BEGIN, (uint8_t)(arg))
+#else
+#define TRACE_BEGIN(ev) do { } while (0)
+#define TRACE_END(ev) do { } while (0)
+#define TRACE_INSTANT(ev, arg) do { } while (0)
+#define TRACE_BEGIN_ARG(ev, arg) do { } while (0)
+#endif
+
+static inline uint32_t trace_now_us(void)
+{
+#if defined(ESP_PLATFORM) || defined(TRACE_CLOCK_ESP_TIMER)
+    return (uint32_t)esp_timer_get_time();
+#else
+    return perf_now_us();
+#endif
+}
+
+void trace_record(trace_event_id_t event, trace_phase_t phase, uint8_t arg);
+void trace_set_enabled(bool enabled);
+bool trace_export(trace_export_cb_t cb, void *arg);
+#ifndef ESP_PLATFORM
+// Bản host: ghi các khối (kind u8, count u8, độ dài u16, dữ liệu) ra file cho trace_to_chrome.py
+bool trace_export_file(const char *path);
+#endif
+
+#endif
@@ -0,0 +1,308 @@
+#include "vitals_log.h"
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_log.h"
+
+static const char *TAG_VLOG = "VLOG";
+
+#define VLOG_PAGES_PER_SECTOR (VLOG_SECTOR_SIZE / VLOG_PAGE_SIZE)
+#define VLOG_CRC_HEADER_BYTES offsetof(vlog_page_header_t, crc32)
+// Sau lần ghi lỗi: số lần thử ghi phải chờ trước khi xóa sector kế tiếp, gấp đôi sau mỗi lần xóa
+// mà vẫn chưa ghi được (lỗi kéo dài không được xóa dần cả vòng log)
+#define VLOG_ERASE_BACKOFF_MIN 32
+#define VLOG_ERASE_BACKOFF_MAX 4096
+
+_Static_assert(sizeof(vlog_record_t) == 16, "vlog_record_t must stay 16 bytes");
+_Static_assert(sizeof(vlog_page_t) <= VLOG_PAGE_SIZE, "vlog_page_t must fit one flash page");
+
+// Bộ đệm đọc cả sector khi mount/xuất dữ liệu (đọc lớn nhanh hơn nhiều so với từng trang)
+static uint8_t vlog_sector_buf[VLOG_SECTOR_SIZE];
+
+
+/**
+ * @brief CRC32 (IEEE 802.3, giống zlib.crc32), có thể nối tiếp nhiều đoạn.
+ */
+uint32_t vlog_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t page_crc(const vlog_page_header_t *header, const vlog_record_t *records)
+{
+    uint32_t crc = vlog_crc32(0, header, VLOG_CRC_HEADER_BYTES);
+    return vlog_crc32(crc, records, header->count * sizeof(vlog_record_t));
+}
+
+static bool page_is_blank(const uint8_t *page)
+{
+    for (int i = 0; i < VLOG_PAGE_SIZE; i++) {
+        if (page[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static bool page_is_valid(const uint8_t *page)
+{
+    const vlog_page_header_t *header = (const vlog_page_header_t *)page;
+    if (header->magic != VLOG_MAGIC || header->version != VLOG_VERSION ||
+        header->count == 0 || header->count > VLOG_RECORDS_PER_PAGE) {
+        return false;
+    }
+    return page_crc(header, (const vlog_record_t *)(page + sizeof(vlog_page_header_t))) == header->crc32;
+}
+
+
+// =========================================================
+// FLASH THẬT: PARTITION "vitals"
+// =========================================================
+
+static esp_err_t partition_read(void *ctx, uint32_t offset, void *dst, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, dst, len);
+}
+
+static esp_err_t partition_write(void *ctx, uint32_t offset, const void *src, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, src, len);
+}
+
+static esp_err_t partition_erase(void *ctx, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len);
+}
+
+esp_err_t vitals_log_flash_partition(vlog_flash_t *flash, const char *label)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL) {
+        ESP_LOGW(TAG_VLOG, "Partition '%s' not found", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    flash->read = partition_read;
+    flash->write = partition_write;
+    flash->erase = partition_erase;
+    flash->ctx = (void *)part;
+    flash->size = part->size - (part->size % VLOG_SECTOR_SIZE);
+    return ESP_OK;
+}
+
+
+// =========================================================
+// LOG VÒNG
+// =========================================================
+
+/**
+ * @brief Quét toàn bộ vùng log: tìm trang mới nhất (seq lớn nhất) để đặt đầu ghi ngay sau nó.
+ * Trang ghi dở (CRC sai) bị bỏ qua, không làm mất các trang khác.
+ */
+esp_err_t vitals_log_mount(vitals_log_t *log, const vlog_flash_t *flash)
+{
+    memset(log, 0, sizeof(*log));
+    log->flash = *flash;
+    log->page_count = flash->size / VLOG_PAGE_SIZE;
+    if (log->page_count < 2 * VLOG_PAGES_PER_SECTOR) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    bool found = false;
+    uint32_t newest_page = 0, newest_seq = 0;
+    uint16_t newest_boot = 0;
+
+    for (uint32_t offset = 0; offset < flash->size; offset += VLOG_SECTOR_SIZE) {
+        esp_err_t ret = flash->read(flash->ctx, offset, vlog_sector_buf, VLOG_SECTOR_SIZE);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        for (int p = 0; p < VLOG_PAGES_PER_SECTOR; p++) {
+            const uint8_t *page = vlog_sector_buf + p * VLOG_PAGE_SIZE;
+            if (page_is_blank(page)) {
+                continue;
+            }
+            if (!page_is_valid(page)) {
+                log->corrupt_pages++;
+                continue;
+            }
+            const vlog_page_header_t *header = (const vlog_page_header_t *)page;
+            log->valid_pages++;
+            // So sánh seq theo hiệu có dấu để vẫn đúng khi seq tràn 32 bit
+            if (!found || (int32_t)(header->seq - newest_seq) > 0) {
+                found = true;
+                newest_seq = header->seq;
+                newest_boot = header->boot_id;
+                newest_page = offset / VLOG_PAGE_SIZE + p;
+            }
+        }
+    }
+
+    if (found) {
+        log->head = (newest_page + 1) % log->page_count;
+        log->next_seq = newest_seq + 1;
+        log->boot_id = newest_boot + 1;
+    }
+    ESP_LOGI(TAG_VLOG, "Mounted: %u/%u pages valid, %u corrupt, head=%u, boot=%u",
+             (unsigned)log->valid_pages, (unsigned)log->page_count, (unsigned)log->corrupt_pages,
+             (unsigned)log->head, log->boot_id);
+    return ESP_OK;
+}
+
+/**
+ * @brief Ghi trang đang gom xuống vị trí đầu ghi. Vào sector mới thì xóa sector đó trước
+ * (bỏ VLOG_PAGES_PER_SECTOR trang cũ nhất); trang không trắng do ghi dở thì bỏ qua.
+ * Ghi lỗi thì chỉ bỏ qua trang đó; sector kế tiếp chỉ được xóa khi đã ghi lại được,
+ * hoặc sau erase_backoff lần thử (trả về ESP_ERR_INVALID_STATE trong lúc chờ).
+ */
+static esp_err_t write_pending_page(vitals_log_t *log)
+{
+    static uint8_t page[VLOG_PAGE_SIZE];
+    vlog_flash_t *flash = &log->flash;
+
+    vlog_page_header_t *header = &log->pending.header;
+    header->magic = VLOG_MAGIC;
+    header->version = VLOG_VERSION;
+    header->seq = log->next_seq;
+    header->boot_id = log->boot_id;
+    header->reserved = 0xFFFF;
+    header->crc32 = page_crc(header, log->pending.records);
+
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, header, sizeof(*header));
+    memcpy(page + sizeof(*header), log->pending.records, header->count * sizeof(vlog_record_t));
+
+    for (uint32_t tries = 0; tries < log->page_count; tries++) {
+        uint32_t offset = log->head * VLOG_PAGE_SIZE;
+        esp_err_t ret;
+
+        if (log->head % VLOG_PAGES_PER_SECTOR == 0) {
+            if (log->erase_backoff > 0) {
+                log->erase_backoff--;
+                return ESP_ERR_INVALID_STATE;
+            }
+            ret = flash->erase(flash->ctx, offset, VLOG_SECTOR_SIZE);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            log->sectors_erased++;
+            if (log->erase_interval > 0 && log->erase_interval < VLOG_ERASE_BACKOFF_MAX) {
+                log->erase_interval *= 2;
+            }
+        } else {
+            ret = flash->read(flash->ctx, offset, vlog_sector_buf, VLOG_PAGE_SIZE);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            if (!page_is_blank(vlog_sector_buf)) {
+                log->head = (log->head + 1) % log->page_count;
+                continue;
+            }
+        }
+
+        ret = flash->write(flash->ctx, offset, page, VLOG_PAGE_SIZE);
+        log->head = (log->head + 1) % log->page_count;
+        if (ret == ESP_OK) {
+            log->next_seq++;
+            log->pages_written++;
+            log->pending.header.count = 0;
+            log->erase_interval = 0;
+            log->erase_backoff = 0;
+        } else {
+            log->write_errors++;
+            if (log->erase_interval == 0) {
+                log->erase_interval = VLOG_ERASE_BACKOFF_MIN;
+            }
+            log->erase_backoff = log->erase_interval;
+        }
+        return ret;
+    }
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Thêm một bản ghi. Chỉ ghi flash khi trang đầy (VLOG_RECORDS_PER_PAGE bản ghi).
+ * Xóa sector (vài chục ms, tạm dừng cache flash) chỉ xảy ra mỗi VLOG_PAGES_PER_SECTOR trang.
+ * Trang đầy còn lại từ lần ghi lỗi trước được thử ghi lại trước; vẫn lỗi thì bỏ bản ghi mới
+ * (đếm vào records_dropped) để không ghi tràn trang đang gom.
+ */
+esp_err_t vitals_log_append(vitals_log_t *log, const vlog_record_t *record)
+{
+    if (log->pending.header.count >= VLOG_RECORDS_PER_PAGE) {
+        esp_err_t ret = write_pending_page(log);
+        if (ret != ESP_OK) {
+            log->records_dropped++;
+            return ret;
+        }
+    }
+    log->pending.records[log->pending.header.count++] = *record;
+    if (log->pending.header.count < VLOG_RECORDS_PER_PAGE) {
+        return ESP_OK;
+    }
+    return write_pending_page(log);
+}
+
+// Ghi ngay trang chưa đầy (ví dụ trước khi ngủ); phần còn trống của trang bị bỏ
+esp_err_t vitals_log_flush(vitals_log_t *log)
+{
+    if (log->pending.header.count == 0) {
+        return ESP_OK;
+    }
+    return write_pending_page(log);
+}
+
+/**
+ * @brief Xuất mọi trang hợp lệ theo thứ tự ghi (cũ nhất trước), đọc từng sector một,
+ * cuối cùng là trang đang gom trong RAM (header.seq = next_seq, crc32 = 0).
+ */
+esp_err_t vitals_log_export(vitals_log_t *log, vlog_export_cb_t cb, void *arg)
+{
+    vlog_flash_t *flash = &log->flash;
+    uint32_t cached_sector = UINT32_MAX;
+
+    for (uint32_t i = 0; i < log->page_count; i++) {
+        uint32_t page_index = (log->head + i) % log->page_count;
+        uint32_t sector = page_index / VLOG_PAGES_PER_SECTOR;
+        if (sector != cached_sector) {
+            esp_err_t ret = flash->read(flash->ctx, sector * VLOG_SECTOR_SIZE, vlog_sector_buf, VLOG_SECTOR_SIZE);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            cached_sector = sector;
+        }
+        const uint8_t *page = vlog_sector_buf + (page_index % VLOG_PAGES_PER_SECTOR) * VLOG_PAGE_SIZE;
+        if (!page_is_valid(page)) {
+            continue;
+        }
+        if (!cb((const vlog_page_header_t *)page, (const vlog_record_t *)(page + sizeof(vlog_page_header_t)), arg)) {
+            return ESP_OK;
+        }
+    }
+
+    if (log->pending.header.count > 0) {
+        vlog_page_header_t header = log->pending.header;
+        header.magic = VLOG_MAGIC;
+        header.version = VLOG_VERSION;
+        header.seq = log->next_seq;
+        header.boot_id = log->boot_id;
+        header.crc32 = 0;
+        cb(&header, log->pending.records, arg);
+    }
+    return ESP_OK;
+}
+
+esp_err_t vitals_log_erase_all(vitals_log_t *log)
+{
+    esp_err_t ret = log->flash.erase(log->flash.ctx, 0, log->flash.size);
+    if (ret == ESP_OK) {
+        log->head = 0;
+        log->valid_pages = 0;
+        log->corrupt_pages = 0;
+        log->pending.header.count = 0;
+    }
+    return ret;
+}
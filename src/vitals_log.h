@@ -0,0 +1,94 @@
+#ifndef VITALS_LOG_H
+#define VITALS_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// =========================================================
+// NHẬT KÝ KẾT QUẢ TRÊN FLASH (LOG VÒNG)
+// =========================================================
+// - Partition riêng (label "vitals") chia thành trang VLOG_PAGE_SIZE byte, mỗi sector 4 KiB
+// - Bản ghi cố định 16 byte được gom trong RAM, đủ một trang mới ghi (mỗi trang chỉ ghi 1 lần)
+// - Ghi tuần tự vòng quanh partition: sector cũ nhất bị xóa khi đầu ghi quay lại,
+//   nên mọi sector bị xóa đều nhau (cân bằng mòn tự nhiên)
+// - Mỗi trang có seq tăng dần và CRC32: trang ghi dở do mất điện bị bỏ qua khi mount
+
+#define VLOG_PARTITION_LABEL "vitals"
+#define VLOG_SECTOR_SIZE 4096
+#define VLOG_PAGE_SIZE 256              // Bằng trang ghi (program page) của SPI flash
+#define VLOG_MAGIC 0x4C56               // "VL"
+#define VLOG_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;                   // Thời gian từ lúc khởi động (kèm boot_id của trang)
+    uint16_t hr_x10;                    // bpm
+    uint16_t spo2_x10;                  // %
+    uint16_t hrv_x10;                   // RMSSD (ms)
+    uint16_t accel_mg;
+    uint8_t ml_class;
+    uint8_t sqi_reason;
+    int16_t temp_x100;                  // °C
+} vlog_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t count;                      // Số bản ghi hợp lệ trong trang
+    uint32_t seq;                       // Tăng dần qua mọi trang, xác định thứ tự trong vòng
+    uint16_t boot_id;                   // Tăng mỗi lần mount
+    uint16_t reserved;
+    uint32_t crc32;                     // Trên 12 byte đầu của header và count bản ghi
+} vlog_page_header_t;
+
+#define VLOG_RECORDS_PER_PAGE ((VLOG_PAGE_SIZE - sizeof(vlog_page_header_t)) / sizeof(vlog_record_t))
+
+typedef struct {
+    vlog_page_header_t header;
+    vlog_record_t records[VLOG_RECORDS_PER_PAGE];
+} vlog_page_t;
+
+/**
+ * @brief Lớp truy cập flash (partition thật trên ESP32, hoặc file giả lập khi thử trên host).
+ * offset tính từ đầu vùng log, erase luôn theo bội số VLOG_SECTOR_SIZE.
+ */
+typedef struct {
+    esp_err_t (*read)(void *ctx, uint32_t offset, void *dst, size_t len);
+    esp_err_t (*write)(void *ctx, uint32_t offset, const void *src, size_t len);
+    esp_err_t (*erase)(void *ctx, uint32_t offset, size_t len);
+    void *ctx;
+    uint32_t size;
+} vlog_flash_t;
+
+typedef struct {
+    vlog_flash_t flash;
+    uint32_t page_count;
+    uint32_t head;                      // Trang sẽ ghi tiếp theo
+    uint32_t next_seq;
+    uint16_t boot_id;
+    vlog_page_t pending;                // Trang đang gom trong RAM
+    // Thống kê
+    uint32_t valid_pages;               // Số trang hợp lệ trên flash
+    uint32_t corrupt_pages;             // Trang hỏng CRC phát hiện khi mount
+    uint32_t pages_written;
+    uint32_t sectors_erased;
+    uint32_t write_errors;              // Lần ghi trang thất bại (trang vẫn giữ trong RAM để thử lại)
+    uint32_t records_dropped;           // Bản ghi bị bỏ vì trang đầy mà vẫn không ghi được
+    uint32_t erase_interval;            // Khác 0 khi đang ghi lỗi: số lần thử chờ trước lần xóa sector kế tiếp
+    uint32_t erase_backoff;             // Số lần thử còn phải chờ trước khi được xóa sector
+} vitals_log_t;
+
+// Gọi lại khi xuất dữ liệu: trả về false để dừng
+typedef bool (*vlog_export_cb_t)(const vlog_page_header_t *header, const vlog_record_t *records, void *arg);
+
+esp_err_t vitals_log_flash_partition(vlog_flash_t *flash, const char *label);
+esp_err_t vitals_log_mount(vitals_log_t *log, const vlog_flash_t *flash);
+esp_err_t vitals_log_append(vitals_log_t *log, const vlog_record_t *record);
+esp_err_t vitals_log_flush(vitals_log_t *log);
+esp_err_t vitals_log_export(vitals_log_t *log, vlog_export_cb_t cb, void *arg);
+esp_err_t vitals_log_erase_all(vitals_log_t *log);
+
+uint32_t vlog_crc32(uint32_t crc, const void *data, size_t len);
+
+#endif
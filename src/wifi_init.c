@@ -1,46 +1,84 @@
+#include "wifi_init.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_system.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "esp_netif.h"
 
 static const char *TAG = "wifi station";
 
 static EventGroupHandle_t s_wifi_event_group;
-const static int WIFI_CONNECTED_BIT = BIT0;
-const static int WIFI_FAIL_BIT      = BIT1;
+static const int WIFI_CONNECTED_BIT = BIT0;
 
-static int s_retry_num = 0;
+static esp_timer_handle_t s_retry_timer;
+static uint32_t s_backoff_ms = WIFI_BACKOFF_MIN_MS;
+static uint32_t s_retry_num = 0;
+static uint32_t s_connect_count = 0;
 
-#define SSID           "Thanh An 2"
-#define PASSWORD       "29051999"
-#define MAXIMUM_RETRY  500
+// Thông tin mạng lấy từ menuconfig (Kconfig.projbuild), không ghi cứng trong mã nguồn
+#define SSID           CONFIG_ESP_WIFI_SSID
+#define PASSWORD       CONFIG_ESP_WIFI_PASSWORD
 
-void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+static void retry_timer_cb(void *arg)
+{
+    esp_wifi_connect();
+}
+
+/**
+ * @brief Mất kết nối: hẹn giờ kết nối lại với thời gian chờ tăng gấp đôi mỗi lần
+ * (WIFI_BACKOFF_MIN_MS .. WIFI_BACKOFF_MAX_MS), không bao giờ chặn task nào.
+ */
+static void schedule_reconnect(void)
+{
+    s_retry_num++;
+    ESP_LOGI(TAG, "retry %u in %u ms", (unsigned)s_retry_num, (unsigned)s_backoff_ms);
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, (uint64_t)s_backoff_ms * 1000);
+
+    s_backoff_ms *= 2;
+    if (s_backoff_ms > WIFI_BACKOFF_MAX_MS) {
+        s_backoff_ms = WIFI_BACKOFF_MAX_MS;
+    }
+}
+
+static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < MAXIMUM_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
-        } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        }
-        ESP_LOGI(TAG,"connect to the AP fail");
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        schedule_reconnect();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        ESP_LOGI(TAG, "got ip:" IPSTR " after %u retries", IP2STR(&event->ip_info.ip), (unsigned)s_retry_num);
         s_retry_num = 0;
+        s_backoff_ms = WIFI_BACKOFF_MIN_MS;
+        s_connect_count++;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
-void wifi_init_sta(void)
+/**
+ * @brief Khởi động Wi-Fi station và trả về ngay. Kết nối/kết nối lại chạy nền theo sự kiện,
+ * nên việc đo không phụ thuộc vào việc có mạng hay không.
+ */
+esp_err_t wifi_init_sta(void)
 {
     s_wifi_event_group = xEventGroupCreate();
+    if (s_wifi_event_group == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t retry_args = {
+        .callback = retry_timer_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_args, &s_retry_timer));
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -51,28 +89,25 @@ void wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = SSID,
-            .password = PASSWORD
-        },
-    };
+    wifi_config_t wifi_config = { 0 };
+    strncpy((char *)wifi_config.sta.ssid, SSID, sizeof(wifi_config.sta.ssid));
+    strncpy((char *)wifi_config.sta.password, PASSWORD, sizeof(wifi_config.sta.password));
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    ESP_LOGI(TAG, "connecting to SSID:%s in background", SSID);
+    return ESP_OK;
+}
 
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "connected to ap SSID:%s password:%s", SSID, PASSWORD);
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID:%s, password:%s", SSID, PASSWORD);
-    } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
-    }
+bool wifi_is_connected(void)
+{
+    return s_wifi_event_group != NULL &&
+           (xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT) != 0;
+}
 
-    ESP_ERROR_CHECK(esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler));
-    ESP_ERROR_CHECK(esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler));
-    vEventGroupDelete(s_wifi_event_group);
+uint32_t wifi_connect_count(void)
+{
+    return s_connect_count;
 }
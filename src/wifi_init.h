@@ -1,6 +1,16 @@
 #ifndef WIFI_INIT_H
 #define WIFI_INIT_H
 
-void wifi_init_sta(void);
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#define WIFI_BACKOFF_MIN_MS 1000        // Lần thử lại đầu tiên sau khi mất kết nối
+#define WIFI_BACKOFF_MAX_MS 60000       // Trần của thời gian chờ (tăng gấp đôi mỗi lần)
+
+esp_err_t wifi_init_sta(void);
+bool wifi_is_connected(void);
+uint32_t wifi_connect_count(void);
 
 #endif
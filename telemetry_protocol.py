@@ -0,0 +1,318 @@
+"""
+Giao thức telemetry nhị phân của ESP32 (PHẢI KHỚP VỚI src/telemetry.h, src/telemetry_udp.h).
+Dùng chung cho dashboard_monitor.py (UART) và udp_collector.py (Wi-Fi/UDP).
+
+Khung: COBS( type | seq u16 | payload | CRC16 u16 ) + 0x00, little-endian
+Datagram UDP: tlm_udp_header_t | các khung COBS liên tiếp (mỗi khung kết thúc bằng 0x00)
+"""
+import struct
+
+TLM_MSG_VITALS = 0x01
+TLM_MSG_RAW = 0x02
+TLM_MSG_EVENT = 0x03
+TLM_MSG_DIAG = 0x04
+TLM_MSG_CONFIG = 0x05
+TLM_MSG_PERF = 0x06
+TLM_MSG_SYSMON = 0x07
+TLM_MSG_TRACE = 0x08
+
+# Lệnh host -> thiết bị (cùng định dạng khung)
+TLM_MSG_CONFIG_SET = 0x10
+TLM_MSG_CONFIG_GET = 0x11
+TLM_MSG_TRACE_DUMP = 0x12
+
+TLM_EVT_SQI_REJECT = 0x01
+TLM_EVT_LOW_CORRELATION = 0x02
+TLM_EVT_PROX_ENTER = 0x03
+TLM_EVT_PROX_EXIT = 0x04
+TLM_EVT_AGC = 0x05
+
+# tlm_vitals_t: time, class, sqi, hr, spo2, hrv, accel, energy, sdnn, pnn50, lf, hf, lf/hf, rr, temp
+VITALS_FORMAT = "<IBBHHHHHHHIIHHh"
+EVENT_HEADER_FORMAT = "<IB"
+EVT_SQI_FORMAT = "<BIHHhHHh"
+EVT_CORR_FORMAT = "<hh"
+EVT_AGC_FORMAT = "<BBBBBBHH"
+DIAG_FORMAT = "<IIIIIIIIIIIIIIII"
+
+# Cấu hình chạy (thứ tự = config_param_id_t trong src/config_store.h)
+CONFIG_PARAMS = ["accel_thr", "min_corr", "hr_base", "spo2_a", "spo2_b", "spo2_c",
+                 "min_ac_ratio", "led1_pa", "led2_pa", "acq_profile"]
+CONFIG_STATUS = ["OK", "Unknown key", "Out of range", "NVS error"]
+TLM_CONFIG_ALL = 0xFF
+TLM_CONFIG_PERSIST = 0x01
+CONFIG_FORMAT = "<IBBf"           # tlm_config_t: version, param, status, value
+CONFIG_SET_FORMAT = "<BfB"        # tlm_config_set_t: param, value, flags
+
+# Thời gian từng bước xử lý (thứ tự = perf_stage_t trong src/perf_stats.h)
+PERF_STAGES = ["acq", "sqi", "dc", "nlms", "beat", "acorr", "spo2", "ml", "oled", "win"]
+PERF_HEADER_FORMAT = "<IIB"       # time_ms, interval_ms, stage_count
+PERF_STAGE_FORMAT = "<HIIII"      # count, min, avg, p99, max (µs)
+
+# tlm_sysmon_t: time, heap free/min/largest, heap delta, lỗi I2C, timeout I2C, tổng task, số task | các task
+SYSMON_HEADER_FORMAT = "<IIIIiIIBB"
+SYSMON_TASK_FORMAT = "<8sHH"      # tên, kích thước stack, byte chưa từng dùng
+
+# Ghi vết (thứ tự = trace_event_id_t trong src/trace_recorder.h)
+TRACE_EVENTS = ["acquire", "dsp", "accel_drain", "display", "alarm", "tlm_write", "hrv_spectrum",
+                "sqi_reject", "agc", "vitals"]
+TRACE_CHUNK_TASKS, TRACE_CHUNK_EVENTS, TRACE_CHUNK_END = 0, 1, 2
+TRACE_CHUNK_HEADER_FORMAT = "<BB"     # tlm_trace_header_t: kind, count
+TRACE_FILE_CHUNK_FORMAT = "<BBH"      # File dump từ bản host: kind, count, độ dài dữ liệu
+TRACE_EVENT_FORMAT = "<IBBBB"         # trace_event_t: time_us, event, phase, task, arg
+TRACE_END_FORMAT = "<II"              # trace_end_t: recorded, exported
+TRACE_TASK_NAME_LEN = 8
+
+# Khung dạng sóng thô: header | mỗi kênh (giá trị đầu i32, độ rộng bit u8) | delta zigzag ghép bit
+TLM_RAW_PPG = 0x01
+TLM_RAW_ACCEL = 0x02
+TLM_RAW_FLAG_DISCONTINUITY = 0x01
+RAW_HEADER_FORMAT = "<BBBBIH"
+RAW_STREAM_NAMES = {TLM_RAW_PPG: ("ppg", ["red", "ir"]), TLM_RAW_ACCEL: ("accel", ["ax", "ay", "az"])}
+
+# Tên lớp ML (giống g_stress_status trong main.c)
+CLASS_NAMES = ["Normal", "Stress/Risk", "Moving", "Low SpO2!", "Arrhythmia!"]
+SQI_REASONS = ["OK", "No finger", "Saturated", "ADC range", "Low perfusion",
+               "High perfusion", "Artifact", "Irregular"]
+
+
+def tlm_crc16(data):
+    """CRC16-CCITT (0x1021, khởi tạo 0xFFFF)"""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """Giải mã COBS (không gồm byte phân cách). Trả về None nếu khung hỏng."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def cobs_encode(data):
+    """Mã hóa COBS (không gồm byte phân cách 0x00 ở cuối)."""
+    out = bytearray([0])
+    code_pos, code = 0, 1
+    for b in data:
+        if b == 0:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+            continue
+        out.append(b)
+        code += 1
+        if code == 0xFF:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+    out[code_pos] = code
+    return bytes(out)
+
+
+def build_frame(msg_type, seq, payload):
+    """Đóng khung gửi xuống thiết bị: COBS(type | seq | payload | CRC16) + 0x00."""
+    body = struct.pack("<BH", msg_type, seq & 0xFFFF) + payload
+    return cobs_encode(body + struct.pack("<H", tlm_crc16(body))) + b"\x00"
+
+
+def config_set_frame(seq, name, value, persist=False):
+    payload = struct.pack(CONFIG_SET_FORMAT, CONFIG_PARAMS.index(name), float(value),
+                          TLM_CONFIG_PERSIST if persist else 0)
+    return build_frame(TLM_MSG_CONFIG_SET, seq, payload)
+
+
+def config_get_frame(seq, name=None):
+    param = TLM_CONFIG_ALL if name is None else CONFIG_PARAMS.index(name)
+    return build_frame(TLM_MSG_CONFIG_GET, seq, bytes([param]))
+
+
+def decode_raw(payload):
+    """Giải nén khung TLM_MSG_RAW. Trả về (stream, flags, t0_ms, period_us, [kênh][mẫu])."""
+    stream, flags, count, channels, t0_ms, period_us = struct.unpack_from(RAW_HEADER_FORMAT, payload)
+    pos = struct.calcsize(RAW_HEADER_FORMAT)
+    firsts, widths = [], []
+    for _ in range(channels):
+        first, width = struct.unpack_from("<iB", payload, pos)
+        firsts.append(first)
+        widths.append(width)
+        pos += 5
+
+    bits = int.from_bytes(payload[pos:], "little")
+    data = []
+    for c in range(channels):
+        values = [firsts[c]]
+        mask = (1 << widths[c]) - 1
+        for _ in range(count - 1):
+            zz = bits & mask
+            bits >>= widths[c]
+            values.append(values[-1] + ((zz >> 1) ^ -(zz & 1)))
+        data.append(values)
+    return stream, flags, t0_ms, period_us, data
+
+
+def decode_perf(payload):
+    """Trả về (time_ms, interval_ms, [(tên, count, min, avg, p99, max), ...]) của khung TLM_MSG_PERF."""
+    time_ms, interval_ms, stage_count = struct.unpack_from(PERF_HEADER_FORMAT, payload)
+    pos = struct.calcsize(PERF_HEADER_FORMAT)
+    stages = []
+    for i in range(stage_count):
+        name = PERF_STAGES[i] if i < len(PERF_STAGES) else f"#{i}"
+        stages.append((name,) + struct.unpack_from(PERF_STAGE_FORMAT, payload, pos))
+        pos += struct.calcsize(PERF_STAGE_FORMAT)
+    return time_ms, interval_ms, stages
+
+
+def format_perf(stages):
+    """Một dòng "tên min/avg/p99/max" (µs) cho các bước có số đo."""
+    return " ".join(f"{name} {mn}/{avg}/{p99}/{mx}" for name, count, mn, avg, p99, mx in stages if count)
+
+
+def decode_sysmon(payload):
+    """Trả về (dict header, [(tên, stack_size, stack_free_min), ...]) của khung TLM_MSG_SYSMON."""
+    fields = struct.unpack_from(SYSMON_HEADER_FORMAT, payload)
+    keys = ("time_ms", "heap_free", "heap_min_free", "heap_largest", "heap_delta",
+            "i2c_errors", "i2c_timeouts", "task_total", "task_count")
+    header = dict(zip(keys, fields))
+    pos = struct.calcsize(SYSMON_HEADER_FORMAT)
+    tasks = []
+    for _ in range(header["task_count"]):
+        name, size, free = struct.unpack_from(SYSMON_TASK_FORMAT, payload, pos)
+        tasks.append((name.split(b"\0")[0].decode(errors="replace"), size, free))
+        pos += struct.calcsize(SYSMON_TASK_FORMAT)
+    return header, tasks
+
+
+def format_sysmon(header, tasks):
+    """Một dòng: heap và "tên dùng/tổng" stack (byte) của từng task ("tên -/còn" nếu không biết kích thước)."""
+    stacks = " ".join(f"{name} {size - free}/{size}" if size else f"{name} -/{free}" for name, size, free in tasks)
+    return (f"heap {header['heap_free']} (min {header['heap_min_free']}, block {header['heap_largest']}, "
+            f"delta {header['heap_delta']:+d}) | I2C err {header['i2c_errors']} timeout {header['i2c_timeouts']} "
+            f"| {header['task_total']} task: {stacks}")
+
+
+class TraceAssembler:
+    """Gom các khối của một lần xuất ghi vết (khung TLM_MSG_TRACE hoặc file dump của bản host)."""
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.tasks = []
+        self.events = []
+        self.recorded = 0
+
+    def add_chunk(self, kind, count, data):
+        """Trả về True khi nhận khối kết thúc (dữ liệu đủ để chuyển đổi)."""
+        if kind == TRACE_CHUNK_TASKS:
+            self.reset()
+            self.tasks = [data[i * TRACE_TASK_NAME_LEN:(i + 1) * TRACE_TASK_NAME_LEN].split(b"\0")[0]
+                          .decode(errors="replace") for i in range(count)]
+        elif kind == TRACE_CHUNK_EVENTS:
+            self.events.extend(struct.iter_unpack(TRACE_EVENT_FORMAT, data[:count * struct.calcsize(TRACE_EVENT_FORMAT)]))
+        elif kind == TRACE_CHUNK_END:
+            self.recorded, _ = struct.unpack_from(TRACE_END_FORMAT, data)
+            return True
+        return False
+
+    def add_frame(self, payload):
+        kind, count = struct.unpack_from(TRACE_CHUNK_HEADER_FORMAT, payload)
+        return self.add_chunk(kind, count, payload[struct.calcsize(TRACE_CHUNK_HEADER_FORMAT):])
+
+    def to_chrome(self):
+        """Chuyển sang Chrome trace JSON (dict), mở bằng ui.perfetto.dev hoặc chrome://tracing."""
+        out = [{"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "ESP32 PPG"}}]
+        for tid, name in enumerate(self.tasks):
+            out.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": name}})
+
+        depth = {}
+        offset, last = 0, None
+        for time_us, event, phase, task, arg in self.events:
+            # time_us 32 bit tràn sau ~71 phút; sai lệch nhỏ giữa hai core không phải tràn
+            if last is not None and time_us + offset < last - (1 << 31):
+                offset += 1 << 32
+            ts = time_us + offset
+            last = ts
+            ph = chr(phase)
+            # Vòng bắt đầu giữa chừng: bỏ các END không có BEGIN tương ứng
+            if ph == "E":
+                if depth.get(task, 0) == 0:
+                    continue
+                depth[task] -= 1
+            elif ph == "B":
+                depth[task] = depth.get(task, 0) + 1
+            name = TRACE_EVENTS[event] if event < len(TRACE_EVENTS) else f"event{event}"
+            item = {"name": name, "ph": ph, "ts": ts, "pid": 1, "tid": task}
+            if ph == "i":
+                item["s"] = "t"
+            if ph != "E":
+                item["args"] = {"arg": arg}
+            out.append(item)
+        return {"traceEvents": out, "displayTimeUnit": "ms",
+                "otherData": {"recorded": self.recorded, "exported": len(self.events)}}
+
+
+def read_trace_file(path):
+    """Đọc file dump do bản host ghi (các khối: kind, count, độ dài, dữ liệu)."""
+    trace = TraceAssembler()
+    with open(path, "rb") as f:
+        data = f.read()
+    pos, size = 0, struct.calcsize(TRACE_FILE_CHUNK_FORMAT)
+    while pos + size <= len(data):
+        kind, count, length = struct.unpack_from(TRACE_FILE_CHUNK_FORMAT, data, pos)
+        pos += size
+        if trace.add_chunk(kind, count, data[pos:pos + length]):
+            break
+        pos += length
+    return trace
+
+
+def parse_frame(chunk):
+    """Trả về (type, seq, payload) nếu chunk là khung hợp lệ, ngược lại None."""
+    frame = cobs_decode(chunk)
+    if frame is None or len(frame) < 5:
+        return None
+    body, crc = frame[:-2], struct.unpack("<H", frame[-2:])[0]
+    if tlm_crc16(body) != crc:
+        return None
+    msg_type, seq = struct.unpack("<BH", body[:3])
+    return msg_type, seq, body[3:]
+
+
+# tlm_udp_header_t: magic, version, số khung, seq datagram
+UDP_MAGIC = 0x4854
+UDP_VERSION = 1
+UDP_HEADER_FORMAT = "<HBBI"
+
+
+def parse_datagram(data):
+    """Trả về (seq, [(type, seq, payload), ...], số khung hỏng) hoặc None nếu không phải datagram telemetry."""
+    size = struct.calcsize(UDP_HEADER_FORMAT)
+    if len(data) < size:
+        return None
+    magic, version, frame_count, seq = struct.unpack_from(UDP_HEADER_FORMAT, data)
+    if magic != UDP_MAGIC or version != UDP_VERSION:
+        return None
+    frames, bad = [], 0
+    for chunk in data[size:].split(b"\x00"):
+        if not chunk:
+            continue
+        parsed = parse_frame(chunk)
+        if parsed is None:
+            bad += 1
+        else:
+            frames.append(parsed)
+    bad += max(0, frame_count - len(frames) - bad)
+    return seq, frames, bad
@@ -0,0 +1,29 @@
+"""
+Chuyển file dump ghi vết (bản host, trace_export_file()) sang Chrome trace JSON.
+Dump từ ESP32 qua telemetry được dashboard_monitor.py lưu thẳng thành JSON.
+
+Cách dùng:  python3 trace_to_chrome.py trace.bin [-o trace.json]
+Mở kết quả bằng https://ui.perfetto.dev hoặc chrome://tracing
+"""
+import argparse
+import json
+import os
+
+from telemetry_protocol import read_trace_file
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a trace dump to Chrome trace JSON")
+    parser.add_argument("dump")
+    parser.add_argument("-o", "--output", help="mặc định: cùng tên, đuôi .json")
+    args = parser.parse_args()
+
+    trace = read_trace_file(args.dump)
+    output = args.output or os.path.splitext(args.dump)[0] + ".json"
+    with open(output, "w") as f:
+        json.dump(trace.to_chrome(), f)
+    print(f"{len(trace.events)} events ({trace.recorded} recorded), {len(trace.tasks)} tasks -> {output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,100 @@
+"""
+Collector UDP cho telemetry qua Wi-Fi (CONFIG_TLM_UDP_ENABLE).
+Nghe trên một cổng UDP, kiểm tra seq của datagram và của từng khung, in kết quả ra terminal.
+
+Cách dùng:  python3 udp_collector.py [--port 5005] [--raw-csv raw.csv]
+"""
+import argparse
+import socket
+import struct
+import time
+
+from telemetry_protocol import *
+
+
+def describe(msg_type, payload):
+    if msg_type == TLM_MSG_VITALS:
+        v = struct.unpack_from(VITALS_FORMAT, payload)
+        name = CLASS_NAMES[v[1]] if v[1] < len(CLASS_NAMES) else str(v[1])
+        return f"VITALS t={v[0]} HR={v[3] / 10.0:.1f} SpO2={v[4] / 10.0:.1f} HRV={v[5] / 10.0:.1f} class={name}"
+    if msg_type == TLM_MSG_EVENT:
+        t_ms, code = struct.unpack_from(EVENT_HEADER_FORMAT, payload)
+        return f"EVENT t={t_ms} code={code}"
+    if msg_type == TLM_MSG_DIAG:
+        d = struct.unpack_from(DIAG_FORMAT, payload)
+        return (f"DIAG t={d[0]} tlm={d[8]}/{d[9]} raw={d[10]}/{d[11]} "
+                f"udp datagrams={d[12]} dropped={d[13]} send_err={d[14]} ppg_lost={d[15]}")
+    if msg_type == TLM_MSG_PERF:
+        t_ms, interval_ms, stages = decode_perf(payload)
+        return f"PERF t={t_ms} ({interval_ms} ms) min/avg/p99/max us: {format_perf(stages)}"
+    if msg_type == TLM_MSG_SYSMON:
+        header, tasks = decode_sysmon(payload)
+        return f"SYSMON t={header['time_ms']} {format_sysmon(header, tasks)}"
+    if msg_type == TLM_MSG_RAW:
+        stream, flags, t0_ms, period_us, data = decode_raw(payload)
+        return f"RAW stream={stream} t0={t0_ms} n={len(data[0])} flags={flags}"
+    return f"type={msg_type} len={len(payload)}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32 UDP telemetry collector")
+    parser.add_argument("--port", type=int, default=5005)
+    parser.add_argument("--raw-csv", help="Ghi mẫu dạng sóng thô vào file CSV")
+    parser.add_argument("--quiet", action="store_true", help="Không in khung RAW")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", args.port))
+    print(f"[UDP] Listening on port {args.port}")
+
+    raw_file = open(args.raw_csv, "w", buffering=1) if args.raw_csv else None
+    if raw_file:
+        raw_file.write("t_ms,stream,flags,ch0,ch1,ch2\n")
+
+    last_dgram_seq = None
+    last_frame_seq = None
+    dgrams_lost = frames_lost = bad_frames = 0
+    last_losses = (0, 0, 0)
+    start = time.time()
+
+    try:
+        while True:
+            data, addr = sock.recvfrom(2048)
+            parsed = parse_datagram(data)
+            if parsed is None:
+                print(f"[UDP] Datagram lạ từ {addr[0]} ({len(data)} byte)")
+                continue
+            seq, frames, bad = parsed
+            bad_frames += bad
+            if last_dgram_seq is not None and seq != (last_dgram_seq + 1) & 0xFFFFFFFF:
+                dgrams_lost += (seq - last_dgram_seq - 1) & 0xFFFFFFFF
+            last_dgram_seq = seq
+
+            for msg_type, frame_seq, payload in frames:
+                if last_frame_seq is not None:
+                    frames_lost += (frame_seq - last_frame_seq - 1) & 0xFFFF
+                last_frame_seq = frame_seq
+
+                if msg_type == TLM_MSG_RAW and raw_file:
+                    stream, flags, t0_ms, period_us, samples = decode_raw(payload)
+                    for k in range(len(samples[0])):
+                        row = [str(ch[k]) for ch in samples] + [""] * (3 - len(samples))
+                        raw_file.write(f"{t0_ms + k * period_us / 1000.0:.2f},{stream},{flags if k == 0 else 0},"
+                                       + ",".join(row) + "\n")
+                if msg_type == TLM_MSG_RAW and args.quiet:
+                    continue
+                print(f"[{time.time() - start:8.2f}] #{seq} {describe(msg_type, payload)}")
+
+            losses = (dgrams_lost, frames_lost, bad_frames)
+            if losses != last_losses:
+                print(f"[UDP] Mất datagram={dgrams_lost}, mất khung={frames_lost}, khung hỏng={bad_frames}")
+                last_losses = losses
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if raw_file:
+            raw_file.close()
+
+
+if __name__ == "__main__":
+    main()
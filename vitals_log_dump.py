@@ -0,0 +1,73 @@
+"""
+Giải mã nhật ký kết quả trên flash (partition "vitals", src/vitals_log.h) thành CSV.
+
+Đọc partition từ thiết bị (nhanh, qua bootloader):
+    parttool.py --port COM3 read_partition --partition-name vitals --output vitals.bin
+    python3 vitals_log_dump.py vitals.bin vitals.csv
+"""
+import struct
+import sys
+import zlib
+
+from telemetry_protocol import CLASS_NAMES, SQI_REASONS
+
+PAGE_SIZE = 256
+MAGIC = 0x4C56
+VERSION = 1
+HEADER_FORMAT = "<HBBIHHI"          # magic, version, count, seq, boot_id, reserved, crc32
+RECORD_FORMAT = "<IHHHHBBh"         # time, hr, spo2, hrv, accel, class, sqi, temp
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+CRC_HEADER_BYTES = HEADER_SIZE - 4
+
+
+def read_pages(image):
+    """Trả về các trang hợp lệ (seq, boot_id, [record...]) theo thứ tự ghi."""
+    pages, corrupt = [], 0
+    for offset in range(0, len(image) - PAGE_SIZE + 1, PAGE_SIZE):
+        page = image[offset:offset + PAGE_SIZE]
+        if page == b"\xff" * PAGE_SIZE:
+            continue
+        magic, version, count, seq, boot_id, _, crc = struct.unpack_from(HEADER_FORMAT, page)
+        body = page[HEADER_SIZE:HEADER_SIZE + count * RECORD_SIZE]
+        if (magic != MAGIC or version != VERSION or count == 0 or len(body) < count * RECORD_SIZE
+                or zlib.crc32(body, zlib.crc32(page[:CRC_HEADER_BYTES])) != crc):
+            corrupt += 1
+            continue
+        records = [struct.unpack_from(RECORD_FORMAT, body, i * RECORD_SIZE) for i in range(count)]
+        pages.append((seq, boot_id, records))
+    # seq tăng dần (có thể tràn 32 bit): bắt đầu từ trang ngay sau khoảng nhảy lớn nhất
+    pages.sort(key=lambda p: p[0])
+    if pages:
+        gaps = [(pages[i][0] - pages[i - 1][0]) & 0xFFFFFFFF for i in range(1, len(pages))]
+        if gaps and max(gaps) > 0x7FFFFFFF:
+            split = gaps.index(max(gaps)) + 1
+            pages = pages[split:] + pages[:split]
+    return pages, corrupt
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    with open(sys.argv[1], "rb") as f:
+        image = f.read()
+    pages, corrupt = read_pages(image)
+    out = open(sys.argv[2], "w") if len(sys.argv) > 2 else sys.stdout
+
+    out.write("boot_id,time_ms,hr,spo2,hrv,accel_g,class,sqi,temp_c\n")
+    count = 0
+    for seq, boot_id, records in pages:
+        for t, hr, spo2, hrv, accel, cls, sqi, temp in records:
+            cls_name = CLASS_NAMES[cls] if cls < len(CLASS_NAMES) else str(cls)
+            sqi_name = SQI_REASONS[sqi] if sqi < len(SQI_REASONS) else str(sqi)
+            out.write(f"{boot_id},{t},{hr / 10.0:.1f},{spo2 / 10.0:.1f},{hrv / 10.0:.1f},"
+                      f"{accel / 1000.0:.3f},{cls_name},{sqi_name},{temp / 100.0:.2f}\n")
+            count += 1
+    if out is not sys.stdout:
+        out.close()
+    print(f"{len(pages)} pages, {count} records, {corrupt} corrupt pages", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()